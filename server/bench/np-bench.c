@@ -0,0 +1,2029 @@
+/**
+ * @file np-bench.c
+ * @brief Netopeer server benchmark driver
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#ifdef NP_SSH
+#	include <libnetconf_ssh.h>
+#endif
+#ifdef NP_TLS
+#	include <libnetconf_tls.h>
+#endif
+#include <libxml/parser.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "../src/datastore_snapshot.h"
+
+/* version of the JSON output, increase on any incompatible change */
+#define BENCH_SCHEMA "netopeer-bench/1"
+
+#ifdef __GNUC__
+#	define UNUSED(x) UNUSED_ ## x __attribute__((__unused__))
+#else
+#	define UNUSED(x) UNUSED_ ## x
+#endif
+
+#define NETOPEER_NS "urn:cesnet:tmc:netopeer:1.0"
+#define NETCONF_NS "urn:ietf:params:xml:ns:netconf:base:1.0"
+
+/* client thread stack, libnetconf parses the replies on it */
+#define BENCH_STACK_SIZE (256*1024)
+
+/* seconds to wait for the last notification */
+#define BENCH_NOTIF_TIMEOUT 30
+
+/* loads of the synthetic datastore measured, and the parser options of the journal datastore */
+#define BENCH_STARTUP_RUNS 5
+#define BENCH_PARSE_OPTS (XML_PARSE_NOBLANKS|XML_PARSE_NSCLEAN|XML_PARSE_NOWARNING|XML_PARSE_NOERROR|XML_PARSE_HUGE)
+
+/* commits, unchanged-datastores, aligned-datastores and changed-subtrees of /netopeer/commit */
+#define BENCH_COMMIT_COUNTERS 4
+
+/* the ids of the cert-to-name entries of the bulk scenario, after any real ones */
+#define BENCH_BULK_ID 4000000000U
+#define X509C2N_NS "urn:ietf:params:xml:ns:yang:ietf-x509-cert-to-name"
+
+enum bench_transport {
+	BENCH_SSH,
+	BENCH_TLS,
+	BENCH_UNIX,
+	BENCH_TRANSPORT_COUNT
+};
+
+static const char* transport_names[BENCH_TRANSPORT_COUNT] = {"ssh", "tls", "unix"};
+
+enum bench_op {
+	BENCH_GET,
+	BENCH_GETCONFIG,
+	BENCH_EDITCONFIG,
+	BENCH_OP_COUNT
+};
+
+static const char* op_names[BENCH_OP_COUNT] = {"get", "get-config", "edit-config"};
+
+/* the values of /netopeer/io-backend */
+static const char* backend_names[] = {"epoll", "io-uring"};
+
+enum bench_scenario {
+	SCEN_CONNECT = 0x01,
+	SCEN_HANDSHAKE = 0x02,
+	SCEN_RPC = 0x04,
+	SCEN_NOTIF = 0x08,
+	SCEN_MEMORY = 0x10,
+	SCEN_STARTUP = 0x20,
+	SCEN_COMMIT = 0x40,
+	SCEN_BULK = 0x80,
+	SCEN_IO = 0x100,
+	SCEN_WORKERS = 0x200,
+	SCEN_LOCAL = 0x400
+};
+
+static const struct {
+	const char* name;
+	int flag;
+} scenario_names[] = {
+	{"connect", SCEN_CONNECT},
+	{"handshake", SCEN_HANDSHAKE},
+	{"rpc", SCEN_RPC},
+	{"notification", SCEN_NOTIF},
+	{"memory", SCEN_MEMORY},
+	{"startup", SCEN_STARTUP},
+	{"commit", SCEN_COMMIT},
+	{"bulk", SCEN_BULK},
+	{"io", SCEN_IO},
+	{"workers", SCEN_WORKERS},
+	{"local", SCEN_LOCAL},
+	{NULL, 0}
+};
+
+static struct bench_opts {
+	const char* host;
+	unsigned short ssh_port;
+	unsigned short tls_port;
+	const char* unix_path;
+	const char* user;
+	const char* password;
+	const char* key;
+	const char* cert;
+	const char* cert_key;
+	const char* ca;
+	const char* filter;
+	const char* label;
+	const char* output;
+	int transports[BENCH_TRANSPORT_COUNT];
+	unsigned int sessions[16];
+	unsigned int sessions_count;
+	int scenarios;
+	unsigned int duration;
+	unsigned int subscribers;
+	unsigned int events;
+	unsigned int memory_sessions;
+	unsigned int hibernate;
+	unsigned int startup_mib;
+	unsigned int bulk_entries;
+	unsigned int bulk_delay;
+	unsigned int workers;
+	unsigned int worker_sessions;
+	unsigned int wait;
+	pid_t pid;
+} opts = {
+	.host = "localhost",
+	.ssh_port = 830,
+	.tls_port = 6513,
+	.unix_path = "/tmp/netopeer-bench.sock",
+	.filter = "<netopeer xmlns=\""NETOPEER_NS"\"/>",
+	.label = "",
+	.sessions = {1, 100, 1000},
+	.sessions_count = 3,
+	.scenarios = SCEN_CONNECT | SCEN_HANDSHAKE | SCEN_RPC | SCEN_NOTIF | SCEN_MEMORY | SCEN_STARTUP | SCEN_COMMIT | SCEN_BULK | SCEN_IO |
+			SCEN_WORKERS | SCEN_LOCAL,
+	.duration = 10,
+	.subscribers = 100,
+	.events = 100,
+	.memory_sessions = 100,
+	.hibernate = 0,
+	.startup_mib = 50,
+	.bulk_entries = 10000,
+	.bulk_delay = 0,
+	.workers = 0,
+	.worker_sessions = 1000,
+	.wait = 10,
+	.pid = 0
+};
+
+/* a session and, for the Unix transport, the socket libnetconf does not own */
+struct bench_sess {
+	struct nc_session* nc_sess;
+	int fd;
+};
+
+/* latencies in microseconds */
+struct bench_lat {
+	unsigned long* val;
+	unsigned int count;
+	unsigned int size;
+};
+
+static FILE* out;
+static int out_first = 1;
+static volatile int bench_stop;
+
+static volatile unsigned long notif_received;
+static volatile unsigned long long notif_last;
+
+static unsigned long long now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void lat_add(struct bench_lat* lat, unsigned long val) {
+	unsigned long* new_val;
+
+	if (lat->count == lat->size) {
+		new_val = realloc(lat->val, (lat->size ? 2*lat->size : 1024) * sizeof *lat->val);
+		if (new_val == NULL) {
+			return;
+		}
+		lat->val = new_val;
+		lat->size = (lat->size ? 2*lat->size : 1024);
+	}
+	lat->val[lat->count++] = val;
+}
+
+static void lat_merge(struct bench_lat* dst, const struct bench_lat* src) {
+	unsigned int i;
+
+	for (i = 0; i < src->count; ++i) {
+		lat_add(dst, src->val[i]);
+	}
+}
+
+static int lat_cmp(const void* a, const void* b) {
+	unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+
+	return (x > y) - (x < y);
+}
+
+static unsigned long lat_pct(const struct bench_lat* lat, unsigned int pct) {
+	if (lat->count == 0) {
+		return 0;
+	}
+	return lat->val[((unsigned long long)(lat->count - 1) * pct) / 100];
+}
+
+/*
+ * JSON output
+ */
+
+static void json_result_start(const char* scenario, const char* transport) {
+	fprintf(out, "%s\n\t\t{\"scenario\": \"%s\"", (out_first ? "" : ","), scenario);
+	if (transport != NULL) {
+		fprintf(out, ", \"transport\": \"%s\"", transport);
+	}
+	out_first = 0;
+}
+
+static void json_result_end(void) {
+	fprintf(out, "}");
+	fflush(out);
+}
+
+static void json_lat(struct bench_lat* lat) {
+	unsigned long long sum = 0;
+	unsigned int i;
+
+	qsort(lat->val, lat->count, sizeof *lat->val, lat_cmp);
+	for (i = 0; i < lat->count; ++i) {
+		sum += lat->val[i];
+	}
+
+	fprintf(out, ", \"latency_us\": {\"count\": %u, \"min\": %lu, \"mean\": %llu, \"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}",
+			lat->count, lat_pct(lat, 0), (lat->count ? sum / lat->count : 0), lat_pct(lat, 50), lat_pct(lat, 90),
+			lat_pct(lat, 99), lat_pct(lat, 100));
+}
+
+static void json_string(const char* str) {
+	fputc('"', out);
+	for (; *str; ++str) {
+		if (*str == '"' || *str == '\\') {
+			fprintf(out, "\\%c", *str);
+		} else if ((unsigned char)*str < 0x20) {
+			fprintf(out, "\\u%04x", *str);
+		} else {
+			fputc(*str, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/*
+ * sessions
+ */
+
+#ifdef NP_SSH
+static char* clb_sshauth_password(const char* UNUSED(username), const char* UNUSED(hostname)) {
+	return strdup(opts.password ? opts.password : "");
+}
+
+static int clb_hostkey_check(const char* UNUSED(hostname), ssh_session UNUSED(session)) {
+	/* the benchmarked server is local */
+	return 0;
+}
+#endif
+
+static void clb_print(NC_VERB_LEVEL level, const char* msg) {
+	if (level == NC_VERB_ERROR) {
+		fprintf(stderr, "libnetconf: %s\n", msg);
+	}
+}
+
+static int unix_connect(void) {
+	struct sockaddr_un addr;
+	int sock;
+
+	if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, opts.unix_path, sizeof addr.sun_path - 1);
+	if (connect(sock, (struct sockaddr*)&addr, sizeof addr) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+static int tcp_connect(unsigned short port) {
+	struct addrinfo hints, *res, *ai;
+	char port_str[8];
+	int sock = -1;
+
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port_str, sizeof port_str, "%u", port);
+	if (getaddrinfo(opts.host, port_str, &hints, &res) != 0) {
+		return -1;
+	}
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		if ((sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) == -1) {
+			continue;
+		}
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(res);
+
+	return sock;
+}
+
+/* return: 0 - connected, 1 - failed */
+static int sess_connect(enum bench_transport transport, struct bench_sess* sess) {
+	sess->nc_sess = NULL;
+	sess->fd = -1;
+
+	switch (transport) {
+	case BENCH_SSH:
+#ifdef NP_SSH
+#	ifdef NP_TLS
+		nc_session_transport(NC_TRANSPORT_SSH);
+#	endif
+		sess->nc_sess = nc_session_connect(opts.host, opts.ssh_port, opts.user, NULL);
+#endif
+		break;
+	case BENCH_TLS:
+#ifdef NP_TLS
+		nc_session_transport(NC_TRANSPORT_TLS);
+		sess->nc_sess = nc_session_connect(opts.host, opts.tls_port, opts.user, NULL);
+#endif
+		break;
+	case BENCH_UNIX:
+		if ((sess->fd = unix_connect()) == -1) {
+			return 1;
+		}
+		sess->nc_sess = nc_session_connect_inout(sess->fd, sess->fd, NULL, NULL, NULL, opts.user, NC_TRANSPORT_SSH);
+		if (sess->nc_sess == NULL) {
+			close(sess->fd);
+			sess->fd = -1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return (sess->nc_sess == NULL);
+}
+
+static void sess_free(struct bench_sess* sess) {
+	if (sess->nc_sess != NULL) {
+		nc_session_free(sess->nc_sess);
+		sess->nc_sess = NULL;
+	}
+	if (sess->fd != -1) {
+		close(sess->fd);
+		sess->fd = -1;
+	}
+}
+
+/* return: 0 - ok or data reply, 1 - any error */
+static int sess_rpc(struct bench_sess* sess, nc_rpc* rpc) {
+	nc_reply* reply = NULL;
+	NC_REPLY_TYPE type;
+
+	if (rpc == NULL) {
+		return 1;
+	}
+
+	if (nc_session_send_recv(sess->nc_sess, rpc, &reply) != NC_MSG_REPLY) {
+		nc_rpc_free(rpc);
+		return 1;
+	}
+	type = nc_reply_get_type(reply);
+	nc_reply_free(reply);
+	nc_rpc_free(rpc);
+
+	return (type != NC_REPLY_OK && type != NC_REPLY_DATA);
+}
+
+/* data of a reply, NULL on any error */
+static char* sess_data(struct bench_sess* sess, nc_rpc* rpc) {
+	nc_reply* reply = NULL;
+	char* data = NULL;
+
+	if (rpc == NULL) {
+		return NULL;
+	}
+
+	if (nc_session_send_recv(sess->nc_sess, rpc, &reply) == NC_MSG_REPLY && nc_reply_get_type(reply) == NC_REPLY_DATA) {
+		data = nc_reply_get_data(reply);
+	}
+	nc_reply_free(reply);
+	nc_rpc_free(rpc);
+
+	return data;
+}
+
+static nc_rpc* rpc_edit(const char* config) {
+	return nc_rpc_editconfig(NC_DATASTORE_RUNNING, NC_DATASTORE_CONFIG, NC_EDIT_DEFOP_MERGE, NC_EDIT_ERROPT_STOP,
+			NC_EDIT_TESTOPT_SET, config);
+}
+
+/* every edit changes the value so that a netconf-config-change notification is generated */
+static nc_rpc* rpc_edit_bench(unsigned long seq) {
+	char config[128];
+
+	snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\"><hello-timeout>%lu</hello-timeout></netopeer>",
+			600 + seq % 2);
+	return rpc_edit(config);
+}
+
+static nc_rpc* rpc_create(enum bench_op op, unsigned long seq) {
+	struct nc_filter* filter = NULL;
+	nc_rpc* rpc = NULL;
+
+	if (op != BENCH_EDITCONFIG && opts.filter[0] != '\0') {
+		filter = nc_filter_new(NC_FILTER_SUBTREE, opts.filter);
+	}
+
+	switch (op) {
+	case BENCH_GET:
+		rpc = nc_rpc_get(filter);
+		break;
+	case BENCH_GETCONFIG:
+		rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, filter);
+		break;
+	case BENCH_EDITCONFIG:
+		rpc = rpc_edit_bench(seq);
+		break;
+	default:
+		break;
+	}
+
+	nc_filter_free(filter);
+	return rpc;
+}
+
+/*
+ * server setup
+ */
+
+static struct bench_sess admin_sess = {NULL, -1};
+
+/* return: 0 - the administrative session opened, 1 - the server does not accept it within opts.wait */
+static int admin_connect(void) {
+	unsigned long long deadline;
+
+	deadline = now_us() + (unsigned long long)opts.wait * 1000000;
+	while (1) {
+#ifdef NP_SSH
+		if (!sess_connect(BENCH_SSH, &admin_sess)) {
+			break;
+		}
+#endif
+#ifdef NP_TLS
+		if (!sess_connect(BENCH_TLS, &admin_sess)) {
+			break;
+		}
+#endif
+		if (now_us() > deadline) {
+			fprintf(stderr, "Failed to connect to the server.\n");
+			return 1;
+		}
+		sleep(1);
+	}
+
+	return 0;
+}
+
+/* the server configuration the suite needs, removed again by setup_restore() */
+static int setup_apply(void) {
+	char config[1024];
+	int len;
+
+	if (admin_connect()) {
+		return 1;
+	}
+
+	len = snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\"><max-sessions>1024</max-sessions>");
+	if (opts.hibernate) {
+		len += snprintf(config + len, sizeof config - len, "<hibernate-timeout>%u</hibernate-timeout>", opts.hibernate);
+	}
+	if (opts.transports[BENCH_UNIX]) {
+		len += snprintf(config + len, sizeof config - len, "<unix><listen-path>%s</listen-path></unix>", opts.unix_path);
+	}
+	snprintf(config + len, sizeof config - len, "</netopeer>");
+
+	if (sess_rpc(&admin_sess, rpc_edit(config))) {
+		fprintf(stderr, "Failed to configure the server.\n");
+		return 1;
+	}
+
+	/* let the server start listening on the new socket */
+	if (opts.transports[BENCH_UNIX]) {
+		sleep(1);
+	}
+
+	return 0;
+}
+
+static void setup_restore(void) {
+	char config[1024];
+	int len;
+
+	if (admin_sess.nc_sess == NULL) {
+		return;
+	}
+
+	len = snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\" xmlns:xc=\""NETCONF_NS"\">"
+			"<max-sessions xc:operation=\"remove\"/><hello-timeout xc:operation=\"remove\"/><io-backend xc:operation=\"remove\"/>"
+			"<workers xc:operation=\"remove\"/>");
+	if (opts.hibernate) {
+		len += snprintf(config + len, sizeof config - len, "<hibernate-timeout xc:operation=\"remove\"/>");
+	}
+	if (opts.transports[BENCH_UNIX]) {
+		len += snprintf(config + len, sizeof config - len, "<unix><listen-path xc:operation=\"remove\">%s</listen-path></unix>",
+				opts.unix_path);
+	}
+	snprintf(config + len, sizeof config - len, "</netopeer>");
+
+	if (sess_rpc(&admin_sess, rpc_edit(config))) {
+		fprintf(stderr, "Failed to restore the server configuration.\n");
+	}
+	sess_free(&admin_sess);
+}
+
+/* return: 0 - all opened, 1 - failed */
+static int sessions_open(enum bench_transport transport, struct bench_sess* sess, unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; ++i) {
+		if (sess_connect(transport, &sess[i])) {
+			fprintf(stderr, "Failed to open %s session %u of %u.\n", transport_names[transport], i + 1, count);
+			while (i) {
+				sess_free(&sess[--i]);
+			}
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void sessions_close(struct bench_sess* sess, unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; ++i) {
+		sess_free(&sess[i]);
+	}
+}
+
+/* return: number of threads started, less than count on error */
+static unsigned int threads_start(pthread_t* tids, unsigned int count, void* (*func)(void*), void* args, size_t arg_size) {
+	pthread_attr_t attr;
+	unsigned int i;
+	int ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, BENCH_STACK_SIZE);
+	for (i = 0; i < count; ++i) {
+		if ((ret = pthread_create(&tids[i], &attr, func, (char*)args + i*arg_size)) != 0) {
+			fprintf(stderr, "Failed to create a thread (%s).\n", strerror(ret));
+			break;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	return i;
+}
+
+/*
+ * scenarios
+ */
+
+/* return: connections opened and closed until end */
+static unsigned long connect_loop(enum bench_transport transport, unsigned long long end, unsigned long* errors) {
+	unsigned long count = 0;
+	int sock;
+
+	while (now_us() < end) {
+		switch (transport) {
+		case BENCH_SSH:
+			sock = tcp_connect(opts.ssh_port);
+			break;
+		case BENCH_TLS:
+			sock = tcp_connect(opts.tls_port);
+			break;
+		default:
+			sock = unix_connect();
+			break;
+		}
+
+		if (sock == -1) {
+			++(*errors);
+			continue;
+		}
+		close(sock);
+		++count;
+	}
+
+	return count;
+}
+
+/* TCP or Unix connections accepted and closed by the server per second, without any handshake */
+static void bench_connect(enum bench_transport transport) {
+	unsigned long long start, end;
+	unsigned long count, errors = 0;
+
+	start = now_us();
+	count = connect_loop(transport, start + (unsigned long long)opts.duration * 1000000, &errors);
+	end = now_us();
+
+	json_result_start("connect", transport_names[transport]);
+	fprintf(out, ", \"connections\": %lu, \"errors\": %lu, \"duration_s\": %.3f, \"rate_per_s\": %.1f",
+			count, errors, (end - start) / 1e6, count / ((end - start) / 1e6));
+	json_result_end();
+}
+
+/* full NETCONF sessions (transport handshake, authentication, hello) established per second */
+static void bench_handshake(enum bench_transport transport) {
+	struct bench_lat lat = {NULL, 0, 0};
+	struct bench_sess sess;
+	unsigned long long start, end, t;
+	unsigned long errors = 0;
+
+	start = now_us();
+	end = start + (unsigned long long)opts.duration * 1000000;
+	while ((t = now_us()) < end) {
+		if (sess_connect(transport, &sess)) {
+			++errors;
+			continue;
+		}
+		lat_add(&lat, now_us() - t);
+		sess_free(&sess);
+	}
+	end = now_us();
+
+	json_result_start("handshake", transport_names[transport]);
+	fprintf(out, ", \"sessions\": %u, \"errors\": %lu, \"duration_s\": %.3f, \"rate_per_s\": %.1f",
+			lat.count, errors, (end - start) / 1e6, lat.count / ((end - start) / 1e6));
+	json_lat(&lat);
+	json_result_end();
+
+	free(lat.val);
+}
+
+struct rpc_worker {
+	struct bench_sess* sess;
+	enum bench_op op;
+	struct bench_lat lat;
+	unsigned long errors;
+};
+
+static void* rpc_worker_thread(void* arg) {
+	struct rpc_worker* worker = (struct rpc_worker*)arg;
+	unsigned long long t;
+	unsigned long seq = 0;
+	nc_rpc* rpc;
+
+	while (!bench_stop) {
+		rpc = rpc_create(worker->op, seq++);
+		t = now_us();
+		if (sess_rpc(worker->sess, rpc)) {
+			++worker->errors;
+			if (nc_session_get_status(worker->sess->nc_sess) != NC_SESSION_STATUS_WORKING) {
+				break;
+			}
+			continue;
+		}
+		lat_add(&worker->lat, now_us() - t);
+	}
+
+	return NULL;
+}
+
+/*
+ * RPC throughput and latency with every session sending requests back to back,
+ * reported as the workers scenario with the number of the server workers unless negative
+ */
+static void bench_rpc(enum bench_transport transport, enum bench_op op, unsigned int count, int server_workers) {
+	struct bench_lat lat = {NULL, 0, 0};
+	struct bench_sess* sess;
+	struct rpc_worker* workers;
+	pthread_t* tids;
+	unsigned long long start, end;
+	unsigned long errors = 0;
+	unsigned int i, started;
+
+	sess = calloc(count, sizeof *sess);
+	workers = calloc(count, sizeof *workers);
+	tids = calloc(count, sizeof *tids);
+	if (sess == NULL || workers == NULL || tids == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		goto cleanup;
+	}
+
+	if (sessions_open(transport, sess, count)) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; ++i) {
+		workers[i].sess = &sess[i];
+		workers[i].op = op;
+	}
+
+	bench_stop = 0;
+	start = now_us();
+	if ((started = threads_start(tids, count, rpc_worker_thread, workers, sizeof *workers)) == count) {
+		sleep(opts.duration);
+	}
+	bench_stop = 1;
+	for (i = 0; i < started; ++i) {
+		pthread_join(tids[i], NULL);
+	}
+	end = now_us();
+	if (started < count) {
+		for (i = 0; i < count; ++i) {
+			free(workers[i].lat.val);
+		}
+		sessions_close(sess, count);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; ++i) {
+		lat_merge(&lat, &workers[i].lat);
+		errors += workers[i].errors;
+		free(workers[i].lat.val);
+	}
+	sessions_close(sess, count);
+
+	json_result_start((server_workers < 0 ? "rpc" : "workers"), transport_names[transport]);
+	if (server_workers >= 0) {
+		fprintf(out, ", \"workers\": %d", server_workers);
+	}
+	fprintf(out, ", \"operation\": \"%s\", \"sessions\": %u, \"requests\": %u, \"errors\": %lu, \"duration_s\": %.3f, \"throughput_per_s\": %.1f",
+			op_names[op], count, lat.count, errors, (end - start) / 1e6, lat.count / ((end - start) / 1e6));
+	json_lat(&lat);
+	json_result_end();
+
+cleanup:
+	free(lat.val);
+	free(tids);
+	free(workers);
+	free(sess);
+}
+
+/* return: sessions established per second within the duration */
+static double local_setup_rate(enum bench_transport transport, unsigned long* errors) {
+	struct bench_sess sess;
+	unsigned long long start, end;
+	unsigned long count = 0;
+
+	start = now_us();
+	end = start + (unsigned long long)opts.duration * 1000000;
+	while (now_us() < end) {
+		if (sess_connect(transport, &sess)) {
+			++(*errors);
+			continue;
+		}
+		sess_free(&sess);
+		++count;
+	}
+
+	return count / ((now_us() - start) / 1e6);
+}
+
+/* return: get RPCs of a single session per second within the duration, -1 if it could not connect */
+static double local_rpc_rate(enum bench_transport transport, struct bench_lat* lat, unsigned long* errors) {
+	struct bench_sess sess;
+	unsigned long long start, end, t;
+	unsigned long count = 0, seq = 0;
+
+	if (sess_connect(transport, &sess)) {
+		++(*errors);
+		return -1;
+	}
+
+	start = now_us();
+	end = start + (unsigned long long)opts.duration * 1000000;
+	while ((t = now_us()) < end) {
+		if (sess_rpc(&sess, rpc_create(BENCH_GET, seq++))) {
+			++(*errors);
+			if (nc_session_get_status(sess.nc_sess) != NC_SESSION_STATUS_WORKING) {
+				break;
+			}
+			continue;
+		}
+		lat_add(lat, now_us() - t);
+		++count;
+	}
+	end = now_us();
+	sess_free(&sess);
+
+	return count / ((end - start) / 1e6);
+}
+
+/*
+ * an on-box client over the Unix socket compared with SSH on the loopback: the session
+ * setup rate and the get throughput and latency of a single session, the same runs for both
+ */
+static void bench_local(void) {
+	static const enum bench_transport transports[2] = {BENCH_UNIX, BENCH_SSH};
+	struct bench_lat lat;
+	double setup[2], rpc[2];
+	unsigned long errors[2] = {0, 0};
+	int i;
+
+	for (i = 0; i < 2; ++i) {
+		memset(&lat, 0, sizeof lat);
+		setup[i] = local_setup_rate(transports[i], &errors[i]);
+		rpc[i] = local_rpc_rate(transports[i], &lat, &errors[i]);
+
+		json_result_start("local", transport_names[transports[i]]);
+		fprintf(out, ", \"errors\": %lu, \"setup_per_s\": %.1f, \"throughput_per_s\": %.1f", errors[i], setup[i], (rpc[i] < 0 ? 0 : rpc[i]));
+		json_lat(&lat);
+		json_result_end();
+		free(lat.val);
+	}
+
+	json_result_start("local", NULL);
+	fprintf(out, ", \"setup_speedup\": %.2f, \"throughput_speedup\": %.2f",
+			(setup[1] > 0 ? setup[0] / setup[1] : 0), (rpc[0] > 0 && rpc[1] > 0 ? rpc[0] / rpc[1] : 0));
+	json_result_end();
+}
+
+/* return: 0 - the commit counters of the server read, 1 - failed */
+static int commit_counters(struct bench_sess* sess, unsigned long long counters[BENCH_COMMIT_COUNTERS]) {
+	static const char* names[BENCH_COMMIT_COUNTERS] = {"commits", "unchanged-datastores", "aligned-datastores", "changed-subtrees"};
+	struct nc_filter* filter;
+	xmlDocPtr doc;
+	xmlNodePtr node;
+	xmlChar* value;
+	char* data, *xml;
+	int i, found = 0;
+
+	filter = nc_filter_new(NC_FILTER_SUBTREE, "<netopeer xmlns=\""NETOPEER_NS"\"><commit/></netopeer>");
+	data = sess_data(sess, nc_rpc_get(filter));
+	nc_filter_free(filter);
+	if (data == NULL || asprintf(&xml, "<data>%s</data>", data) == -1) {
+		free(data);
+		return 1;
+	}
+	free(data);
+	doc = xmlReadMemory(xml, strlen(xml), NULL, NULL, BENCH_PARSE_OPTS);
+	free(xml);
+	if (doc == NULL) {
+		return 1;
+	}
+
+	for (node = xmlDocGetRootElement(doc)->children; node != NULL && !xmlStrEqual(node->name, BAD_CAST "netopeer"); node = node->next);
+	for (node = (node != NULL ? node->children : NULL); node != NULL && !xmlStrEqual(node->name, BAD_CAST "commit"); node = node->next);
+	for (node = (node != NULL ? node->children : NULL); node != NULL; node = node->next) {
+		for (i = 0; i < BENCH_COMMIT_COUNTERS; ++i) {
+			if (xmlStrEqual(node->name, BAD_CAST names[i]) && (value = xmlNodeGetContent(node)) != NULL) {
+				counters[i] = strtoull((char*)value, NULL, 10);
+				xmlFree(value);
+				++found;
+			}
+		}
+	}
+	xmlFreeDoc(doc);
+
+	return (found != BENCH_COMMIT_COUNTERS);
+}
+
+/* candidate edit replacing the Netopeer modules with the same ones in the reverse order, NULL if there are less than 2 */
+static char* commit_reorder_config(struct bench_sess* sess) {
+	struct nc_filter* filter;
+	xmlDocPtr doc;
+	xmlNodePtr modules = NULL, node;
+	xmlBufferPtr buf;
+	char* data, *xml, *config = NULL;
+	int count = 0;
+
+	filter = nc_filter_new(NC_FILTER_SUBTREE, "<netopeer xmlns=\""NETOPEER_NS"\"><modules/></netopeer>");
+	data = sess_data(sess, nc_rpc_getconfig(NC_DATASTORE_RUNNING, filter));
+	nc_filter_free(filter);
+	if (data == NULL || asprintf(&xml, "<data>%s</data>", data) == -1) {
+		free(data);
+		return NULL;
+	}
+	free(data);
+	doc = xmlReadMemory(xml, strlen(xml), NULL, NULL, BENCH_PARSE_OPTS);
+	free(xml);
+	if (doc == NULL) {
+		return NULL;
+	}
+
+	for (node = xmlDocGetRootElement(doc)->children; node != NULL && modules == NULL; node = node->next) {
+		if (xmlStrEqual(node->name, BAD_CAST "netopeer")) {
+			for (modules = node->children; modules != NULL && !xmlStrEqual(modules->name, BAD_CAST "modules"); modules = modules->next);
+		}
+	}
+	if (modules != NULL && (buf = xmlBufferCreate()) != NULL) {
+		xmlBufferCat(buf, BAD_CAST "<netopeer xmlns=\""NETOPEER_NS"\" xmlns:xc=\""NETCONF_NS"\"><modules xc:operation=\"replace\">");
+		for (node = modules->last; node != NULL; node = node->prev, ++count) {
+			xmlNodeDump(buf, doc, node, 0, 0);
+		}
+		xmlBufferCat(buf, BAD_CAST "</modules></netopeer>");
+		if (count > 1) {
+			config = strdup((char*)xmlBufferContent(buf));
+		}
+		xmlBufferFree(buf);
+	}
+	xmlFreeDoc(doc);
+
+	return config;
+}
+
+/*
+ * candidate commits of a single changed leaf, or of only reordered entries,
+ * with the changes the server dispatched to the transAPI callbacks
+ */
+static void bench_commit(enum bench_transport transport, int reorder) {
+	struct bench_lat lat = {NULL, 0, 0};
+	struct bench_sess sess = {NULL, -1};
+	unsigned long long start, end, t, before[BENCH_COMMIT_COUNTERS], after[BENCH_COMMIT_COUNTERS];
+	unsigned long seq, errors = 0;
+	char* config = NULL, leaf[128];
+	int i;
+
+	if (sess_connect(transport, &sess)) {
+		fprintf(stderr, "Failed to open a %s session.\n", transport_names[transport]);
+		return;
+	}
+	if (commit_counters(&sess, before)) {
+		fprintf(stderr, "The server does not provide the commit counters, skipping the commit scenario.\n");
+		goto cleanup;
+	}
+	if (reorder && (config = commit_reorder_config(&sess)) == NULL) {
+		fprintf(stderr, "Less than 2 Netopeer modules to reorder, skipping the commit scenario.\n");
+		goto cleanup;
+	}
+
+	start = now_us();
+	end = start + (unsigned long long)opts.duration * 1000000;
+	for (seq = 0; now_us() < end; ++seq) {
+		if (!reorder) {
+			snprintf(leaf, sizeof leaf, "<netopeer xmlns=\""NETOPEER_NS"\"><hello-timeout>%lu</hello-timeout></netopeer>", 600 + seq % 2);
+		}
+		if (sess_rpc(&sess, nc_rpc_editconfig(NC_DATASTORE_CANDIDATE, NC_DATASTORE_CONFIG, NC_EDIT_DEFOP_MERGE,
+				NC_EDIT_ERROPT_STOP, NC_EDIT_TESTOPT_SET, reorder ? config : leaf))) {
+			++errors;
+			continue;
+		}
+		t = now_us();
+		if (sess_rpc(&sess, nc_rpc_commit())) {
+			++errors;
+			sess_rpc(&sess, nc_rpc_discardchanges());
+			continue;
+		}
+		lat_add(&lat, now_us() - t);
+	}
+	end = now_us();
+
+	if (commit_counters(&sess, after)) {
+		goto cleanup;
+	}
+	for (i = 0; i < BENCH_COMMIT_COUNTERS; ++i) {
+		after[i] -= before[i];
+	}
+
+	json_result_start("commit", transport_names[transport]);
+	fprintf(out, ", \"change\": \"%s\", \"commits\": %u, \"errors\": %lu, \"duration_s\": %.3f, \"unchanged_datastores\": %llu, "
+			"\"aligned_datastores\": %llu, \"changed_subtrees\": %llu, \"changed_subtrees_per_commit\": %.2f",
+			reorder ? "reorder" : "leaf", lat.count, errors, (end - start) / 1e6, after[1], after[2], after[3],
+			after[0] ? (double)after[3] / after[0] : 0.0);
+	json_lat(&lat);
+	json_result_end();
+
+cleanup:
+	free(lat.val);
+	free(config);
+	sess_free(&sess);
+}
+
+/* the cert-to-name entries filling the bulk replies, or their removal */
+static char* bulk_config(int remove) {
+	char* config, *ptr;
+	size_t size;
+	unsigned int i, j;
+
+	size = 256 + (size_t)opts.bulk_entries * 384;
+	if ((config = malloc(size)) == NULL) {
+		return NULL;
+	}
+	ptr = config + sprintf(config, "<netopeer xmlns=\""NETOPEER_NS"\" xmlns:xc=\""NETCONF_NS"\"><tls><cert-maps>");
+	for (i = 0; i < opts.bulk_entries; ++i) {
+		if (remove) {
+			ptr += sprintf(ptr, "<cert-to-name xc:operation=\"remove\"><id>%u</id></cert-to-name>", BENCH_BULK_ID + i);
+			continue;
+		}
+		/* a SHA-256 fingerprint no certificate has */
+		ptr += sprintf(ptr, "<cert-to-name><id>%u</id><fingerprint>04", BENCH_BULK_ID + i);
+		for (j = 0; j < 32; ++j) {
+			ptr += sprintf(ptr, ":%02x", (j < 4 ? (i >> (8 * j)) & 0xff : 0xbe));
+		}
+		ptr += sprintf(ptr, "</fingerprint><map-type xmlns:x509c2n=\""X509C2N_NS"\">x509c2n:specified</map-type>"
+				"<name>np-bench</name></cert-to-name>");
+	}
+	sprintf(ptr, "</cert-maps></tls></netopeer>");
+
+	return config;
+}
+
+/*
+ * kernel-tls of TLS or coalesce-replies of SSH for the new sessions, removed if
+ * value is negative, return: 0 - configured, 1 - failed
+ */
+static int bulk_variant(enum bench_transport transport, int value) {
+	const char* container = (transport == BENCH_SSH ? "ssh" : "tls");
+	const char* leaf = (transport == BENCH_SSH ? "coalesce-replies" : "kernel-tls");
+	char config[256];
+
+	if (value < 0) {
+		snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\" xmlns:xc=\""NETCONF_NS"\"><%s>"
+				"<%s xc:operation=\"remove\"/></%s></netopeer>", container, leaf, container);
+	} else {
+		snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\"><%s><%s>%s</%s></%s></netopeer>",
+				container, leaf, (value ? "true" : "false"), leaf, container);
+	}
+	return sess_rpc(&admin_sess, rpc_edit(config));
+}
+
+/* netem delay of every packet on the loopback, 0 removes it, return: 0 - applied, 1 - failed */
+/* return: 1 - np-bench runs in a network namespace of its own, not in the one of the host (init), 0 - otherwise */
+static int netns_private(void) {
+	struct stat self, init;
+
+	if (stat("/proc/self/ns/net", &self) == -1 || stat("/proc/1/ns/net", &init) == -1) {
+		return 0;
+	}
+	return (self.st_dev != init.st_dev || self.st_ino != init.st_ino);
+}
+
+/*
+ * only the loopback of a private network namespace is delayed (bench/run-bench.sh creates one),
+ * a qdisc already on it is never replaced and only the one added here is deleted
+ */
+static int bulk_loopback_delay(unsigned int ms) {
+	static int added = 0;
+	char cmd[128];
+
+	if (ms == 0) {
+		if (!added) {
+			return 0;
+		}
+		added = 0;
+		return (system("tc qdisc del dev lo root netem 2>/dev/null") != 0);
+	}
+	if (!netns_private()) {
+		fprintf(stderr, "Not in a private network namespace, the loopback of the host is not delayed.\n");
+		return 1;
+	}
+	snprintf(cmd, sizeof cmd, "tc qdisc add dev lo root netem delay %ums limit 100000", ms);
+	if (system(cmd) != 0) {
+		return 1;
+	}
+	added = 1;
+	return 0;
+}
+
+/*
+ * large get-config replies back to back, over TLS with the record layer in the
+ * kernel or in OpenSSL, over SSH with or without the reply packets coalesced
+ */
+static void bench_bulk(enum bench_transport transport, int variant, unsigned int delay) {
+	struct bench_lat lat = {NULL, 0, 0};
+	struct bench_sess sess = {NULL, -1};
+	struct nc_filter* filter;
+	unsigned long long start, end, bytes = 0, t;
+	unsigned long errors = 0;
+	char* data;
+
+	if (bulk_variant(transport, variant)) {
+		fprintf(stderr, "Failed to configure %s, skipping the bulk scenario.\n", (transport == BENCH_SSH ? "coalesce-replies" : "kernel-tls"));
+		return;
+	}
+	if (sess_connect(transport, &sess)) {
+		fprintf(stderr, "Failed to open a %s session.\n", transport_names[transport]);
+		goto cleanup;
+	}
+	filter = nc_filter_new(NC_FILTER_SUBTREE, "<netopeer xmlns=\""NETOPEER_NS"\"><tls><cert-maps/></tls></netopeer>");
+
+	start = now_us();
+	end = start + (unsigned long long)opts.duration * 1000000;
+	while (now_us() < end) {
+		t = now_us();
+		if ((data = sess_data(&sess, nc_rpc_getconfig(NC_DATASTORE_RUNNING, filter))) == NULL) {
+			++errors;
+			continue;
+		}
+		lat_add(&lat, now_us() - t);
+		bytes += strlen(data);
+		free(data);
+	}
+	end = now_us();
+	nc_filter_free(filter);
+
+	json_result_start("bulk", transport_names[transport]);
+	fprintf(out, ", \"%s\": %s, \"delay_ms\": %u, \"entries\": %u, \"replies\": %u, \"errors\": %lu, \"duration_s\": %.3f, "
+			"\"reply_bytes\": %llu, \"throughput_mib_per_s\": %.2f", (transport == BENCH_SSH ? "coalesce_replies" : "kernel_tls"),
+			variant ? "true" : "false", delay, opts.bulk_entries, lat.count, errors, (end - start) / 1e6,
+			(lat.count ? bytes / lat.count : 0), bytes / 1048576.0 / ((end - start) / 1e6));
+	json_lat(&lat);
+	json_result_end();
+
+cleanup:
+	free(lat.val);
+	sess_free(&sess);
+	bulk_variant(transport, -1);
+}
+
+static void clb_notif(time_t UNUSED(eventtime), const char* UNUSED(content)) {
+	__sync_fetch_and_add(&notif_received, 1);
+	notif_last = now_us();
+}
+
+static void* notif_thread(void* arg) {
+	struct bench_sess* sess = (struct bench_sess*)arg;
+
+	ncntf_dispatch_receive(sess->nc_sess, clb_notif);
+	return NULL;
+}
+
+/* netconf-config-change notifications delivered to all the subscribers per second */
+static void bench_notif(enum bench_transport transport) {
+	struct bench_sess* sess, writer;
+	pthread_t* tids;
+	unsigned long long start, end, last;
+	unsigned long expected, errors = 0, prev;
+	unsigned int i, started;
+
+	sess = calloc(opts.subscribers, sizeof *sess);
+	tids = calloc(opts.subscribers, sizeof *tids);
+	if (sess == NULL || tids == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		goto cleanup;
+	}
+
+	if (sessions_open(transport, sess, opts.subscribers)) {
+		goto cleanup;
+	}
+	if (sess_connect(transport, &writer)) {
+		fprintf(stderr, "Failed to open the %s writer session.\n", transport_names[transport]);
+		sessions_close(sess, opts.subscribers);
+		goto cleanup;
+	}
+
+	for (i = 0; i < opts.subscribers; ++i) {
+		if (sess_rpc(&sess[i], nc_rpc_subscribe("NETCONF", NULL, NULL, NULL))) {
+			fprintf(stderr, "Failed to subscribe session %u.\n", i + 1);
+			sess_free(&writer);
+			sessions_close(sess, opts.subscribers);
+			goto cleanup;
+		}
+	}
+
+	notif_received = 0;
+	notif_last = 0;
+	if ((started = threads_start(tids, opts.subscribers, notif_thread, sess, sizeof *sess)) < opts.subscribers) {
+		sess_free(&writer);
+		for (i = 0; i < opts.subscribers; ++i) {
+			nc_session_close(sess[i].nc_sess, NC_SESSION_TERM_CLOSED);
+		}
+		for (i = 0; i < started; ++i) {
+			pthread_join(tids[i], NULL);
+		}
+		sessions_close(sess, opts.subscribers);
+		goto cleanup;
+	}
+
+	start = now_us();
+	for (i = 0; i < opts.events; ++i) {
+		if (sess_rpc(&writer, rpc_edit_bench(i))) {
+			++errors;
+		}
+	}
+
+	/* wait for the delivery to finish or stall */
+	expected = (unsigned long)(opts.events - errors) * opts.subscribers;
+	last = now_us();
+	prev = 0;
+	while (notif_received < expected && now_us() - last < BENCH_NOTIF_TIMEOUT * 1000000ULL) {
+		usleep(100000);
+		if (notif_received != prev) {
+			prev = notif_received;
+			last = now_us();
+		}
+	}
+	end = (notif_last > start ? notif_last : now_us());
+
+	sess_free(&writer);
+	for (i = 0; i < opts.subscribers; ++i) {
+		nc_session_close(sess[i].nc_sess, NC_SESSION_TERM_CLOSED);
+	}
+	for (i = 0; i < opts.subscribers; ++i) {
+		pthread_join(tids[i], NULL);
+	}
+	sessions_close(sess, opts.subscribers);
+
+	json_result_start("notification", transport_names[transport]);
+	fprintf(out, ", \"subscribers\": %u, \"events\": %u, \"errors\": %lu, \"expected\": %lu, \"delivered\": %lu, \"duration_s\": %.3f, \"rate_per_s\": %.1f",
+			opts.subscribers, opts.events, errors, expected, notif_received, (end - start) / 1e6,
+			notif_received / ((end - start) / 1e6));
+	json_result_end();
+
+cleanup:
+	free(tids);
+	free(sess);
+}
+
+/* return: 0 - read, 1 - failed */
+static int proc_status(unsigned long* rss_kib, unsigned long* threads) {
+	char path[32], line[256];
+	FILE* f;
+
+	snprintf(path, sizeof path, "/proc/%d/status", opts.pid);
+	if ((f = fopen(path, "r")) == NULL) {
+		return 1;
+	}
+
+	*rss_kib = 0;
+	*threads = 0;
+	while (fgets(line, sizeof line, f) != NULL) {
+		sscanf(line, "VmRSS: %lu", rss_kib);
+		sscanf(line, "Threads: %lu", threads);
+	}
+	fclose(f);
+
+	return 0;
+}
+
+/*
+ * server resident memory and threads per idle session, before and after the sessions hibernated,
+ * optionally with every session subscribed to the notifications
+ */
+static void bench_memory(enum bench_transport transport, int subscribed) {
+	struct bench_sess* sess;
+	unsigned long rss_base, threads_base, rss, threads, rss_hib = 0, threads_hib = 0;
+	unsigned int i, count = opts.memory_sessions;
+
+	if ((sess = calloc(count, sizeof *sess)) == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return;
+	}
+
+	if (proc_status(&rss_base, &threads_base)) {
+		fprintf(stderr, "Failed to read the status of the server process %d.\n", opts.pid);
+		free(sess);
+		return;
+	}
+	if (sessions_open(transport, sess, count)) {
+		free(sess);
+		return;
+	}
+	for (i = 0; subscribed && i < count; ++i) {
+		if (sess_rpc(&sess[i], nc_rpc_subscribe("NETCONF", NULL, NULL, NULL))) {
+			fprintf(stderr, "Failed to subscribe session %u.\n", i + 1);
+			sessions_close(sess, count);
+			free(sess);
+			return;
+		}
+	}
+	sleep(1);
+	proc_status(&rss, &threads);
+	if (opts.hibernate) {
+		sleep(opts.hibernate + 2);
+		proc_status(&rss_hib, &threads_hib);
+	}
+	sessions_close(sess, count);
+	free(sess);
+
+	json_result_start("memory", transport_names[transport]);
+	fprintf(out, ", \"subscribed\": %s, \"sessions\": %u, \"rss_base_kib\": %lu, \"rss_kib\": %lu, \"rss_per_session_kib\": %.1f, \"threads_base\": %lu, \"threads\": %lu",
+			(subscribed ? "true" : "false"), count, rss_base, rss, ((double)rss - rss_base) / count, threads_base, threads);
+	if (opts.hibernate) {
+		fprintf(out, ", \"hibernate_timeout_s\": %u, \"rss_hibernated_kib\": %lu, \"rss_per_session_hibernated_kib\": %.1f, \"threads_hibernated\": %lu",
+				opts.hibernate, rss_hib, ((double)rss_hib - rss_base) / count, threads_hib);
+	}
+	json_result_end();
+}
+
+/* server CPU time of all its threads, including the finished ones, return: 0 - read, 1 - failed */
+static int proc_cpu(unsigned long long* cpu_us) {
+	char path[32], line[1024], *ptr;
+	unsigned long long utime, stime;
+	FILE* f;
+
+	snprintf(path, sizeof path, "/proc/%d/stat", opts.pid);
+	if ((f = fopen(path, "r")) == NULL) {
+		return 1;
+	}
+	/* the fields after the command, which may contain spaces */
+	if (fgets(line, sizeof line, f) == NULL || (ptr = strrchr(line, ')')) == NULL ||
+			sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	*cpu_us = (utime + stime) * 1000000 / sysconf(_SC_CLK_TCK);
+	return 0;
+}
+
+/*
+ * connections accepted and RPCs of sessions woken up from hibernation with
+ * an io-backend, with the server CPU time spent on each of them
+ */
+/*
+ * configure the session worker processes, removed if count is negative, and hard
+ * restart the server for them to start, return: 0 - the server is back, 1 - failed
+ */
+static int workers_restart(int count) {
+	char config[256];
+
+	if (count < 0) {
+		snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\" xmlns:xc=\""NETCONF_NS"\">"
+				"<workers xc:operation=\"remove\"/></netopeer>");
+	} else {
+		snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\"><workers>%d</workers></netopeer>", count);
+	}
+	if (sess_rpc(&admin_sess, rpc_edit(config))) {
+		return 1;
+	}
+
+	/* the session is dropped by the restart, possibly before the reply */
+	sess_rpc(&admin_sess, nc_rpc_generic("<netopeer-reboot xmlns=\""NETOPEER_NS"\"><type>hard</type></netopeer-reboot>"));
+	sess_free(&admin_sess);
+	sleep(2);
+
+	return admin_connect();
+}
+
+/*
+ * RPC throughput of many concurrent sessions with all of them in the server
+ * process and with the sessions spread among the worker processes
+ */
+static void bench_workers(void) {
+	int counts[2] = {0, opts.workers};
+	unsigned int i, j, k;
+
+	for (i = 0; i < 2; ++i) {
+		if (workers_restart(counts[i])) {
+			fprintf(stderr, "Failed to restart the server with %d workers, skipping the workers scenario.\n", counts[i]);
+			break;
+		}
+		/* the Unix socket sessions are always run by the owner process */
+		for (j = 0; j < BENCH_UNIX; ++j) {
+			if (!opts.transports[j]) {
+				continue;
+			}
+			for (k = 0; k < BENCH_OP_COUNT; ++k) {
+				bench_rpc(j, k, opts.worker_sessions, counts[i]);
+			}
+		}
+	}
+
+	if (admin_sess.nc_sess == NULL || workers_restart(-1)) {
+		fprintf(stderr, "Failed to restart the server without workers.\n");
+	}
+}
+
+static void bench_io(enum bench_transport transport, int backend) {
+	struct bench_lat lat = {NULL, 0, 0};
+	struct bench_sess* sess = NULL;
+	unsigned long long start, end, t, cpu_start, cpu_conn = 0, cpu_rpc = 0;
+	unsigned long conns, conn_errors = 0, rpc_errors = 0;
+	unsigned int i, count = opts.memory_sessions;
+	int have_cpu;
+	char config[256];
+
+	snprintf(config, sizeof config, "<netopeer xmlns=\""NETOPEER_NS"\"><io-backend>%s</io-backend></netopeer>", backend_names[backend]);
+	if (sess_rpc(&admin_sess, rpc_edit(config))) {
+		fprintf(stderr, "Failed to configure io-backend %s, skipping the io scenario.\n", backend_names[backend]);
+		return;
+	}
+	/* the listening and the hibernated sockets are moved on the next wait */
+	sleep(2);
+
+	have_cpu = (opts.pid && !proc_cpu(&cpu_start));
+	start = now_us();
+	conns = connect_loop(transport, start + (unsigned long long)opts.duration * 1000000, &conn_errors);
+	end = now_us();
+	if (have_cpu && !proc_cpu(&cpu_conn)) {
+		cpu_conn -= cpu_start;
+	}
+
+	/* every RPC wakes up another hibernated session */
+	if (opts.hibernate) {
+		if ((sess = calloc(count, sizeof *sess)) == NULL) {
+			fprintf(stderr, "Memory allocation failed.\n");
+			goto result;
+		}
+		if (sessions_open(transport, sess, count)) {
+			free(sess);
+			sess = NULL;
+			goto result;
+		}
+		sleep(opts.hibernate + 2);
+
+		have_cpu = (have_cpu && !proc_cpu(&cpu_start));
+		for (i = 0; i < count; ++i) {
+			t = now_us();
+			if (sess_rpc(&sess[i], nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL))) {
+				++rpc_errors;
+				continue;
+			}
+			lat_add(&lat, now_us() - t);
+		}
+		if (have_cpu && !proc_cpu(&cpu_rpc)) {
+			cpu_rpc -= cpu_start;
+		}
+		sessions_close(sess, count);
+	}
+
+result:
+	json_result_start("io", transport_names[transport]);
+	fprintf(out, ", \"backend\": \"%s\", \"connections\": %lu, \"errors\": %lu, \"rate_per_s\": %.1f", backend_names[backend],
+			conns, conn_errors, conns / ((end - start) / 1e6));
+	if (have_cpu) {
+		fprintf(out, ", \"cpu_us_per_connection\": %.1f", (conns ? (double)cpu_conn / conns : 0));
+	}
+	if (sess != NULL) {
+		fprintf(out, ", \"hibernate_timeout_s\": %u, \"sessions\": %u, \"rpcs\": %u, \"rpc_errors\": %lu", opts.hibernate, count,
+				lat.count, rpc_errors);
+		if (have_cpu) {
+			fprintf(out, ", \"cpu_us_per_rpc\": %.1f", (lat.count ? (double)cpu_rpc / lat.count : 0));
+		}
+		json_lat(&lat);
+	}
+	json_result_end();
+
+	free(lat.val);
+	free(sess);
+}
+
+/* write a datastore file of about opts.startup_mib MiB, return: 0 - written, 1 - failed */
+static int startup_generate(const char* path) {
+	FILE* f;
+	unsigned long i;
+
+	if ((f = fopen(path, "w")) == NULL) {
+		return 1;
+	}
+
+	fprintf(f, "<?xml version=\"1.0\"?>\n<datastores xmlns=\"urn:cesnet:tmc:datastores:file\">\n  <running>\n"
+			"    <interfaces xmlns=\"urn:ietf:params:xml:ns:yang:ietf-interfaces\" xmlns:ianaift=\"urn:ietf:params:xml:ns:yang:iana-if-type\">\n");
+	for (i = 0; ftell(f) < (long)opts.startup_mib * 1024 * 1024; ++i) {
+		fprintf(f, "      <interface>\n        <name>eth%lu</name>\n        <description>uplink %lu to rack %lu</description>\n"
+				"        <type>ianaift:ethernetCsmacd</type>\n        <enabled>%s</enabled>\n"
+				"        <ipv4 xmlns=\"urn:ietf:params:xml:ns:yang:ietf-ip\">\n          <mtu>1500</mtu>\n"
+				"          <address>\n            <ip>10.%lu.%lu.%lu</ip>\n            <prefix-length>24</prefix-length>\n"
+				"          </address>\n        </ipv4>\n      </interface>\n",
+				i, i, i / 48, (i % 7 ? "true" : "false"), (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+	}
+	fprintf(f, "    </interfaces>\n  </running>\n  <startup/>\n  <candidate/>\n</datastores>\n");
+
+	return (fclose(f) == EOF);
+}
+
+/* load the datastore the way a journal datastore starts, from the XML or from the snapshot, return: time in us, 0 on error */
+static unsigned long long startup_load(const char* xml_path, const char* snap_path, size_t* xml_size) {
+	struct stat st;
+	unsigned long long start;
+	xmlDocPtr doc;
+	void* map;
+	int fd;
+
+	start = now_us();
+	if ((fd = open(xml_path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		if (fd != -1) {
+			close(fd);
+		}
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return 0;
+	}
+	if (snap_path == NULL) {
+		doc = xmlReadMemory(map, st.st_size, xml_path, NULL, BENCH_PARSE_OPTS);
+	} else {
+		doc = np_snapshot_load(snap_path, np_snapshot_hash(map, st.st_size), st.st_size);
+	}
+	munmap(map, st.st_size);
+	if (doc == NULL) {
+		return 0;
+	}
+	start = now_us() - start;
+
+	xmlFreeDoc(doc);
+	*xml_size = st.st_size;
+	return start;
+}
+
+/* datastore load time on a synthetic configuration, parsed as XML and from the binary snapshot */
+static void bench_startup(void) {
+	char dir[] = "/tmp/np-bench-XXXXXX", xml_path[64], snap_path[64], *xml = NULL, *snap = NULL;
+	unsigned long long parse_sum = 0, parse_min = 0, load_sum = 0, load_min = 0, build, t;
+	size_t xml_size = 0, snap_len = 0;
+	xmlDocPtr doc;
+	FILE* f;
+	int i;
+
+	if (mkdtemp(dir) == NULL) {
+		fprintf(stderr, "Failed to create a temporary directory (%s).\n", strerror(errno));
+		return;
+	}
+	snprintf(xml_path, sizeof xml_path, "%s/datastore.xml", dir);
+	snprintf(snap_path, sizeof snap_path, "%s/datastore.xml.snap", dir);
+
+	if (startup_generate(xml_path)) {
+		fprintf(stderr, "Failed to write \"%s\".\n", xml_path);
+		goto cleanup;
+	}
+
+	/* the snapshot is built from the loaded document, like the journal datastore does */
+	if ((f = fopen(xml_path, "r")) == NULL) {
+		goto cleanup;
+	}
+	fseek(f, 0, SEEK_END);
+	xml_size = ftell(f);
+	rewind(f);
+	if ((xml = malloc(xml_size)) == NULL || fread(xml, 1, xml_size, f) != xml_size) {
+		fclose(f);
+		goto cleanup;
+	}
+	fclose(f);
+	if ((doc = xmlReadMemory(xml, xml_size, xml_path, NULL, BENCH_PARSE_OPTS)) == NULL) {
+		fprintf(stderr, "Failed to parse \"%s\".\n", xml_path);
+		goto cleanup;
+	}
+
+	build = now_us();
+	if (np_snapshot_build(doc, np_snapshot_hash(xml, xml_size), xml_size, &snap, &snap_len) || (f = fopen(snap_path, "w")) == NULL) {
+		fprintf(stderr, "Failed to build the snapshot.\n");
+		xmlFreeDoc(doc);
+		goto cleanup;
+	}
+	fwrite(snap, 1, snap_len, f);
+	fclose(f);
+	build = now_us() - build;
+	xmlFreeDoc(doc);
+
+	for (i = 0; i < BENCH_STARTUP_RUNS; ++i) {
+		if ((t = startup_load(xml_path, NULL, &xml_size)) == 0) {
+			goto cleanup;
+		}
+		parse_sum += t;
+		parse_min = (i == 0 || t < parse_min ? t : parse_min);
+
+		if ((t = startup_load(xml_path, snap_path, &xml_size)) == 0) {
+			fprintf(stderr, "Failed to load the snapshot.\n");
+			goto cleanup;
+		}
+		load_sum += t;
+		load_min = (i == 0 || t < load_min ? t : load_min);
+	}
+
+	json_result_start("startup", NULL);
+	fprintf(out, ", \"xml_bytes\": %zu, \"snapshot_bytes\": %zu, \"runs\": %d, \"parse_us\": {\"min\": %llu, \"mean\": %llu}, "
+			"\"snapshot_load_us\": {\"min\": %llu, \"mean\": %llu}, \"snapshot_build_us\": %llu, \"speedup\": %.2f",
+			xml_size, snap_len, BENCH_STARTUP_RUNS, parse_min, parse_sum / BENCH_STARTUP_RUNS, load_min,
+			load_sum / BENCH_STARTUP_RUNS, build, (double)parse_sum / load_sum);
+	json_result_end();
+
+cleanup:
+	free(xml);
+	free(snap);
+	unlink(snap_path);
+	unlink(xml_path);
+	rmdir(dir);
+}
+
+/*
+ * main
+ */
+
+static void print_usage(const char* progname) {
+	fprintf(stdout, "Usage: %s [options]\n\n", progname);
+	fprintf(stdout, " --host <host>              server address (localhost)\n");
+	fprintf(stdout, " --ssh-port <port>          SSH port (830)\n");
+	fprintf(stdout, " --tls-port <port>          TLS port (6513)\n");
+	fprintf(stdout, " --unix-path <path>         Unix socket configured for the run (/tmp/netopeer-bench.sock)\n");
+	fprintf(stdout, " --user <name>              NETCONF username (the current user)\n");
+	fprintf(stdout, " --key <path>               SSH private key, the public key is <path>.pub\n");
+	fprintf(stdout, " --cert <path>              TLS client certificate\n");
+	fprintf(stdout, " --cert-key <path>          TLS client certificate key\n");
+	fprintf(stdout, " --ca <path>                TLS trusted CA file\n");
+	fprintf(stdout, " --transports <list>        comma-separated ssh,tls,unix (all compiled in)\n");
+	fprintf(stdout, " --scenarios <list>         comma-separated connect,handshake,rpc,notification,memory,startup,commit,bulk,io,\n");
+	fprintf(stdout, "                            workers,local (all)\n");
+	fprintf(stdout, " --sessions <list>          concurrent sessions of the rpc scenario (1,100,1000)\n");
+	fprintf(stdout, " --duration <sec>           duration of each timed run (10)\n");
+	fprintf(stdout, " --filter <xml>             subtree filter of get and get-config, empty for none\n");
+	fprintf(stdout, " --subscribers <num>        notification subscribers (100)\n");
+	fprintf(stdout, " --events <num>             notifications generated (100)\n");
+	fprintf(stdout, " --memory-sessions <num>    idle sessions of the memory and io scenarios (100)\n");
+	fprintf(stdout, " --hibernate <sec>          hibernate-timeout configured for the run (0)\n");
+	fprintf(stdout, " --pid <pid>                server process, needed by the memory scenario and the CPU time of io\n");
+	fprintf(stdout, " --startup-size <MiB>       synthetic datastore of the startup scenario (50)\n");
+	fprintf(stdout, " --bulk-entries <num>       cert-to-name entries in the replies of the bulk scenario (10000)\n");
+	fprintf(stdout, " --bulk-delay <ms>          also run the bulk scenario with the loopback packets delayed by netem,\n");
+	fprintf(stdout, "                            only in a private network namespace (0)\n");
+	fprintf(stdout, " --workers <num>            worker processes of the workers scenario (online CPUs)\n");
+	fprintf(stdout, " --worker-sessions <num>    concurrent sessions of the workers scenario (1000)\n");
+	fprintf(stdout, " --wait <sec>               wait for the server to accept connections (10)\n");
+	fprintf(stdout, " --label <text>             label stored in the results\n");
+	fprintf(stdout, " --output <file>            JSON results file (stdout)\n\n");
+	fprintf(stdout, "The SSH password is read from the NP_BENCH_PASSWORD environment variable.\n");
+}
+
+/* return: 0 - parsed, 1 - unknown item */
+static int parse_list(char* list, int scenarios) {
+	char* item, *saveptr = NULL;
+	int i, found;
+
+	for (item = strtok_r(list, ",", &saveptr); item != NULL; item = strtok_r(NULL, ",", &saveptr)) {
+		found = 0;
+		if (scenarios) {
+			for (i = 0; scenario_names[i].name != NULL; ++i) {
+				if (strcmp(item, scenario_names[i].name) == 0) {
+					opts.scenarios |= scenario_names[i].flag;
+					found = 1;
+				}
+			}
+		} else {
+			for (i = 0; i < BENCH_TRANSPORT_COUNT; ++i) {
+				if (strcmp(item, transport_names[i]) == 0) {
+					opts.transports[i] = 1;
+					found = 1;
+				}
+			}
+		}
+		if (!found) {
+			fprintf(stderr, "Unknown %s \"%s\".\n", (scenarios ? "scenario" : "transport"), item);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	static const struct option long_options[] = {
+		{"host", required_argument, NULL, 'a'},
+		{"ssh-port", required_argument, NULL, 'p'},
+		{"tls-port", required_argument, NULL, 'P'},
+		{"unix-path", required_argument, NULL, 'x'},
+		{"user", required_argument, NULL, 'u'},
+		{"key", required_argument, NULL, 'k'},
+		{"cert", required_argument, NULL, 'c'},
+		{"cert-key", required_argument, NULL, 'K'},
+		{"ca", required_argument, NULL, 'C'},
+		{"transports", required_argument, NULL, 't'},
+		{"scenarios", required_argument, NULL, 's'},
+		{"sessions", required_argument, NULL, 'n'},
+		{"duration", required_argument, NULL, 'd'},
+		{"filter", required_argument, NULL, 'f'},
+		{"subscribers", required_argument, NULL, 'S'},
+		{"events", required_argument, NULL, 'e'},
+		{"memory-sessions", required_argument, NULL, 'm'},
+		{"hibernate", required_argument, NULL, 'H'},
+		{"pid", required_argument, NULL, 'i'},
+		{"startup-size", required_argument, NULL, 'z'},
+		{"bulk-entries", required_argument, NULL, 'b'},
+		{"bulk-delay", required_argument, NULL, 'D'},
+		{"workers", required_argument, NULL, 'W'},
+		{"worker-sessions", required_argument, NULL, 'N'},
+		{"wait", required_argument, NULL, 'w'},
+		{"label", required_argument, NULL, 'l'},
+		{"output", required_argument, NULL, 'o'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	struct passwd* pw;
+	char* item, *saveptr = NULL, *config = NULL, pubkey[1024], started[32];
+	int opt, transports_set = 0, ret = EXIT_FAILURE;
+	unsigned int i, j;
+	time_t t;
+
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'a':
+			opts.host = optarg;
+			break;
+		case 'p':
+			opts.ssh_port = atoi(optarg);
+			break;
+		case 'P':
+			opts.tls_port = atoi(optarg);
+			break;
+		case 'x':
+			opts.unix_path = optarg;
+			break;
+		case 'u':
+			opts.user = optarg;
+			break;
+		case 'k':
+			opts.key = optarg;
+			break;
+		case 'c':
+			opts.cert = optarg;
+			break;
+		case 'K':
+			opts.cert_key = optarg;
+			break;
+		case 'C':
+			opts.ca = optarg;
+			break;
+		case 't':
+			transports_set = 1;
+			if (parse_list(optarg, 0)) {
+				return EXIT_FAILURE;
+			}
+			break;
+		case 's':
+			opts.scenarios = 0;
+			if (parse_list(optarg, 1)) {
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			opts.sessions_count = 0;
+			for (item = strtok_r(optarg, ",", &saveptr); item != NULL && opts.sessions_count < 16; item = strtok_r(NULL, ",", &saveptr)) {
+				opts.sessions[opts.sessions_count++] = atoi(item);
+			}
+			break;
+		case 'd':
+			opts.duration = atoi(optarg);
+			break;
+		case 'f':
+			opts.filter = optarg;
+			break;
+		case 'S':
+			opts.subscribers = atoi(optarg);
+			break;
+		case 'e':
+			opts.events = atoi(optarg);
+			break;
+		case 'm':
+			opts.memory_sessions = atoi(optarg);
+			break;
+		case 'H':
+			opts.hibernate = atoi(optarg);
+			break;
+		case 'i':
+			opts.pid = atoi(optarg);
+			break;
+		case 'z':
+			opts.startup_mib = atoi(optarg);
+			break;
+		case 'b':
+			opts.bulk_entries = atoi(optarg);
+			break;
+		case 'D':
+			opts.bulk_delay = atoi(optarg);
+			break;
+		case 'W':
+			opts.workers = atoi(optarg);
+			break;
+		case 'N':
+			opts.worker_sessions = atoi(optarg);
+			break;
+		case 'w':
+			opts.wait = atoi(optarg);
+			break;
+		case 'l':
+			opts.label = optarg;
+			break;
+		case 'o':
+			opts.output = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!transports_set) {
+#ifdef NP_SSH
+		opts.transports[BENCH_SSH] = 1;
+#endif
+#ifdef NP_TLS
+		opts.transports[BENCH_TLS] = 1;
+#endif
+		opts.transports[BENCH_UNIX] = 1;
+	}
+#ifndef NP_SSH
+	opts.transports[BENCH_SSH] = 0;
+#endif
+#ifndef NP_TLS
+	opts.transports[BENCH_TLS] = 0;
+#endif
+
+	if (opts.user == NULL) {
+		if ((pw = getpwuid(geteuid())) == NULL) {
+			fprintf(stderr, "Failed to get the current user name.\n");
+			return EXIT_FAILURE;
+		}
+		opts.user = strdup(pw->pw_name);
+	}
+	opts.password = getenv("NP_BENCH_PASSWORD");
+
+	if (opts.workers == 0) {
+		opts.workers = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if ((opts.scenarios & SCEN_WORKERS) && !opts.transports[BENCH_SSH] && !opts.transports[BENCH_TLS]) {
+		fprintf(stderr, "The workers scenario needs the SSH or TLS transport, skipping it.\n");
+		opts.scenarios &= ~SCEN_WORKERS;
+	}
+
+	if ((opts.scenarios & SCEN_LOCAL) && (!opts.transports[BENCH_UNIX] || !opts.transports[BENCH_SSH])) {
+		fprintf(stderr, "The local scenario needs the Unix and SSH transports, skipping it.\n");
+		opts.scenarios &= ~SCEN_LOCAL;
+	}
+
+	if ((opts.scenarios & SCEN_MEMORY) && opts.pid == 0) {
+		fprintf(stderr, "The memory scenario needs the server process (--pid), skipping it.\n");
+		opts.scenarios &= ~SCEN_MEMORY;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	nc_init(NC_INIT_CLIENT | NC_INIT_LIBSSH_PTHREAD);
+	nc_verbosity(NC_VERB_ERROR);
+	nc_callback_print(clb_print);
+#ifdef NP_SSH
+	nc_callback_sshauth_password(clb_sshauth_password);
+	nc_callback_ssh_host_authenticity_check(clb_hostkey_check);
+	if (opts.key != NULL) {
+		snprintf(pubkey, sizeof pubkey, "%s.pub", opts.key);
+		nc_set_keypair_path(opts.key, pubkey);
+	}
+#else
+	(void)pubkey;
+#endif
+#ifdef NP_TLS
+	if (opts.transports[BENCH_TLS] && nc_tls_init(opts.cert, opts.cert_key, opts.ca, NULL, NULL, NULL) != EXIT_SUCCESS) {
+		fprintf(stderr, "Initiating TLS failed, skipping the TLS transport.\n");
+		opts.transports[BENCH_TLS] = 0;
+	}
+#endif
+
+	if (opts.output == NULL) {
+		out = stdout;
+	} else if ((out = fopen(opts.output, "w")) == NULL) {
+		fprintf(stderr, "Failed to open \"%s\" (%s).\n", opts.output, strerror(errno));
+		goto cleanup;
+	}
+
+	/* the startup scenario does not need the server */
+	if ((opts.scenarios & ~SCEN_STARTUP) && setup_apply()) {
+		goto cleanup;
+	}
+
+	t = time(NULL);
+	strftime(started, sizeof started, "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+	fprintf(out, "{\n\t\"schema\": \"%s\",\n\t\"label\": ", BENCH_SCHEMA);
+	json_string(opts.label);
+	fprintf(out, ",\n\t\"started\": \"%s\",\n\t\"parameters\": {\"duration_s\": %u, \"sessions\": [", started, opts.duration);
+	for (i = 0; i < opts.sessions_count; ++i) {
+		fprintf(out, "%s%u", (i ? ", " : ""), opts.sessions[i]);
+	}
+	fprintf(out, "], \"filter\": ");
+	json_string(opts.filter);
+	fprintf(out, ", \"subscribers\": %u, \"events\": %u, \"memory_sessions\": %u, \"hibernate_timeout_s\": %u, \"startup_mib\": %u, "
+			"\"bulk_entries\": %u, \"bulk_delay_ms\": %u, \"workers\": %u, \"worker_sessions\": %u},\n\t\"results\": [", opts.subscribers,
+			opts.events, opts.memory_sessions, opts.hibernate, opts.startup_mib, opts.bulk_entries, opts.bulk_delay, opts.workers,
+			opts.worker_sessions);
+
+	if (opts.scenarios & SCEN_STARTUP) {
+		bench_startup();
+	}
+
+	for (i = 0; i < BENCH_TRANSPORT_COUNT && (opts.scenarios & ~SCEN_STARTUP); ++i) {
+		if (!opts.transports[i]) {
+			continue;
+		}
+		if (opts.scenarios & SCEN_CONNECT) {
+			bench_connect(i);
+		}
+		if (opts.scenarios & SCEN_HANDSHAKE) {
+			bench_handshake(i);
+		}
+		if (opts.scenarios & SCEN_RPC) {
+			for (j = 0; j < BENCH_OP_COUNT * opts.sessions_count; ++j) {
+				bench_rpc(i, j / opts.sessions_count, opts.sessions[j % opts.sessions_count], -1);
+			}
+		}
+		if (opts.scenarios & SCEN_NOTIF) {
+			bench_notif(i);
+		}
+		if (opts.scenarios & SCEN_MEMORY) {
+			bench_memory(i, 0);
+			bench_memory(i, 1);
+		}
+		if (opts.scenarios & SCEN_COMMIT) {
+			bench_commit(i, 0);
+			bench_commit(i, 1);
+		}
+		if (opts.scenarios & SCEN_IO) {
+			bench_io(i, 0);
+			bench_io(i, 1);
+		}
+	}
+
+	/* the replies are cert-to-name entries, so the TLS feature is needed even for SSH */
+	if ((opts.scenarios & SCEN_BULK) && (opts.transports[BENCH_SSH] || opts.transports[BENCH_TLS])) {
+		if ((config = bulk_config(0)) == NULL || sess_rpc(&admin_sess, rpc_edit(config))) {
+			fprintf(stderr, "Failed to add the bulk cert-to-name entries, skipping the bulk scenario.\n");
+		} else {
+			for (i = 0; i < (opts.bulk_delay ? 2 : 1); ++i) {
+				if (i && bulk_loopback_delay(opts.bulk_delay)) {
+					fprintf(stderr, "Failed to delay the loopback by netem (tc), skipping the delayed bulk scenario.\n");
+					break;
+				}
+				for (j = 0; j < 4; ++j) {
+					if (opts.transports[j / 2 ? BENCH_TLS : BENCH_SSH]) {
+						bench_bulk(j / 2 ? BENCH_TLS : BENCH_SSH, j % 2, (i ? opts.bulk_delay : 0));
+					}
+				}
+				if (i) {
+					bulk_loopback_delay(0);
+				}
+			}
+		}
+		free(config);
+		if ((config = bulk_config(1)) == NULL || sess_rpc(&admin_sess, rpc_edit(config))) {
+			fprintf(stderr, "Failed to remove the bulk cert-to-name entries.\n");
+		}
+		free(config);
+	}
+
+	if (opts.scenarios & SCEN_LOCAL) {
+		bench_local();
+	}
+
+	/* the last one, it restarts the server */
+	if (opts.scenarios & SCEN_WORKERS) {
+		bench_workers();
+	}
+
+	fprintf(out, "\n\t]\n}\n");
+	ret = EXIT_SUCCESS;
+
+cleanup:
+	setup_restore();
+	if (out != NULL && out != stdout) {
+		fclose(out);
+	}
+	nc_close();
+
+	return ret;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Start netopeer-server built in this tree, run np-bench against it and store
+# the JSON results. Must be run from the server directory as a user allowed to
+# start the server (it binds the NETCONF ports). Additional arguments are
+# passed to np-bench, the SSH password can be set in NP_BENCH_PASSWORD. The
+# sessions are hibernated after 5 seconds, so the memory scenario measures the
+# server memory before and after the hibernation, unless --hibernate is given.
+#
+# The server never uses the installed configuration. The module configurations
+# of NP_BENCH_MODULES (the installed modules.conf.d) and their datastores are
+# copied into a temporary directory, the server reads them from there
+# (NETOPEER_MODULES_CFG_DIR) and the directory is removed at the end, so all
+# the configuration changes of np-bench are discarded with it.
+#
+# The server and np-bench run in a private network namespace (unshare) with a
+# loopback of its own, so the ports of an installed server are not taken and
+# the netem delay of --bulk-delay never affects the host.
+#
+# usage: bench/run-bench.sh [results.json] [np-bench options]
+#
+
+if [ -z "$NP_BENCH_NETNS" ]; then
+	NP_BENCH_NETNS=1 exec unshare --net "$0" "$@"
+fi
+ip link set lo up || exit 1
+
+SERVER=${NP_BENCH_SERVER:-./netopeer-server}
+BENCH=${NP_BENCH:-bench/np-bench}
+MODULES=${NP_BENCH_MODULES:-/etc/netopeer/modules.conf.d}
+RESULTS=${1:-bench-results.json}
+[ $# -gt 0 ] && shift
+
+LABEL="$(cat VERSION)"
+if git rev-parse --short HEAD >/dev/null 2>&1; then
+	LABEL="$LABEL $(git rev-parse --short HEAD)"
+fi
+
+RUNDIR=$(mktemp -d /tmp/np-bench-run-XXXXXX) || exit 1
+trap 'rm -rf "$RUNDIR"' EXIT
+mkdir "$RUNDIR/modules.conf.d" "$RUNDIR/datastores" || exit 1
+
+# every module gets its own copy of its datastore, the rest of its configuration is kept
+for CFG in "$MODULES"/*.xml; do
+	[ -f "$CFG" ] || continue
+	NAME=$(basename "$CFG" .xml)
+	DS=$(sed -n '/<repo>/,/<\/repo>/s/.*<path>\(.*\)<\/path>.*/\1/p' "$CFG")
+	if [ -n "$DS" ]; then
+		if [ -f "$DS" ]; then
+			cp "$DS" "$RUNDIR/datastores/$NAME.xml" || exit 1
+		fi
+		sed '/<repo>/,/<\/repo>/s|<path>.*</path>|<path>'"$RUNDIR/datastores/$NAME.xml"'</path>|' "$CFG" \
+			> "$RUNDIR/modules.conf.d/$NAME.xml" || exit 1
+	else
+		cp "$CFG" "$RUNDIR/modules.conf.d/" || exit 1
+	fi
+done
+if [ ! -f "$RUNDIR/modules.conf.d/Netopeer.xml" ]; then
+	echo "No Netopeer module configuration in \"$MODULES\", set NP_BENCH_MODULES." >&2
+	exit 1
+fi
+
+NETOPEER_MODULES_CFG_DIR="$RUNDIR/modules.conf.d" $SERVER -v 0 &
+SERVER_PID=$!
+trap 'kill -TERM $SERVER_PID 2>/dev/null; wait $SERVER_PID; rm -rf "$RUNDIR"' EXIT INT TERM
+
+$BENCH --pid $SERVER_PID --label "$LABEL" --cert certs/client.crt --cert-key certs/client.key \
+	--ca certs/ca.pem --output "$RESULTS" --hibernate 5 "$@"
@@ -0,0 +1,1018 @@
+/**
+ * @file netopeer-import.c
+ * @brief Bulk import of the Netopeer SSH and TLS authentication configuration
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NS_DATASTORES "urn:cesnet:tmc:datastores:file"
+#define NS_NETOPEER "urn:cesnet:tmc:netopeer:1.0"
+#define NS_X509C2N "urn:ietf:params:xml:ns:yang:ietf-x509-cert-to-name"
+
+/* entries read before a batch is validated */
+#define IMPORT_BATCH 4096
+
+/* buckets of the duplicate set, a power of two */
+#define IMPORT_HASH_SIZE 65536
+
+enum import_type {
+	IMPORT_CA_CERT,
+	IMPORT_CLIENT_CERT,
+	IMPORT_CTN,
+	IMPORT_AUTH_KEY
+};
+
+static const char* type_names[] = {"ca-cert", "client-cert", "cert-to-name", "client-auth-key"};
+
+struct import_entry {
+	enum import_type type;
+	const char* src;
+	unsigned int line;
+	/* raw fields, as read */
+	char* field[4];
+	/* results of the validation */
+	char* value;
+	uint32_t id;
+	char* err;
+};
+
+static const struct {
+	const char* name;
+	const char* id;
+	const EVP_MD* (*md)(void);
+} hashes[] = {
+	{"md5", "01", EVP_md5},
+	{"sha1", "02", EVP_sha1},
+	{"sha224", "03", EVP_sha224},
+	{"sha256", "04", EVP_sha256},
+	{"sha384", "05", EVP_sha384},
+	{"sha512", "06", EVP_sha512},
+	{NULL, NULL, NULL}
+};
+
+static const char* map_types[] = {"specified", "san-rfc822-name", "san-dns-name", "san-ip-address", "san-any", "common-name", NULL};
+
+static struct import_opts {
+	unsigned int threads;
+	int hash;
+	int skip_invalid;
+	const char* format;
+	const char* datastore;
+	const char* target;
+	const char* output;
+} opts = {
+	.hash = 3,
+	.target = "startup"
+};
+
+/* the batch being validated */
+static struct import_entry* batch;
+static unsigned int batch_count;
+static volatile unsigned int batch_next;
+
+/* set of the list keys and leaf-list values already in the configuration */
+static struct import_key {
+	char* key;
+	struct import_key* next;
+}* keys[IMPORT_HASH_SIZE];
+
+/* the configuration being built */
+static xmlDocPtr doc;
+static xmlNodePtr netopeer;
+static xmlNsPtr ns_netopeer;
+
+static unsigned long stat_added, stat_skipped, stat_invalid;
+
+static void entry_error(struct import_entry* entry, const char* format, ...) {
+	va_list ap;
+
+	if (entry->err != NULL) {
+		return;
+	}
+	va_start(ap, format);
+	if (vasprintf(&entry->err, format, ap) == -1) {
+		entry->err = NULL;
+	}
+	va_end(ap);
+}
+
+/* return NULL - not a readable file, the content otherwise */
+static char* read_file(const char* path, size_t* len) {
+	FILE* file;
+	char* buf;
+	struct stat st;
+
+	if ((file = fopen(path, "r")) == NULL) {
+		return NULL;
+	}
+	if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode) || (buf = malloc(st.st_size + 1)) == NULL) {
+		fclose(file);
+		return NULL;
+	}
+	*len = fread(buf, 1, st.st_size, file);
+	buf[*len] = '\0';
+	fclose(file);
+
+	return buf;
+}
+
+/* return NULL - not a certificate, the first certificate of a PEM or DER file or a base64 DER string otherwise */
+static X509* load_cert(const char* arg) {
+	X509* cert = NULL;
+	BIO* bio;
+	char* buf, *pem;
+	const unsigned char* ptr;
+	size_t len;
+
+	if ((buf = read_file(arg, &len)) != NULL) {
+		if ((bio = BIO_new_mem_buf(buf, len)) != NULL) {
+			cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+			BIO_free(bio);
+		}
+		if (cert == NULL) {
+			ptr = (const unsigned char*)buf;
+			cert = d2i_X509(NULL, &ptr, len);
+		}
+		free(buf);
+	} else if (asprintf(&pem, "-----BEGIN CERTIFICATE-----\n%s\n-----END CERTIFICATE-----\n", arg) != -1) {
+		if ((bio = BIO_new_mem_buf(pem, strlen(pem))) != NULL) {
+			cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+			BIO_free(bio);
+		}
+		free(pem);
+	}
+	ERR_clear_error();
+
+	return cert;
+}
+
+/* return NULL - error, the base64 DER of the certificate in the 64 column lines the datastore uses otherwise */
+static char* cert_to_base64der(X509* cert) {
+	BIO* bio;
+	char* data, *start, *end, *ret = NULL;
+	long len;
+
+	if ((bio = BIO_new(BIO_s_mem())) == NULL) {
+		return NULL;
+	}
+	if (PEM_write_bio_X509(bio, cert) == 1 && (len = BIO_get_mem_data(bio, &data)) > 0) {
+		/* strip the PEM header and footer lines */
+		start = memchr(data, '\n', len);
+		end = data + len - 1;
+		while (end > data && *end == '\n') {
+			--end;
+		}
+		while (end > data && *end != '\n') {
+			--end;
+		}
+		if (start != NULL && end > start) {
+			ret = strndup(start + 1, end - start - 1);
+		}
+	}
+	BIO_free(bio);
+
+	return ret;
+}
+
+static char* cert_fingerprint(X509* cert, int hash) {
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int dig_len, i;
+	char* str;
+
+	if (X509_digest(cert, hashes[hash].md(), digest, &dig_len) != 1 || dig_len == 0) {
+		return NULL;
+	}
+	if ((str = malloc(3 + dig_len * 3)) == NULL) {
+		return NULL;
+	}
+	strcpy(str, hashes[hash].id);
+	for (i = 0; i < dig_len; ++i) {
+		sprintf(str + 2 + i * 3, ":%02X", digest[i]);
+	}
+
+	return str;
+}
+
+/* return: 0 - a valid fingerprint, 1 - not a fingerprint */
+static int check_fingerprint(const char* str) {
+	int i;
+	size_t len;
+
+	for (i = 0; hashes[i].name != NULL; ++i) {
+		if (strncmp(str, hashes[i].id, 2) == 0 && str[2] == ':') {
+			break;
+		}
+	}
+	if (hashes[i].name == NULL) {
+		return 1;
+	}
+
+	len = strlen(str + 2);
+	if (len % 3 || len / 3 != (size_t)EVP_MD_size(hashes[i].md())) {
+		return 1;
+	}
+	for (str += 2; *str != '\0'; str += 3) {
+		if (str[0] != ':' || !isxdigit(str[1]) || !isxdigit(str[2])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* return: 0 - a valid public key, 1 - not an OpenSSH public key */
+static int check_pubkey(const char* path) {
+	static const char* key_types[] = {"ssh-rsa", "ssh-dss", "ssh-ed25519", "ecdsa-sha2-nistp256", "ecdsa-sha2-nistp384", "ecdsa-sha2-nistp521", NULL};
+	char* buf, *type, *blob, *saveptr = NULL;
+	unsigned char* raw;
+	size_t len, blob_len;
+	uint32_t type_len;
+	int i, ret = 1;
+
+	if ((buf = read_file(path, &len)) == NULL) {
+		return 1;
+	}
+	type = strtok_r(buf, " \t\r\n", &saveptr);
+	blob = strtok_r(NULL, " \t\r\n", &saveptr);
+	if (type == NULL || blob == NULL) {
+		free(buf);
+		return 1;
+	}
+	for (i = 0; key_types[i] != NULL; ++i) {
+		if (strcmp(type, key_types[i]) == 0) {
+			break;
+		}
+	}
+
+	/* the blob starts with the key type again */
+	blob_len = strlen(blob);
+	if (key_types[i] != NULL && blob_len % 4 == 0 && (raw = malloc(blob_len / 4 * 3 + 1)) != NULL) {
+		len = EVP_DecodeBlock(raw, (unsigned char*)blob, blob_len);
+		if (len > 4 && len != (size_t)-1) {
+			type_len = (raw[0] << 24) | (raw[1] << 16) | (raw[2] << 8) | raw[3];
+			if (type_len == strlen(type) && type_len <= len - 4 && memcmp(raw + 4, type, type_len) == 0) {
+				ret = 0;
+			}
+		}
+		free(raw);
+	}
+	free(buf);
+
+	return ret;
+}
+
+static void validate(struct import_entry* entry) {
+	X509* cert;
+	char* end;
+	unsigned long id;
+	int i;
+
+	if (entry->err != NULL) {
+		/* malformed on input */
+		return;
+	}
+
+	switch (entry->type) {
+	case IMPORT_CA_CERT:
+	case IMPORT_CLIENT_CERT:
+		if ((cert = load_cert(entry->field[0])) == NULL) {
+			entry_error(entry, "\"%s\" is not a certificate", entry->field[0]);
+			break;
+		}
+		if ((entry->value = cert_to_base64der(cert)) == NULL) {
+			entry_error(entry, "failed to encode the certificate");
+		}
+		X509_free(cert);
+		break;
+
+	case IMPORT_CTN:
+		errno = 0;
+		id = strtoul(entry->field[0], &end, 10);
+		if (errno || *end != '\0' || end == entry->field[0] || id > UINT32_MAX) {
+			entry_error(entry, "invalid id \"%s\"", entry->field[0]);
+			break;
+		}
+		entry->id = id;
+
+		for (i = 0; map_types[i] != NULL; ++i) {
+			if (strcmp(entry->field[2], map_types[i]) == 0
+					|| (strncmp(entry->field[2], "x509c2n:", 8) == 0 && strcmp(entry->field[2] + 8, map_types[i]) == 0)) {
+				break;
+			}
+		}
+		if (map_types[i] == NULL) {
+			entry_error(entry, "invalid map-type \"%s\"", entry->field[2]);
+			break;
+		}
+		/* store it normalized */
+		free(entry->field[2]);
+		entry->field[2] = strdup(map_types[i]);
+		if ((i == 0) != (entry->field[3] != NULL && entry->field[3][0] != '\0')) {
+			entry_error(entry, "name must be set exactly with the \"specified\" map-type");
+			break;
+		}
+
+		if (check_fingerprint(entry->field[1]) == 0) {
+			entry->value = strdup(entry->field[1]);
+		} else if ((cert = load_cert(entry->field[1])) != NULL) {
+			if ((entry->value = cert_fingerprint(cert, opts.hash)) == NULL) {
+				entry_error(entry, "failed to compute the fingerprint");
+			}
+			X509_free(cert);
+		} else {
+			entry_error(entry, "\"%s\" is neither a fingerprint nor a certificate", entry->field[1]);
+		}
+		break;
+
+	case IMPORT_AUTH_KEY:
+		if (entry->field[1] == NULL || entry->field[1][0] == '\0') {
+			entry_error(entry, "missing username");
+			break;
+		}
+		if ((entry->value = realpath(entry->field[0], NULL)) == NULL) {
+			entry_error(entry, "\"%s\" (%s)", entry->field[0], strerror(errno));
+			break;
+		}
+		if (check_pubkey(entry->value)) {
+			entry_error(entry, "\"%s\" is not an OpenSSH public key", entry->field[0]);
+		}
+		break;
+	}
+}
+
+static void* validate_thread(void* arg) {
+	unsigned int i;
+
+	(void)arg;
+	while ((i = __sync_fetch_and_add(&batch_next, 1)) < batch_count) {
+		validate(&batch[i]);
+	}
+
+	return NULL;
+}
+
+static unsigned int key_hash(const char* str) {
+	unsigned int hash = 5381;
+
+	while (*str != '\0') {
+		hash = hash * 33 + (unsigned char)*str++;
+	}
+
+	return hash & (IMPORT_HASH_SIZE - 1);
+}
+
+/* return: 0 - added, 1 - already present */
+static int key_add(enum import_type type, const char* value) {
+	struct import_key* key;
+	char* str;
+	unsigned int hash;
+
+	if (asprintf(&str, "%d %s", type, value) == -1) {
+		return 0;
+	}
+	hash = key_hash(str);
+	for (key = keys[hash]; key != NULL; key = key->next) {
+		if (strcmp(key->key, str) == 0) {
+			free(str);
+			return 1;
+		}
+	}
+
+	if ((key = malloc(sizeof *key)) == NULL) {
+		free(str);
+		return 0;
+	}
+	key->key = str;
+	key->next = keys[hash];
+	keys[hash] = key;
+
+	return 0;
+}
+
+static void keys_free(void) {
+	struct import_key* key;
+	unsigned int i;
+
+	for (i = 0; i < IMPORT_HASH_SIZE; ++i) {
+		while ((key = keys[i]) != NULL) {
+			keys[i] = key->next;
+			free(key->key);
+			free(key);
+		}
+	}
+}
+
+static xmlNodePtr child_get(xmlNodePtr parent, const char* name, int create) {
+	xmlNodePtr child;
+
+	for (child = parent->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE && xmlStrEqual(child->name, BAD_CAST name)) {
+			return child;
+		}
+	}
+
+	return create ? xmlNewChild(parent, ns_netopeer, BAD_CAST name, NULL) : NULL;
+}
+
+static char* child_content(xmlNodePtr parent, const char* name) {
+	xmlNodePtr child;
+	char* content, *ptr;
+
+	if ((child = child_get(parent, name, 0)) == NULL || (content = (char*)xmlNodeGetContent(child)) == NULL) {
+		return NULL;
+	}
+	/* leaf values are trimmed */
+	for (ptr = content; isspace(*ptr); ++ptr);
+	memmove(content, ptr, strlen(ptr) + 1);
+	for (ptr = content + strlen(content); ptr > content && isspace(ptr[-1]); --ptr);
+	*ptr = '\0';
+
+	return content;
+}
+
+/* remember the entries already in the configuration, they are not added again */
+static void keys_load(void) {
+	xmlNodePtr node, cont;
+	char* value;
+
+	if ((cont = child_get(netopeer, "tls", 0)) != NULL) {
+		if ((node = child_get(cont, "trusted-ca-certs", 0)) != NULL) {
+			for (node = node->children; node != NULL; node = node->next) {
+				if (node->type == XML_ELEMENT_NODE && (value = (char*)xmlNodeGetContent(node)) != NULL) {
+					key_add(IMPORT_CA_CERT, value);
+					xmlFree(value);
+				}
+			}
+		}
+		if ((node = child_get(cont, "trusted-client-certs", 0)) != NULL) {
+			for (node = node->children; node != NULL; node = node->next) {
+				if (node->type == XML_ELEMENT_NODE && (value = (char*)xmlNodeGetContent(node)) != NULL) {
+					key_add(IMPORT_CLIENT_CERT, value);
+					xmlFree(value);
+				}
+			}
+		}
+		if ((node = child_get(cont, "cert-maps", 0)) != NULL) {
+			for (node = node->children; node != NULL; node = node->next) {
+				if (node->type == XML_ELEMENT_NODE && (value = child_content(node, "id")) != NULL) {
+					key_add(IMPORT_CTN, value);
+					free(value);
+				}
+			}
+		}
+	}
+	if ((cont = child_get(netopeer, "ssh", 0)) != NULL && (node = child_get(cont, "client-auth-keys", 0)) != NULL) {
+		for (node = node->children; node != NULL; node = node->next) {
+			if (node->type == XML_ELEMENT_NODE && (value = child_content(node, "path")) != NULL) {
+				key_add(IMPORT_AUTH_KEY, value);
+				free(value);
+			}
+		}
+	}
+}
+
+static void entry_store(struct import_entry* entry) {
+	xmlNodePtr node, parent;
+	xmlNsPtr ns;
+	char* content, id[11];
+
+	switch (entry->type) {
+	case IMPORT_CA_CERT:
+	case IMPORT_CLIENT_CERT:
+		if (key_add(entry->type, entry->value)) {
+			++stat_skipped;
+			return;
+		}
+		parent = child_get(child_get(netopeer, "tls", 1), entry->type == IMPORT_CA_CERT ? "trusted-ca-certs" : "trusted-client-certs", 1);
+		xmlNewTextChild(parent, ns_netopeer, BAD_CAST (entry->type == IMPORT_CA_CERT ? "trusted-ca-cert" : "trusted-client-cert"), BAD_CAST entry->value);
+		break;
+
+	case IMPORT_CTN:
+		sprintf(id, "%u", entry->id);
+		if (key_add(entry->type, id)) {
+			fprintf(stderr, "%s:%u: cert-to-name %s already exists, skipping.\n", entry->src, entry->line, id);
+			++stat_skipped;
+			return;
+		}
+		if ((ns = xmlSearchNsByHref(doc, netopeer, BAD_CAST NS_X509C2N)) == NULL) {
+			ns = xmlNewNs(netopeer, BAD_CAST NS_X509C2N, BAD_CAST "x509c2n");
+		}
+		parent = child_get(child_get(netopeer, "tls", 1), "cert-maps", 1);
+		node = xmlNewChild(parent, ns_netopeer, BAD_CAST "cert-to-name", NULL);
+		xmlNewTextChild(node, ns_netopeer, BAD_CAST "id", BAD_CAST id);
+		xmlNewTextChild(node, ns_netopeer, BAD_CAST "fingerprint", BAD_CAST entry->value);
+		if (asprintf(&content, "%s:%s", ns->prefix, entry->field[2]) != -1) {
+			xmlNewTextChild(node, ns_netopeer, BAD_CAST "map-type", BAD_CAST content);
+			free(content);
+		}
+		if (entry->field[3] != NULL && entry->field[3][0] != '\0') {
+			xmlNewTextChild(node, ns_netopeer, BAD_CAST "name", BAD_CAST entry->field[3]);
+		}
+		break;
+
+	case IMPORT_AUTH_KEY:
+		if (key_add(entry->type, entry->value)) {
+			fprintf(stderr, "%s:%u: client-auth-key %s already exists, skipping.\n", entry->src, entry->line, entry->value);
+			++stat_skipped;
+			return;
+		}
+		parent = child_get(child_get(netopeer, "ssh", 1), "client-auth-keys", 1);
+		node = xmlNewChild(parent, ns_netopeer, BAD_CAST "client-auth-key", NULL);
+		xmlNewTextChild(node, ns_netopeer, BAD_CAST "path", BAD_CAST entry->value);
+		xmlNewTextChild(node, ns_netopeer, BAD_CAST "username", BAD_CAST entry->field[1]);
+		break;
+	}
+
+	++stat_added;
+}
+
+static void entry_clean(struct import_entry* entry) {
+	int i;
+
+	for (i = 0; i < 4; ++i) {
+		free(entry->field[i]);
+	}
+	free(entry->value);
+	free(entry->err);
+	memset(entry, 0, sizeof *entry);
+}
+
+/* validate the batch in parallel and store it in the input order */
+static void batch_flush(void) {
+	pthread_t* threads;
+	unsigned int i, count;
+
+	if (batch_count == 0) {
+		return;
+	}
+
+	count = opts.threads < batch_count ? opts.threads : batch_count;
+	batch_next = 0;
+	threads = calloc(count, sizeof *threads);
+	for (i = 0; threads != NULL && i < count; ++i) {
+		if (pthread_create(&threads[i], NULL, validate_thread, NULL) != 0) {
+			break;
+		}
+	}
+	/* the rest is done here, also when no thread could be created */
+	validate_thread(NULL);
+	while (threads != NULL && i > 0) {
+		pthread_join(threads[--i], NULL);
+	}
+	free(threads);
+
+	for (i = 0; i < batch_count; ++i) {
+		if (batch[i].err != NULL) {
+			fprintf(stderr, "%s:%u: %s: %s.\n", batch[i].src, batch[i].line, type_names[batch[i].type], batch[i].err);
+			++stat_invalid;
+		} else if (stat_invalid == 0 || opts.skip_invalid) {
+			entry_store(&batch[i]);
+		}
+		entry_clean(&batch[i]);
+	}
+	batch_count = 0;
+}
+
+static struct import_entry* batch_add(enum import_type type, const char* src, unsigned int line) {
+	struct import_entry* entry;
+
+	if (batch_count == IMPORT_BATCH) {
+		batch_flush();
+	}
+	entry = &batch[batch_count++];
+	entry->type = type;
+	entry->src = src;
+	entry->line = line;
+
+	return entry;
+}
+
+/* return -1 - unknown, the type otherwise */
+static int type_parse(const char* str) {
+	int i;
+
+	for (i = 0; i <= IMPORT_AUTH_KEY; ++i) {
+		if (strcmp(str, type_names[i]) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static char* trim(char* str) {
+	char* end;
+
+	while (isspace(*str)) {
+		++str;
+	}
+	for (end = str + strlen(str); end > str && isspace(end[-1]); --end);
+	*end = '\0';
+
+	return str;
+}
+
+/* return: number of the malformed lines */
+static unsigned int read_csv(FILE* file, const char* src) {
+	static const int field_min[] = {1, 1, 3, 2}, field_max[] = {1, 1, 4, 2};
+	struct import_entry* entry;
+	char* line = NULL, *ptr, *field[5];
+	size_t size = 0;
+	unsigned int lineno = 0, errors = 0;
+	int type, count;
+
+	while (getline(&line, &size, file) != -1) {
+		++lineno;
+		ptr = trim(line);
+		if (ptr[0] == '\0' || ptr[0] == '#') {
+			continue;
+		}
+
+		for (count = 0; ptr != NULL && count < 5; ++count) {
+			field[count] = trim(strsep(&ptr, ","));
+		}
+		if ((type = type_parse(field[0])) == -1 || count - 1 < field_min[type] || count - 1 > field_max[type] || ptr != NULL) {
+			fprintf(stderr, "%s:%u: malformed entry.\n", src, lineno);
+			++errors;
+			continue;
+		}
+
+		entry = batch_add(type, src, lineno);
+		for (--count; count > 0; --count) {
+			entry->field[count - 1] = strdup(field[count]);
+		}
+	}
+	free(line);
+
+	return errors;
+}
+
+/* return: number of the malformed elements */
+static unsigned int read_xml(const char* path, const char* src) {
+	static const char* leaves[][4] = {
+		{NULL},
+		{NULL},
+		{"id", "fingerprint", "map-type", "name"},
+		{"path", "username", NULL, NULL}
+	};
+	xmlTextReaderPtr reader;
+	xmlNodePtr node;
+	struct import_entry* entry;
+	const char* name;
+	char* content;
+	unsigned int errors = 0;
+	int ret, type, i;
+
+	if ((reader = xmlReaderForFile(path, NULL, XML_PARSE_NOBLANKS | XML_PARSE_HUGE)) == NULL) {
+		fprintf(stderr, "%s: failed to open.\n", src);
+		return 1;
+	}
+
+	ret = xmlTextReaderRead(reader);
+	while (ret == 1) {
+		name = (const char*)xmlTextReaderConstLocalName(reader);
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+			ret = xmlTextReaderRead(reader);
+			continue;
+		}
+		if (strcmp(name, "trusted-ca-cert") == 0) {
+			type = IMPORT_CA_CERT;
+		} else if (strcmp(name, "trusted-client-cert") == 0) {
+			type = IMPORT_CLIENT_CERT;
+		} else if (strcmp(name, "cert-to-name") == 0) {
+			type = IMPORT_CTN;
+		} else if (strcmp(name, "client-auth-key") == 0) {
+			type = IMPORT_AUTH_KEY;
+		} else {
+			ret = xmlTextReaderRead(reader);
+			continue;
+		}
+
+		/* only this element is kept in memory */
+		if ((node = xmlTextReaderExpand(reader)) == NULL) {
+			break;
+		}
+		entry = batch_add(type, src, xmlTextReaderGetParserLineNumber(reader));
+		if (leaves[type][0] == NULL) {
+			content = (char*)xmlNodeGetContent(node);
+			entry->field[0] = strdup(content != NULL ? trim(content) : "");
+			xmlFree(content);
+		} else {
+			for (i = 0; i < 4 && leaves[type][i] != NULL; ++i) {
+				entry->field[i] = child_content(node, leaves[type][i]);
+			}
+			for (i = 0; i < 2; ++i) {
+				if (entry->field[i] == NULL) {
+					entry_error(entry, "missing %s", leaves[type][i]);
+				}
+			}
+			if (type == IMPORT_CTN && entry->field[2] == NULL) {
+				entry_error(entry, "missing map-type");
+			}
+		}
+		if (entry->err != NULL) {
+			/* reported with the batch */
+			for (i = 0; i < 4; ++i) {
+				if (entry->field[i] == NULL) {
+					entry->field[i] = strdup("");
+				}
+			}
+		}
+		ret = xmlTextReaderNext(reader);
+	}
+	if (ret == -1) {
+		fprintf(stderr, "%s: XML parsing failed.\n", src);
+		++errors;
+	}
+	xmlFreeTextReader(reader);
+
+	return errors;
+}
+
+/* return: 0 - prepared, 1 - error */
+static int doc_prepare(void) {
+	xmlNodePtr node;
+
+	if (opts.datastore == NULL) {
+		doc = xmlNewDoc(BAD_CAST "1.0");
+		netopeer = xmlNewNode(NULL, BAD_CAST "netopeer");
+		ns_netopeer = xmlNewNs(netopeer, BAD_CAST NS_NETOPEER, NULL);
+		xmlSetNs(netopeer, ns_netopeer);
+		xmlDocSetRootElement(doc, netopeer);
+		return 0;
+	}
+
+	if ((doc = xmlReadFile(opts.datastore, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN | XML_PARSE_HUGE)) == NULL) {
+		fprintf(stderr, "Failed to parse the datastore \"%s\".\n", opts.datastore);
+		return 1;
+	}
+	node = xmlDocGetRootElement(doc);
+	if (node == NULL || !xmlStrEqual(node->name, BAD_CAST "datastores") || node->ns == NULL || !xmlStrEqual(node->ns->href, BAD_CAST NS_DATASTORES)) {
+		fprintf(stderr, "\"%s\" is not a file datastore.\n", opts.datastore);
+		return 1;
+	}
+	for (node = node->children; node != NULL; node = node->next) {
+		if (node->type == XML_ELEMENT_NODE && xmlStrEqual(node->name, BAD_CAST opts.target)) {
+			break;
+		}
+	}
+	if (node == NULL) {
+		fprintf(stderr, "The datastore \"%s\" has no %s configuration.\n", opts.datastore, opts.target);
+		return 1;
+	}
+
+	for (netopeer = node->children; netopeer != NULL; netopeer = netopeer->next) {
+		if (netopeer->type == XML_ELEMENT_NODE && xmlStrEqual(netopeer->name, BAD_CAST "netopeer")
+				&& netopeer->ns != NULL && xmlStrEqual(netopeer->ns->href, BAD_CAST NS_NETOPEER)) {
+			break;
+		}
+	}
+	if (netopeer == NULL) {
+		netopeer = xmlNewChild(node, NULL, BAD_CAST "netopeer", NULL);
+		xmlSetNs(netopeer, xmlNewNs(netopeer, BAD_CAST NS_NETOPEER, NULL));
+	}
+	ns_netopeer = netopeer->ns;
+	keys_load();
+
+	return 0;
+}
+
+/* return: 0 - written, 1 - error */
+static int doc_write(void) {
+	struct stat st;
+	char* tmp;
+	int fd, ret;
+
+	if (opts.datastore == NULL) {
+		ret = xmlSaveFormatFile(opts.output != NULL ? opts.output : "-", doc, 1);
+		if (ret == -1) {
+			fprintf(stderr, "Failed to write the configuration.\n");
+			return 1;
+		}
+		return 0;
+	}
+
+	/* replace the datastore at once, keeping its permissions */
+	if (asprintf(&tmp, "%s.XXXXXX", opts.datastore) == -1) {
+		return 1;
+	}
+	if ((fd = mkstemp(tmp)) == -1) {
+		fprintf(stderr, "Failed to create \"%s\" (%s).\n", tmp, strerror(errno));
+		free(tmp);
+		return 1;
+	}
+	if (stat(opts.datastore, &st) == 0) {
+		if (fchmod(fd, st.st_mode & 07777) != 0 || fchown(fd, st.st_uid, st.st_gid) != 0) {
+			/* not fatal, only root can change the owner */
+		}
+	}
+	close(fd);
+
+	if (xmlSaveFormatFile(tmp, doc, 1) == -1 || rename(tmp, opts.datastore) != 0) {
+		fprintf(stderr, "Failed to write the datastore \"%s\" (%s).\n", opts.datastore, strerror(errno));
+		unlink(tmp);
+		free(tmp);
+		return 1;
+	}
+	free(tmp);
+
+	return 0;
+}
+
+static void print_usage(const char* progname) {
+	fprintf(stdout, "Usage: %s [options] <file> ...\n\n", progname);
+	fprintf(stdout, " -d, --datastore <path>     write into this file datastore, the edit-config content otherwise\n");
+	fprintf(stdout, " -t, --target <name>        datastore configuration to change (startup)\n");
+	fprintf(stdout, " -o, --output <path>        edit-config content file (stdout)\n");
+	fprintf(stdout, " -f, --format csv|xml       format of the input files (by the file suffix)\n");
+	fprintf(stdout, " -H, --hash <name>          fingerprint hash md5,sha1,sha224,sha256,sha384,sha512 (sha256)\n");
+	fprintf(stdout, " -j, --jobs <num>           validation threads (the online CPUs)\n");
+	fprintf(stdout, " -s, --skip-invalid         import the valid entries even if some are invalid\n");
+	fprintf(stdout, " -h, --help                 display this help\n\n");
+	fprintf(stdout, "CSV entries, one per line (\"-\" reads the standard input):\n");
+	fprintf(stdout, "  ca-cert,<cert>\n");
+	fprintf(stdout, "  client-cert,<cert>\n");
+	fprintf(stdout, "  cert-to-name,<id>,<fingerprint or cert>,<map-type>[,<name>]\n");
+	fprintf(stdout, "  client-auth-key,<public key path>,<username>\n");
+	fprintf(stdout, "where <cert> is a PEM or DER file or a base64 DER string.\n");
+}
+
+int main(int argc, char** argv) {
+	const struct option longopts[] = {
+		{"datastore", required_argument, NULL, 'd'},
+		{"target", required_argument, NULL, 't'},
+		{"output", required_argument, NULL, 'o'},
+		{"format", required_argument, NULL, 'f'},
+		{"hash", required_argument, NULL, 'H'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"skip-invalid", no_argument, NULL, 's'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	FILE* file;
+	const char* suffix;
+	unsigned int errors = 0;
+	long num;
+	int c, i, xml, ret = EXIT_FAILURE;
+
+	num = sysconf(_SC_NPROCESSORS_ONLN);
+	opts.threads = num > 0 ? num : 1;
+
+	while ((c = getopt_long(argc, argv, "d:t:o:f:H:j:sh", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'd':
+			opts.datastore = optarg;
+			break;
+		case 't':
+			opts.target = optarg;
+			break;
+		case 'o':
+			opts.output = optarg;
+			break;
+		case 'f':
+			if (strcmp(optarg, "csv") && strcmp(optarg, "xml")) {
+				fprintf(stderr, "Unknown format \"%s\".\n", optarg);
+				return EXIT_FAILURE;
+			}
+			opts.format = optarg;
+			break;
+		case 'H':
+			for (i = 0; hashes[i].name != NULL && strcmp(optarg, hashes[i].name); ++i);
+			if (hashes[i].name == NULL) {
+				fprintf(stderr, "Unknown hash \"%s\".\n", optarg);
+				return EXIT_FAILURE;
+			}
+			opts.hash = i;
+			break;
+		case 'j':
+			num = atol(optarg);
+			if (num < 1) {
+				fprintf(stderr, "Invalid number of jobs \"%s\".\n", optarg);
+				return EXIT_FAILURE;
+			}
+			opts.threads = num;
+			break;
+		case 's':
+			opts.skip_invalid = 1;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind == argc) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (opts.datastore != NULL && opts.output != NULL) {
+		fprintf(stderr, "Options --datastore and --output are mutually exclusive.\n");
+		return EXIT_FAILURE;
+	}
+
+	LIBXML_TEST_VERSION
+	xmlKeepBlanksDefault(0);
+	if ((batch = calloc(IMPORT_BATCH, sizeof *batch)) == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return EXIT_FAILURE;
+	}
+	if (doc_prepare()) {
+		goto cleanup;
+	}
+
+	for (i = optind; i < argc; ++i) {
+		if (opts.format != NULL) {
+			xml = (strcmp(opts.format, "xml") == 0);
+		} else {
+			suffix = strrchr(argv[i], '.');
+			xml = (suffix != NULL && strcasecmp(suffix, ".xml") == 0);
+		}
+
+		if (xml) {
+			errors += read_xml(argv[i], argv[i]);
+		} else if (strcmp(argv[i], "-") == 0) {
+			errors += read_csv(stdin, "<stdin>");
+		} else if ((file = fopen(argv[i], "r")) == NULL) {
+			fprintf(stderr, "%s: failed to open (%s).\n", argv[i], strerror(errno));
+			++errors;
+		} else {
+			errors += read_csv(file, argv[i]);
+			fclose(file);
+		}
+	}
+	batch_flush();
+	stat_invalid += errors;
+
+	if (stat_invalid && !opts.skip_invalid) {
+		fprintf(stderr, "%lu invalid entries, nothing imported.\n", stat_invalid);
+		goto cleanup;
+	}
+	if (doc_write()) {
+		goto cleanup;
+	}
+	fprintf(stderr, "%lu entries imported, %lu already configured, %lu invalid.\n", stat_added, stat_skipped, stat_invalid);
+	ret = stat_invalid ? EXIT_FAILURE : EXIT_SUCCESS;
+
+cleanup:
+	xmlFreeDoc(doc);
+	keys_free();
+	free(batch);
+	xmlCleanupParser();
+
+	return ret;
+}
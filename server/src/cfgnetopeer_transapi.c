@@ -48,11 +48,18 @@
 #include <stdlib.h>
 #include <libxml/tree.h>
 #include <libnetconf_xml.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
 #include <string.h>
 
 #include "server.h"
+#include "datastore_journal.h"
+#include "module_config.h"
+#include "state_data.h"
+#include "checkpoint.h"
+#include "commit.h"
+#include "event.h"
+#include "output_queue.h"
+#include "tcp_profile.h"
+#include "worker.h"
 
 static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
 
@@ -80,12 +87,21 @@ Feel free to use it to distinguish module behavior for different error-option va
 NC_EDIT_ERROPT_TYPE netopeer_erropt = NC_EDIT_ERROPT_NOTSET;
 
 struct np_options netopeer_options = {
-	.binds_lock = PTHREAD_MUTEX_INITIALIZER
+	.queue_high_watermark = 1048576,
+	.queue_low_watermark = 262144,
+	.queue_limit = 0,
+	.queue_stall_timeout = 60,
+	.queue_overflow = OUTPUT_QUEUE_DISCONNECT,
+	.binds_lock = PTHREAD_MUTEX_INITIALIZER,
+	.modules_lock = PTHREAD_MUTEX_INITIALIZER
 };
 
 extern struct transapi server_transapi;
 struct transapi netopeer_transapi;
 
+/* the modules of the startup configuration, enabled by module_enable_deferred() */
+static struct np_module* deferred_modules = NULL, **deferred_last = &deferred_modules;
+
 char* get_node_content(const xmlNodePtr node) {
 	if (node == NULL || node->children == NULL) {
 		return NULL;
@@ -93,10 +109,92 @@ char* get_node_content(const xmlNodePtr node) {
 	return (char*)node->children->content;
 }
 
+static unsigned int module_idx_hash(const char* name) {
+	unsigned int hash = 5381;
+
+	for (; *name != '\0'; ++name) {
+		hash = ((hash << 5) + hash) + (unsigned char)*name;
+	}
+
+	return hash % MODULE_INDEX_SIZE;
+}
+
+/* link a module into the list of active modules and the index, the caller must hold modules_lock (or be the only thread) */
+static void module_link(struct np_module* module) {
+	unsigned int hash = module_idx_hash(module->name);
+
+	if (netopeer_options.modules) {
+		netopeer_options.modules->prev = module;
+	}
+	module->next = netopeer_options.modules;
+	module->prev = NULL;
+	netopeer_options.modules = module;
+
+	module->idx_next = netopeer_options.module_idx[hash];
+	netopeer_options.module_idx[hash] = module;
+}
+
+static void module_unlink(struct np_module* module) {
+	struct np_module** prev;
+
+	if (module->next) {
+		module->next->prev = module->prev;
+	}
+	if (module->prev) {
+		module->prev->next = module->next;
+	}
+	if (netopeer_options.modules == module) {
+		netopeer_options.modules = module->next;
+	}
+
+	for (prev = &netopeer_options.module_idx[module_idx_hash(module->name)]; *prev != NULL; prev = &(*prev)->idx_next) {
+		if (*prev == module) {
+			*prev = module->idx_next;
+			break;
+		}
+	}
+}
+
+struct np_module* module_find(const char* name) {
+	struct np_module* module;
+
+	for (module = netopeer_options.module_idx[module_idx_hash(name)]; module != NULL; module = module->idx_next) {
+		if (strcmp(module->name, name) == 0) {
+			break;
+		}
+	}
+
+	return module;
+}
+
+/* the advertised capabilities may have changed, the owner and the workers collect them again */
+static void module_cpblts_changed(void) {
+	worker_cpblts_changed(__sync_add_and_fetch(&netopeer_options.cpblts_changes, 1));
+}
+
+/* a lazy module is being activated or disabled, the caller must hold modules_lock */
+static void module_lazy_clear(struct np_module* module) {
+	module_cfg_put(module->lazy);
+	module->lazy = NULL;
+	__sync_sub_and_fetch(&netopeer_options.lazy_count, 1);
+	__sync_add_and_fetch(&netopeer_options.lazy_activations, 1);
+	module_cpblts_changed();
+}
+
+/* keep a module only advertised until its first use, the caller must hold modules_lock */
+static void module_lazy_set(struct np_module* module, struct np_module_cfg* cfg) {
+	module->lazy = cfg;
+	__sync_add_and_fetch(&netopeer_options.lazy_count, 1);
+	module_cpblts_changed();
+}
+
 void module_free(struct np_module* module) {
 	if (module->ds) {
 		module_disable(module, 1);
 	} else {
+		if (module->lazy) {
+			module_lazy_clear(module);
+		}
 		free(module->name);
 		free(module);
 	}
@@ -105,10 +203,11 @@ void module_free(struct np_module* module) {
 /*
  * if repo_type is -1, then we are working with augment models specifications
  */
-static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE repo_type) {
-	char *transapi_path = NULL, *model_path = NULL, *feature, *name, *aux;
+static int parse_model_cfg(struct np_module* module, const struct np_module_model* model, NCDS_TYPE repo_type) {
+	const char *transapi_path = model->transapi, *model_path = model->path, *feature;
+	char *name, *aux;
 	struct transapi *st = NULL;
-	xmlNodePtr aux_node;
+	unsigned int i;
 
 	if (strcmp(module->name, NETOPEER_MODULE_NAME) == 0) {
 		st = &netopeer_transapi;
@@ -116,17 +215,6 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 		st = &server_transapi;
 	}
 
-	for (aux_node = node->children; aux_node != NULL; aux_node = aux_node->next) {
-		if (xmlStrcmp(aux_node->name, BAD_CAST "path") == 0) {
-			model_path = (char*)xmlNodeGetContent(aux_node);
-		}
-		if (xmlStrcmp(aux_node->name, BAD_CAST "transapi") == 0) {
-			transapi_path = (char*)xmlNodeGetContent(aux_node);
-		}
-		if (model_path && transapi_path) {
-			break;
-		}
-	}
 	/* Netopeer module is something extra */
 	if (st != NULL && model_path) {
 		/* internal static server (Netopeer) module */
@@ -141,8 +229,6 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 		} else {
 			nc_verb_verbose("Adding static transapi \"%s\"", model_path);
 			if ((module->ds = ncds_new_transapi_static(repo_type, model_path, st)) == NULL) {
-				free(model_path);
-				free(transapi_path);
 				return (EXIT_FAILURE);
 			}
 		}
@@ -155,8 +241,6 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 			/* base transapi module for datastore */
 			nc_verb_verbose("Adding transapi \"%s\"", model_path);
 			if ((module->ds = ncds_new_transapi(repo_type, model_path, transapi_path)) == NULL) {
-				free(model_path);
-				free(transapi_path);
 				return (EXIT_FAILURE);
 			}
 		}
@@ -169,14 +253,16 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 			/* base model for datastore */
 			nc_verb_verbose("Adding base model \"%s\"", model_path);
 			if ((module->ds = ncds_new2(repo_type, model_path, NULL)) == NULL) {
-				free(model_path);
 				return (EXIT_FAILURE);
 			}
 		}
 	} else {
 		nc_verb_error("Configuration mismatch: missing model path in %s config.", module->name);
+		return (EXIT_FAILURE);
 	}
-	name = strdup(basename(model_path));
+	aux = strdup(model_path);
+	name = strdup(basename(aux));
+	free(aux);
 	/* cut off the .yin suffix */
 	aux = strrchr(name, '.');
 	if (aux) { *aux = '\0';}
@@ -184,29 +270,26 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 	aux = strrchr(name, '@');
 	if (aux) { *aux = '\0';}
 
-	free(model_path);
-	free(transapi_path);
-
 	/* set features */
-	for (aux_node = node->children; aux_node != NULL; aux_node = aux_node->next) {
-		if (xmlStrcmp(aux_node->name, BAD_CAST "feature") == 0) {
-			feature = (char*)xmlNodeGetContent(aux_node);
-			if (strcmp(feature, "*") == 0) {
-				if (ncds_features_enableall(name)) {
-					nc_verb_error("Enabling all features in \"%s\" module failed.", name);
-					free(name);
-					return EXIT_FAILURE;
-				}
-				nc_verb_verbose("All features in \"%s\" module enabled.", name);
-			} else {
-				if (ncds_feature_enable(name, feature)) {
-					nc_verb_error("Enabling \"%s\" features in \"%s\" module failed.", feature, name);
-					free(name);
-					return EXIT_FAILURE;
-				}
-				nc_verb_verbose("\"%s\" features in \"%s\" module enabled.", feature, name);
+	for (i = 0; i < model->feature_count; ++i) {
+		feature = model->features[i];
+		if (feature == NULL) {
+			continue;
+		}
+		if (strcmp(feature, "*") == 0) {
+			if (ncds_features_enableall(name)) {
+				nc_verb_error("Enabling all features in \"%s\" module failed.", name);
+				free(name);
+				return EXIT_FAILURE;
+			}
+			nc_verb_verbose("All features in \"%s\" module enabled.", name);
+		} else {
+			if (ncds_feature_enable(name, feature)) {
+				nc_verb_error("Enabling \"%s\" features in \"%s\" module failed.", feature, name);
+				free(name);
+				return EXIT_FAILURE;
 			}
-			free(feature);
+			nc_verb_verbose("\"%s\" features in \"%s\" module enabled.", feature, name);
 		}
 	}
 	free(name);
@@ -214,97 +297,52 @@ static int parse_model_cfg(struct np_module* module, xmlNodePtr node, NCDS_TYPE
 	return (EXIT_SUCCESS);
 }
 
-int module_enable(struct np_module* module, int add) {
-	char *config_path = NULL, *repo_path = NULL, *repo_type_str = NULL;
-	int repo_type = -1, main_model_count;
-	xmlDocPtr module_config;
-	xmlNodePtr node;
-	xmlXPathContextPtr xpath_ctxt;
-	xmlXPathObjectPtr xpath_obj;
-
-	if (asprintf(&config_path, "%s/%s.xml", MODULES_CFG_DIR, module->name) == -1) {
-		nc_verb_error("asprintf() failed (%s:%d).", __FILE__, __LINE__);
-		return(EXIT_FAILURE);
-	}
-	if ((module_config = xmlReadFile(config_path, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NSCLEAN|XML_PARSE_NOWARNING|XML_PARSE_NOERROR)) == NULL) {
+/* create and initialize the datastore of a module, it must be consolidated before module_start() */
+static int module_load(struct np_module* module) {
+	struct np_module_cfg* cfg;
+	int repo_type = -1, main_model_count, journal = 0;
+	unsigned int i;
+
+	/* parsed only when the file changed since the last time */
+	if ((cfg = module_cfg_get(module->name)) == NULL) {
 		nc_verb_error("Reading configuration for %s module failed", module->name);
-		free(config_path);
 		return(EXIT_FAILURE);
 	}
-	free(config_path);
-
-	if ((xpath_ctxt = xmlXPathNewContext(module_config)) == NULL) {
-		nc_verb_error("Creating XPath context failed (%s:%d - module %s)", __FILE__, __LINE__, module->name);
-		return (EXIT_FAILURE);
-	}
-
-	/* get datastore information */
-	if ((xpath_obj = xmlXPathEvalExpression(BAD_CAST "/device/repo", xpath_ctxt)) == NULL) {
-		nc_verb_error("XPath evaluating error (%s:%d)", __FILE__, __LINE__);
-		goto err_cleanup;
-	} else if (xpath_obj->nodesetval == NULL || xpath_obj->nodesetval->nodeNr != 1) {
-		nc_verb_verbose("repo is not unique in %s transAPI module configuration.", module->name);
-		xmlXPathFreeObject(xpath_obj);
+	if (cfg->error != NULL) {
+		nc_verb_verbose("%s in %s transAPI module configuration.", cfg->error, module->name);
 		goto err_cleanup;
 	}
 
-	for (node = xpath_obj->nodesetval->nodeTab[0]->children; node != NULL; node = node->next) {
-		if (node->type != XML_ELEMENT_NODE) {
-			continue;
-		}
-		if (xmlStrcmp(node->name, BAD_CAST "type") == 0) {
-			repo_type_str = (char*)xmlNodeGetContent(node);
-		} else if (xmlStrcmp(node->name, BAD_CAST "path") == 0) {
-			repo_path = (char*)xmlNodeGetContent(node);
-		}
-	}
-	if (repo_type_str == NULL) {
+	/* get datastore information */
+	if (cfg->repo_type == NULL) {
 		nc_verb_warning("Missing attribute \'type\' in repo element for %s transAPI module.", module->name);
-		repo_type_str = strdup("unknown");
-	}
-	if (strcmp(repo_type_str, "empty") == 0) {
 		repo_type = NCDS_TYPE_EMPTY;
-	} else if (strcmp(repo_type_str, "file") == 0) {
+	} else if (strcmp(cfg->repo_type, "empty") == 0) {
+		repo_type = NCDS_TYPE_EMPTY;
+	} else if (strcmp(cfg->repo_type, "file") == 0) {
 		repo_type = NCDS_TYPE_FILE;
+	} else if (strcmp(cfg->repo_type, "journal") == 0) {
+		/* in-memory datastore with a write-ahead log, implemented as a custom libnetconf datastore */
+		repo_type = NCDS_TYPE_CUSTOM;
+		journal = 1;
 	} else {
-		nc_verb_warning("Unknown repo type \'%s\' in %s transAPI module configuration", repo_type_str, module->name);
+		nc_verb_warning("Unknown repo type \'%s\' in %s transAPI module configuration", cfg->repo_type, module->name);
 		nc_verb_warning("Continuing with \'empty\' datastore type.");
 		repo_type = NCDS_TYPE_EMPTY;
 	}
-	free(repo_type_str);
 
-	if (repo_type == NCDS_TYPE_FILE && repo_path == NULL) {
-		nc_verb_error("Missing path for \'file\' datastore type in %s transAPI module configuration.", module->name);
-		xmlXPathFreeObject(xpath_obj);
-		goto err_cleanup;
-	}
-	xmlXPathFreeObject(xpath_obj);
-
-	/* get data-models element */
-	if ((xpath_obj = xmlXPathEvalExpression(BAD_CAST "/device/data-models", xpath_ctxt)) == NULL) {
-		nc_verb_error("XPath evaluating error (%s:%d)", __FILE__, __LINE__);
-		goto err_cleanup;
-	} else if (xpath_obj->nodesetval == NULL || xpath_obj->nodesetval->nodeNr != 1) {
-		nc_verb_verbose("data-models is not unique in %s transAPI module configuration.", module->name);
-		xmlXPathFreeObject(xpath_obj);
+	if ((repo_type == NCDS_TYPE_FILE || journal) && cfg->repo_path == NULL) {
+		nc_verb_error("Missing path for \'%s\' datastore type in %s transAPI module configuration.", (journal ? "journal" : "file"), module->name);
 		goto err_cleanup;
 	}
 
 	/* parse models in the config-defined order, both main and augments */
 	main_model_count = 0;
-	for (node = xpath_obj->nodesetval->nodeTab[0]->children; node != NULL; node = node->next) {
-		if (node->type != XML_ELEMENT_NODE) {
-			continue;
-		}
-		if (xmlStrcmp(node->name, BAD_CAST "model") == 0) {
-			parse_model_cfg(module, node, -1);
-		}
-		if (xmlStrcmp(node->name, BAD_CAST "model-main") == 0) {
-			parse_model_cfg(module, node, repo_type);
+	for (i = 0; i < cfg->model_count; ++i) {
+		if (cfg->models[i].main) {
 			main_model_count++;
 		}
 	}
-	xmlXPathFreeObject(xpath_obj);
 	if (main_model_count == 0) {
 		nc_verb_verbose("model-main is not present in %s transAPI module configuration.", module->name);
 		goto err_cleanup;
@@ -312,81 +350,278 @@ int module_enable(struct np_module* module, int add) {
 		nc_verb_verbose("model-main is not unique in %s transAPI module configuration.", module->name);
 		goto err_cleanup;
 	}
+	for (i = 0; i < cfg->model_count; ++i) {
+		parse_model_cfg(module, &cfg->models[i], (cfg->models[i].main ? repo_type : -1));
+	}
 
 	if (repo_type == NCDS_TYPE_FILE) {
-		if (ncds_file_set_path(module->ds, repo_path)) {
+		if (ncds_file_set_path(module->ds, cfg->repo_path)) {
 			nc_verb_verbose("Unable to set path to datastore of the \'%s\' transAPI module.", module->name);
 			goto err_cleanup;
 		}
+	} else if (journal) {
+		if (module->ds == NULL || ncds_custom_set_data(module->ds, np_journal_new(cfg->repo_path), &np_journal_funcs)) {
+			nc_verb_verbose("Unable to set the journal datastore of the \'%s\' transAPI module.", module->name);
+			goto err_cleanup;
+		}
 	}
-	free(repo_path);
-	repo_path = NULL;
 
 	if ((module->id = ncds_init(module->ds)) < 0) {
 		goto err_cleanup;
 	}
+	if (cfg->state_ttl) {
+		state_data_cache_add(module->id, module->name, cfg->model, cfg->ns, cfg->state_ttl);
+	}
 
-	xmlXPathFreeContext(xpath_ctxt);
-	xmlFreeDoc(module_config);
+	module_cfg_put(cfg);
 
-	if (ncds_consolidate() != 0) {
-		nc_verb_warning("%s: consolidating libnetconf datastores failed for module %s.", __func__, module->name);
-		return (EXIT_FAILURE);
-	}
+	return (EXIT_SUCCESS);
 
+err_cleanup:
+
+	module_cfg_put(cfg);
+
+	ncds_free(module->ds);
+	module->ds = NULL;
+
+	return (EXIT_FAILURE);
+}
+
+/* apply the startup configuration of a loaded module */
+static int module_start(struct np_module* module, int add) {
 	/* remove datastore locks if any kept */
 	if (server_start) {
 		ncds_break_locks(NULL);
 	}
 	if (ncds_device_init(&(module->id), NULL, 1) != 0) {
 		nc_verb_error("Device initialization of module %s failed.", module->name);
+		state_data_cache_del(module->id);
 		ncds_free(module->ds);
 		module->ds = NULL;
 		return (EXIT_FAILURE);
 	}
 
 	if (add) {
-		if (netopeer_options.modules) {
-			netopeer_options.modules->prev = module;
-		}
-		module->next = netopeer_options.modules;
-		netopeer_options.modules = module;
+		module_link(module);
 	}
 
 	return (EXIT_SUCCESS);
+}
 
-err_cleanup:
+/* load and start a module, the caller must hold modules_lock (or be the only thread) */
+static int module_activate(struct np_module* module, int add) {
+	if (module_load(module)) {
+		return (EXIT_FAILURE);
+	}
 
-	xmlXPathFreeContext(xpath_ctxt);
-	xmlFreeDoc(module_config);
+	module_cpblts_changed();
+	state_data_invalidate();
+	if (ncds_consolidate() != 0) {
+		nc_verb_warning("%s: consolidating libnetconf datastores failed for module %s.", __func__, module->name);
+		return (EXIT_FAILURE);
+	}
 
-	ncds_free(module->ds);
-	module->ds = NULL;
+	return module_start(module, add);
+}
 
-	free(repo_path);
+int module_enable(struct np_module* module, int add) {
+	struct np_module_cfg* cfg;
+
+	/* the internal modules are always needed */
+	if (strcmp(module->name, NETOPEER_MODULE_NAME) && strcmp(module->name, NCSERVER_MODULE_NAME)
+			&& (cfg = module_cfg_get(module->name)) != NULL) {
+		if (cfg->error == NULL && cfg->lazy) {
+			nc_verb_verbose("Module %s will be activated on its first use.", module->name);
+			module_lazy_set(module, cfg);
+			if (add) {
+				module_link(module);
+			}
+			return (EXIT_SUCCESS);
+		}
+		module_cfg_put(cfg);
+	}
 
-	return (EXIT_FAILURE);
+	return module_activate(module, add);
 }
 
-int module_disable(struct np_module* module, int destroy) {
-	ncds_free(module->ds);
-	module->ds = NULL;
+int module_enable_deferred(void) {
+	struct np_module* module;
+	int ret = EXIT_SUCCESS;
 
-	if (ncds_consolidate() != 0) {
-		nc_verb_warning("%s: consolidating libnetconf datastores failed for module %s.", __func__, module->name);
+	/* MODULES LOCK */
+	pthread_mutex_lock(&netopeer_options.modules_lock);
+
+	while ((module = deferred_modules) != NULL) {
+		deferred_modules = module->next;
+		module->next = NULL;
+		if (module_enable(module, 1)) {
+			nc_verb_error("Starting the %s module failed.", module->name);
+			free(module->name);
+			free(module);
+			ret = EXIT_FAILURE;
+		}
 	}
+	deferred_last = &deferred_modules;
 
-	if (destroy) {
-		if (module->next) {
-			module->next->prev = module->prev;
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+	return ret;
+}
+
+void module_activate_lazy(const char* const* targets, unsigned int count) {
+	struct np_module* module;
+	unsigned int i;
+
+	if (netopeer_options.lazy_count == 0) {
+		return;
+	}
+
+	/* MODULES LOCK */
+	pthread_mutex_lock(&netopeer_options.modules_lock);
+
+	for (module = netopeer_options.modules; module != NULL && netopeer_options.lazy_count; module = module->next) {
+		if (module->lazy == NULL) {
+			/* active, or activated by a concurrent RPC while we were waiting for the lock */
+			continue;
 		}
-		if (module->prev) {
-			module->prev->next = module->next;
+		if (targets != NULL) {
+			for (i = 0; i < count && strcmp(targets[i], module->lazy->ns) && strcmp(targets[i], module->lazy->model); ++i);
+			if (i == count) {
+				continue;
+			}
 		}
-		if (netopeer_options.modules == module) {
-			netopeer_options.modules = module->next;
+
+		nc_verb_verbose("Activating module %s on its first use.", module->name);
+		module_lazy_clear(module);
+		if (module_activate(module, 0)) {
+			nc_verb_error("Activation of module %s failed, reload it to try again.", module->name);
 		}
+	}
+
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+}
+
+/* the capabilities of the datastores and the lazy modules */
+static struct nc_cpblts* module_collect_cpblts(void) {
+	struct nc_cpblts* caps;
+	struct np_module* module;
+	unsigned int activations;
+
+	while (1) {
+		activations = netopeer_options.lazy_activations;
+		/* not under modules_lock, libnetconf locks its datastores on its own */
+		caps = nc_session_get_cpblts_default();
+		if (caps == NULL || netopeer_options.lazy_count == 0) {
+			return caps;
+		}
+
+		/* MODULES LOCK */
+		pthread_mutex_lock(&netopeer_options.modules_lock);
+		if (activations == netopeer_options.lazy_activations) {
+			break;
+		}
+		/* MODULES UNLOCK */
+		pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+		/* a lazy module was activated meanwhile and may be missing in caps */
+		nc_cpblts_free(caps);
+	}
+
+	for (module = netopeer_options.modules; module != NULL; module = module->next) {
+		if (module->lazy != NULL) {
+			nc_cpblts_add(caps, module->lazy->capability);
+		}
+	}
+
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+	return caps;
+}
 
+/* the capabilities of the last server hello, kept until they may change, in the owner and in every worker */
+static struct {
+	pthread_mutex_t lock;
+	unsigned int changes;
+	char** list;
+} cpblts_cache = {PTHREAD_MUTEX_INITIALIZER, 0, NULL};
+
+static void module_cpblts_cache_free(void) {
+	int i;
+
+	for (i = 0; cpblts_cache.list != NULL && cpblts_cache.list[i] != NULL; ++i) {
+		free(cpblts_cache.list[i]);
+	}
+	free(cpblts_cache.list);
+	cpblts_cache.list = NULL;
+}
+
+struct nc_cpblts* module_get_cpblts(void) {
+	struct nc_cpblts* caps;
+	const char* cpblt;
+	unsigned int changes;
+	int i;
+
+	/* read before collecting them, so a concurrent change makes the next hello collect them again */
+	if (worker_id() != -1) {
+		/* published by the owner, a worker asks it only after a change */
+		changes = worker_cpblts_changes();
+	} else {
+		changes = netopeer_options.cpblts_changes;
+	}
+
+	/* CPBLTS CACHE LOCK */
+	pthread_mutex_lock(&cpblts_cache.lock);
+
+	if (cpblts_cache.list == NULL || cpblts_cache.changes != changes) {
+		module_cpblts_cache_free();
+		/* the modules are enabled in the owner process */
+		if ((caps = (worker_id() != -1 ? worker_cpblts() : module_collect_cpblts())) == NULL) {
+			/* CPBLTS CACHE UNLOCK */
+			pthread_mutex_unlock(&cpblts_cache.lock);
+			return NULL;
+		}
+		if ((cpblts_cache.list = calloc(nc_cpblts_count(caps) + 1, sizeof *cpblts_cache.list)) == NULL) {
+			/* CPBLTS CACHE UNLOCK */
+			pthread_mutex_unlock(&cpblts_cache.lock);
+			return caps;
+		}
+		nc_cpblts_iter_start(caps);
+		for (i = 0; (cpblt = nc_cpblts_iter_next(caps)) != NULL; ++i) {
+			cpblts_cache.list[i] = strdup(cpblt);
+		}
+		nc_cpblts_free(caps);
+		cpblts_cache.changes = changes;
+	}
+
+	caps = nc_cpblts_new((const char* const*)cpblts_cache.list);
+
+	/* CPBLTS CACHE UNLOCK */
+	pthread_mutex_unlock(&cpblts_cache.lock);
+
+	return caps;
+}
+
+int module_disable(struct np_module* module, int destroy) {
+	if (module->lazy) {
+		/* nothing was added to libnetconf */
+		module_lazy_clear(module);
+	} else {
+		state_data_cache_del(module->id);
+		ncds_free(module->ds);
+		module->ds = NULL;
+		module_cpblts_changed();
+		state_data_invalidate();
+
+		if (ncds_consolidate() != 0) {
+			nc_verb_warning("%s: consolidating libnetconf datastores failed for module %s.", __func__, module->name);
+		}
+	}
+
+	if (destroy) {
+		module_unlink(module);
 		module_free(module);
 	}
 	return(EXIT_SUCCESS);
@@ -401,8 +636,44 @@ int module_disable(struct np_module* module, int destroy) {
  * @return State data as libxml2 xmlDocPtr or NULL in case of error.
  */
 xmlDocPtr netopeer_get_state_data (xmlDocPtr UNUSED(model), xmlDocPtr UNUSED(running), struct nc_err** UNUSED(err)) {
-	/* no state data */
-	return(NULL);
+	xmlDocPtr doc;
+	xmlNodePtr root, cache, checkpoints, queues, workers;
+	xmlNsPtr ns;
+
+	/* the state data are the counters of the state data caches and commits, the checkpoints, the output queues, and the workers */
+	doc = xmlNewDoc(BAD_CAST "1.0");
+	root = xmlNewNode(NULL, BAD_CAST "netopeer");
+	xmlDocSetRootElement(doc, root);
+	ns = xmlNewNs(root, BAD_CAST "urn:cesnet:tmc:netopeer:1.0", NULL);
+	xmlSetNs(root, ns);
+	cache = xmlNewChild(root, ns, BAD_CAST "state-data-cache", NULL);
+
+	state_data_cache_stats(cache);
+	if (cache->children == NULL) {
+		xmlUnlinkNode(cache);
+		xmlFreeNode(cache);
+	}
+	commit_stats(xmlNewChild(root, ns, BAD_CAST "commit", NULL));
+	checkpoints = xmlNewChild(root, ns, BAD_CAST "checkpoints", NULL);
+	checkpoint_stats(checkpoints);
+	if (checkpoints->children == NULL) {
+		xmlUnlinkNode(checkpoints);
+		xmlFreeNode(checkpoints);
+	}
+	queues = xmlNewChild(root, ns, BAD_CAST "output-queues", NULL);
+	output_queue_stats(queues);
+	if (queues->children == NULL) {
+		xmlUnlinkNode(queues);
+		xmlFreeNode(queues);
+	}
+	workers = xmlNewChild(root, ns, BAD_CAST "worker-processes", NULL);
+	worker_stats(workers);
+	if (workers->children == NULL) {
+		xmlUnlinkNode(workers);
+		xmlFreeNode(workers);
+	}
+
+	return(doc);
 }
 /*
  * Mapping prefixes with namespaces.
@@ -501,6 +772,48 @@ int callback_n_netopeer_n_idle_timeout(void** UNUSED(data), XMLDIFF_OP op, xmlNo
 	return EXIT_SUCCESS;
 }
 
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:hibernate-timeout changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_hibernate_timeout(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL, *ptr, *msg;
+	uint32_t num;
+
+	if (op & XMLDIFF_REM) {
+		netopeer_options.hibernate_timeout = 0;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	num = strtol(content, &ptr, 10);
+	if (*ptr != '\0') {
+		*error = nc_err_new(NC_ERR_BAD_ELEM);
+		if (asprintf(&msg, "Could not convert '%s' to a number.", content) == 0) {
+			nc_err_set(*error, NC_ERR_PARAM_MSG, msg);
+			nc_err_set(*error, NC_ERR_PARAM_INFO_BADELEM, "/netopeer/hibernate-timeout");
+			free(msg);
+		}
+		return EXIT_FAILURE;
+	}
+
+	netopeer_options.hibernate_timeout = num;
+	return EXIT_SUCCESS;
+}
+
 /**
  * @brief This callback will be run when node in path /n:netopeer/n:max-sessions changes
  *
@@ -543,6 +856,52 @@ int callback_n_netopeer_n_max_sessions(void** UNUSED(data), XMLDIFF_OP op, xmlNo
 	return EXIT_SUCCESS;
 }
 
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:workers changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_workers(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL, *ptr, *msg;
+	uint16_t num;
+
+	/* the workers are started with the server, a change applies after a hard restart */
+	if (op & XMLDIFF_REM) {
+		netopeer_options.workers = 0;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	num = strtol(content, &ptr, 10);
+	if (*ptr != '\0' || num > WORKER_MAX) {
+		*error = nc_err_new(NC_ERR_BAD_ELEM);
+		if (asprintf(&msg, "Invalid number of workers '%s'.", content) == 0) {
+			nc_err_set(*error, NC_ERR_PARAM_MSG, msg);
+			nc_err_set(*error, NC_ERR_PARAM_INFO_BADELEM, "/netopeer/workers");
+			free(msg);
+		}
+		return EXIT_FAILURE;
+	}
+
+	if (!server_start && num != worker_count()) {
+		nc_verb_verbose("The number of workers changes to %u after a hard restart.", num);
+	}
+	netopeer_options.workers = num;
+	return EXIT_SUCCESS;
+}
+
 /**
  * @brief This callback will be run when node in path /n:netopeer/n:response-time changes
  *
@@ -584,6 +943,185 @@ int callback_n_netopeer_n_response_time(void** UNUSED(data), XMLDIFF_OP op, xmlN
 	return EXIT_SUCCESS;
 }
 
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:io-backend changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_io_backend(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL;
+
+	if (op & XMLDIFF_REM) {
+		netopeer_options.io_backend = NP_EVENT_EPOLL;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	/* the listening and the hibernated sockets are moved to the new backend on their next wait */
+	if (strcmp(content, "io-uring") == 0) {
+		netopeer_options.io_backend = NP_EVENT_IO_URING;
+#ifndef NP_IO_URING
+		nc_verb_warning("io_uring is not supported by this build of the server, epoll will be used.");
+#endif
+	} else {
+		netopeer_options.io_backend = NP_EVENT_EPOLL;
+	}
+	return EXIT_SUCCESS;
+}
+
+/* the output queue sizes and timeout, the queues pick up a change on their next flush */
+static int output_queue_option(XMLDIFF_OP op, xmlNodePtr new_node, const char* leaf, uint32_t def, uint32_t* value, struct nc_err** error) {
+	char* content = NULL, *ptr, *msg;
+	unsigned long num;
+
+	if (op & XMLDIFF_REM) {
+		*value = def;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	num = strtoul(content, &ptr, 10);
+	if (*ptr != '\0' || num > UINT32_MAX) {
+		*error = nc_err_new(NC_ERR_BAD_ELEM);
+		if (asprintf(&msg, "Could not convert '%s' to a number.", content) != -1) {
+			nc_err_set(*error, NC_ERR_PARAM_MSG, msg);
+			free(msg);
+		}
+		if (asprintf(&msg, "/netopeer/output-queue/%s", leaf) != -1) {
+			nc_err_set(*error, NC_ERR_PARAM_INFO_BADELEM, msg);
+			free(msg);
+		}
+		return EXIT_FAILURE;
+	}
+
+	*value = num;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:output-queue/n:high-watermark changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_output_queue_n_high_watermark(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	return output_queue_option(op, new_node, "high-watermark", 1048576, &netopeer_options.queue_high_watermark, error);
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:output-queue/n:low-watermark changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_output_queue_n_low_watermark(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	return output_queue_option(op, new_node, "low-watermark", 262144, &netopeer_options.queue_low_watermark, error);
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:output-queue/n:limit changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_output_queue_n_limit(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	return output_queue_option(op, new_node, "limit", 0, &netopeer_options.queue_limit, error);
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:output-queue/n:stall-timeout changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_output_queue_n_stall_timeout(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	return output_queue_option(op, new_node, "stall-timeout", 60, &netopeer_options.queue_stall_timeout, error);
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:output-queue/n:overflow changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_output_queue_n_overflow(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL;
+
+	if (op & XMLDIFF_REM) {
+		netopeer_options.queue_overflow = OUTPUT_QUEUE_DISCONNECT;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	netopeer_options.queue_overflow = (strcmp(content, "disconnect") == 0 ? OUTPUT_QUEUE_DISCONNECT : OUTPUT_QUEUE_WAIT);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:tcp-profile changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_tcp_profile(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error) {
+	/* only the new sessions pick up a change */
+	return tcp_profile_set((op & (XMLDIFF_REM | XMLDIFF_MOD) ? old_node : NULL), (op & (XMLDIFF_ADD | XMLDIFF_MOD) ? new_node : NULL), error);
+}
+
 /**
  * @brief This callback will be run when node in path /n:netopeer/n:modules/n:module/n:module/n:enabled changes
  *
@@ -598,7 +1136,8 @@ int callback_n_netopeer_n_response_time(void** UNUSED(data), XMLDIFF_OP op, xmlN
 int callback_n_netopeer_n_modules_n_module_n_enabled(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** UNUSED(error)) {
 	xmlNodePtr tmp, node;
 	char* module_name = NULL, *module_enabled = NULL;
-	struct np_module* module = netopeer_options.modules;
+	struct np_module* module;
+	int ret = EXIT_SUCCESS;
 
 	node = (op & XMLDIFF_REM ? old_node : new_node);
 	if (node == NULL) {
@@ -623,38 +1162,39 @@ int callback_n_netopeer_n_modules_n_module_n_enabled(void** UNUSED(data), XMLDIF
 		return EXIT_SUCCESS;
 	}
 
-	while (module) {
-		if (strcmp(module->name, module_name) == 0) {
-			break;
-		}
-		module = module->next;
-	}
+	/* MODULES LOCK */
+	pthread_mutex_lock(&netopeer_options.modules_lock);
 
-	if ((op & XMLDIFF_REM) || ((op & XMLDIFF_MOD) && strcmp(module_enabled, "false") == 0)) {
-		if (module == NULL) {
-			/* it does not exist, so it is disabled */
-			return EXIT_SUCCESS;
-		}
+	module = module_find(module_name);
 
-		if (module_disable(module, 1)) {
-			return EXIT_FAILURE;
+	if ((op & XMLDIFF_REM) || ((op & XMLDIFF_MOD) && strcmp(module_enabled, "false") == 0)) {
+		/* if it does not exist, it is disabled */
+		if (module != NULL && module_disable(module, 1)) {
+			ret = EXIT_FAILURE;
 		}
 	} else if ((op & XMLDIFF_ADD) || ((op & XMLDIFF_MOD) && strcmp(module_enabled, "true") == 0)) {
 		if (module != NULL) {
 			nc_verb_error("%s: internal error: module to enable already exists", __func__);
-			return EXIT_FAILURE;
-		}
-
-		module = calloc(1, sizeof(struct np_module));
-		module->name = strdup(module_name);
-		if (module_enable(module, 1)) {
+			ret = EXIT_FAILURE;
+		} else if ((module = calloc(1, sizeof(struct np_module))) == NULL || (module->name = strdup(module_name)) == NULL) {
+			nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+			free(module);
+			ret = EXIT_FAILURE;
+		} else if (server_start) {
+			/* no thread of the module may run when the worker processes are forked */
+			*deferred_last = module;
+			deferred_last = &module->next;
+		} else if (module_enable(module, 1)) {
 			free(module->name);
 			free(module);
-			return EXIT_FAILURE;
+			ret = EXIT_FAILURE;
 		}
 	}
 
-	return EXIT_SUCCESS;
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+	return ret;
 }
 /*
 * Structure transapi_config_callbacks provide mapping between callback and path in configuration datastore.
@@ -663,16 +1203,27 @@ int callback_n_netopeer_n_modules_n_module_n_enabled(void** UNUSED(data), XMLDIF
 */
 struct transapi_data_callbacks netopeer_clbks = {
 #if defined(NP_SSH) && defined(NP_TLS)
-	.callbacks_count = 17,
+	.callbacks_count = 29,
+#elif defined(NP_TLS)
+	.callbacks_count = 22,
 #else
-	.callbacks_count = 11,
+	.callbacks_count = 22,
 #endif
 	.data = NULL,
 	.callbacks = {
 		{.path = "/n:netopeer/n:hello-timeout", .func = callback_n_netopeer_n_hello_timeout},
 		{.path = "/n:netopeer/n:idle-timeout", .func = callback_n_netopeer_n_idle_timeout},
+		{.path = "/n:netopeer/n:hibernate-timeout", .func = callback_n_netopeer_n_hibernate_timeout},
 		{.path = "/n:netopeer/n:max-sessions", .func = callback_n_netopeer_n_max_sessions},
+		{.path = "/n:netopeer/n:workers", .func = callback_n_netopeer_n_workers},
 		{.path = "/n:netopeer/n:response-time", .func = callback_n_netopeer_n_response_time},
+		{.path = "/n:netopeer/n:io-backend", .func = callback_n_netopeer_n_io_backend},
+		{.path = "/n:netopeer/n:output-queue/n:high-watermark", .func = callback_n_netopeer_n_output_queue_n_high_watermark},
+		{.path = "/n:netopeer/n:output-queue/n:low-watermark", .func = callback_n_netopeer_n_output_queue_n_low_watermark},
+		{.path = "/n:netopeer/n:output-queue/n:limit", .func = callback_n_netopeer_n_output_queue_n_limit},
+		{.path = "/n:netopeer/n:output-queue/n:stall-timeout", .func = callback_n_netopeer_n_output_queue_n_stall_timeout},
+		{.path = "/n:netopeer/n:output-queue/n:overflow", .func = callback_n_netopeer_n_output_queue_n_overflow},
+		{.path = "/n:netopeer/n:tcp-profile", .func = callback_n_netopeer_n_tcp_profile},
 #ifdef NP_SSH
 		{.path = "/n:netopeer/n:ssh/n:server-keys/n:rsa-key", .func = callback_n_netopeer_n_ssh_n_server_keys_n_rsa_key},
 		{.path = "/n:netopeer/n:ssh/n:server-keys/n:dsa-key", .func = callback_n_netopeer_n_ssh_n_server_keys_n_dsa_key},
@@ -680,6 +1231,7 @@ struct transapi_data_callbacks netopeer_clbks = {
 		{.path = "/n:netopeer/n:ssh/n:password-auth-enabled", .func = callback_n_netopeer_n_ssh_n_password_auth_enabled},
 		{.path = "/n:netopeer/n:ssh/n:auth-attempts", .func = callback_n_netopeer_n_ssh_n_auth_attempts},
 		{.path = "/n:netopeer/n:ssh/n:auth-timeout", .func = callback_n_netopeer_n_ssh_n_auth_timeout},
+		{.path = "/n:netopeer/n:ssh/n:coalesce-replies", .func = callback_n_netopeer_n_ssh_n_coalesce_replies},
 #endif
 #ifdef NP_TLS
 		{.path = "/n:netopeer/n:tls/n:server-cert", .func = callback_n_netopeer_n_tls_n_server_cert},
@@ -687,8 +1239,10 @@ struct transapi_data_callbacks netopeer_clbks = {
 		{.path = "/n:netopeer/n:tls/n:trusted-ca-certs/n:trusted-ca-cert", .func = callback_n_netopeer_n_tls_n_trusted_ca_certs_n_trusted_ca_cert},
 		{.path = "/n:netopeer/n:tls/n:trusted-client-certs/n:trusted-client-cert", .func = callback_n_netopeer_n_tls_n_trusted_client_certs_n_trusted_client_cert},
 		{.path = "/n:netopeer/n:tls/n:crl-dir", .func = callback_n_netopeer_n_tls_n_crl_dir},
+		{.path = "/n:netopeer/n:tls/n:kernel-tls", .func = callback_n_netopeer_n_tls_n_kernel_tls},
 		{.path = "/n:netopeer/n:tls/n:cert-maps/n:cert-to-name", .func = callback_n_netopeer_n_tls_n_cert_maps_n_cert_to_name},
 #endif
+		{.path = "/n:netopeer/n:unix/n:listen-path", .func = callback_n_netopeer_n_unix_n_listen_path},
 		{.path = "/n:netopeer/n:modules/n:module/n:enabled", .func = callback_n_netopeer_n_modules_n_module_n_enabled}
 	}
 };
@@ -805,9 +1359,21 @@ void netopeer_transapi_close(void) {
 
 	nc_verb_verbose("Netopeer cleanup.");
 
+	/* MODULES LOCK */
+	pthread_mutex_lock(&netopeer_options.modules_lock);
 	while (netopeer_options.modules) {
 		module_disable(netopeer_options.modules, 1);
 	}
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+	/* CPBLTS CACHE LOCK */
+	pthread_mutex_lock(&cpblts_cache.lock);
+	module_cpblts_cache_free();
+	/* CPBLTS CACHE UNLOCK */
+	pthread_mutex_unlock(&cpblts_cache.lock);
+
+	tcp_profile_del_all();
 }
 
 /**
@@ -860,40 +1426,157 @@ nc_reply* rpc_netopeer_reboot(xmlNodePtr input) {
 	return nc_reply_ok();
 }
 
+struct module_reload {
+	struct np_module** modules;
+	struct np_module_cfg** cfgs;
+	unsigned int count;
+	volatile unsigned int next;
+};
+
+/* read the changed module configurations in parallel, the rest of the reload is serialized by libnetconf */
+static void* module_reload_read_thread(void* arg) {
+	struct module_reload* reload = (struct module_reload*)arg;
+	unsigned int i;
+
+	while ((i = __sync_fetch_and_add(&reload->next, 1)) < reload->count) {
+		reload->cfgs[i] = module_cfg_get(reload->modules[i]->name);
+	}
+
+	return NULL;
+}
+
+/* return: message with the failed modules, NULL if all were reloaded */
+static char* module_reload(struct np_module** modules, unsigned int count) {
+	struct module_reload reload = {.modules = modules, .count = count, .next = 0};
+	pthread_t tids[MODULE_RELOAD_THREADS];
+	unsigned int i, thread_count = 0;
+	int* loaded;
+	char* failed = NULL, *aux;
+
+	if ((reload.cfgs = calloc(count, sizeof *reload.cfgs)) == NULL || (loaded = calloc(count, sizeof *loaded)) == NULL) {
+		free(reload.cfgs);
+		return strdup("memory allocation failed");
+	}
+
+	while (thread_count < MODULE_RELOAD_THREADS && thread_count < count
+			&& pthread_create(&tids[thread_count], NULL, module_reload_read_thread, &reload) == 0) {
+		++thread_count;
+	}
+	/* also if no thread could be created */
+	module_reload_read_thread(&reload);
+	for (i = 0; i < thread_count; ++i) {
+		pthread_join(tids[i], NULL);
+	}
+
+	/* a lazy module not activated yet only gets its advertised capability refreshed */
+	for (i = 0; i < count; ++i) {
+		if (modules[i]->lazy == NULL) {
+			continue;
+		}
+		module_lazy_clear(modules[i]);
+		if (reload.cfgs[i] != NULL && reload.cfgs[i]->error == NULL && reload.cfgs[i]->lazy) {
+			module_lazy_set(modules[i], reload.cfgs[i]);
+			reload.cfgs[i] = NULL;
+		}
+	}
+
+	/* consolidate the datastores only once for all the modules */
+	state_data_invalidate();
+	for (i = 0; i < count; ++i) {
+		if (modules[i]->lazy == NULL) {
+			state_data_cache_del(modules[i]->id);
+			ncds_free(modules[i]->ds);
+			modules[i]->ds = NULL;
+		}
+	}
+	for (i = 0; i < count; ++i) {
+		if (modules[i]->lazy == NULL) {
+			loaded[i] = !module_load(modules[i]);
+		}
+	}
+	if (ncds_consolidate() != 0) {
+		nc_verb_warning("%s: consolidating libnetconf datastores failed.", __func__);
+	}
+	for (i = 0; i < count; ++i) {
+		if (modules[i]->lazy != NULL) {
+			continue;
+		}
+		if (!loaded[i] || module_start(modules[i], 0)) {
+			if (asprintf(&aux, "%s%s%s", (failed ? failed : ""), (failed ? ", " : ""), modules[i]->name) != -1) {
+				free(failed);
+				failed = aux;
+			}
+		}
+		module_cfg_put(reload.cfgs[i]);
+	}
+
+	free(loaded);
+	free(reload.cfgs);
+	return failed;
+}
+
 nc_reply* rpc_reload_module(xmlNodePtr input) {
-	xmlNodePtr module_node = get_rpc_node("module", input);
-	char* module_name;
-	struct np_module* module = netopeer_options.modules;
+	xmlNodePtr module_node;
+	struct np_module** modules = NULL, **new_modules, *module;
+	unsigned int count = 0, i;
+	char* module_name, *msg;
+	struct nc_err* err;
 
-	if (module_node) {
-		module_name = (char*)xmlNodeGetContent(module_node);
-	} else {
+	if (get_rpc_node("module", input) == NULL) {
 		return nc_reply_error(nc_err_new(NC_ERR_MISSING_ELEM));
 	}
 
-	while (module) {
-		if (strcmp(module->name, module_name) == 0) {
-			break;
+	/* MODULES LOCK */
+	pthread_mutex_lock(&netopeer_options.modules_lock);
+
+	for (module_node = get_rpc_node("module", input); module_node != NULL; module_node = get_rpc_node("module", module_node->next)) {
+		module_name = (char*)xmlNodeGetContent(module_node);
+		module = (module_name == NULL ? NULL : module_find(module_name));
+		if (module == NULL) {
+			/* MODULES UNLOCK */
+			pthread_mutex_unlock(&netopeer_options.modules_lock);
+
+			err = nc_err_new(NC_ERR_INVALID_VALUE);
+			if (module_name != NULL && asprintf(&msg, "Module \"%s\" is not enabled.", module_name) != -1) {
+				nc_err_set(err, NC_ERR_PARAM_MSG, msg);
+				free(msg);
+			}
+			free(module_name);
+			free(modules);
+			return nc_reply_error(err);
 		}
-		module = module->next;
-	}
-	free(module_name);
+		free(module_name);
 
-	if (module == NULL) {
-		return nc_reply_error(nc_err_new(NC_ERR_INVALID_VALUE));
+		for (i = 0; i < count && modules[i] != module; ++i);
+		if (i < count) {
+			continue;
+		}
+		if ((new_modules = realloc(modules, (count + 1) * sizeof *modules)) == NULL) {
+			/* MODULES UNLOCK */
+			pthread_mutex_unlock(&netopeer_options.modules_lock);
+			free(modules);
+			return nc_reply_error(nc_err_new(NC_ERR_OP_FAILED));
+		}
+		modules = new_modules;
+		modules[count++] = module;
 	}
 
-	if (module_disable(module, 0) || module_enable(module, 0)) {
-		return nc_reply_error(nc_err_new(NC_ERR_OP_FAILED));
+	msg = module_reload(modules, count);
+
+	/* MODULES UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.modules_lock);
+	free(modules);
+
+	if (msg != NULL) {
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, msg);
+		free(msg);
+		return nc_reply_error(err);
 	}
 
 	return nc_reply_ok();
 }
-/*
-* Structure transapi_rpc_callbacks provide mapping between callbacks and RPC messages.
-* It is used by libnetconf library to decide which callbacks will be run when RPC arrives.
-* DO NOT alter this structure
-*/
+
 struct transapi_rpc_callbacks netopeer_rpc_clbks = {
 	.callbacks_count = 2,
 	.callbacks = {
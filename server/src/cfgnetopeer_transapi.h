@@ -41,12 +41,23 @@
 #define _CFGNETOPEER_TRANSAPI_H_
 
 #include "netconf_server_transapi.h"
+#include "config.h"
+
+struct np_module_cfg;
 
 struct np_options {
 	uint8_t verbose;
 	uint32_t idle_timeout;
+	uint32_t hibernate_timeout;
 	uint16_t max_sessions;
 	uint16_t response_time;
+	uint8_t io_backend; /**< enum np_event_backend of the listening and hibernated sockets */
+	uint32_t queue_high_watermark; /**< bytes of a session output queue above which no RPCs are read */
+	uint32_t queue_low_watermark; /**< bytes of a paused output queue below which RPCs are read again */
+	uint32_t queue_limit; /**< maximum bytes of an output queue, 0 for no queues */
+	uint32_t queue_stall_timeout; /**< seconds a socket may take no data before its session is disconnected */
+	uint8_t queue_overflow; /**< enum output_queue_overflow */
+	uint16_t workers; /**< session worker processes, started with the server */
 
 	struct np_options_ssh* ssh_opts;
 	struct np_options_tls* tls_opts;
@@ -56,7 +67,14 @@ struct np_options {
 		struct ncds_ds* ds; /**< pointer to datastore returned by libnetconf */
 		ncds_id id; /**< Related datastore ID */
 		struct np_module* prev, *next;
+		struct np_module* idx_next; /**< next module in the same module_idx bucket */
+		struct np_module_cfg* lazy; /**< configuration of a lazy module not activated yet, it has no datastore */
 	} *modules;
+	pthread_mutex_t modules_lock; /**< enabling, disabling, activating, and reloading modules */
+	struct np_module* module_idx[MODULE_INDEX_SIZE];
+	volatile unsigned int lazy_count; /**< lazy modules not activated yet */
+	volatile unsigned int lazy_activations; /**< changed whenever a lazy module stops being advertised as such */
+	volatile unsigned int cpblts_changes; /**< changed whenever the advertised capabilities may change */
 
 	pthread_mutex_t binds_lock;
 	uint8_t binds_change_flag;
@@ -64,7 +82,8 @@ struct np_options {
 };
 
 /**
- * @brief Load module configuration, add module to library (and enlink to list)
+ * @brief Load module configuration, add module to library (and enlink to list),
+ * a lazy module is only enlinked and added on its first use
  *
  * @param module Module to enable
  * @param add Enlink module to list of active modules?
@@ -73,6 +92,44 @@ struct np_options {
  */
 int module_enable(struct np_module* module, int add);
 
+/**
+ * @brief Enable the modules of the startup configuration, they are only
+ * collected while the server starts, so that no thread of theirs runs when the
+ * worker processes are forked
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE if any of them failed
+ */
+int module_enable_deferred(void);
+
+/**
+ * @brief Activate the lazy modules targeted by an RPC, concurrent callers wait
+ * for the first one to finish the activation
+ *
+ * @param targets Namespaces or main model names, NULL for all the lazy modules
+ * @param count Number of targets
+ */
+void module_activate_lazy(const char* const* targets, unsigned int count);
+
+/**
+ * @brief Get the capabilities for a server hello, including the lazy modules
+ *
+ * They are collected from the datastores only after a module was enabled,
+ * disabled, or activated, otherwise a copy of the cached ones is returned.
+ *
+ * @return Capabilities to be freed by nc_cpblts_free()
+ */
+struct nc_cpblts* module_get_cpblts(void);
+
+/**
+ * @brief Find an enabled module in the list of active modules, the caller must
+ * hold modules_lock
+ *
+ * @param name Module name
+ *
+ * @return Module or NULL
+ */
+struct np_module* module_find(const char* name);
+
 /**
  * @brief Stop module, remove it from library (and destroy)
  *
@@ -0,0 +1,788 @@
+/**
+ * @file checkpoint.c
+ * @brief Netopeer configuration checkpoints saved as the changed subtrees only
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/dict.h>
+#include <libxml/hash.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "checkpoint.h"
+
+#define NS_YIN "urn:ietf:params:xml:ns:yang:yin:1"
+#define NS_NETCONF "urn:ietf:params:xml:ns:netconf:base:1.0"
+
+/* a subtree of the running configuration as it was when the checkpoint was created */
+struct cp_entry {
+	char* path;				/**< identities of the nodes from the top, separated by '/' */
+	xmlNodePtr* chain;		/**< shells of the ancestors from the top, the saved subtree last */
+	unsigned int depth;		/**< number of the nodes in chain */
+	int absent;				/**< the subtree did not exist, only its shell is saved */
+	struct cp_entry* next;
+};
+
+struct checkpoint {
+	char* name;				/**< NULL for the internal checkpoint of a confirmed commit */
+	time_t created;
+	xmlDocPtr doc;			/**< owns all the saved nodes */
+	unsigned int count;
+	struct cp_entry* entries;
+	struct checkpoint* next;
+};
+
+/* the configuration being compared */
+struct cp_diff_ctx {
+	xmlNodePtr old_root;
+	xmlNodePtr new_root;
+	const struct checkpoint_schema* schema;
+};
+
+static struct checkpoint* checkpoints;
+static unsigned int checkpoints_count;
+static pthread_mutex_t checkpoint_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void cp_schema_names(xmlXPathContextPtr ctx, const char* expr, xmlHashTablePtr table, xmlDictPtr dict, int keys) {
+	xmlXPathObjectPtr obj;
+	xmlNodePtr node, child;
+	xmlChar* name, *value;
+	const xmlChar* payload;
+	int i;
+
+	if ((obj = xmlXPathEvalExpression(BAD_CAST expr, ctx)) == NULL) {
+		return;
+	}
+	for (i = 0; obj->nodesetval != NULL && i < obj->nodesetval->nodeNr; ++i) {
+		node = obj->nodesetval->nodeTab[i];
+		if ((name = xmlGetProp(node, BAD_CAST "name")) == NULL) {
+			continue;
+		}
+		payload = BAD_CAST "";
+		if (keys) {
+			for (child = node->children; child != NULL; child = child->next) {
+				if (child->type == XML_ELEMENT_NODE && xmlStrEqual(child->name, BAD_CAST "key")) {
+					break;
+				}
+			}
+			if (child == NULL || (value = xmlGetProp(child, BAD_CAST "value")) == NULL) {
+				/* a state list without keys */
+				xmlFree(name);
+				continue;
+			}
+			payload = xmlDictLookup(dict, value, -1);
+			xmlFree(value);
+		}
+		xmlHashAddEntry(table, name, (void*)payload);
+		xmlFree(name);
+	}
+	xmlXPathFreeObject(obj);
+}
+
+int checkpoint_schema_add(struct checkpoint_schema* schema, const char* model) {
+	xmlDocPtr doc;
+	xmlXPathContextPtr ctx;
+
+	if ((schema->dict == NULL && (schema->dict = xmlDictCreate()) == NULL) ||
+			(schema->keys == NULL && (schema->keys = xmlHashCreate(16)) == NULL) ||
+			(schema->leaf_lists == NULL && (schema->leaf_lists = xmlHashCreate(16)) == NULL) ||
+			(schema->user == NULL && (schema->user = xmlHashCreate(8)) == NULL)) {
+		return 1;
+	}
+	if ((doc = xmlReadMemory(model, strlen(model), NULL, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN)) == NULL) {
+		return 1;
+	}
+	if ((ctx = xmlXPathNewContext(doc)) == NULL || xmlXPathRegisterNs(ctx, BAD_CAST "yin", BAD_CAST NS_YIN) != 0) {
+		xmlXPathFreeContext(ctx);
+		xmlFreeDoc(doc);
+		return 1;
+	}
+
+	cp_schema_names(ctx, "//yin:list", schema->keys, schema->dict, 1);
+	cp_schema_names(ctx, "//yin:leaf-list", schema->leaf_lists, schema->dict, 0);
+	cp_schema_names(ctx, "//yin:ordered-by[@value='user']/..", schema->user, schema->dict, 0);
+
+	xmlXPathFreeContext(ctx);
+	xmlFreeDoc(doc);
+	return 0;
+}
+
+void checkpoint_schema_clean(struct checkpoint_schema* schema) {
+	if (schema->keys != NULL) {
+		xmlHashFree(schema->keys, NULL);
+	}
+	if (schema->leaf_lists != NULL) {
+		xmlHashFree(schema->leaf_lists, NULL);
+	}
+	if (schema->user != NULL) {
+		xmlHashFree(schema->user, NULL);
+	}
+	if (schema->dict != NULL) {
+		xmlDictFree(schema->dict);
+	}
+	memset(schema, 0, sizeof *schema);
+}
+
+static int cp_leaf(xmlNodePtr node) {
+	return (xmlFirstElementChild(node) == NULL);
+}
+
+static xmlNodePtr cp_child(xmlNodePtr parent, const xmlChar* name, size_t len) {
+	xmlNodePtr child;
+
+	for (child = parent->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE && xmlStrlen(child->name) == (int)len && xmlStrncmp(child->name, name, len) == 0) {
+			return child;
+		}
+	}
+	return NULL;
+}
+
+/* a value in an identity, the path separators escaped */
+static void cp_value_cat(xmlBufferPtr buf, xmlNodePtr node) {
+	xmlChar* value, *ptr;
+
+	value = xmlNodeGetContent(node);
+	for (ptr = value; ptr != NULL && *ptr != '\0'; ++ptr) {
+		if (*ptr == '\\' || *ptr == ']' || *ptr == '/') {
+			xmlBufferAdd(buf, BAD_CAST "\\", 1);
+		}
+		xmlBufferAdd(buf, ptr, 1);
+	}
+	xmlFree(value);
+}
+
+/* identity of a node among its siblings - its namespace, name, and list keys or leaf-list value */
+static char* cp_identity(xmlNodePtr node, const struct checkpoint_schema* schema) {
+	xmlBufferPtr buf;
+	xmlNodePtr key;
+	const xmlChar* keys, *end;
+	char* ret;
+
+	if ((buf = xmlBufferCreate()) == NULL) {
+		return NULL;
+	}
+	xmlBufferCCat(buf, "{");
+	if (node->ns != NULL) {
+		xmlBufferCat(buf, node->ns->href);
+	}
+	xmlBufferCCat(buf, "}");
+	xmlBufferCat(buf, node->name);
+
+	if ((keys = xmlHashLookup(schema->keys, node->name)) != NULL) {
+		while (*keys != '\0') {
+			for (end = keys; *end != '\0' && *end != ' '; ++end);
+			if (end > keys && (key = cp_child(node, keys, end - keys)) != NULL) {
+				xmlBufferCCat(buf, "[");
+				xmlBufferAdd(buf, keys, end - keys);
+				xmlBufferCCat(buf, "=");
+				cp_value_cat(buf, key);
+				xmlBufferCCat(buf, "]");
+			}
+			for (keys = end; *keys == ' '; ++keys);
+		}
+	} else if (xmlHashLookup(schema->leaf_lists, node->name) != NULL) {
+		xmlBufferCCat(buf, "[.=");
+		cp_value_cat(buf, node);
+		xmlBufferCCat(buf, "]");
+	}
+
+	ret = strdup((const char*)xmlBufferContent(buf));
+	xmlBufferFree(buf);
+	return ret;
+}
+
+/* a node without its content, except for the list keys and the value of a leaf or a leaf-list */
+static xmlNodePtr cp_shell(xmlNodePtr node, xmlDocPtr doc, const struct checkpoint_schema* schema) {
+	xmlNodePtr shell, key;
+	const xmlChar* keys, *end;
+
+	if (cp_leaf(node)) {
+		return xmlDocCopyNode(node, doc, 1);
+	}
+	if ((shell = xmlDocCopyNode(node, doc, 2)) == NULL) {
+		return NULL;
+	}
+	if ((keys = xmlHashLookup(schema->keys, node->name)) != NULL) {
+		while (*keys != '\0') {
+			for (end = keys; *end != '\0' && *end != ' '; ++end);
+			if (end > keys && (key = cp_child(node, keys, end - keys)) != NULL) {
+				xmlAddChild(shell, xmlDocCopyNode(key, doc, 1));
+			}
+			for (keys = end; *keys == ' '; ++keys);
+		}
+	}
+	return shell;
+}
+
+/* the child with the identity, NULL if there is none */
+static xmlNodePtr cp_find(xmlNodePtr parent, const char* id, const struct checkpoint_schema* schema) {
+	xmlNodePtr child;
+	char* cid;
+	int found;
+
+	for (child = parent->children; child != NULL; child = child->next) {
+		if (child->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		cid = cp_identity(child, schema);
+		found = (cid != NULL && strcmp(cid, id) == 0);
+		free(cid);
+		if (found) {
+			return child;
+		}
+	}
+	return NULL;
+}
+
+/* return: 1 - path is the same as or a descendant of ancestor, 0 - otherwise */
+static int cp_under(const char* path, const char* ancestor) {
+	size_t len = strlen(ancestor);
+
+	return (strncmp(path, ancestor, len) == 0 && (path[len] == '\0' || path[len] == '/'));
+}
+
+static void cp_entry_free(struct cp_entry* entry) {
+	if (entry->chain != NULL && entry->chain[0] != NULL) {
+		xmlUnlinkNode(entry->chain[0]);
+		xmlFreeNode(entry->chain[0]);
+	}
+	free(entry->chain);
+	free(entry->path);
+	free(entry);
+}
+
+static struct checkpoint* cp_find_checkpoint(const char* name) {
+	struct checkpoint* cp;
+
+	for (cp = checkpoints; cp != NULL; cp = cp->next) {
+		if ((name == NULL && cp->name == NULL) || (name != NULL && cp->name != NULL && strcmp(name, cp->name) == 0)) {
+			return cp;
+		}
+	}
+	return NULL;
+}
+
+/* merge an entry saved before into the subtree of its new ancestor entry */
+static void cp_compose(struct checkpoint* cp, struct cp_entry* entry, struct cp_entry* desc, const struct checkpoint_schema* schema) {
+	xmlNodePtr cur, child;
+	unsigned int i;
+	char* id;
+
+	cur = entry->chain[entry->depth - 1];
+	for (i = entry->depth; i < desc->depth; ++i) {
+		if ((id = cp_identity(desc->chain[i], schema)) == NULL) {
+			return;
+		}
+		child = cp_find(cur, id, schema);
+		free(id);
+
+		if (i == desc->depth - 1) {
+			if (child != NULL) {
+				xmlUnlinkNode(child);
+				xmlFreeNode(child);
+			}
+			if (!desc->absent) {
+				xmlAddChild(cur, xmlDocCopyNode(desc->chain[i], cp->doc, 1));
+				/* the ancestor existed, at least partially */
+				entry->absent = 0;
+			}
+		} else if (child == NULL) {
+			if (desc->absent) {
+				/* not there in either of them */
+				return;
+			}
+			child = xmlAddChild(cur, cp_shell(desc->chain[i], cp->doc, schema));
+		}
+		cur = child;
+	}
+}
+
+/*
+ * save the previous state of a changed subtree unless it or any of its
+ * ancestors is saved already, the saved descendants are merged into it
+ */
+static void cp_save(struct checkpoint* cp, const char* path, xmlNodePtr* nodes, unsigned int depth, int absent,
+		const struct checkpoint_schema* schema) {
+	struct cp_entry* entry, *iter, **prev;
+	unsigned int i;
+
+	for (iter = cp->entries; iter != NULL; iter = iter->next) {
+		if (cp_under(path, iter->path)) {
+			return;
+		}
+	}
+
+	if ((entry = calloc(1, sizeof *entry)) == NULL || (entry->chain = calloc(depth, sizeof *entry->chain)) == NULL
+			|| (entry->path = strdup(path)) == NULL) {
+		goto error;
+	}
+	entry->depth = depth;
+	entry->absent = absent;
+	for (i = 0; i < depth; ++i) {
+		if (i < depth - 1 || absent) {
+			entry->chain[i] = cp_shell(nodes[i], cp->doc, schema);
+		} else {
+			entry->chain[i] = xmlDocCopyNode(nodes[i], cp->doc, 1);
+		}
+		if (entry->chain[i] == NULL) {
+			goto error;
+		}
+		xmlAddChild(i ? entry->chain[i - 1] : xmlDocGetRootElement(cp->doc), entry->chain[i]);
+	}
+
+	for (prev = &cp->entries; *prev != NULL;) {
+		iter = *prev;
+		if (cp_under(iter->path, path)) {
+			cp_compose(cp, entry, iter, schema);
+			*prev = iter->next;
+			cp_entry_free(iter);
+			--cp->count;
+		} else {
+			prev = &iter->next;
+		}
+	}
+
+	entry->next = cp->entries;
+	cp->entries = entry;
+	++cp->count;
+	return;
+
+error:
+	nc_verb_error("%s: memory allocation failed, the checkpoint \"%s\" is incomplete", __func__,
+			cp->name != NULL ? cp->name : "confirmed-commit");
+	if (entry != NULL) {
+		cp_entry_free(entry);
+	}
+}
+
+/* a subtree added (old NULL), removed (new NULL), or modified */
+static void cp_change(struct cp_diff_ctx* ctx, xmlNodePtr old, xmlNodePtr new) {
+	struct checkpoint* cp;
+	xmlNodePtr node, root, *nodes = NULL;
+	xmlBufferPtr buf = NULL;
+	unsigned int depth = 0, i;
+	char* id;
+
+	node = (old != NULL ? old : new);
+	root = (old != NULL ? ctx->old_root : ctx->new_root);
+	for (; node != NULL && node != root; node = node->parent) {
+		++depth;
+	}
+	if (node == NULL || (nodes = malloc(depth * sizeof *nodes)) == NULL || (buf = xmlBufferCreate()) == NULL) {
+		goto cleanup;
+	}
+	node = (old != NULL ? old : new);
+	for (i = depth; i > 0; node = node->parent) {
+		nodes[--i] = node;
+	}
+	for (i = 0; i < depth; ++i) {
+		if ((id = cp_identity(nodes[i], ctx->schema)) == NULL) {
+			goto cleanup;
+		}
+		if (i) {
+			xmlBufferCCat(buf, "/");
+		}
+		xmlBufferCCat(buf, id);
+		free(id);
+	}
+
+	for (cp = checkpoints; cp != NULL; cp = cp->next) {
+		cp_save(cp, (const char*)xmlBufferContent(buf), nodes, depth, (old == NULL), ctx->schema);
+	}
+
+cleanup:
+	free(nodes);
+	if (buf != NULL) {
+		xmlBufferFree(buf);
+	}
+}
+
+static int cp_values_differ(xmlNodePtr a, xmlNodePtr b) {
+	xmlChar* va, *vb;
+	int ret;
+
+	va = xmlNodeGetContent(a);
+	vb = xmlNodeGetContent(b);
+	ret = !xmlStrEqual(va, vb);
+	xmlFree(va);
+	xmlFree(vb);
+	return ret;
+}
+
+/* compare the children of two nodes matched by their identity */
+static void cp_diff(struct cp_diff_ctx* ctx, xmlNodePtr old, xmlNodePtr new) {
+	xmlHashTablePtr table = NULL;
+	xmlNodePtr child, *oc = NULL, *nc = NULL;
+	unsigned int on = 0, nn = 0, i, j, last = 0;
+	int* match = NULL, reorder = 0;
+	char* used = NULL, *id;
+	void* found;
+
+	for (child = old->children; child != NULL; child = child->next) {
+		on += (child->type == XML_ELEMENT_NODE);
+	}
+	for (child = new->children; child != NULL; child = child->next) {
+		nn += (child->type == XML_ELEMENT_NODE);
+	}
+	if ((on && ((oc = malloc(on * sizeof *oc)) == NULL || (used = calloc(on, 1)) == NULL))
+			|| (nn && ((nc = malloc(nn * sizeof *nc)) == NULL || (match = malloc(nn * sizeof *match)) == NULL))
+			|| (table = xmlHashCreate(on + 1)) == NULL) {
+		goto replace;
+	}
+
+	/* the old children by identity, stored as their index + 1 */
+	for (i = 0, child = old->children; child != NULL; child = child->next) {
+		if (child->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		oc[i] = child;
+		if ((id = cp_identity(child, ctx->schema)) == NULL) {
+			goto replace;
+		}
+		xmlHashAddEntry(table, BAD_CAST id, (void*)(uintptr_t)(i + 1));
+		free(id);
+		++i;
+	}
+	for (j = 0, child = new->children; child != NULL; child = child->next) {
+		if (child->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		nc[j] = child;
+		match[j] = -1;
+		if ((id = cp_identity(child, ctx->schema)) == NULL) {
+			goto replace;
+		}
+		if ((found = xmlHashLookup(table, BAD_CAST id)) != NULL && !used[(uintptr_t)found - 1]) {
+			match[j] = (uintptr_t)found - 1;
+			used[match[j]] = 1;
+			if (xmlHashLookup(ctx->schema->user, child->name) != NULL) {
+				/* a moved user-ordered entry */
+				if ((unsigned int)match[j] < last) {
+					reorder = 1;
+				}
+				last = match[j];
+			}
+		}
+		free(id);
+		++j;
+	}
+	if (reorder && old != ctx->old_root) {
+		goto replace;
+	}
+
+	for (j = 0; j < nn; ++j) {
+		if (match[j] == -1) {
+			cp_change(ctx, NULL, nc[j]);
+		} else if (cp_leaf(oc[match[j]]) != cp_leaf(nc[j])) {
+			cp_change(ctx, oc[match[j]], nc[j]);
+		} else if (cp_leaf(nc[j])) {
+			if (cp_values_differ(oc[match[j]], nc[j])) {
+				cp_change(ctx, oc[match[j]], nc[j]);
+			}
+		} else {
+			cp_diff(ctx, oc[match[j]], nc[j]);
+		}
+	}
+	for (i = 0; i < on; ++i) {
+		if (!used[i]) {
+			cp_change(ctx, oc[i], NULL);
+		}
+	}
+	goto cleanup;
+
+replace:
+	/* the whole node is saved */
+	if (old != ctx->old_root) {
+		cp_change(ctx, old, new);
+	}
+
+cleanup:
+	if (table != NULL) {
+		xmlHashFree(table, NULL);
+	}
+	free(oc);
+	free(nc);
+	free(match);
+	free(used);
+}
+
+int checkpoint_add(const char* name) {
+	struct checkpoint* cp;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	if (cp_find_checkpoint(name) != NULL) {
+		/* CHECKPOINT UNLOCK */
+		pthread_mutex_unlock(&checkpoint_lock);
+		return 1;
+	}
+
+	if ((cp = calloc(1, sizeof *cp)) == NULL || (name != NULL && (cp->name = strdup(name)) == NULL)
+			|| (cp->doc = xmlNewDoc(BAD_CAST "1.0")) == NULL) {
+		goto error;
+	}
+	xmlDocSetRootElement(cp->doc, xmlNewDocNode(cp->doc, NULL, BAD_CAST "checkpoint", NULL));
+	if (xmlDocGetRootElement(cp->doc) == NULL) {
+		goto error;
+	}
+	cp->created = time(NULL);
+	cp->next = checkpoints;
+	checkpoints = cp;
+	++checkpoints_count;
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+	return 0;
+
+error:
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+
+	nc_verb_error("%s: memory allocation failed", __func__);
+	if (cp != NULL) {
+		xmlFreeDoc(cp->doc);
+		free(cp->name);
+		free(cp);
+	}
+	return -1;
+}
+
+static void cp_clear(struct checkpoint* cp) {
+	struct cp_entry* entry;
+
+	while ((entry = cp->entries) != NULL) {
+		cp->entries = entry->next;
+		cp_entry_free(entry);
+	}
+	cp->count = 0;
+}
+
+int checkpoint_del(const char* name) {
+	struct checkpoint* cp, **prev;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	cp = cp_find_checkpoint(name);
+	for (prev = &checkpoints; *prev != NULL && *prev != cp; prev = &(*prev)->next);
+	if ((cp = *prev) == NULL) {
+		/* CHECKPOINT UNLOCK */
+		pthread_mutex_unlock(&checkpoint_lock);
+		return 1;
+	}
+	*prev = cp->next;
+	--checkpoints_count;
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+
+	cp_clear(cp);
+	xmlFreeDoc(cp->doc);
+	free(cp->name);
+	free(cp);
+	return 0;
+}
+
+void checkpoint_del_all(void) {
+	struct checkpoint* cp;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	while ((cp = checkpoints) != NULL) {
+		checkpoints = cp->next;
+		cp_clear(cp);
+		xmlFreeDoc(cp->doc);
+		free(cp->name);
+		free(cp);
+	}
+	checkpoints_count = 0;
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+}
+
+int checkpoint_exists(const char* name) {
+	int ret;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+	ret = (cp_find_checkpoint(name) != NULL);
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+
+	return ret;
+}
+
+unsigned int checkpoint_count(void) {
+	return checkpoints_count;
+}
+
+void checkpoint_record(xmlNodePtr old_root, xmlNodePtr new_root, const struct checkpoint_schema* schema) {
+	struct cp_diff_ctx ctx;
+
+	ctx.old_root = old_root;
+	ctx.new_root = new_root;
+	ctx.schema = schema;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	if (checkpoints != NULL) {
+		cp_diff(&ctx, old_root, new_root);
+	}
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+}
+
+char* checkpoint_inverse(const char* name, const struct checkpoint_schema* schema) {
+	struct checkpoint* cp;
+	struct cp_entry* entry;
+	xmlDocPtr doc;
+	xmlNodePtr root, cur, child, node;
+	xmlNsPtr ns;
+	xmlBufferPtr buf;
+	unsigned int i;
+	char* id, *ret = NULL;
+
+	if ((doc = xmlNewDoc(BAD_CAST "1.0")) == NULL || (root = xmlNewDocNode(doc, NULL, BAD_CAST "config", NULL)) == NULL) {
+		xmlFreeDoc(doc);
+		return NULL;
+	}
+	xmlDocSetRootElement(doc, root);
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	if ((cp = cp_find_checkpoint(name)) == NULL) {
+		goto cleanup;
+	}
+	for (entry = cp->entries; entry != NULL; entry = entry->next) {
+		/* the ancestors are merged */
+		for (cur = root, i = 0; i < entry->depth - 1; ++i, cur = child) {
+			if ((id = cp_identity(entry->chain[i], schema)) == NULL) {
+				goto cleanup;
+			}
+			child = cp_find(cur, id, schema);
+			free(id);
+			if (child == NULL) {
+				child = xmlAddChild(cur, cp_shell(entry->chain[i], doc, schema));
+			}
+			if (child == NULL) {
+				goto cleanup;
+			}
+		}
+
+		/* the saved subtree replaces the current one, or the added one is removed */
+		if ((node = xmlDocCopyNode(entry->chain[entry->depth - 1], doc, 1)) == NULL) {
+			goto cleanup;
+		}
+		if (entry->absent && cp_leaf(node) && xmlHashLookup(schema->leaf_lists, node->name) == NULL) {
+			/* any value of a leaf */
+			xmlNodeSetContent(node, NULL);
+		}
+		xmlAddChild(cur, node);
+		ns = xmlNewNs(node, BAD_CAST NS_NETCONF, BAD_CAST "xc");
+		xmlSetNsProp(node, ns, BAD_CAST "operation", BAD_CAST (entry->absent ? "remove" : "replace"));
+	}
+
+	if ((buf = xmlBufferCreate()) != NULL) {
+		for (child = root->children; child != NULL; child = child->next) {
+			xmlNodeDump(buf, doc, child, 0, 0);
+		}
+		ret = strdup((const char*)xmlBufferContent(buf));
+		xmlBufferFree(buf);
+	}
+
+cleanup:
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+
+	xmlFreeDoc(doc);
+	return ret;
+}
+
+void checkpoint_clear(const char* name) {
+	struct checkpoint* cp;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	if ((cp = cp_find_checkpoint(name)) != NULL) {
+		cp_clear(cp);
+	}
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+}
+
+void checkpoint_stats(xmlNodePtr parent) {
+	struct checkpoint* cp;
+	xmlNodePtr node;
+	char buf[16], *created;
+
+	/* CHECKPOINT LOCK */
+	pthread_mutex_lock(&checkpoint_lock);
+
+	for (cp = checkpoints; cp != NULL; cp = cp->next) {
+		if (cp->name == NULL) {
+			continue;
+		}
+		node = xmlNewChild(parent, parent->ns, BAD_CAST "checkpoint", NULL);
+		xmlNewTextChild(node, parent->ns, BAD_CAST "name", BAD_CAST cp->name);
+		if ((created = nc_time2datetime(cp->created, NULL)) != NULL) {
+			xmlNewChild(node, parent->ns, BAD_CAST "created", BAD_CAST created);
+			free(created);
+		}
+		snprintf(buf, sizeof buf, "%u", cp->count);
+		xmlNewChild(node, parent->ns, BAD_CAST "saved-subtrees", BAD_CAST buf);
+	}
+
+	/* CHECKPOINT UNLOCK */
+	pthread_mutex_unlock(&checkpoint_lock);
+}
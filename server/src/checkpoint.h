@@ -0,0 +1,148 @@
+/**
+ * @file checkpoint.h
+ * @brief Netopeer candidate checkpoint.header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <libxml/dict.h>
+#include <libxml/hash.h>
+#include <libxml/tree.h>
+
+/**
+ * @brief Schema information needed to identify configuration nodes, by node name
+ */
+struct checkpoint_schema {
+	xmlDictPtr dict;			/**< strings of the tables */
+	xmlHashTablePtr keys;		/**< lists, their key names separated by spaces */
+	xmlHashTablePtr leaf_lists;	/**< leaf-lists */
+	xmlHashTablePtr user;		/**< lists and leaf-lists ordered by user */
+};
+
+/**
+ * @brief Add the lists and leaf-lists of a model into a schema
+ *
+ * @param schema Schema to fill, the tables are created if needed
+ * @param model Model in the YIN format
+ *
+ * @return 0 on success, 1 on error
+ */
+int checkpoint_schema_add(struct checkpoint_schema* schema, const char* model);
+
+/**
+ * @brief Free the tables of a schema
+ *
+ * @param schema Schema to clean
+ */
+void checkpoint_schema_clean(struct checkpoint_schema* schema);
+
+/**
+ * @brief Create an empty checkpoint of the current running configuration
+ *
+ * @param name Name of the checkpoint, NULL for the internal checkpoint of
+ * a confirmed commit
+ *
+ * @return 0 - created, 1 - it already exists, -1 - error
+ */
+int checkpoint_add(const char* name);
+
+/**
+ * @brief Remove a checkpoint
+ *
+ * @param name Name of the checkpoint, NULL for the internal one
+ *
+ * @return 0 - removed, 1 - there is no such checkpoint
+ */
+int checkpoint_del(const char* name);
+
+/**
+ * @brief Remove all the checkpoints
+ */
+void checkpoint_del_all(void);
+
+/**
+ * @brief Whether a checkpoint exists
+ *
+ * @param name Name of the checkpoint, NULL for the internal one
+ *
+ * @return 1 if it does, 0 otherwise
+ */
+int checkpoint_exists(const char* name);
+
+/**
+ * @brief Number of the checkpoints, including the internal one
+ */
+unsigned int checkpoint_count(void);
+
+/**
+ * @brief Record a change of the running configuration into every checkpoint
+ *
+ * Only the subtrees that were not changed since the checkpoint was created
+ * are saved, so each checkpoint costs memory proportional to the changes
+ * made since then, never a copy of the whole configuration.
+ *
+ * @param old_root Element with the previous running configuration as children
+ * @param new_root Element with the current running configuration as children
+ * @param schema Schema of the configuration
+ */
+void checkpoint_record(xmlNodePtr old_root, xmlNodePtr new_root, const struct checkpoint_schema* schema);
+
+/**
+ * @brief Edit-config content restoring the running configuration of a checkpoint
+ *
+ * @param name Name of the checkpoint, NULL for the internal one
+ * @param schema Schema of the configuration
+ *
+ * @return Content of the <config> element, empty if nothing changed since the
+ * checkpoint, NULL if there is no such checkpoint or on error
+ */
+char* checkpoint_inverse(const char* name, const struct checkpoint_schema* schema);
+
+/**
+ * @brief Forget the changes recorded in a checkpoint after it was restored
+ *
+ * @param name Name of the checkpoint, NULL for the internal one
+ */
+void checkpoint_clear(const char* name);
+
+/**
+ * @brief Add a checkpoint element for every named checkpoint as children
+ *
+ * @param parent Parent element, its namespace is used
+ */
+void checkpoint_stats(xmlNodePtr parent);
+
+#endif /* _CHECKPOINT_H_ */
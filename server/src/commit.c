@@ -0,0 +1,1170 @@
+/**
+ * @file commit.c
+ * @brief Netopeer candidate commit with the unchanged subtrees aligned
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/hash.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "checkpoint.h"
+#include "commit.h"
+
+#define NS_NETOPEER "urn:cesnet:tmc:netopeer:1.0"
+
+/* default confirm-timeout of a confirmed commit in seconds */
+#define COMMIT_CONFIRM_TIMEOUT 600
+
+/*
+ * The RPCs writing the candidate or running are serialized, so the candidate
+ * cannot change between reading it and writing it aligned before a commit and
+ * every change of running is recorded in the checkpoints.
+ */
+static pthread_mutex_t commit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+	uint64_t commits;
+	uint64_t unchanged;		/**< datastores whose candidate was equal to running */
+	uint64_t aligned;		/**< datastores whose candidate was aligned with running */
+	uint64_t changes;		/**< subtrees added, removed, or modified by the commits */
+} commit_counters;
+
+/* the pending confirmed commit, protected by commit_lock */
+static struct {
+	int pending;
+	int quit;
+	char* sid;					/**< the session that issued it, the only one to confirm or cancel it */
+	struct timespec deadline;	/**< CLOCK_MONOTONIC */
+	int thread_running;
+	pthread_t thread;
+	pthread_cond_t cond;
+} commit_confirm;
+
+/* schema of the running configuration of all the datastores, protected by commit_lock */
+static struct {
+	ncds_id* ids;
+	struct checkpoint_schema schema;
+} commit_schema;
+
+/*
+ * datastores whose candidate was committed and not written since, so it is
+ * equal to running and not aligned again, -1 terminated, protected by commit_lock
+ */
+static ncds_id* commit_clean;
+
+/* the Netopeer RPCs handled here */
+enum commit_rpc {
+	COMMIT_RPC_CONFIRMED,
+	COMMIT_RPC_CANCEL,
+	COMMIT_RPC_CREATE,
+	COMMIT_RPC_ROLLBACK,
+	COMMIT_RPC_DELETE
+};
+
+static const char* commit_rpc_names[] = {"confirmed-commit", "cancel-commit", "create-checkpoint", "rollback-checkpoint",
+		"delete-checkpoint", NULL};
+
+/* entry of a list being sorted */
+struct commit_sibling {
+	unsigned int key;
+	xmlNodePtr node;
+};
+
+/* the operation of a Netopeer RPC handled here, -1 for any other RPC */
+static int commit_rpc_op(const nc_rpc* rpc, xmlNodePtr* op) {
+	xmlNodePtr node;
+	char* ns;
+	int i;
+
+	if (op != NULL) {
+		*op = NULL;
+	}
+	if ((ns = nc_rpc_get_ns(rpc)) == NULL || strcmp(ns, NS_NETOPEER) != 0) {
+		free(ns);
+		return -1;
+	}
+	free(ns);
+
+	if ((node = ncxml_rpc_get_op_content(rpc)) == NULL) {
+		return -1;
+	}
+	for (i = 0; commit_rpc_names[i] != NULL; ++i) {
+		if (xmlStrEqual(node->name, BAD_CAST commit_rpc_names[i])) {
+			break;
+		}
+	}
+	if (commit_rpc_names[i] == NULL) {
+		i = -1;
+	}
+	if (op != NULL && i != -1) {
+		*op = node;
+	} else {
+		xmlFreeNodeList(node);
+	}
+
+	return i;
+}
+
+int commit_writes_config(const nc_rpc* rpc) {
+	switch (nc_rpc_get_op(rpc)) {
+	case NC_OP_COMMIT:
+	case NC_OP_DISCARDCHANGES:
+		return 1;
+	case NC_OP_EDITCONFIG:
+	case NC_OP_COPYCONFIG:
+	case NC_OP_DELETECONFIG:
+		return (nc_rpc_get_target(rpc) == NC_DATASTORE_CANDIDATE || nc_rpc_get_target(rpc) == NC_DATASTORE_RUNNING);
+	case NC_OP_UNKNOWN:
+		return (commit_rpc_op(rpc, NULL) != -1);
+	default:
+		return 0;
+	}
+}
+
+static unsigned int commit_str_hash(const xmlChar* str, unsigned int hash) {
+	while (str != NULL && *str != '\0') {
+		hash = hash * 33 + *str++;
+	}
+	return hash;
+}
+
+static int commit_user_ordered_node(xmlNodePtr node, xmlHashTablePtr user) {
+	return (xmlHashLookup(user, node->name) != NULL);
+}
+
+static unsigned int commit_node_hash(xmlNodePtr node) {
+	return (unsigned int)(uintptr_t)node->_private;
+}
+
+/* hash of a subtree independent of the order of its system-ordered entries, kept in _private of every node */
+static unsigned int commit_subtree_hash(xmlNodePtr node, xmlHashTablePtr user) {
+	xmlNodePtr child;
+	xmlAttrPtr attr;
+	xmlChar* value;
+	unsigned int hash, sum = 0, seq = 0;
+	int leaf = 1;
+
+	hash = commit_str_hash(node->name, commit_str_hash(node->ns != NULL ? node->ns->href : NULL, 5381));
+	for (attr = node->properties; attr != NULL; attr = attr->next) {
+		value = xmlNodeListGetString(node->doc, attr->children, 1);
+		sum += commit_str_hash(value, commit_str_hash(attr->name, 7));
+		xmlFree(value);
+	}
+	for (child = node->children; child != NULL; child = child->next) {
+		if (child->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		leaf = 0;
+		if (commit_user_ordered_node(child, user)) {
+			seq = seq * 31 + commit_subtree_hash(child, user);
+		} else {
+			sum += commit_subtree_hash(child, user);
+		}
+	}
+	if (leaf) {
+		value = xmlNodeGetContent(node);
+		hash = commit_str_hash(value, hash);
+		xmlFree(value);
+	}
+	hash = (hash * 31 + sum) * 31 + seq;
+
+	node->_private = (void*)(uintptr_t)hash;
+	return hash;
+}
+
+/* return: 1 - the subtrees are serialized the same, namespace prefixes and order included, 0 - they differ */
+static int commit_subtree_identical(xmlNodePtr a, xmlNodePtr b) {
+	xmlNodePtr ca, cb;
+	xmlAttrPtr aa, ab;
+	xmlChar* va, *vb;
+	int ret = 1;
+
+	if (a->type != b->type || !xmlStrEqual(a->name, b->name) || (a->ns == NULL) != (b->ns == NULL) ||
+			(a->ns != NULL && (!xmlStrEqual(a->ns->href, b->ns->href) || !xmlStrEqual(a->ns->prefix, b->ns->prefix)))) {
+		return 0;
+	}
+	if (a->type != XML_ELEMENT_NODE) {
+		return xmlStrEqual(a->content, b->content);
+	}
+
+	for (aa = a->properties, ab = b->properties; ret && aa != NULL && ab != NULL; aa = aa->next, ab = ab->next) {
+		va = xmlNodeListGetString(a->doc, aa->children, 1);
+		vb = xmlNodeListGetString(b->doc, ab->children, 1);
+		ret = (xmlStrEqual(aa->name, ab->name) && xmlStrEqual(va, vb));
+		xmlFree(va);
+		xmlFree(vb);
+	}
+	if (!ret || aa != NULL || ab != NULL) {
+		return 0;
+	}
+
+	for (ca = a->children, cb = b->children; ca != NULL && cb != NULL; ca = ca->next, cb = cb->next) {
+		if (!commit_subtree_identical(ca, cb)) {
+			return 0;
+		}
+	}
+	return (ca == NULL && cb == NULL);
+}
+
+static int commit_same_name(xmlNodePtr a, xmlNodePtr b) {
+	if (!xmlStrEqual(a->name, b->name)) {
+		return 0;
+	}
+	if (a->ns == NULL || b->ns == NULL) {
+		return (a->ns == b->ns);
+	}
+	return xmlStrEqual(a->ns->href, b->ns->href);
+}
+
+/* element children of a node, return NULL if it has none (or on error) */
+static xmlNodePtr* commit_children(xmlNodePtr node, unsigned int* count) {
+	xmlNodePtr child, *children;
+
+	*count = 0;
+	for (child = node->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE) {
+			++(*count);
+		}
+	}
+	if (*count == 0 || (children = malloc(*count * sizeof *children)) == NULL) {
+		*count = 0;
+		return NULL;
+	}
+
+	*count = 0;
+	for (child = node->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE) {
+			children[(*count)++] = child;
+		}
+	}
+
+	return children;
+}
+
+/* return: 1 - the subtrees are equal, apart from the order of their system-ordered entries, 0 - they differ */
+static int commit_subtree_equal(xmlNodePtr a, xmlNodePtr b, xmlHashTablePtr user) {
+	xmlNodePtr* ca, *cb;
+	xmlAttrPtr attr;
+	xmlChar* va, *vb;
+	unsigned int na, nb, i, j, k;
+	char* used;
+	int ret = 1;
+
+	if (commit_node_hash(a) != commit_node_hash(b) || !commit_same_name(a, b)) {
+		return 0;
+	}
+
+	for (i = 0, attr = a->properties; attr != NULL; attr = attr->next, ++i);
+	for (j = 0, attr = b->properties; attr != NULL; attr = attr->next, ++j);
+	if (i != j) {
+		return 0;
+	}
+	for (attr = a->properties; attr != NULL && ret; attr = attr->next) {
+		va = xmlNodeListGetString(a->doc, attr->children, 1);
+		vb = xmlGetNsProp(b, attr->name, attr->ns != NULL ? attr->ns->href : NULL);
+		ret = (vb != NULL && xmlStrEqual(va, vb));
+		xmlFree(va);
+		xmlFree(vb);
+	}
+	if (!ret) {
+		return 0;
+	}
+
+	ca = commit_children(a, &na);
+	cb = commit_children(b, &nb);
+	if (na != nb) {
+		ret = 0;
+	} else if (na == 0) {
+		/* leaves */
+		va = xmlNodeGetContent(a);
+		vb = xmlNodeGetContent(b);
+		ret = xmlStrEqual(va, vb);
+		xmlFree(va);
+		xmlFree(vb);
+	} else if ((used = calloc(nb, 1)) == NULL) {
+		ret = 0;
+	} else {
+		/* the user-ordered entries pairwise, the rest in any order */
+		for (i = 0, k = 0; i < na && ret; ++i) {
+			if (commit_user_ordered_node(ca[i], user)) {
+				while (k < nb && !commit_user_ordered_node(cb[k], user)) {
+					++k;
+				}
+				ret = (k < nb && commit_subtree_equal(ca[i], cb[k], user));
+				if (ret) {
+					used[k++] = 1;
+				}
+				continue;
+			}
+			for (j = 0; j < nb; ++j) {
+				/* the same position first */
+				k = (i + j) % nb;
+				if (!used[k] && !commit_user_ordered_node(cb[k], user) && commit_subtree_equal(ca[i], cb[k], user)) {
+					used[k] = 1;
+					break;
+				}
+			}
+			ret = (j < nb);
+		}
+		free(used);
+	}
+
+	free(ca);
+	free(cb);
+	return ret;
+}
+
+/*
+ * the same list entry, container, or leaf with a different content - a list
+ * entry is identified by its first key, which is always encoded first
+ */
+static int commit_same_entry(xmlNodePtr a, xmlNodePtr b) {
+	xmlNodePtr ka, kb;
+	xmlChar* va, *vb;
+	int ret;
+
+	if (!commit_same_name(a, b)) {
+		return 0;
+	}
+	for (ka = a->children; ka != NULL && ka->type != XML_ELEMENT_NODE; ka = ka->next);
+	for (kb = b->children; kb != NULL && kb->type != XML_ELEMENT_NODE; kb = kb->next);
+	if (ka == NULL || kb == NULL) {
+		/* a leaf, or a node that lost all of its children */
+		return 1;
+	}
+	if (!commit_same_name(ka, kb)) {
+		return 0;
+	}
+	if (xmlFirstElementChild(ka) != NULL || xmlFirstElementChild(kb) != NULL) {
+		/* a container */
+		return 1;
+	}
+
+	va = xmlNodeGetContent(ka);
+	vb = xmlNodeGetContent(kb);
+	ret = xmlStrEqual(va, vb);
+	xmlFree(va);
+	xmlFree(vb);
+
+	return ret;
+}
+
+static int commit_sibling_cmp(const void* a, const void* b) {
+	const struct commit_sibling* sa = a, *sb = b;
+
+	return (sa->key > sb->key) - (sa->key < sb->key);
+}
+
+/*
+ * replace the candidate subtrees equal to their running counterparts with them
+ * (moved from the running document) and put the system-ordered entries into
+ * the running order, count the subtrees that really differ and the subtrees
+ * that were not already serialized as in running (aligned)
+ */
+static void commit_align_children(xmlNodePtr cand, xmlNodePtr run, xmlHashTablePtr user, uint64_t* changes, uint64_t* aligned) {
+	xmlNodePtr* c, *r, node;
+	struct commit_sibling* order;
+	unsigned int cn, rn, i, j, k;
+	int* match = NULL, reorder = 1;
+	char* used = NULL, *equal = NULL;
+
+	c = commit_children(cand, &cn);
+	r = commit_children(run, &rn);
+	if ((cn && ((match = malloc(cn * sizeof *match)) == NULL || (equal = calloc(cn, 1)) == NULL))
+			|| (rn && (used = calloc(rn, 1)) == NULL)) {
+		/* nothing aligned, everything counted as changed */
+		*changes += cn + rn;
+		++(*aligned);
+		goto cleanup;
+	}
+
+	/* equal subtrees, the same position first */
+	for (i = 0; i < cn; ++i) {
+		match[i] = -1;
+		for (j = 0; j < rn; ++j) {
+			k = (i + j) % rn;
+			if (!used[k] && commit_subtree_equal(c[i], r[k], user)) {
+				match[i] = k;
+				equal[i] = 1;
+				used[k] = 1;
+				break;
+			}
+		}
+	}
+
+	/* modified entries are aligned recursively, the rest was added or removed */
+	for (i = 0; i < cn; ++i) {
+		if (match[i] != -1) {
+			continue;
+		}
+		for (j = 0; j < rn; ++j) {
+			k = (i + j) % rn;
+			if (!used[k] && commit_same_entry(c[i], r[k])) {
+				match[i] = k;
+				used[k] = 1;
+				break;
+			}
+		}
+		if (match[i] != -1 && xmlFirstElementChild(c[i]) != NULL && xmlFirstElementChild(r[match[i]]) != NULL) {
+			commit_align_children(c[i], r[match[i]], user, changes, aligned);
+		} else {
+			++(*changes);
+		}
+	}
+	for (j = 0; j < rn; ++j) {
+		if (!used[j]) {
+			++(*changes);
+		}
+	}
+
+	for (i = 0; i < cn; ++i) {
+		if (equal[i]) {
+			node = r[match[i]];
+			if (!commit_subtree_identical(c[i], node)) {
+				++(*aligned);
+			}
+			xmlUnlinkNode(node);
+			xmlDOMWrapAdoptNode(NULL, run->doc, node, cand->doc, cand, 0);
+			xmlReplaceNode(c[i], node);
+			xmlFreeNode(c[i]);
+			c[i] = node;
+		}
+		if (commit_user_ordered_node(c[i], user)) {
+			reorder = 0;
+		}
+	}
+
+	if (!reorder) {
+		/* moving a user-ordered entry is a change */
+		for (i = 0, k = 0; i < cn; ++i) {
+			if (match[i] != -1 && commit_user_ordered_node(c[i], user)) {
+				if ((unsigned int)match[i] < k) {
+					++(*changes);
+					break;
+				}
+				k = match[i];
+			}
+		}
+	}
+
+	/* the order of the running entries, the new ones last */
+	if (reorder && cn > 1 && (order = malloc(cn * sizeof *order)) != NULL) {
+		for (i = 0; i < cn; ++i) {
+			order[i].key = (match[i] != -1 ? (unsigned int)match[i] : rn + i);
+			order[i].node = c[i];
+		}
+		qsort(order, cn, sizeof *order, commit_sibling_cmp);
+		for (i = 0; i < cn && order[i].node == c[i]; ++i);
+		if (i < cn) {
+			++(*aligned);
+		}
+		for (; i < cn; ++i) {
+			xmlUnlinkNode(order[i].node);
+			xmlAddChild(cand, order[i].node);
+		}
+		free(order);
+	}
+
+cleanup:
+	free(c);
+	free(r);
+	free(match);
+	free(used);
+	free(equal);
+}
+
+/* the children of a node serialized, NULL on error */
+static char* commit_dump(xmlNodePtr node) {
+	xmlBufferPtr buf;
+	xmlNodePtr child;
+	char* ret = NULL;
+
+	if ((buf = xmlBufferCreate()) == NULL) {
+		return NULL;
+	}
+	for (child = node->children; child != NULL; child = child->next) {
+		if (xmlNodeDump(buf, node->doc, child, 0, 0) == -1) {
+			xmlBufferFree(buf);
+			return NULL;
+		}
+	}
+	ret = strdup((const char*)xmlBufferContent(buf));
+	xmlBufferFree(buf);
+
+	return ret;
+}
+
+/* configuration of a single datastore, NULL if it has none */
+static xmlDocPtr commit_config(ncds_id id, struct nc_session* session, const nc_rpc* rpc, char** data) {
+	nc_reply* reply;
+	xmlDocPtr doc;
+	char* config;
+
+	*data = NULL;
+	reply = ncds_apply_rpc(id, session, rpc);
+	if (reply == NULL || reply == NCDS_RPC_NOT_APPLICABLE || nc_reply_get_type(reply) != NC_REPLY_DATA) {
+		if (reply != NULL) {
+			nc_reply_free(reply);
+		}
+		return NULL;
+	}
+	*data = nc_reply_get_data(reply);
+	nc_reply_free(reply);
+
+	if (*data == NULL || asprintf(&config, "<config>%s</config>", *data) == -1) {
+		return NULL;
+	}
+	doc = xmlReadMemory(config, strlen(config), NULL, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN | XML_PARSE_HUGE);
+	free(config);
+
+	return doc;
+}
+
+/* align the candidate of a datastore with its running configuration, commit_lock must be held */
+static void commit_align(ncds_id id, struct nc_session* session, const nc_rpc* get_candidate, const nc_rpc* get_running) {
+	xmlDocPtr cand_doc = NULL, run_doc = NULL;
+	struct checkpoint_schema schema;
+	xmlHashTablePtr user;
+	nc_rpc* copy;
+	nc_reply* reply;
+	char* cand_data, *run_data, *model, *after = NULL;
+	uint64_t changes = 0, aligned = 0;
+
+	memset(&schema, 0, sizeof schema);
+	cand_doc = commit_config(id, session, get_candidate, &cand_data);
+	run_doc = commit_config(id, session, get_running, &run_data);
+	if (cand_data != NULL && run_data != NULL && strcmp(cand_data, run_data) == 0) {
+		/* the usual case, only a few datastores were edited */
+		__sync_add_and_fetch(&commit_counters.unchanged, 1);
+		goto cleanup;
+	}
+	if (cand_doc == NULL || run_doc == NULL) {
+		goto cleanup;
+	}
+
+	if ((model = ncds_get_model(id, 0)) != NULL) {
+		checkpoint_schema_add(&schema, model);
+		free(model);
+	}
+	user = schema.user;
+	commit_subtree_hash(xmlDocGetRootElement(cand_doc), user);
+	commit_subtree_hash(xmlDocGetRootElement(run_doc), user);
+
+	commit_align_children(xmlDocGetRootElement(cand_doc), xmlDocGetRootElement(run_doc), user, &changes, &aligned);
+	__sync_add_and_fetch(&commit_counters.changes, changes);
+
+	if (changes == 0) {
+		/* nothing but the order or the namespace prefixes differed */
+		__sync_add_and_fetch(&commit_counters.unchanged, 1);
+	}
+	if (aligned == 0) {
+		/* the differences are only real changes, libnetconf finds no other, nothing is written back */
+		goto cleanup;
+	}
+	if ((after = commit_dump(xmlDocGetRootElement(cand_doc))) == NULL) {
+		goto cleanup;
+	}
+
+	/* an RPC created here carries no NACM data, the whole configuration is written */
+	if ((copy = nc_rpc_copyconfig(NC_DATASTORE_CONFIG, NC_DATASTORE_CANDIDATE, after)) == NULL) {
+		goto cleanup;
+	}
+	reply = ncds_apply_rpc(id, session, copy);
+	if (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE && nc_reply_get_type(reply) == NC_REPLY_OK) {
+		__sync_add_and_fetch(&commit_counters.aligned, 1);
+	} else {
+		nc_verb_warning("%s: failed to align the candidate of the datastore %d, it is committed as it is", __func__, id);
+	}
+	if (reply != NULL) {
+		nc_reply_free(reply);
+	}
+	nc_rpc_free(copy);
+
+cleanup:
+	checkpoint_schema_clean(&schema);
+	xmlFreeDoc(cand_doc);
+	xmlFreeDoc(run_doc);
+	free(cand_data);
+	free(run_data);
+	free(after);
+}
+
+static int commit_reply_ok(const nc_reply* reply) {
+	return (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE && nc_reply_get_type(reply) == NC_REPLY_OK);
+}
+
+static nc_reply* commit_error(NC_ERR type, const char* elem, const char* msg) {
+	struct nc_err* err;
+
+	err = nc_err_new(type);
+	if (elem != NULL) {
+		nc_err_set(err, NC_ERR_PARAM_INFO_BADELEM, elem);
+	}
+	nc_err_set(err, NC_ERR_PARAM_MSG, msg);
+	return nc_reply_error(err);
+}
+
+/* the pending confirmed commit was confirmed or rolled back, commit_lock must be held */
+static void commit_confirm_end(void) {
+	checkpoint_del(NULL);
+	commit_confirm.pending = 0;
+	free(commit_confirm.sid);
+	commit_confirm.sid = NULL;
+}
+
+/* return: 1 - no confirmed commit is pending or the session issued it, 0 - another session did, commit_lock must be held */
+static int commit_confirm_owner(struct nc_session* session) {
+	const char* sid;
+
+	if (!commit_confirm.pending || commit_confirm.sid == NULL) {
+		return 1;
+	}
+	sid = nc_session_get_id(session);
+	return (sid != NULL && strcmp(sid, commit_confirm.sid) == 0);
+}
+
+/* the running configuration of all the datastores, NULL on error */
+static xmlDocPtr commit_running(struct nc_session* session, ncds_id** ids) {
+	nc_rpc* get;
+	nc_reply* reply;
+	xmlDocPtr doc = NULL;
+	char* data = NULL, *config;
+
+	/* an RPC created here carries no NACM data, the whole configuration is read */
+	if ((get = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL)) == NULL) {
+		return NULL;
+	}
+	reply = ncds_apply_rpc2all(session, get, ids);
+	nc_rpc_free(get);
+	if (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE && nc_reply_get_type(reply) == NC_REPLY_DATA) {
+		data = nc_reply_get_data(reply);
+	}
+	if (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE) {
+		nc_reply_free(reply);
+	}
+
+	if (data != NULL && asprintf(&config, "<config>%s</config>", data) != -1) {
+		doc = xmlReadMemory(config, strlen(config), NULL, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN | XML_PARSE_HUGE);
+		free(config);
+	}
+	free(data);
+
+	return doc;
+}
+
+/* the schema of the datastores, parsed again only if they change, commit_lock must be held */
+static const struct checkpoint_schema* commit_schema_get(const ncds_id* ids) {
+	char* model;
+	int i;
+
+	for (i = 0; ids != NULL && commit_schema.ids != NULL && ids[i] == commit_schema.ids[i] && ids[i] != -1; ++i);
+	if (ids == NULL || (commit_schema.ids != NULL && ids[i] == -1 && commit_schema.ids[i] == -1)) {
+		/* the same datastores */
+		return &commit_schema.schema;
+	}
+
+	checkpoint_schema_clean(&commit_schema.schema);
+	free(commit_schema.ids);
+	for (i = 0; ids[i] != -1; ++i);
+	if ((commit_schema.ids = malloc((i + 1) * sizeof *commit_schema.ids)) != NULL) {
+		memcpy(commit_schema.ids, ids, (i + 1) * sizeof *commit_schema.ids);
+	}
+	for (i = 0; ids[i] != -1; ++i) {
+		if ((model = ncds_get_model(ids[i], 0)) != NULL) {
+			checkpoint_schema_add(&commit_schema.schema, model);
+			free(model);
+		}
+	}
+
+	return &commit_schema.schema;
+}
+
+/* return: 1 - the candidate of the datastore equals running since the last commit, 0 - it may differ */
+static int commit_is_clean(ncds_id id) {
+	int i;
+
+	for (i = 0; commit_clean != NULL && commit_clean[i] != -1; ++i) {
+		if (commit_clean[i] == id) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* the candidate of the datastores may differ from running, NULL for all of them, commit_lock must be held */
+static void commit_clean_del(const ncds_id* ids) {
+	int i, j, k;
+
+	if (ids == NULL) {
+		free(commit_clean);
+		commit_clean = NULL;
+		return;
+	}
+
+	for (i = 0, k = 0; commit_clean != NULL && commit_clean[i] != -1; ++i) {
+		for (j = 0; ids[j] != -1 && ids[j] != commit_clean[i]; ++j);
+		if (ids[j] == -1) {
+			commit_clean[k++] = commit_clean[i];
+		}
+	}
+	if (commit_clean != NULL) {
+		commit_clean[k] = -1;
+	}
+}
+
+/* apply an RPC changing running and record the change in the checkpoints, commit_lock must be held */
+static nc_reply* commit_write_running(struct nc_session* session, const nc_rpc* rpc) {
+	xmlDocPtr before = NULL, after;
+	ncds_id* ids = NULL;
+	nc_reply* reply;
+
+	/* running is not what was committed anymore */
+	commit_clean_del(NULL);
+
+	/* reading running costs a copy of it, but only while there are any checkpoints */
+	if (checkpoint_count() && (before = commit_running(session, &ids)) == NULL) {
+		nc_verb_warning("%s: failed to read the running configuration, the checkpoints miss the change", __func__);
+	}
+
+	reply = ncds_apply_rpc2all(session, rpc, NULL);
+
+	if (before != NULL && commit_reply_ok(reply)) {
+		if ((after = commit_running(session, NULL)) != NULL) {
+			checkpoint_record(xmlDocGetRootElement(before), xmlDocGetRootElement(after), commit_schema_get(ids));
+			xmlFreeDoc(after);
+		} else {
+			nc_verb_warning("%s: failed to read the running configuration, the checkpoints miss the change", __func__);
+		}
+	}
+	xmlFreeDoc(before);
+	free(ids);
+
+	return reply;
+}
+
+/* commit the candidate aligned with running first, commit_lock must be held */
+static nc_reply* commit_commit(struct nc_session* session, const nc_rpc* rpc) {
+	nc_rpc* get_candidate, *get_running;
+	nc_reply* reply;
+	ncds_id* ids = NULL;
+	int i;
+
+	__sync_add_and_fetch(&commit_counters.commits, 1);
+
+	get_candidate = nc_rpc_getconfig(NC_DATASTORE_CANDIDATE, NULL);
+	get_running = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL);
+	if (get_candidate != NULL && get_running != NULL) {
+		/* learn the datastores */
+		reply = ncds_apply_rpc2all(session, get_running, &ids);
+		if (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE) {
+			nc_reply_free(reply);
+		}
+	}
+	for (i = 0; ids != NULL && ids[i] != -1; ++i) {
+		if (commit_is_clean(ids[i])) {
+			/* its candidate was not written since the last commit */
+			__sync_add_and_fetch(&commit_counters.unchanged, 1);
+			continue;
+		}
+		commit_align(ids[i], session, get_candidate, get_running);
+	}
+	nc_rpc_free(get_candidate);
+	nc_rpc_free(get_running);
+
+	reply = commit_write_running(session, rpc);
+	if (commit_reply_ok(reply) && ids != NULL) {
+		/* the candidate of every datastore was committed as it is */
+		commit_clean = ids;
+		ids = NULL;
+	}
+	free(ids);
+
+	return reply;
+}
+
+/* restore the running configuration of a checkpoint, NULL for the confirmed commit, commit_lock must be held */
+static nc_reply* commit_rollback(struct nc_session* session, const char* name) {
+	nc_rpc* edit;
+	nc_reply* reply;
+	char* config;
+
+	if ((config = checkpoint_inverse(name, &commit_schema.schema)) == NULL) {
+		return commit_error(NC_ERR_OP_FAILED, NULL, "Failed to create the inverse of the checkpoint changes.");
+	}
+	if (config[0] == '\0') {
+		/* nothing changed since */
+		free(config);
+		return nc_reply_ok();
+	}
+
+	/* the transAPI callbacks are called only for the changed subtrees, all of them or none */
+	edit = nc_rpc_editconfig(NC_DATASTORE_RUNNING, NC_DATASTORE_CONFIG, NC_EDIT_DEFOP_MERGE, NC_EDIT_ERROPT_ROLLBACK,
+			NC_EDIT_TESTOPT_TESTSET, config);
+	free(config);
+	if (edit == NULL) {
+		return commit_error(NC_ERR_OP_FAILED, NULL, "Failed to create the rollback edit-config.");
+	}
+	reply = commit_write_running(session, edit);
+	nc_rpc_free(edit);
+
+	if (commit_reply_ok(reply)) {
+		/* the other checkpoints recorded the rollback as any other change */
+		checkpoint_clear(name);
+	}
+	return reply;
+}
+
+/* rolls back an unconfirmed commit after its timeout or when the server stops */
+static void* commit_confirm_thread(void* arg) {
+	struct nc_session* dummy;
+	struct nc_cpblts* cpblts;
+	struct passwd* pw;
+	struct timespec now;
+	nc_reply* reply;
+
+	(void)arg;
+
+	pw = getpwuid(getuid());
+	cpblts = nc_session_get_cpblts_default();
+	dummy = nc_session_dummy("0", pw != NULL ? pw->pw_name : "root", NULL, cpblts);
+	nc_cpblts_free(cpblts);
+	if (dummy == NULL) {
+		nc_verb_error("%s: failed to create a dummy session, confirmed commits do not time out", __func__);
+		return NULL;
+	}
+
+	/* COMMIT LOCK */
+	pthread_mutex_lock(&commit_lock);
+
+	while (1) {
+		if (!commit_confirm.pending) {
+			if (commit_confirm.quit) {
+				break;
+			}
+			pthread_cond_wait(&commit_confirm.cond, &commit_lock);
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (!commit_confirm.quit && (now.tv_sec < commit_confirm.deadline.tv_sec ||
+				(now.tv_sec == commit_confirm.deadline.tv_sec && now.tv_nsec < commit_confirm.deadline.tv_nsec))) {
+			pthread_cond_timedwait(&commit_confirm.cond, &commit_lock, &commit_confirm.deadline);
+			continue;
+		}
+
+		nc_verb_warning("The confirmed commit was not confirmed, rolling back the running configuration.");
+		reply = commit_rollback(dummy, NULL);
+		if (!commit_reply_ok(reply)) {
+			nc_verb_error("Rolling back the unconfirmed commit failed, the running configuration is kept.");
+		}
+		if (reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE) {
+			nc_reply_free(reply);
+		}
+		commit_confirm_end();
+	}
+
+	/* COMMIT UNLOCK */
+	pthread_mutex_unlock(&commit_lock);
+
+	nc_session_free(dummy);
+	return NULL;
+}
+
+/* the content of a child of an RPC operation, NULL if there is none */
+static char* commit_rpc_param(xmlNodePtr op, const char* name) {
+	xmlNodePtr child;
+
+	for (child = op->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE && xmlStrEqual(child->name, BAD_CAST name)) {
+			return (char*)xmlNodeGetContent(child);
+		}
+	}
+	return NULL;
+}
+
+/* commit_lock must be held */
+static nc_reply* commit_confirmed(struct nc_session* session, xmlNodePtr op) {
+	pthread_condattr_t attr;
+	nc_rpc* commit;
+	nc_reply* reply;
+	unsigned long timeout = COMMIT_CONFIRM_TIMEOUT;
+	const char* sid;
+	char* str, *ptr;
+
+	if ((str = commit_rpc_param(op, "confirm-timeout")) != NULL) {
+		timeout = strtoul(str, &ptr, 10);
+		if (*str == '\0' || *ptr != '\0' || timeout == 0 || timeout > UINT32_MAX) {
+			free(str);
+			return commit_error(NC_ERR_INVALID_VALUE, "confirm-timeout", "Invalid confirm-timeout value.");
+		}
+		free(str);
+	}
+
+	/* a confirmed commit following another one only extends its timeout */
+	if (!commit_confirm.pending && checkpoint_add(NULL) == -1) {
+		return commit_error(NC_ERR_OP_FAILED, NULL, "Failed to create the confirmed commit checkpoint.");
+	}
+	if ((commit = nc_rpc_commit()) == NULL) {
+		reply = commit_error(NC_ERR_OP_FAILED, NULL, "Failed to create the commit.");
+	} else {
+		reply = commit_commit(session, commit);
+		nc_rpc_free(commit);
+	}
+	if (!commit_reply_ok(reply)) {
+		if (!commit_confirm.pending) {
+			checkpoint_del(NULL);
+		}
+		return reply;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &commit_confirm.deadline);
+	commit_confirm.deadline.tv_sec += timeout;
+	if (!commit_confirm.pending && (sid = nc_session_get_id(session)) != NULL) {
+		/* rolled back when this session ends, NULL lets any session confirm it */
+		commit_confirm.sid = strdup(sid);
+	}
+	commit_confirm.pending = 1;
+
+	if (!commit_confirm.thread_running) {
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&commit_confirm.cond, &attr);
+		pthread_condattr_destroy(&attr);
+		if ((errno = pthread_create(&commit_confirm.thread, NULL, commit_confirm_thread, NULL)) != 0) {
+			nc_verb_error("%s: failed to create a thread (%s), the commit is confirmed", __func__, strerror(errno));
+			pthread_cond_destroy(&commit_confirm.cond);
+			commit_confirm_end();
+			return reply;
+		}
+		commit_confirm.thread_running = 1;
+	} else {
+		pthread_cond_signal(&commit_confirm.cond);
+	}
+
+	return reply;
+}
+
+/* a Netopeer RPC handled here, commit_lock must be held */
+static nc_reply* commit_netopeer_rpc(struct nc_session* session, const nc_rpc* rpc) {
+	xmlNodePtr op;
+	nc_reply* reply;
+	char* name = NULL;
+	int ret;
+
+	ret = commit_rpc_op(rpc, &op);
+	if (ret == COMMIT_RPC_CREATE || ret == COMMIT_RPC_ROLLBACK || ret == COMMIT_RPC_DELETE) {
+		if ((name = commit_rpc_param(op, "name")) == NULL || name[0] == '\0') {
+			free(name);
+			xmlFreeNodeList(op);
+			return commit_error(NC_ERR_MISSING_ELEM, "name", "Missing the checkpoint name.");
+		}
+	}
+
+	switch (ret) {
+	case COMMIT_RPC_CONFIRMED:
+		if (!commit_confirm_owner(session)) {
+			reply = commit_error(NC_ERR_IN_USE, NULL, "A confirmed commit of another session is pending.");
+			break;
+		}
+		reply = commit_confirmed(session, op);
+		break;
+	case COMMIT_RPC_CANCEL:
+		if (!commit_confirm.pending) {
+			reply = commit_error(NC_ERR_OP_FAILED, NULL, "No confirmed commit is pending.");
+			break;
+		}
+		if (!commit_confirm_owner(session)) {
+			reply = commit_error(NC_ERR_IN_USE, NULL, "A confirmed commit of another session is pending.");
+			break;
+		}
+		reply = commit_rollback(session, NULL);
+		if (commit_reply_ok(reply)) {
+			commit_confirm_end();
+			pthread_cond_signal(&commit_confirm.cond);
+		}
+		break;
+	case COMMIT_RPC_CREATE:
+		ret = checkpoint_add(name);
+		if (ret == 1) {
+			reply = commit_error(NC_ERR_DATA_EXISTS, "name", "A checkpoint with this name already exists.");
+		} else if (ret == -1) {
+			reply = commit_error(NC_ERR_OP_FAILED, NULL, "Failed to create the checkpoint.");
+		} else {
+			reply = nc_reply_ok();
+		}
+		break;
+	case COMMIT_RPC_ROLLBACK:
+		if (!checkpoint_exists(name)) {
+			reply = commit_error(NC_ERR_DATA_MISSING, "name", "No checkpoint with this name exists.");
+		} else {
+			reply = commit_rollback(session, name);
+		}
+		break;
+	case COMMIT_RPC_DELETE:
+		if (checkpoint_del(name)) {
+			reply = commit_error(NC_ERR_DATA_MISSING, "name", "No checkpoint with this name exists.");
+		} else {
+			reply = nc_reply_ok();
+		}
+		break;
+	default:
+		reply = commit_error(NC_ERR_OP_FAILED, NULL, "Corrupted RPC message.");
+		break;
+	}
+
+	free(name);
+	xmlFreeNodeList(op);
+	return reply;
+}
+
+nc_reply* commit_apply(struct nc_session* session, const nc_rpc* rpc) {
+	nc_reply* reply;
+	ncds_id* ids = NULL;
+
+	/* COMMIT LOCK */
+	pthread_mutex_lock(&commit_lock);
+
+	switch (nc_rpc_get_op(rpc)) {
+	case NC_OP_COMMIT:
+		if (!commit_confirm_owner(session)) {
+			/* it would be rolled back with the pending one */
+			reply = commit_error(NC_ERR_IN_USE, NULL, "A confirmed commit of another session is pending.");
+			break;
+		}
+		reply = commit_commit(session, rpc);
+		if (commit_confirm.pending && commit_reply_ok(reply)) {
+			/* the confirming commit */
+			commit_confirm_end();
+			pthread_cond_signal(&commit_confirm.cond);
+		}
+		break;
+	case NC_OP_UNKNOWN:
+		reply = commit_netopeer_rpc(session, rpc);
+		break;
+	default:
+		if (nc_rpc_get_target(rpc) == NC_DATASTORE_RUNNING) {
+			reply = commit_write_running(session, rpc);
+		} else {
+			/* the candidate, aligned again by the next commit in the datastores it was applied to */
+			reply = ncds_apply_rpc2all(session, rpc, &ids);
+			commit_clean_del(commit_reply_ok(reply) ? ids : NULL);
+			free(ids);
+		}
+		break;
+	}
+
+	/* COMMIT UNLOCK */
+	pthread_mutex_unlock(&commit_lock);
+
+	return reply;
+}
+
+void commit_session_end(const char* sid) {
+	if (sid == NULL) {
+		return;
+	}
+
+	/* COMMIT LOCK */
+	pthread_mutex_lock(&commit_lock);
+
+	if (commit_confirm.pending && commit_confirm.sid != NULL && strcmp(sid, commit_confirm.sid) == 0) {
+		/* the timer thread rolls it back right away */
+		nc_verb_warning("The session %s of the pending confirmed commit ended.", sid);
+		clock_gettime(CLOCK_MONOTONIC, &commit_confirm.deadline);
+		pthread_cond_signal(&commit_confirm.cond);
+	}
+
+	/* COMMIT UNLOCK */
+	pthread_mutex_unlock(&commit_lock);
+}
+
+void commit_cleanup(void) {
+	/* COMMIT LOCK */
+	pthread_mutex_lock(&commit_lock);
+	commit_confirm.quit = 1;
+	if (commit_confirm.thread_running) {
+		pthread_cond_signal(&commit_confirm.cond);
+	}
+	/* COMMIT UNLOCK */
+	pthread_mutex_unlock(&commit_lock);
+
+	if (commit_confirm.thread_running) {
+		/* a pending confirmed commit is rolled back */
+		pthread_join(commit_confirm.thread, NULL);
+		pthread_cond_destroy(&commit_confirm.cond);
+		commit_confirm.thread_running = 0;
+	}
+	commit_confirm.pending = 0;
+	commit_confirm.quit = 0;
+	free(commit_confirm.sid);
+	commit_confirm.sid = NULL;
+
+	free(commit_clean);
+	commit_clean = NULL;
+
+	checkpoint_del_all();
+	checkpoint_schema_clean(&commit_schema.schema);
+	free(commit_schema.ids);
+	commit_schema.ids = NULL;
+}
+
+void commit_stats(xmlNodePtr parent) {
+	char buf[24];
+
+	snprintf(buf, sizeof buf, "%" PRIu64, commit_counters.commits);
+	xmlNewChild(parent, parent->ns, BAD_CAST "commits", BAD_CAST buf);
+	snprintf(buf, sizeof buf, "%" PRIu64, commit_counters.unchanged);
+	xmlNewChild(parent, parent->ns, BAD_CAST "unchanged-datastores", BAD_CAST buf);
+	snprintf(buf, sizeof buf, "%" PRIu64, commit_counters.aligned);
+	xmlNewChild(parent, parent->ns, BAD_CAST "aligned-datastores", BAD_CAST buf);
+	snprintf(buf, sizeof buf, "%" PRIu64, commit_counters.changes);
+	xmlNewChild(parent, parent->ns, BAD_CAST "changed-subtrees", BAD_CAST buf);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file commit.h
+ * @brief Netopeer candidate commit header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _COMMIT_H_
+#define _COMMIT_H_
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+
+/**
+ * @brief Whether an RPC writes the candidate or running datastore, or it is
+ * one of the Netopeer checkpoint RPCs, and must be applied by commit_apply()
+ *
+ * @param rpc RPC to check
+ *
+ * @return 1 if it does, 0 otherwise
+ */
+int commit_writes_config(const nc_rpc* rpc);
+
+/**
+ * @brief Apply an RPC writing the candidate or running, serialized with the
+ * other ones
+ *
+ * Before a <commit>, the candidate of every datastore written since the last
+ * commit is compared with its running configuration and the subtrees equal to
+ * their running counterparts, except for the order of the system-ordered
+ * entries or namespace prefixes, are replaced by exact copies of them, so
+ * libnetconf finds no difference in them and calls no transAPI callbacks for
+ * them. The candidate is written back only if some of them were not exact
+ * copies already.
+ *
+ * While there are any checkpoints, every change of running is recorded in
+ * them. The Netopeer confirmed-commit, cancel-commit, create-checkpoint,
+ * rollback-checkpoint, and delete-checkpoint RPCs are handled here as well.
+ *
+ * @param session Session of the RPC
+ * @param rpc The RPC
+ *
+ * @return Reply as from ncds_apply_rpc2all()
+ */
+nc_reply* commit_apply(struct nc_session* session, const nc_rpc* rpc);
+
+/**
+ * @brief Add the commit counters as children
+ *
+ * @param parent Parent element, its namespace is used
+ */
+void commit_stats(xmlNodePtr parent);
+
+/**
+ * @brief Roll back a pending confirmed commit issued by a session that ended
+ *
+ * @param sid ID of the session, of the owner or of a worker
+ */
+void commit_session_end(const char* sid);
+
+/**
+ * @brief Roll back a pending confirmed commit, stop its timer, and remove all
+ * the checkpoints
+ */
+void commit_cleanup(void);
+
+#endif /* _COMMIT_H_ */
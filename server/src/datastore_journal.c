@@ -0,0 +1,1229 @@
+/**
+ * @file datastore_journal.c
+ * @brief Netopeer journaled in-memory datastore
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf_xml.h>
+#include <libxml/tree.h>
+#include <libxml/parser.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "server.h"
+#include "datastore_journal.h"
+#include "datastore_snapshot.h"
+
+/*
+ * The log is a sequence of records, one for every change of the datastore:
+ *
+ *   <seq> <payload-length> <payload-hash>\n<payload>\n
+ *
+ * The payload is a sequence of splice operations replacing a range of
+ * children of a node, addressed by the child indices from the datastore
+ * element:
+ *
+ *   S <datastore> <index.index...|-> <start> <delete-count> <xml-length>\n<xml>\n
+ *
+ * Only the changed subtrees are written, so a record is proportional to the
+ * edit, not to the datastore. A torn or corrupted record ends the replay.
+ *
+ * With JOURNAL_SNAPSHOT, every checkpoint is accompanied by a binary snapshot
+ * "<path>.snap" of the same content, which is loaded instead of parsing the
+ * checkpoint as long as the checkpoint is the one it was built from.
+ */
+
+#define JOURNAL_NS "urn:cesnet:tmc:datastores:file"
+#define JOURNAL_DS_COUNT 3
+#define JOURNAL_PARSE_OPTS (XML_PARSE_NOBLANKS|XML_PARSE_NSCLEAN|XML_PARSE_NOWARNING|XML_PARSE_NOERROR|XML_PARSE_HUGE)
+
+static const char* journal_ds_names[JOURNAL_DS_COUNT] = {"running", "startup", "candidate"};
+static const NC_DATASTORE journal_ds_types[JOURNAL_DS_COUNT] = {NC_DATASTORE_RUNNING, NC_DATASTORE_STARTUP, NC_DATASTORE_CANDIDATE};
+
+struct np_journal {
+	char* path;				// checkpoint
+	char* wal_path;			// write-ahead log
+	char* wal_old_path;		// log replaced by the checkpoint in progress
+	char* snap_path;		// binary snapshot of the checkpoint
+	int wal_fd;
+
+	pthread_mutex_t lock;	// content, locks, and the log position
+	xmlDocPtr doc;
+	xmlNodePtr ds[JOURNAL_DS_COUNT];
+	struct ncds_lockinfo lockinfo[JOURNAL_DS_COUNT];
+	xmlNodePtr backup;		// content of ds[backup_idx] before the last change, for rollback
+	int backup_idx;
+	uint64_t seq;			// last record written
+	uint64_t checkpoint_seq;	// last record included in the checkpoint
+	off_t wal_size;
+	time_t checkpoint_time;
+
+	pthread_mutex_t sync_lock;	// group fsync of the log
+	pthread_cond_t sync_cond;
+	uint64_t synced_seq;
+	int syncing;
+
+	struct np_journal* next;
+};
+
+/* all the initialized journals, for the checkpoint thread */
+static pthread_mutex_t journals_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct np_journal* journals;
+static pthread_once_t checkpoint_thread_once = PTHREAD_ONCE_INIT;
+
+extern int server_start;
+
+static int journal_ds_idx(NC_DATASTORE ds) {
+	int i;
+
+	for (i = 0; i < JOURNAL_DS_COUNT; ++i) {
+		if (journal_ds_types[i] == ds) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void journal_error(struct nc_err** error, NC_ERR type, const char* msg) {
+	if (error != NULL) {
+		*error = nc_err_new(type);
+		nc_err_set(*error, NC_ERR_PARAM_MSG, msg);
+	}
+}
+
+/* FNV-1a */
+static uint32_t journal_hash(uint64_t seq, const char* data, size_t len) {
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < sizeof seq; ++i) {
+		hash = (hash ^ ((seq >> (8*i)) & 0xff)) * 16777619U;
+	}
+	for (i = 0; i < len; ++i) {
+		hash = (hash ^ (unsigned char)data[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * tree comparison
+ */
+
+static int journal_attrs_equal(xmlAttrPtr a, xmlAttrPtr b) {
+	for (; a != NULL && b != NULL; a = a->next, b = b->next) {
+		if (!xmlStrEqual(a->name, b->name) || (a->ns == NULL) != (b->ns == NULL)
+				|| (a->ns != NULL && !xmlStrEqual(a->ns->href, b->ns->href))) {
+			return 0;
+		}
+		if ((a->children == NULL) != (b->children == NULL)
+				|| (a->children != NULL && !xmlStrEqual(a->children->content, b->children->content))) {
+			return 0;
+		}
+	}
+	return (a == NULL && b == NULL);
+}
+
+/* same element with the same attributes, its children may differ */
+static int journal_node_shallow_equal(xmlNodePtr a, xmlNodePtr b) {
+	if (a->type != XML_ELEMENT_NODE || b->type != XML_ELEMENT_NODE || !xmlStrEqual(a->name, b->name)) {
+		return 0;
+	}
+	if ((a->ns == NULL) != (b->ns == NULL) || (a->ns != NULL && !xmlStrEqual(a->ns->href, b->ns->href))) {
+		return 0;
+	}
+	return journal_attrs_equal(a->properties, b->properties);
+}
+
+static int journal_node_equal(xmlNodePtr a, xmlNodePtr b) {
+	if (a->type != b->type) {
+		return 0;
+	}
+	if (a->type != XML_ELEMENT_NODE) {
+		return xmlStrEqual(a->content, b->content);
+	}
+	if (!journal_node_shallow_equal(a, b)) {
+		return 0;
+	}
+
+	for (a = a->children, b = b->children; a != NULL && b != NULL; a = a->next, b = b->next) {
+		if (!journal_node_equal(a, b)) {
+			return 0;
+		}
+	}
+	return (a == NULL && b == NULL);
+}
+
+static xmlNodePtr* journal_children(xmlNodePtr parent, unsigned int* count) {
+	xmlNodePtr child, *children;
+	unsigned int i;
+
+	*count = 0;
+	for (child = parent->children; child != NULL; child = child->next) {
+		++(*count);
+	}
+	if ((children = malloc((*count + 1) * sizeof *children)) == NULL) {
+		return NULL;
+	}
+	for (child = parent->children, i = 0; child != NULL; child = child->next, ++i) {
+		children[i] = child;
+	}
+
+	return children;
+}
+
+/*
+ * records
+ */
+
+/* append a splice of the children of the node at path */
+static int journal_splice_write(xmlBufferPtr ops, const char* ds_name, const char* path, unsigned int start,
+		unsigned int del, xmlNodePtr* ins, unsigned int ins_count) {
+	xmlBufferPtr xml;
+	xmlDocPtr doc;
+	xmlNodePtr copy;
+	unsigned int i;
+	char header[64];
+
+	if ((xml = xmlBufferCreate()) == NULL || (doc = xmlNewDoc(BAD_CAST "1.0")) == NULL) {
+		xmlBufferFree(xml);
+		return EXIT_FAILURE;
+	}
+
+	/* copying to another document declares the namespaces on the copy itself */
+	for (i = 0; i < ins_count; ++i) {
+		if ((copy = xmlDocCopyNode(ins[i], doc, 1)) == NULL) {
+			xmlFreeDoc(doc);
+			xmlBufferFree(xml);
+			return EXIT_FAILURE;
+		}
+		xmlNodeDump(xml, doc, copy, 0, 0);
+		xmlFreeNode(copy);
+	}
+	xmlFreeDoc(doc);
+
+	xmlBufferCCat(ops, "S ");
+	xmlBufferCCat(ops, ds_name);
+	xmlBufferCCat(ops, " ");
+	xmlBufferCCat(ops, path[0] ? path : "-");
+	snprintf(header, sizeof header, " %u %u %d\n", start, del, xmlBufferLength(xml));
+	xmlBufferCCat(ops, header);
+	xmlBufferAdd(ops, xmlBufferContent(xml), xmlBufferLength(xml));
+	xmlBufferCCat(ops, "\n");
+
+	xmlBufferFree(xml);
+	return EXIT_SUCCESS;
+}
+
+/* append the splices turning the children of old into the children of new */
+static int journal_diff(xmlBufferPtr ops, const char* ds_name, const char* path, xmlNodePtr old, xmlNodePtr new) {
+	xmlNodePtr* a, *b;
+	unsigned int n, m, p, s, i;
+	char* child_path;
+	int ret = EXIT_SUCCESS;
+
+	a = journal_children(old, &n);
+	b = journal_children(new, &m);
+	if (a == NULL || b == NULL) {
+		free(a);
+		free(b);
+		return EXIT_FAILURE;
+	}
+
+	/* common prefix and suffix */
+	for (p = 0; p < n && p < m && journal_node_equal(a[p], b[p]); ++p);
+	for (s = 0; s < n - p && s < m - p && journal_node_equal(a[n - 1 - s], b[m - 1 - s]); ++s);
+
+	if (n - p - s == m - p - s) {
+		/* the same number of nodes changed, descend into the ones only the content of which changed */
+		for (i = p; i < n - s && ret == EXIT_SUCCESS; ++i) {
+			if (journal_node_equal(a[i], b[i])) {
+				continue;
+			}
+			if (journal_node_shallow_equal(a[i], b[i])) {
+				if (asprintf(&child_path, "%s%s%u", path, (path[0] ? "." : ""), i) == -1) {
+					ret = EXIT_FAILURE;
+					break;
+				}
+				ret = journal_diff(ops, ds_name, child_path, a[i], b[i]);
+				free(child_path);
+			} else {
+				ret = journal_splice_write(ops, ds_name, path, i, 1, &b[i], 1);
+			}
+		}
+	} else {
+		ret = journal_splice_write(ops, ds_name, path, p, n - p - s, &b[p], m - p - s);
+	}
+
+	free(a);
+	free(b);
+	return ret;
+}
+
+/* write one record, called with the journal lock held, return: 0 - written, 1 - error */
+static int journal_record_write(struct np_journal* j, xmlBufferPtr ops) {
+	char header[64];
+	const char* payload = (const char*)xmlBufferContent(ops);
+	size_t len = xmlBufferLength(ops);
+	struct iovec iov[3];
+	ssize_t ret;
+	uint64_t seq = j->seq + 1;
+	int hlen;
+
+	hlen = snprintf(header, sizeof header, "%" PRIu64 " %zu %08" PRIx32 "\n", seq, len, journal_hash(seq, payload, len));
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = hlen;
+	iov[1].iov_base = (void*)payload;
+	iov[1].iov_len = len;
+	iov[2].iov_base = (void*)"\n";
+	iov[2].iov_len = 1;
+
+	/* the log is opened with O_APPEND, a short write is left for the replay to discard */
+	if ((ret = writev(j->wal_fd, iov, 3)) != (ssize_t)(hlen + len + 1)) {
+		nc_verb_error("%s: writing to \"%s\" failed (%s).", __func__, j->wal_path, (ret == -1 ? strerror(errno) : "short write"));
+		if (ret > 0 && ftruncate(j->wal_fd, j->wal_size) == -1) {
+			nc_verb_error("%s: truncating \"%s\" failed (%s).", __func__, j->wal_path, strerror(errno));
+		}
+		return EXIT_FAILURE;
+	}
+
+	j->wal_size += ret;
+	__atomic_store_n(&j->seq, seq, __ATOMIC_RELEASE);
+
+	return EXIT_SUCCESS;
+}
+
+/* wait until the record seq is on the disk, sharing the fsync with concurrent commits, return: 0 - durable, 1 - error */
+static int journal_sync(struct np_journal* j, uint64_t seq) {
+	uint64_t target;
+	int fd, ret = EXIT_SUCCESS;
+
+	/* JOURNAL SYNC LOCK */
+	pthread_mutex_lock(&j->sync_lock);
+
+	while (j->synced_seq < seq) {
+		if (j->syncing) {
+			/* another thread is syncing, the other thread's fsync may cover our record */
+			pthread_cond_wait(&j->sync_cond, &j->sync_lock);
+			continue;
+		}
+
+		j->syncing = 1;
+		target = __atomic_load_n(&j->seq, __ATOMIC_ACQUIRE);
+		fd = j->wal_fd;
+
+		/* JOURNAL SYNC UNLOCK */
+		pthread_mutex_unlock(&j->sync_lock);
+
+		if (fdatasync(fd) == -1) {
+			nc_verb_error("%s: fdatasync on \"%s\" failed (%s).", __func__, j->wal_path, strerror(errno));
+			ret = EXIT_FAILURE;
+		}
+
+		/* JOURNAL SYNC LOCK */
+		pthread_mutex_lock(&j->sync_lock);
+
+		j->syncing = 0;
+		if (ret == EXIT_SUCCESS && target > j->synced_seq) {
+			j->synced_seq = target;
+		}
+		pthread_cond_broadcast(&j->sync_cond);
+		if (ret != EXIT_SUCCESS) {
+			break;
+		}
+	}
+
+	/* JOURNAL SYNC UNLOCK */
+	pthread_mutex_unlock(&j->sync_lock);
+
+	return ret;
+}
+
+/* replace the datastore content, called with the journal lock held, return: 0 - replaced, 1 - error */
+static int journal_replace(struct np_journal* j, int idx, xmlNodePtr new, uint64_t* seq, struct nc_err** error) {
+	xmlBufferPtr ops;
+
+	*seq = 0;
+	if ((ops = xmlBufferCreate()) == NULL) {
+		journal_error(error, NC_ERR_OP_FAILED, "Memory allocation failed.");
+		return EXIT_FAILURE;
+	}
+
+	if (journal_diff(ops, journal_ds_names[idx], "", j->ds[idx], new)) {
+		journal_error(error, NC_ERR_OP_FAILED, "Creating the journal record failed.");
+		xmlBufferFree(ops);
+		return EXIT_FAILURE;
+	}
+
+	if (xmlBufferLength(ops) > 0) {
+		if (journal_record_write(j, ops)) {
+			journal_error(error, NC_ERR_OP_FAILED, "Writing the datastore journal failed.");
+			xmlBufferFree(ops);
+			return EXIT_FAILURE;
+		}
+		*seq = j->seq;
+	}
+	xmlBufferFree(ops);
+
+	xmlReplaceNode(j->ds[idx], new);
+	if (j->backup != NULL) {
+		xmlFreeNode(j->backup);
+	}
+	j->backup = j->ds[idx];
+	j->backup_idx = idx;
+	j->ds[idx] = new;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * replay
+ */
+
+static xmlNodePtr journal_path_resolve(xmlNodePtr node, const char* path) {
+	char* end;
+	unsigned long idx;
+
+	if (strcmp(path, "-") == 0) {
+		return node;
+	}
+
+	while (node != NULL && *path) {
+		idx = strtoul(path, &end, 10);
+		if (end == path || (*end != '.' && *end != '\0')) {
+			return NULL;
+		}
+		for (node = node->children; node != NULL && idx; node = node->next, --idx);
+		path = (*end ? end + 1 : end);
+	}
+
+	return node;
+}
+
+static int journal_splice_apply(struct np_journal* j, const char* ds_name, const char* path, unsigned int start,
+		unsigned int del, const char* xml, size_t xml_len) {
+	xmlNodePtr parent, next, aux, child, copy;
+	xmlDocPtr ins_doc = NULL;
+	char* wrapped = NULL;
+	int idx, len;
+
+	for (idx = 0; idx < JOURNAL_DS_COUNT && strcmp(journal_ds_names[idx], ds_name); ++idx);
+	if (idx == JOURNAL_DS_COUNT || (parent = journal_path_resolve(j->ds[idx], path)) == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	if (xml_len > 0) {
+		if ((len = asprintf(&wrapped, "<journal>%.*s</journal>", (int)xml_len, xml)) == -1) {
+			return EXIT_FAILURE;
+		}
+		ins_doc = xmlReadMemory(wrapped, len, NULL, NULL, JOURNAL_PARSE_OPTS & ~XML_PARSE_NOBLANKS);
+		free(wrapped);
+		if (ins_doc == NULL) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (next = parent->children; next != NULL && start; next = next->next, --start);
+	if (start) {
+		xmlFreeDoc(ins_doc);
+		return EXIT_FAILURE;
+	}
+	while (next != NULL && del) {
+		aux = next->next;
+		xmlUnlinkNode(next);
+		xmlFreeNode(next);
+		next = aux;
+		--del;
+	}
+
+	if (ins_doc != NULL) {
+		for (child = xmlDocGetRootElement(ins_doc)->children; child != NULL; child = child->next) {
+			if ((copy = xmlDocCopyNode(child, j->doc, 1)) == NULL) {
+				xmlFreeDoc(ins_doc);
+				return EXIT_FAILURE;
+			}
+			if (next != NULL) {
+				xmlAddPrevSibling(next, copy);
+			} else {
+				xmlAddChild(parent, copy);
+			}
+		}
+		xmlFreeDoc(ins_doc);
+	}
+
+	return (del ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static int journal_record_apply(struct np_journal* j, const char* payload, size_t len) {
+	const char* end = payload + len, *xml;
+	char ds_name[16], path[4096];
+	unsigned int start, del;
+	size_t xml_len;
+	int hlen;
+
+	while (payload < end) {
+		if (sscanf(payload, "S %15s %4095s %u %u %zu\n%n", ds_name, path, &start, &del, &xml_len, &hlen) != 5) {
+			return EXIT_FAILURE;
+		}
+		xml = payload + hlen;
+		if (xml + xml_len + 1 > end || xml[xml_len] != '\n') {
+			return EXIT_FAILURE;
+		}
+		if (journal_splice_apply(j, ds_name, path, start, del, xml, xml_len)) {
+			return EXIT_FAILURE;
+		}
+		payload = xml + xml_len + 1;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* apply the records after the checkpoint, return: 0 - replayed (possibly up to a torn record), 1 - error */
+static int journal_replay(struct np_journal* j, const char* path, int truncate_torn) {
+	struct stat st;
+	char* buf, *payload;
+	size_t pos = 0, len;
+	uint64_t seq;
+	uint32_t hash;
+	int fd, hlen, count = 0;
+
+	if ((fd = open(path, O_RDWR | O_CLOEXEC)) == -1) {
+		return (errno == ENOENT ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (fstat(fd, &st) == -1 || (buf = malloc(st.st_size + 1)) == NULL) {
+		close(fd);
+		return EXIT_FAILURE;
+	}
+	if (read(fd, buf, st.st_size) != st.st_size) {
+		free(buf);
+		close(fd);
+		return EXIT_FAILURE;
+	}
+	buf[st.st_size] = '\0';
+
+	while (pos < (size_t)st.st_size) {
+		if (sscanf(buf + pos, "%" SCNu64 " %zu %" SCNx32 "\n%n", &seq, &len, &hash, &hlen) != 3) {
+			break;
+		}
+		payload = buf + pos + hlen;
+		if (pos + hlen + len + 1 > (size_t)st.st_size || payload[len] != '\n' || journal_hash(seq, payload, len) != hash) {
+			break;
+		}
+
+		if (seq > j->seq) {
+			if (journal_record_apply(j, payload, len)) {
+				nc_verb_error("%s: record %" PRIu64 " in \"%s\" cannot be applied.", __func__, seq, path);
+				free(buf);
+				close(fd);
+				return EXIT_FAILURE;
+			}
+			j->seq = seq;
+			++count;
+		}
+		pos += hlen + len + 1;
+	}
+
+	if (pos < (size_t)st.st_size) {
+		nc_verb_warning("%s: discarding %zu bytes of an incomplete record at the end of \"%s\".", __func__, st.st_size - pos, path);
+		if (truncate_torn && ftruncate(fd, pos) == -1) {
+			nc_verb_error("%s: truncating \"%s\" failed (%s).", __func__, path, strerror(errno));
+		}
+	}
+	if (count) {
+		nc_verb_verbose("%s: %d records replayed from \"%s\".", __func__, count, path);
+	}
+
+	free(buf);
+	close(fd);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * checkpoint
+ */
+
+static int journal_fsync_dir(const char* path) {
+	char* path_dup, *dir;
+	int fd, ret = EXIT_SUCCESS;
+
+	if ((path_dup = strdup(path)) == NULL) {
+		return EXIT_FAILURE;
+	}
+	dir = dirname(path_dup);
+	if ((fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1 || fsync(fd) == -1) {
+		ret = EXIT_FAILURE;
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	free(path_dup);
+
+	return ret;
+}
+
+static int journal_file_write(const char* path, const char* data, size_t len) {
+	char* tmp_path;
+	ssize_t ret;
+	size_t written = 0;
+	int fd;
+
+	if (asprintf(&tmp_path, "%s.tmp", path) == -1) {
+		return EXIT_FAILURE;
+	}
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1) {
+		nc_verb_error("%s: opening \"%s\" failed (%s).", __func__, tmp_path, strerror(errno));
+		free(tmp_path);
+		return EXIT_FAILURE;
+	}
+
+	while (written < len) {
+		if ((ret = write(fd, data + written, len - written)) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += ret;
+	}
+
+	if (written < len || fsync(fd) == -1 || close(fd) == -1 || rename(tmp_path, path) == -1) {
+		nc_verb_error("%s: writing \"%s\" failed (%s).", __func__, tmp_path, strerror(errno));
+		if (written < len) {
+			close(fd);
+		}
+		unlink(tmp_path);
+		free(tmp_path);
+		return EXIT_FAILURE;
+	}
+	free(tmp_path);
+
+	return journal_fsync_dir(path);
+}
+
+/* write the whole datastore and drop the log it contains, return: 0 - written, 1 - error */
+static int journal_checkpoint(struct np_journal* j) {
+	xmlChar* dump = NULL;
+	char seq_str[24], *snap = NULL;
+	size_t snap_len = 0;
+	uint64_t seq;
+	int len, rotated = 0, fd;
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+
+	if (j->seq == j->checkpoint_seq) {
+		/* JOURNAL UNLOCK */
+		pthread_mutex_unlock(&j->lock);
+		return EXIT_SUCCESS;
+	}
+
+	seq = j->seq;
+	snprintf(seq_str, sizeof seq_str, "%" PRIu64, seq);
+	xmlSetProp(xmlDocGetRootElement(j->doc), BAD_CAST "journal-seq", BAD_CAST seq_str);
+	xmlDocDumpFormatMemory(j->doc, &dump, &len, 1);
+#if JOURNAL_SNAPSHOT
+	if (dump != NULL && np_snapshot_build(j->doc, np_snapshot_hash(dump, len), len, &snap, &snap_len)) {
+		nc_verb_warning("%s: building the snapshot of \"%s\" failed.", __func__, j->path);
+	}
+#endif
+
+	/*
+	 * start a new log for the records after this checkpoint, unless the previous
+	 * checkpoint failed and its log is still needed, then the records it contains
+	 * are skipped on replay by their sequence number
+	 */
+	if (dump != NULL && access(j->wal_old_path, F_OK) == -1) {
+		/* JOURNAL SYNC LOCK */
+		pthread_mutex_lock(&j->sync_lock);
+		while (j->syncing) {
+			pthread_cond_wait(&j->sync_cond, &j->sync_lock);
+		}
+
+		if (fdatasync(j->wal_fd) == 0 && rename(j->wal_path, j->wal_old_path) == 0) {
+			if ((fd = open(j->wal_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) != -1) {
+				close(j->wal_fd);
+				j->wal_fd = fd;
+				j->wal_size = 0;
+				j->synced_seq = seq;
+				rotated = 1;
+			} else if (rename(j->wal_old_path, j->wal_path) == -1) {
+				nc_verb_error("%s: restoring \"%s\" failed (%s).", __func__, j->wal_path, strerror(errno));
+			}
+		}
+		pthread_cond_broadcast(&j->sync_cond);
+
+		/* JOURNAL SYNC UNLOCK */
+		pthread_mutex_unlock(&j->sync_lock);
+	}
+
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	if (dump == NULL) {
+		nc_verb_error("%s: dumping the datastore \"%s\" failed.", __func__, j->path);
+		return EXIT_FAILURE;
+	}
+
+	if (journal_file_write(j->path, (char*)dump, len)) {
+		xmlFree(dump);
+		free(snap);
+		return EXIT_FAILURE;
+	}
+	xmlFree(dump);
+
+	/* a snapshot left from the previous checkpoint no longer matches, it is just ignored */
+	if (snap != NULL) {
+		journal_file_write(j->snap_path, snap, snap_len);
+		free(snap);
+	}
+
+	if (unlink(j->wal_old_path) == -1 && errno != ENOENT) {
+		nc_verb_warning("%s: removing \"%s\" failed (%s).", __func__, j->wal_old_path, strerror(errno));
+	}
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+	j->checkpoint_seq = seq;
+	j->checkpoint_time = time(NULL);
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	nc_verb_verbose("%s: datastore \"%s\" checkpointed at record %" PRIu64 "%s.", __func__, j->path, seq,
+			(rotated ? "" : ", the log was kept"));
+	return EXIT_SUCCESS;
+}
+
+static void* journal_checkpoint_thread(void* UNUSED(arg)) {
+	struct np_journal* j;
+	int due;
+
+	while (1) {
+		sleep(1);
+
+		/* JOURNALS LOCK */
+		pthread_mutex_lock(&journals_lock);
+
+		for (j = journals; j != NULL; j = j->next) {
+			/* JOURNAL LOCK */
+			pthread_mutex_lock(&j->lock);
+			due = (j->seq != j->checkpoint_seq && (time(NULL) - j->checkpoint_time >= JOURNAL_CHECKPOINT_INTERVAL
+					|| j->wal_size >= JOURNAL_CHECKPOINT_SIZE));
+			/* JOURNAL UNLOCK */
+			pthread_mutex_unlock(&j->lock);
+
+			if (due) {
+				journal_checkpoint(j);
+			}
+		}
+
+		/* JOURNALS UNLOCK */
+		pthread_mutex_unlock(&journals_lock);
+	}
+
+	return NULL;
+}
+
+static void journal_checkpoint_thread_start(void) {
+	pthread_t tid;
+	int ret;
+
+	if ((ret = pthread_create(&tid, NULL, journal_checkpoint_thread, NULL)) != 0) {
+		nc_verb_error("%s: failed to create a thread (%s), journal datastores are checkpointed only when closed.",
+				__func__, strerror(ret));
+		return;
+	}
+	pthread_detach(tid);
+}
+
+/* read the checkpoint, from its snapshot if it is up to date, return: document, NULL on error */
+static xmlDocPtr journal_load(struct np_journal* j) {
+	struct stat st;
+	xmlDocPtr doc = NULL;
+	void* map;
+	int fd;
+#if JOURNAL_SNAPSHOT
+	uint64_t hash;
+	char* snap;
+	size_t snap_len;
+#endif
+
+	if ((fd = open(j->path, O_RDONLY | O_CLOEXEC)) == -1 || fstat(fd, &st) == -1) {
+		nc_verb_error("%s: opening \"%s\" failed (%s).", __func__, j->path, strerror(errno));
+		if (fd != -1) {
+			close(fd);
+		}
+		return NULL;
+	}
+	if (st.st_size == 0 || (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		doc = xmlReadFd(fd, j->path, NULL, JOURNAL_PARSE_OPTS);
+		close(fd);
+		return doc;
+	}
+	close(fd);
+
+#if JOURNAL_SNAPSHOT
+	hash = np_snapshot_hash(map, st.st_size);
+	if ((doc = np_snapshot_load(j->snap_path, hash, st.st_size)) != NULL) {
+		nc_verb_verbose("%s: datastore \"%s\" loaded from its snapshot.", __func__, j->path);
+		munmap(map, st.st_size);
+		return doc;
+	}
+#endif
+
+	doc = xmlReadMemory(map, st.st_size, j->path, NULL, JOURNAL_PARSE_OPTS);
+
+#if JOURNAL_SNAPSHOT
+	/* the next start can use the snapshot even if no checkpoint is written until then */
+	if (doc != NULL && np_snapshot_build(doc, hash, st.st_size, &snap, &snap_len) == EXIT_SUCCESS) {
+		journal_file_write(j->snap_path, snap, snap_len);
+		free(snap);
+	}
+#endif
+
+	munmap(map, st.st_size);
+	return doc;
+}
+
+/*
+ * libnetconf custom datastore callbacks
+ */
+
+void* np_journal_new(const char* path) {
+	struct np_journal* j;
+
+	if ((j = calloc(1, sizeof *j)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+		return NULL;
+	}
+
+	j->wal_fd = -1;
+	if ((j->path = strdup(path)) == NULL || asprintf(&j->wal_path, "%s.journal", path) == -1) {
+		j->wal_path = NULL;
+		goto error;
+	}
+	if (asprintf(&j->wal_old_path, "%s.journal.old", path) == -1) {
+		j->wal_old_path = NULL;
+		goto error;
+	}
+	if (asprintf(&j->snap_path, "%s.snap", path) == -1) {
+		j->snap_path = NULL;
+		goto error;
+	}
+	pthread_mutex_init(&j->lock, NULL);
+	pthread_mutex_init(&j->sync_lock, NULL);
+	pthread_cond_init(&j->sync_cond, NULL);
+
+	return j;
+
+error:
+	nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+	free(j->snap_path);
+	free(j->wal_old_path);
+	free(j->wal_path);
+	free(j->path);
+	free(j);
+	return NULL;
+}
+
+static int journal_init(void* data) {
+	struct np_journal* j = (struct np_journal*)data;
+	xmlNodePtr root, node;
+	xmlNsPtr ns;
+	xmlChar* seq_str;
+	struct stat st;
+	int i;
+
+	if (j == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	/* the checkpoint, possibly a datastore of the "file" type */
+	if (access(j->path, F_OK) == 0) {
+		if ((j->doc = journal_load(j)) == NULL || (root = xmlDocGetRootElement(j->doc)) == NULL) {
+			nc_verb_error("%s: reading the datastore \"%s\" failed.", __func__, j->path);
+			return EXIT_FAILURE;
+		}
+		if ((seq_str = xmlGetProp(root, BAD_CAST "journal-seq")) != NULL) {
+			j->checkpoint_seq = strtoull((char*)seq_str, NULL, 10);
+			xmlFree(seq_str);
+		}
+	} else {
+		j->doc = xmlNewDoc(BAD_CAST "1.0");
+		root = xmlNewDocNode(j->doc, NULL, BAD_CAST "datastores", NULL);
+		xmlDocSetRootElement(j->doc, root);
+		xmlSetNs(root, xmlNewNs(root, BAD_CAST JOURNAL_NS, NULL));
+	}
+	ns = root->ns;
+
+	for (i = 0; i < JOURNAL_DS_COUNT; ++i) {
+		for (node = root->children; node != NULL; node = node->next) {
+			if (node->type == XML_ELEMENT_NODE && xmlStrEqual(node->name, BAD_CAST journal_ds_names[i])) {
+				break;
+			}
+		}
+		if (node == NULL) {
+			node = xmlNewChild(root, ns, BAD_CAST journal_ds_names[i], NULL);
+		}
+		j->ds[i] = node;
+		j->lockinfo[i].datastore = journal_ds_types[i];
+	}
+
+	/* the records not in the checkpoint */
+	j->seq = j->checkpoint_seq;
+	if (journal_replay(j, j->wal_old_path, 0) || journal_replay(j, j->wal_path, 1)) {
+		return EXIT_FAILURE;
+	}
+	j->synced_seq = j->seq;
+	j->checkpoint_time = time(NULL);
+
+	if ((j->wal_fd = open(j->wal_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) == -1) {
+		nc_verb_error("%s: opening \"%s\" failed (%s).", __func__, j->wal_path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	j->wal_size = (fstat(j->wal_fd, &st) == 0 ? st.st_size : 0);
+
+	/* JOURNALS LOCK */
+	pthread_mutex_lock(&journals_lock);
+	j->next = journals;
+	journals = j;
+	/* JOURNALS UNLOCK */
+	pthread_mutex_unlock(&journals_lock);
+
+	/* when the server starts, np_journal_start() starts it once the worker processes are forked */
+	if (!server_start) {
+		pthread_once(&checkpoint_thread_once, journal_checkpoint_thread_start);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void np_journal_start(void) {
+	int any;
+
+	/* JOURNALS LOCK */
+	pthread_mutex_lock(&journals_lock);
+	any = (journals != NULL);
+	/* JOURNALS UNLOCK */
+	pthread_mutex_unlock(&journals_lock);
+
+	if (any) {
+		pthread_once(&checkpoint_thread_once, journal_checkpoint_thread_start);
+	}
+}
+
+static void journal_free(void* data) {
+	struct np_journal* j = (struct np_journal*)data, **prev;
+	int i;
+
+	if (j == NULL) {
+		return;
+	}
+
+	/* JOURNALS LOCK */
+	pthread_mutex_lock(&journals_lock);
+	for (prev = &journals; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == j) {
+			*prev = j->next;
+			break;
+		}
+	}
+	/* JOURNALS UNLOCK */
+	pthread_mutex_unlock(&journals_lock);
+
+	if (j->wal_fd != -1) {
+		journal_checkpoint(j);
+		close(j->wal_fd);
+	}
+
+	for (i = 0; i < JOURNAL_DS_COUNT; ++i) {
+		free(j->lockinfo[i].sid);
+		free(j->lockinfo[i].time);
+	}
+	if (j->backup != NULL) {
+		xmlFreeNode(j->backup);
+	}
+	xmlFreeDoc(j->doc);
+	pthread_cond_destroy(&j->sync_cond);
+	pthread_mutex_destroy(&j->sync_lock);
+	pthread_mutex_destroy(&j->lock);
+	free(j->snap_path);
+	free(j->wal_old_path);
+	free(j->wal_path);
+	free(j->path);
+	free(j);
+}
+
+static int journal_was_changed(void* UNUSED(data)) {
+	/* nobody else writes the datastore */
+	return 0;
+}
+
+static int journal_rollback(void* data) {
+	struct np_journal* j = (struct np_journal*)data;
+	xmlNodePtr backup;
+	uint64_t seq = 0;
+	int ret = EXIT_SUCCESS;
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+
+	if (j->backup != NULL) {
+		backup = j->backup;
+		j->backup = NULL;
+		if ((ret = journal_replace(j, j->backup_idx, backup, &seq, NULL))) {
+			xmlFreeNode(backup);
+		} else {
+			/* the rolled back content is not a backup */
+			xmlFreeNode(j->backup);
+			j->backup = NULL;
+		}
+	}
+
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	if (ret == EXIT_SUCCESS && seq) {
+		ret = journal_sync(j, seq);
+	}
+	return ret;
+}
+
+static const struct ncds_lockinfo* journal_get_lockinfo(void* data, NC_DATASTORE target) {
+	struct np_journal* j = (struct np_journal*)data;
+	int idx;
+
+	if ((idx = journal_ds_idx(target)) == -1) {
+		return NULL;
+	}
+	return &j->lockinfo[idx];
+}
+
+static int journal_lock(void* data, NC_DATASTORE target, const char* session_id, struct nc_err** error) {
+	struct np_journal* j = (struct np_journal*)data;
+	int idx, ret = EXIT_SUCCESS;
+
+	if ((idx = journal_ds_idx(target)) == -1) {
+		journal_error(error, NC_ERR_OP_NOT_SUPPORTED, "Unknown datastore.");
+		return EXIT_FAILURE;
+	}
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+
+	if (j->lockinfo[idx].sid != NULL) {
+		if (error != NULL) {
+			*error = nc_err_new(NC_ERR_LOCK_DENIED);
+			nc_err_set(*error, NC_ERR_PARAM_INFO_SID, j->lockinfo[idx].sid);
+		}
+		ret = EXIT_FAILURE;
+	} else {
+		j->lockinfo[idx].sid = strdup(session_id);
+		j->lockinfo[idx].time = nc_time2datetime(time(NULL), NULL);
+	}
+
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	return ret;
+}
+
+static int journal_unlock(void* data, NC_DATASTORE target, const char* session_id, struct nc_err** error) {
+	struct np_journal* j = (struct np_journal*)data;
+	int idx, ret = EXIT_SUCCESS;
+
+	if ((idx = journal_ds_idx(target)) == -1) {
+		journal_error(error, NC_ERR_OP_NOT_SUPPORTED, "Unknown datastore.");
+		return EXIT_FAILURE;
+	}
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+
+	if (j->lockinfo[idx].sid == NULL) {
+		journal_error(error, NC_ERR_OP_FAILED, "Target datastore is not locked.");
+		ret = EXIT_FAILURE;
+	} else if (strcmp(j->lockinfo[idx].sid, session_id) != 0) {
+		if (error != NULL) {
+			*error = nc_err_new(NC_ERR_LOCK_DENIED);
+			nc_err_set(*error, NC_ERR_PARAM_INFO_SID, j->lockinfo[idx].sid);
+		}
+		ret = EXIT_FAILURE;
+	} else {
+		free(j->lockinfo[idx].sid);
+		free(j->lockinfo[idx].time);
+		j->lockinfo[idx].sid = NULL;
+		j->lockinfo[idx].time = NULL;
+	}
+
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	return ret;
+}
+
+static char* journal_getconfig(void* data, NC_DATASTORE target, struct nc_err** error) {
+	struct np_journal* j = (struct np_journal*)data;
+	xmlBufferPtr buf;
+	xmlNodePtr child;
+	char* config;
+	int idx;
+
+	if ((idx = journal_ds_idx(target)) == -1) {
+		journal_error(error, NC_ERR_OP_NOT_SUPPORTED, "Unknown datastore.");
+		return NULL;
+	}
+	if ((buf = xmlBufferCreate()) == NULL) {
+		journal_error(error, NC_ERR_OP_FAILED, "Memory allocation failed.");
+		return NULL;
+	}
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+	for (child = j->ds[idx]->children; child != NULL; child = child->next) {
+		xmlNodeDump(buf, j->doc, child, 0, 0);
+	}
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	config = strdup((char*)xmlBufferContent(buf));
+	xmlBufferFree(buf);
+
+	return config;
+}
+
+static int journal_copyconfig(void* data, NC_DATASTORE target, NC_DATASTORE source, char* config, struct nc_err** error) {
+	struct np_journal* j = (struct np_journal*)data;
+	xmlDocPtr config_doc = NULL;
+	xmlNodePtr new, child, copy;
+	char* wrapped;
+	uint64_t seq = 0;
+	int idx, src_idx = -1, len, ret;
+
+	if ((idx = journal_ds_idx(target)) == -1 || (source != NC_DATASTORE_CONFIG && (src_idx = journal_ds_idx(source)) == -1)) {
+		journal_error(error, NC_ERR_OP_NOT_SUPPORTED, "Unknown datastore.");
+		return EXIT_FAILURE;
+	}
+	if (idx == src_idx) {
+		return EXIT_SUCCESS;
+	}
+
+	/* parse the new content before taking the lock */
+	if (source == NC_DATASTORE_CONFIG) {
+		if ((len = asprintf(&wrapped, "<config>%s</config>", (config ? config : ""))) == -1) {
+			journal_error(error, NC_ERR_OP_FAILED, "Memory allocation failed.");
+			return EXIT_FAILURE;
+		}
+		config_doc = xmlReadMemory(wrapped, len, NULL, NULL, JOURNAL_PARSE_OPTS);
+		free(wrapped);
+		if (config_doc == NULL) {
+			journal_error(error, NC_ERR_OP_FAILED, "Invalid configuration data.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* JOURNAL LOCK */
+	pthread_mutex_lock(&j->lock);
+
+	if (config_doc != NULL) {
+		new = xmlNewDocNode(j->doc, j->ds[idx]->ns, BAD_CAST journal_ds_names[idx], NULL);
+		for (child = xmlDocGetRootElement(config_doc)->children; new != NULL && child != NULL; child = child->next) {
+			if ((copy = xmlDocCopyNode(child, j->doc, 1)) == NULL) {
+				xmlFreeNode(new);
+				new = NULL;
+				break;
+			}
+			xmlAddChild(new, copy);
+		}
+	} else if ((new = xmlDocCopyNode(j->ds[src_idx], j->doc, 1)) != NULL) {
+		xmlNodeSetName(new, BAD_CAST journal_ds_names[idx]);
+	}
+
+	if (new == NULL) {
+		journal_error(error, NC_ERR_OP_FAILED, "Memory allocation failed.");
+		ret = EXIT_FAILURE;
+	} else if ((ret = journal_replace(j, idx, new, &seq, error))) {
+		xmlFreeNode(new);
+	}
+
+	/* JOURNAL UNLOCK */
+	pthread_mutex_unlock(&j->lock);
+
+	xmlFreeDoc(config_doc);
+
+	if (ret == EXIT_SUCCESS && seq && journal_sync(j, seq)) {
+		journal_error(error, NC_ERR_OP_FAILED, "Synchronizing the datastore journal failed.");
+		ret = EXIT_FAILURE;
+	}
+	return ret;
+}
+
+static int journal_deleteconfig(void* data, NC_DATASTORE target, struct nc_err** error) {
+	if (target == NC_DATASTORE_RUNNING) {
+		journal_error(error, NC_ERR_OP_FAILED, "Cannot delete a running datastore.");
+		return EXIT_FAILURE;
+	}
+
+	return journal_copyconfig(data, target, NC_DATASTORE_CONFIG, "", error);
+}
+
+/* edit-config is left to libnetconf, which applies it to getconfig() and stores the result by copyconfig() */
+const struct ncds_custom_funcs np_journal_funcs = {
+	.init = journal_init,
+	.free = journal_free,
+	.was_changed = journal_was_changed,
+	.rollback = journal_rollback,
+	.get_lockinfo = journal_get_lockinfo,
+	.lock = journal_lock,
+	.unlock = journal_unlock,
+	.getconfig = journal_getconfig,
+	.copyconfig = journal_copyconfig,
+	.deleteconfig = journal_deleteconfig,
+	.editconfig = NULL
+};
@@ -0,0 +1,66 @@
+/**
+ * @file datastore_journal.h
+ * @brief Netopeer journaled in-memory datastore header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _DATASTORE_JOURNAL_H_
+#define _DATASTORE_JOURNAL_H_
+
+#include <libnetconf.h>
+
+/**
+ * @brief Callbacks of the "journal" repo type, a libnetconf custom datastore
+ * kept in memory, with every change appended to a write-ahead log next to the
+ * checkpoint file and the checkpoint periodically rewritten in the format of
+ * the "file" repo type.
+ */
+extern const struct ncds_custom_funcs np_journal_funcs;
+
+/**
+ * @brief Create the private data of a journal datastore
+ *
+ * @param path Path of the checkpoint file, the log is "<path>.journal"
+ *
+ * @return Data for ncds_custom_set_data(), NULL on error
+ */
+void* np_journal_new(const char* path);
+
+/**
+ * @brief Start the checkpoint thread of the journals initialized while the
+ * server was starting, only after the worker processes are forked
+ */
+void np_journal_start(void);
+
+#endif /* _DATASTORE_JOURNAL_H_ */
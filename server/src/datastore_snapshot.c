@@ -0,0 +1,592 @@
+/**
+ * @file datastore_snapshot.c
+ * @brief Netopeer binary datastore snapshot
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <libxml/dict.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "datastore_snapshot.h"
+
+/*
+ * A snapshot is a header followed by the body, the string table and the tree:
+ *
+ *   strings   every distinct name, namespace, and value once, each
+ *             terminated by a NUL byte, referenced by their order
+ *   tree      the document children in document order, each node as
+ *             a sequence of unsigned LEB128 numbers:
+ *
+ *     element  1 name ns-prefix+1 ns-href+1 nsdef-count (prefix+1 href)...
+ *              attr-count (name ns-prefix+1 ns-href+1 value)... child-count
+ *     text     3 content
+ *     CDATA    4 content
+ *     PI       7 name content
+ *     comment  8 content
+ *
+ *   with 0 instead of a "+1" string for none and the children following
+ *   the child count
+ *
+ * The header records the XML file the snapshot was built from, the snapshot
+ * is used only if that file did not change since.
+ */
+
+#define SNAPSHOT_MAGIC "NPSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t version;
+	uint64_t xml_size;
+	uint64_t xml_hash;
+	uint64_t body_size;
+	uint64_t body_hash;
+	uint64_t str_size;
+	uint32_t str_count;
+	uint32_t node_count;
+};
+
+/* FNV-1a over 64-bit words */
+uint64_t np_snapshot_hash(const void* data, size_t len) {
+	const unsigned char* ptr = (const unsigned char*)data;
+	uint64_t hash = 14695981039346656037ULL, word;
+	size_t i;
+
+	for (i = 0; i + sizeof word <= len; i += sizeof word) {
+		memcpy(&word, ptr + i, sizeof word);
+		hash = (hash ^ word) * 1099511628211ULL;
+		hash ^= hash >> 29;
+	}
+	for (; i < len; ++i) {
+		hash = (hash ^ ptr[i]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/*
+ * build
+ */
+
+struct snapshot_buf {
+	char* data;
+	size_t len;
+	size_t size;
+};
+
+struct snapshot_build_ctx {
+	struct snapshot_buf strs;
+	struct snapshot_buf tree;
+	uint32_t* str_offsets;	// string index -> offset in strs
+	uint32_t str_count;
+	uint32_t* str_idx;		// open addressing, string index + 1, 0 for empty
+	uint32_t str_idx_size;
+	uint32_t node_count;
+	int error;
+};
+
+static char* snapshot_buf_add(struct snapshot_build_ctx* ctx, struct snapshot_buf* buf, size_t len) {
+	char* new_data;
+	size_t new_size;
+
+	if (buf->len + len > buf->size) {
+		new_size = (buf->size ? buf->size : 65536);
+		while (new_size < buf->len + len) {
+			new_size *= 2;
+		}
+		if ((new_data = realloc(buf->data, new_size)) == NULL) {
+			ctx->error = 1;
+			return NULL;
+		}
+		buf->data = new_data;
+		buf->size = new_size;
+	}
+
+	buf->len += len;
+	return buf->data + buf->len - len;
+}
+
+static void snapshot_put(struct snapshot_build_ctx* ctx, uint32_t val) {
+	char* ptr;
+
+	if ((ptr = snapshot_buf_add(ctx, &ctx->tree, 5)) == NULL) {
+		return;
+	}
+	while (val >= 0x80) {
+		*(ptr++) = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	*(ptr++) = val;
+	ctx->tree.len = ptr - ctx->tree.data;
+}
+
+/* return: 0 - resized, 1 - error */
+static int snapshot_str_idx_grow(struct snapshot_build_ctx* ctx) {
+	uint32_t* new_idx, *new_offsets, new_size, i, pos;
+	const char* str;
+
+	new_size = (ctx->str_idx_size ? 2*ctx->str_idx_size : 4096);
+	if ((new_idx = calloc(new_size, sizeof *new_idx)) == NULL) {
+		return 1;
+	}
+	if ((new_offsets = realloc(ctx->str_offsets, (new_size / 2) * sizeof *new_offsets)) == NULL) {
+		free(new_idx);
+		return 1;
+	}
+	ctx->str_offsets = new_offsets;
+
+	for (i = 0; i < ctx->str_count; ++i) {
+		str = ctx->strs.data + ctx->str_offsets[i];
+		for (pos = np_snapshot_hash(str, strlen(str)) & (new_size - 1); new_idx[pos]; pos = (pos + 1) & (new_size - 1));
+		new_idx[pos] = i + 1;
+	}
+	free(ctx->str_idx);
+	ctx->str_idx = new_idx;
+	ctx->str_idx_size = new_size;
+
+	return 0;
+}
+
+/* write the string table index of str, or of "" for NULL, optional strings are shifted by one and 0 means none */
+static void snapshot_put_str(struct snapshot_build_ctx* ctx, const xmlChar* str, int optional) {
+	size_t len;
+	uint32_t pos, idx;
+	char* copy;
+
+	if (str == NULL) {
+		if (optional) {
+			snapshot_put(ctx, 0);
+			return;
+		}
+		str = BAD_CAST "";
+	}
+
+	if (ctx->str_count >= ctx->str_idx_size / 2 && snapshot_str_idx_grow(ctx)) {
+		ctx->error = 1;
+		return;
+	}
+
+	len = strlen((const char*)str);
+	for (pos = np_snapshot_hash(str, len) & (ctx->str_idx_size - 1); (idx = ctx->str_idx[pos]); pos = (pos + 1) & (ctx->str_idx_size - 1)) {
+		if (strcmp(ctx->strs.data + ctx->str_offsets[idx - 1], (const char*)str) == 0) {
+			break;
+		}
+	}
+
+	if (idx == 0) {
+		if (ctx->strs.len + len + 1 > UINT32_MAX || (copy = snapshot_buf_add(ctx, &ctx->strs, len + 1)) == NULL) {
+			ctx->error = 1;
+			return;
+		}
+		memcpy(copy, str, len + 1);
+		ctx->str_offsets[ctx->str_count] = copy - ctx->strs.data;
+		idx = ++ctx->str_count;
+		ctx->str_idx[pos] = idx;
+	}
+
+	snapshot_put(ctx, (optional ? idx : idx - 1));
+}
+
+static void snapshot_build_node(struct snapshot_build_ctx* ctx, xmlNodePtr node) {
+	xmlNsPtr ns;
+	xmlAttrPtr prop;
+	xmlNodePtr child;
+	xmlChar* value;
+	uint32_t count;
+
+	++ctx->node_count;
+	snapshot_put(ctx, node->type);
+
+	switch (node->type) {
+	case XML_ELEMENT_NODE:
+		break;
+	case XML_PI_NODE:
+		snapshot_put_str(ctx, node->name, 0);
+		/* fallthrough */
+	case XML_TEXT_NODE:
+	case XML_CDATA_SECTION_NODE:
+	case XML_COMMENT_NODE:
+		snapshot_put_str(ctx, node->content, 0);
+		return;
+	default:
+		nc_verb_verbose("%s: node type %d cannot be stored in a snapshot.", __func__, node->type);
+		ctx->error = 1;
+		return;
+	}
+
+	snapshot_put_str(ctx, node->name, 0);
+	snapshot_put_str(ctx, (node->ns != NULL ? node->ns->prefix : NULL), 1);
+	snapshot_put_str(ctx, (node->ns != NULL ? node->ns->href : NULL), 1);
+
+	for (count = 0, ns = node->nsDef; ns != NULL; ns = ns->next, ++count);
+	snapshot_put(ctx, count);
+	for (ns = node->nsDef; ns != NULL; ns = ns->next) {
+		snapshot_put_str(ctx, ns->prefix, 1);
+		snapshot_put_str(ctx, ns->href, 0);
+	}
+
+	for (count = 0, prop = node->properties; prop != NULL; prop = prop->next, ++count);
+	snapshot_put(ctx, count);
+	for (prop = node->properties; prop != NULL; prop = prop->next) {
+		snapshot_put_str(ctx, prop->name, 0);
+		snapshot_put_str(ctx, (prop->ns != NULL ? prop->ns->prefix : NULL), 1);
+		snapshot_put_str(ctx, (prop->ns != NULL ? prop->ns->href : NULL), 1);
+		if (prop->children != NULL && prop->children->type == XML_TEXT_NODE && prop->children->next == NULL) {
+			snapshot_put_str(ctx, prop->children->content, 0);
+		} else {
+			value = xmlNodeGetContent((xmlNodePtr)prop);
+			snapshot_put_str(ctx, value, 0);
+			xmlFree(value);
+		}
+	}
+
+	for (count = 0, child = node->children; child != NULL; child = child->next, ++count);
+	snapshot_put(ctx, count);
+	for (child = node->children; child != NULL && !ctx->error; child = child->next) {
+		snapshot_build_node(ctx, child);
+	}
+}
+
+int np_snapshot_build(xmlDocPtr doc, uint64_t xml_hash, uint64_t xml_size, char** data, size_t* len) {
+	struct snapshot_build_ctx ctx;
+	struct snapshot_header* header;
+	xmlNodePtr node;
+	uint32_t count;
+	int ret = EXIT_FAILURE;
+
+	memset(&ctx, 0, sizeof ctx);
+	for (count = 0, node = doc->children; node != NULL; node = node->next, ++count);
+	snapshot_put(&ctx, count);
+	for (node = doc->children; node != NULL && !ctx.error; node = node->next) {
+		snapshot_build_node(&ctx, node);
+	}
+	if (ctx.error) {
+		goto cleanup;
+	}
+
+	*len = sizeof *header + ctx.strs.len + ctx.tree.len;
+	if ((*data = malloc(*len)) == NULL) {
+		goto cleanup;
+	}
+	header = (struct snapshot_header*)*data;
+	memset(header, 0, sizeof *header);
+	memcpy(header->magic, SNAPSHOT_MAGIC, sizeof header->magic);
+	header->byte_order = SNAPSHOT_BYTE_ORDER;
+	header->version = SNAPSHOT_VERSION;
+	header->xml_size = xml_size;
+	header->xml_hash = xml_hash;
+	header->body_size = ctx.strs.len + ctx.tree.len;
+	header->str_size = ctx.strs.len;
+	header->str_count = ctx.str_count;
+	header->node_count = ctx.node_count;
+	if (ctx.strs.len) {
+		memcpy(*data + sizeof *header, ctx.strs.data, ctx.strs.len);
+	}
+	memcpy(*data + sizeof *header + ctx.strs.len, ctx.tree.data, ctx.tree.len);
+	header->body_hash = np_snapshot_hash(*data + sizeof *header, header->body_size);
+	ret = EXIT_SUCCESS;
+
+cleanup:
+	free(ctx.strs.data);
+	free(ctx.tree.data);
+	free(ctx.str_offsets);
+	free(ctx.str_idx);
+	return ret;
+}
+
+/*
+ * load
+ */
+
+struct snapshot_load_ctx {
+	xmlDocPtr doc;
+	const unsigned char* tree;
+	const unsigned char* tree_end;
+	const char** strs;		// string index -> string in the mapping
+	uint32_t* str_lens;
+	const xmlChar** dict_strs;	// strings already in the document dictionary
+	uint32_t str_count;
+	uint32_t nodes_left;
+	int error;
+};
+
+static uint32_t snapshot_get(struct snapshot_load_ctx* ctx) {
+	uint32_t val = 0;
+	int shift;
+
+	for (shift = 0; ctx->tree < ctx->tree_end && shift < 35; shift += 7) {
+		val |= (uint32_t)(*ctx->tree & 0x7f) << shift;
+		if (!(*(ctx->tree++) & 0x80)) {
+			return val;
+		}
+	}
+
+	ctx->error = 1;
+	return 0;
+}
+
+/* read a string table index, for optional strings return UINT32_MAX for none */
+static uint32_t snapshot_get_str(struct snapshot_load_ctx* ctx, int optional) {
+	uint32_t idx = snapshot_get(ctx);
+
+	if (optional) {
+		if (idx == 0) {
+			return UINT32_MAX;
+		}
+		--idx;
+	}
+	if (idx >= ctx->str_count) {
+		ctx->error = 1;
+		return 0;
+	}
+	return idx;
+}
+
+static const xmlChar* snapshot_str(struct snapshot_load_ctx* ctx, uint32_t idx) {
+	return (idx == UINT32_MAX ? NULL : BAD_CAST ctx->strs[idx]);
+}
+
+static const xmlChar* snapshot_dict_str(struct snapshot_load_ctx* ctx, uint32_t idx) {
+	if (ctx->dict_strs[idx] == NULL) {
+		ctx->dict_strs[idx] = xmlDictLookup(ctx->doc->dict, BAD_CAST ctx->strs[idx], ctx->str_lens[idx]);
+	}
+	return ctx->dict_strs[idx];
+}
+
+/* the namespace in scope of node with both the prefix and href */
+static xmlNsPtr snapshot_ns(struct snapshot_load_ctx* ctx, xmlNodePtr node, uint32_t prefix, uint32_t href) {
+	xmlNsPtr ns;
+
+	if (href == UINT32_MAX) {
+		return NULL;
+	}
+	/* mostly the namespace of the parent */
+	if (node->parent != NULL && node->parent->type == XML_ELEMENT_NODE && (ns = node->parent->ns) != NULL && node->nsDef == NULL
+			&& xmlStrEqual(ns->prefix, snapshot_str(ctx, prefix)) && xmlStrEqual(ns->href, snapshot_str(ctx, href))) {
+		return ns;
+	}
+	ns = xmlSearchNs(ctx->doc, node, snapshot_str(ctx, prefix));
+	if (ns == NULL || !xmlStrEqual(ns->href, snapshot_str(ctx, href))) {
+		/* declared on a node that was not stored, reconcile it here */
+		ns = xmlNewNs(node, snapshot_str(ctx, href), snapshot_str(ctx, prefix));
+	}
+	return ns;
+}
+
+/* return: 0 - loaded, 1 - error */
+static int snapshot_load_children(struct snapshot_load_ctx* ctx, xmlNodePtr parent) {
+	xmlNodePtr node;
+	xmlNsPtr ns;
+	uint32_t count, type, name, prefix, href, value, i, k;
+
+	count = snapshot_get(ctx);
+	for (i = 0; i < count && !ctx->error; ++i) {
+		if (ctx->nodes_left-- == 0) {
+			return 1;
+		}
+
+		type = snapshot_get(ctx);
+		switch (type) {
+		case XML_ELEMENT_NODE:
+			name = snapshot_get_str(ctx, 0);
+			if (ctx->error) {
+				return 1;
+			}
+			node = xmlNewDocNodeEatName(ctx->doc, NULL, (xmlChar*)snapshot_dict_str(ctx, name), NULL);
+			break;
+		case XML_TEXT_NODE:
+			value = snapshot_get_str(ctx, 0);
+			node = (ctx->error ? NULL : xmlNewDocTextLen(ctx->doc, snapshot_str(ctx, value), ctx->str_lens[value]));
+			break;
+		case XML_CDATA_SECTION_NODE:
+			value = snapshot_get_str(ctx, 0);
+			node = (ctx->error ? NULL : xmlNewCDataBlock(ctx->doc, snapshot_str(ctx, value), ctx->str_lens[value]));
+			break;
+		case XML_COMMENT_NODE:
+			value = snapshot_get_str(ctx, 0);
+			node = (ctx->error ? NULL : xmlNewDocComment(ctx->doc, snapshot_str(ctx, value)));
+			break;
+		case XML_PI_NODE:
+			name = snapshot_get_str(ctx, 0);
+			value = snapshot_get_str(ctx, 0);
+			node = (ctx->error ? NULL : xmlNewDocPI(ctx->doc, snapshot_str(ctx, name), snapshot_str(ctx, value)));
+			break;
+		default:
+			return 1;
+		}
+		if (node == NULL) {
+			return 1;
+		}
+		xmlAddChild(parent, node);
+
+		if (type != XML_ELEMENT_NODE) {
+			continue;
+		}
+
+		prefix = snapshot_get_str(ctx, 1);
+		href = snapshot_get_str(ctx, 1);
+		for (k = snapshot_get(ctx); k > 0 && !ctx->error; --k) {
+			name = snapshot_get_str(ctx, 1);
+			value = snapshot_get_str(ctx, 0);
+			if (ctx->error || xmlNewNs(node, snapshot_str(ctx, value), snapshot_str(ctx, name)) == NULL) {
+				return 1;
+			}
+		}
+		xmlSetNs(node, snapshot_ns(ctx, node, prefix, href));
+
+		for (k = snapshot_get(ctx); k > 0 && !ctx->error; --k) {
+			name = snapshot_get_str(ctx, 0);
+			prefix = snapshot_get_str(ctx, 1);
+			href = snapshot_get_str(ctx, 1);
+			value = snapshot_get_str(ctx, 0);
+			if (ctx->error) {
+				return 1;
+			}
+			ns = snapshot_ns(ctx, node, prefix, href);
+			if (xmlNewNsProp(node, ns, snapshot_dict_str(ctx, name), snapshot_str(ctx, value)) == NULL) {
+				return 1;
+			}
+		}
+
+		if (ctx->error || snapshot_load_children(ctx, node)) {
+			return 1;
+		}
+	}
+
+	return ctx->error;
+}
+
+xmlDocPtr np_snapshot_load(const char* path, uint64_t xml_hash, uint64_t xml_size) {
+	struct snapshot_load_ctx ctx;
+	const struct snapshot_header* header;
+	struct stat st;
+	const char* str, *str_end, *nul;
+	void* map;
+	uint32_t i;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+		if (errno != ENOENT) {
+			nc_verb_warning("%s: opening \"%s\" failed (%s).", __func__, path, strerror(errno));
+		}
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof *header) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		nc_verb_warning("%s: mapping \"%s\" failed (%s).", __func__, path, strerror(errno));
+		return NULL;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	memset(&ctx, 0, sizeof ctx);
+	header = (const struct snapshot_header*)map;
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof header->magic) || header->byte_order != SNAPSHOT_BYTE_ORDER
+			|| header->version != SNAPSHOT_VERSION) {
+		nc_verb_verbose("%s: \"%s\" is not a snapshot of this version or byte order.", __func__, path);
+		goto error;
+	}
+	if (header->xml_size != xml_size || header->xml_hash != xml_hash) {
+		nc_verb_verbose("%s: \"%s\" was built from a different datastore content.", __func__, path);
+		goto error;
+	}
+	if (header->body_size != (uint64_t)st.st_size - sizeof *header || header->str_size > header->body_size
+			|| np_snapshot_hash((const char*)map + sizeof *header, header->body_size) != header->body_hash) {
+		nc_verb_warning("%s: \"%s\" is corrupted.", __func__, path);
+		goto error;
+	}
+
+	/* the string table */
+	ctx.str_count = header->str_count;
+	if ((ctx.strs = malloc((ctx.str_count + 1) * sizeof *ctx.strs)) == NULL
+			|| (ctx.str_lens = malloc((ctx.str_count + 1) * sizeof *ctx.str_lens)) == NULL
+			|| (ctx.dict_strs = calloc(ctx.str_count + 1, sizeof *ctx.dict_strs)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+		goto error;
+	}
+	str = (const char*)map + sizeof *header;
+	str_end = str + header->str_size;
+	for (i = 0; i < ctx.str_count; ++i) {
+		if ((nul = memchr(str, '\0', str_end - str)) == NULL) {
+			nc_verb_warning("%s: \"%s\" is corrupted.", __func__, path);
+			goto error;
+		}
+		ctx.strs[i] = str;
+		ctx.str_lens[i] = nul - str;
+		str = nul + 1;
+	}
+	ctx.tree = (const unsigned char*)str_end;
+	ctx.tree_end = (const unsigned char*)map + st.st_size;
+	ctx.nodes_left = header->node_count;
+
+	if ((ctx.doc = xmlNewDoc(BAD_CAST "1.0")) == NULL || (ctx.doc->dict = xmlDictCreate()) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+		goto error;
+	}
+	if (snapshot_load_children(&ctx, (xmlNodePtr)ctx.doc) || ctx.nodes_left || ctx.tree != ctx.tree_end) {
+		nc_verb_warning("%s: \"%s\" is corrupted.", __func__, path);
+		goto error;
+	}
+
+	free(ctx.strs);
+	free(ctx.str_lens);
+	free(ctx.dict_strs);
+	munmap(map, st.st_size);
+	return ctx.doc;
+
+error:
+	if (ctx.doc != NULL) {
+		xmlFreeDoc(ctx.doc);
+	}
+	free(ctx.strs);
+	free(ctx.str_lens);
+	free(ctx.dict_strs);
+	munmap(map, st.st_size);
+	return NULL;
+}
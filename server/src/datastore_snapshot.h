@@ -0,0 +1,80 @@
+/**
+ * @file datastore_snapshot.h
+ * @brief Netopeer binary datastore snapshot header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _DATASTORE_SNAPSHOT_H_
+#define _DATASTORE_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libxml/tree.h>
+
+/**
+ * @brief Checksum used for the snapshot and for the XML file it was built from
+ *
+ * @param data Data to hash
+ * @param len Length of data
+ *
+ * @return 64-bit hash
+ */
+uint64_t np_snapshot_hash(const void* data, size_t len);
+
+/**
+ * @brief Serialize a document into the binary snapshot format
+ *
+ * @param doc Document to serialize
+ * @param xml_hash np_snapshot_hash() of the XML file holding the same content
+ * @param xml_size Size of the XML file
+ * @param data Snapshot, to be freed by the caller
+ * @param len Length of data
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int np_snapshot_build(xmlDocPtr doc, uint64_t xml_hash, uint64_t xml_size, char** data, size_t* len);
+
+/**
+ * @brief Load a snapshot file if it is intact and was built from the given XML
+ *
+ * @param path Snapshot file
+ * @param xml_hash np_snapshot_hash() of the current XML file
+ * @param xml_size Size of the current XML file
+ *
+ * @return Document equal to parsing the XML file, NULL if the snapshot is
+ * missing, stale, or corrupted
+ */
+xmlDocPtr np_snapshot_load(const char* path, uint64_t xml_hash, uint64_t xml_size);
+
+#endif /* _DATASTORE_SNAPSHOT_H_ */
@@ -0,0 +1,491 @@
+/**
+ * @file event.c
+ * @brief Netopeer socket event backends (epoll, io_uring)
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#ifdef NP_IO_URING
+#	include <liburing.h>
+#endif
+
+#include "server.h"
+#include "event.h"
+
+/* the highest bits of the data mark the events of the listening sockets and of the cancelled operations */
+#define EVENT_LISTEN (1ULL << 63)
+#define EVENT_CANCEL (1ULL << 62)
+#define EVENT_DATA_MASK (EVENT_CANCEL - 1)
+
+struct np_event_listener {
+	int fd;
+	uint64_t data;
+	int accepting;					/**< io_uring accept in flight */
+	int cancelling;					/**< cancel of the accept in flight submitted */
+	struct sockaddr_storage saddr;	/**< peer of the accept in flight */
+	socklen_t saddr_len;
+};
+
+struct np_event {
+	enum np_event_backend backend;
+	int epoll_fd;
+#ifdef NP_IO_URING
+	struct io_uring ring;
+#endif
+	/* the io_uring accepts keep pointers to them, so they are never moved */
+	struct np_event_listener** listeners;
+	unsigned int listener_count;
+};
+
+#ifdef NP_IO_URING
+
+static struct io_uring_sqe* uring_sqe(struct np_event* ev) {
+	struct io_uring_sqe* sqe;
+
+	if ((sqe = io_uring_get_sqe(&ev->ring)) == NULL) {
+		/* the submission queue is full, flush it */
+		io_uring_submit(&ev->ring);
+		sqe = io_uring_get_sqe(&ev->ring);
+	}
+	if (sqe == NULL) {
+		nc_verb_error("%s: io_uring submission queue full", __func__);
+	}
+
+	return sqe;
+}
+
+/* return: 0 - submitted, 1 - failed */
+static int uring_accept(struct np_event* ev, unsigned int idx) {
+	struct np_event_listener* listener = ev->listeners[idx];
+	struct io_uring_sqe* sqe;
+
+	if ((sqe = uring_sqe(ev)) == NULL) {
+		return 1;
+	}
+	listener->saddr_len = sizeof listener->saddr;
+	io_uring_prep_accept(sqe, listener->fd, (struct sockaddr*)&listener->saddr, &listener->saddr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	io_uring_sqe_set_data64(sqe, EVENT_LISTEN | idx);
+	listener->accepting = 1;
+
+	return 0;
+}
+
+static int uring_wait(struct np_event* ev, struct np_event_res* res, int max, int timeout) {
+	struct __kernel_timespec ts;
+	struct io_uring_cqe* cqe;
+	struct np_event_listener* listener;
+	unsigned int head, seen = 0;
+	uint64_t data;
+	int ret, count = 0;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	/* the queued registrations are submitted by the same system call */
+	ret = io_uring_submit_and_wait_timeout(&ev->ring, &cqe, 1, (timeout < 0 ? NULL : &ts), NULL);
+	if (ret == -ETIME || ret == -EINTR) {
+		return 0;
+	}
+	if (ret < 0) {
+		nc_verb_error("%s: io_uring wait failed (%s)", __func__, strerror(-ret));
+		return -1;
+	}
+
+	io_uring_for_each_cqe(&ev->ring, head, cqe) {
+		if (count == max) {
+			break;
+		}
+		++seen;
+		data = io_uring_cqe_get_data64(cqe);
+
+		if (data & EVENT_CANCEL) {
+			/* completion of an np_event_unwatch() */
+			continue;
+		}
+
+		if (data & EVENT_LISTEN) {
+			listener = ev->listeners[data & EVENT_DATA_MASK];
+			listener->accepting = 0;
+			if (cqe->res >= 0) {
+				res[count].data = listener->data;
+				res[count].fd = cqe->res;
+				memcpy(&res[count].saddr, &listener->saddr, sizeof listener->saddr);
+				++count;
+			} else if (cqe->res != -ECANCELED) {
+				nc_verb_error("%s: accept failed (%s)", __func__, strerror(-cqe->res));
+			}
+			if (cqe->res != -ECANCELED) {
+				uring_accept(ev, data & EVENT_DATA_MASK);
+			}
+			continue;
+		}
+
+		/* a poll of a watched socket, those removed by np_event_unwatch() are cancelled */
+		if (cqe->res != -ECANCELED) {
+			res[count].data = data;
+			res[count].fd = -1;
+			++count;
+		}
+	}
+	io_uring_cq_advance(&ev->ring, seen);
+
+	return count;
+}
+
+/* return: number of the accepts still in flight */
+static unsigned int uring_accepting(const struct np_event* ev) {
+	unsigned int i, accepting = 0;
+
+	for (i = 0; i < ev->listener_count; ++i) {
+		accepting += (ev->listeners[i]->accepting ? 1 : 0);
+	}
+
+	return accepting;
+}
+
+static int uring_cancel(struct np_event* ev, struct np_event_res* res, int max) {
+	struct __kernel_timespec ts = {.tv_sec = 0, .tv_nsec = 100000000};
+	struct np_event_listener* listener;
+	struct io_uring_sqe* sqe;
+	struct io_uring_cqe* cqe;
+	unsigned int i, head, seen, tries;
+	uint64_t data;
+	int count = 0;
+
+	/* a connection may be accepted before the cancel, it is returned */
+	for (i = 0; i < ev->listener_count; ++i) {
+		listener = ev->listeners[i];
+		if (listener->accepting && !listener->cancelling && (sqe = uring_sqe(ev)) != NULL) {
+			io_uring_prep_cancel64(sqe, EVENT_LISTEN | i, 0);
+			io_uring_sqe_set_data64(sqe, EVENT_CANCEL);
+			listener->cancelling = 1;
+		}
+	}
+
+	for (tries = 0; count < max && uring_accepting(ev) && tries < 10; ++tries) {
+		if (io_uring_submit_and_wait_timeout(&ev->ring, &cqe, 1, &ts, NULL) < 0) {
+			continue;
+		}
+
+		seen = 0;
+		io_uring_for_each_cqe(&ev->ring, head, cqe) {
+			if (count == max) {
+				break;
+			}
+			++seen;
+			data = io_uring_cqe_get_data64(cqe);
+			if (!(data & EVENT_LISTEN) || (data & EVENT_CANCEL)) {
+				/* the polls of the watched sockets are just dropped */
+				continue;
+			}
+			listener = ev->listeners[data & EVENT_DATA_MASK];
+			listener->accepting = 0;
+			if (cqe->res >= 0) {
+				res[count].data = listener->data;
+				res[count].fd = cqe->res;
+				memcpy(&res[count].saddr, &listener->saddr, sizeof listener->saddr);
+				++count;
+			}
+		}
+		io_uring_cq_advance(&ev->ring, seen);
+	}
+
+	return count;
+}
+
+static void uring_free(struct np_event* ev) {
+	struct np_event_res res[EVENT_BATCH];
+	int i, count;
+
+	/* the connections the caller did not take by np_event_cancel() must not leak */
+	while ((count = uring_cancel(ev, res, EVENT_BATCH)) > 0) {
+		for (i = 0; i < count; ++i) {
+			close(res[i].fd);
+		}
+	}
+
+	io_uring_queue_exit(&ev->ring);
+}
+
+/* return: 0 - initialized, 1 - not supported */
+static int uring_init(struct np_event* ev) {
+	struct io_uring_params params;
+	int ret;
+
+	memset(&params, 0, sizeof params);
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = EVENT_URING_CQ_SIZE;
+
+	if ((ret = io_uring_queue_init_params(EVENT_URING_SQ_SIZE, &ev->ring, &params)) < 0) {
+		nc_verb_warning("io_uring initialization failed (%s), using epoll.", strerror(-ret));
+		return 1;
+	}
+
+	/* every watched socket has a poll in flight, more of them may complete than the completion queue holds */
+	if (!(params.features & IORING_FEAT_NODROP)) {
+		nc_verb_warning("io_uring of this kernel may drop completions, using epoll.");
+		io_uring_queue_exit(&ev->ring);
+		return 1;
+	}
+
+	return 0;
+}
+
+#endif /* NP_IO_URING */
+
+static int epoll_wait_events(struct np_event* ev, struct np_event_res* res, int max, int timeout) {
+	struct epoll_event events[EVENT_BATCH];
+	struct np_event_listener* listener;
+	socklen_t saddr_len;
+	int ret, i, count = 0;
+
+	if ((ret = epoll_wait(ev->epoll_fd, events, (max < EVENT_BATCH ? max : EVENT_BATCH), timeout)) == -1) {
+		if (errno == EINTR) {
+			return 0;
+		}
+		nc_verb_error("%s: epoll_wait failed (%s)", __func__, strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < ret; ++i) {
+		if (!(events[i].data.u64 & EVENT_LISTEN)) {
+			res[count].data = events[i].data.u64;
+			res[count].fd = -1;
+			++count;
+			continue;
+		}
+
+		listener = ev->listeners[events[i].data.u64 & EVENT_DATA_MASK];
+		saddr_len = sizeof res[count].saddr;
+		res[count].fd = accept4(listener->fd, (struct sockaddr*)&res[count].saddr, &saddr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (res[count].fd == -1) {
+			/* the connection may have been reset meanwhile */
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+				nc_verb_error("%s: accept failed (%s)", __func__, strerror(errno));
+			}
+			continue;
+		}
+		res[count].data = listener->data;
+		++count;
+	}
+
+	return count;
+}
+
+struct np_event* np_event_new(enum np_event_backend backend) {
+	struct np_event* ev;
+
+	if ((ev = calloc(1, sizeof *ev)) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		return NULL;
+	}
+	ev->epoll_fd = -1;
+
+	if (backend == NP_EVENT_IO_URING) {
+#ifdef NP_IO_URING
+		if (uring_init(ev) == 0) {
+			ev->backend = NP_EVENT_IO_URING;
+			return ev;
+		}
+#else
+		nc_verb_warning("io_uring is not supported by this build of the server, using epoll.");
+#endif
+	}
+
+	if ((ev->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		nc_verb_error("%s: epoll_create1 failed (%s)", __func__, strerror(errno));
+		free(ev);
+		return NULL;
+	}
+	ev->backend = NP_EVENT_EPOLL;
+
+	return ev;
+}
+
+enum np_event_backend np_event_backend_get(const struct np_event* ev) {
+	return ev->backend;
+}
+
+int np_event_listen(struct np_event* ev, int fd, uint64_t data) {
+	struct np_event_listener** new_listeners, *listener;
+	struct epoll_event event;
+
+	if ((listener = calloc(1, sizeof *listener)) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		return EXIT_FAILURE;
+	}
+	if ((new_listeners = realloc(ev->listeners, (ev->listener_count + 1) * sizeof *ev->listeners)) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		free(listener);
+		return EXIT_FAILURE;
+	}
+	ev->listeners = new_listeners;
+	listener->fd = fd;
+	listener->data = data;
+	ev->listeners[ev->listener_count] = listener;
+
+#ifdef NP_IO_URING
+	if (ev->backend == NP_EVENT_IO_URING) {
+		if (uring_accept(ev, ev->listener_count)) {
+			free(listener);
+			return EXIT_FAILURE;
+		}
+		++ev->listener_count;
+		return EXIT_SUCCESS;
+	}
+#endif
+
+	/* level-triggered, every wait accepts at most one connection per ready socket */
+	event.events = EPOLLIN;
+	event.data.u64 = EVENT_LISTEN | ev->listener_count;
+	if (epoll_ctl(ev->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		nc_verb_error("%s: epoll_ctl failed (%s)", __func__, strerror(errno));
+		free(listener);
+		return EXIT_FAILURE;
+	}
+	++ev->listener_count;
+
+	return EXIT_SUCCESS;
+}
+
+int np_event_watch(struct np_event* ev, int fd, short events, uint64_t data) {
+	struct epoll_event event;
+#ifdef NP_IO_URING
+	struct io_uring_sqe* sqe;
+
+	if (ev->backend == NP_EVENT_IO_URING) {
+		if ((sqe = uring_sqe(ev)) == NULL) {
+			return EXIT_FAILURE;
+		}
+		io_uring_prep_poll_add(sqe, fd, events);
+		io_uring_sqe_set_data64(sqe, data);
+		return EXIT_SUCCESS;
+	}
+#endif
+
+	/* a oneshot socket stays registered after its event, it is only rearmed */
+	event.events = (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0) | EPOLLONESHOT;
+	event.data.u64 = data;
+	if (epoll_ctl(ev->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1 &&
+			(errno != EEXIST || epoll_ctl(ev->epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)) {
+		nc_verb_error("%s: epoll_ctl failed (%s)", __func__, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void np_event_unwatch(struct np_event* ev, int fd, uint64_t data) {
+#ifdef NP_IO_URING
+	struct io_uring_sqe* sqe;
+
+	if (ev->backend == NP_EVENT_IO_URING) {
+		/* the poll holds a reference of the socket, it is removed even if it completed */
+		if ((sqe = uring_sqe(ev)) != NULL) {
+			io_uring_prep_poll_remove(sqe, data);
+			io_uring_sqe_set_data64(sqe, EVENT_CANCEL);
+		}
+		return;
+	}
+#else
+	(void)data;
+#endif
+
+	if (epoll_ctl(ev->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1 && errno != ENOENT && errno != EBADF) {
+		nc_verb_error("%s: epoll_ctl failed (%s)", __func__, strerror(errno));
+	}
+}
+
+int np_event_wait(struct np_event* ev, struct np_event_res* res, int max, int timeout) {
+#ifdef NP_IO_URING
+	if (ev->backend == NP_EVENT_IO_URING) {
+		return uring_wait(ev, res, max, timeout);
+	}
+#endif
+
+	return epoll_wait_events(ev, res, max, timeout);
+}
+
+int np_event_cancel(struct np_event* ev, struct np_event_res* res, int max) {
+	if (ev == NULL) {
+		return 0;
+	}
+
+#ifdef NP_IO_URING
+	if (ev->backend == NP_EVENT_IO_URING) {
+		return uring_cancel(ev, res, max);
+	}
+#else
+	(void)res;
+	(void)max;
+#endif
+
+	/* epoll accepts only in np_event_wait() */
+	return 0;
+}
+
+void np_event_free(struct np_event* ev) {
+	unsigned int i;
+
+	if (ev == NULL) {
+		return;
+	}
+
+#ifdef NP_IO_URING
+	if (ev->backend == NP_EVENT_IO_URING) {
+		uring_free(ev);
+	}
+#endif
+	if (ev->epoll_fd != -1) {
+		close(ev->epoll_fd);
+	}
+
+	for (i = 0; i < ev->listener_count; ++i) {
+		free(ev->listeners[i]);
+	}
+	free(ev->listeners);
+	free(ev);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file event.h
+ * @brief Netopeer socket event backends header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+
+#ifndef _EVENT_H_
+#define _EVENT_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/* the values of /netopeer/io-backend */
+enum np_event_backend {
+	NP_EVENT_EPOLL,
+	NP_EVENT_IO_URING
+};
+
+/* registered sockets waited on by a single thread */
+struct np_event;
+
+/* a listening socket accepted a connection or a watched socket became readable */
+struct np_event_res {
+	uint64_t data;					/**< as registered */
+	int fd;							/**< accepted socket, -1 for a watched socket */
+	struct sockaddr_storage saddr;	/**< peer of the accepted socket */
+};
+
+/**
+ * @brief Create an event set, the io_uring backend falls back to epoll if it
+ * was not compiled in or the kernel does not support it
+ *
+ * @param backend Requested backend
+ *
+ * @return Event set or NULL
+ */
+struct np_event* np_event_new(enum np_event_backend backend);
+
+/**
+ * @brief Get the backend an event set actually uses
+ *
+ * @param ev Event set
+ *
+ * @return Backend
+ */
+enum np_event_backend np_event_backend_get(const struct np_event* ev);
+
+/**
+ * @brief Accept connections on a listening socket until the event set is freed,
+ * they are returned non-blocking and close-on-exec, failed accepts are only logged
+ *
+ * @param ev Event set
+ * @param fd Listening socket, must not be closed before the event set is freed
+ * @param data Returned with every connection, the 2 highest bits must be zero
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int np_event_listen(struct np_event* ev, int fd, uint64_t data);
+
+/**
+ * @brief Wait for a socket to become readable or writable, returned only once,
+ * a socket whose event was returned can be watched again with the same data
+ *
+ * @param ev Event set
+ * @param fd Socket, must not be closed before np_event_unwatch()
+ * @param events POLLIN or POLLOUT
+ * @param data Returned with the event, unique among the watched sockets, the
+ * 2 highest bits must be zero
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int np_event_watch(struct np_event* ev, int fd, short events, uint64_t data);
+
+/**
+ * @brief Stop watching a socket, whether its event was returned or not,
+ * an event of it already pending may still be returned by the next np_event_wait()
+ *
+ * @param ev Event set
+ * @param fd Watched socket
+ * @param data Data it was watched with
+ */
+void np_event_unwatch(struct np_event* ev, int fd, uint64_t data);
+
+/**
+ * @brief Submit the queued (un)registrations and wait for events
+ *
+ * @param ev Event set
+ * @param res Array for the events
+ * @param max Size of res
+ * @param timeout Milliseconds, -1 for infinite
+ *
+ * @return Number of events, 0 on timeout or interrupt, -1 on error
+ */
+int np_event_wait(struct np_event* ev, struct np_event_res* res, int max, int timeout);
+
+/**
+ * @brief Cancel the accepts in flight of an event set that is going to be freed,
+ * no more connections are accepted by it
+ *
+ * @param ev Event set, NULL is ignored
+ * @param res Array for the connections accepted before the cancel
+ * @param max Size of res, the function is called again while it returns max
+ *
+ * @return Number of the accepted connections
+ */
+int np_event_cancel(struct np_event* ev, struct np_event_res* res, int max);
+
+/**
+ * @brief Free an event set, the connections accepted meanwhile and not taken
+ * by np_event_cancel() are closed
+ *
+ * @param ev Event set, NULL is ignored
+ */
+void np_event_free(struct np_event* ev);
+
+#endif /* _EVENT_H_ */
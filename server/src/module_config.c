@@ -0,0 +1,477 @@
+/**
+ * @file module_config.c
+ * @brief Netopeer cache of the module configuration files
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <libxml/parser.h>
+#include <libxml/xmlreader.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "server.h"
+#include "module_config.h"
+
+#define MODULE_CFG_SUFFIX ".xml"
+#define MODULE_CFG_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*
+ * The files are read once and then only when inotify reports a change of
+ * them, the changed entries are just dropped from the cache and read again
+ * by the next module_cfg_get(). Without inotify, every call reads the file.
+ */
+static struct {
+	pthread_mutex_t lock;
+	int inotify_fd;
+	struct np_module_cfg* cfgs;
+} module_cfgs = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.inotify_fd = -1,
+	.cfgs = NULL
+};
+
+/* MODULES_CFG_DIR, unless overridden by the environment (a test or benchmark run) */
+static const char* module_cfg_dir(void) {
+	static const char* dir = NULL;
+
+	if (dir == NULL && ((dir = getenv(ENVIRONMENT_MODULES_CFG_DIR)) == NULL || dir[0] == '\0')) {
+		dir = MODULES_CFG_DIR;
+	}
+	return dir;
+}
+
+static void module_cfg_free(struct np_module_cfg* cfg) {
+	unsigned int i, j;
+
+	for (i = 0; i < cfg->model_count; ++i) {
+		free(cfg->models[i].path);
+		free(cfg->models[i].transapi);
+		for (j = 0; j < cfg->models[i].feature_count; ++j) {
+			free(cfg->models[i].features[j]);
+		}
+		free(cfg->models[i].features);
+	}
+	free(cfg->models);
+	free(cfg->model);
+	free(cfg->ns);
+	free(cfg->capability);
+	free(cfg->repo_type);
+	free(cfg->repo_path);
+	free(cfg->name);
+	free(cfg);
+}
+
+/* the only child element, return: the element, NULL if missing or not unique */
+static xmlNodePtr module_cfg_unique(xmlNodePtr parent, const char* name) {
+	xmlNodePtr node, found = NULL;
+
+	for (node = parent->children; node != NULL; node = node->next) {
+		if (node->type == XML_ELEMENT_NODE && node->ns == NULL && xmlStrcmp(node->name, BAD_CAST name) == 0) {
+			if (found != NULL) {
+				return NULL;
+			}
+			found = node;
+		}
+	}
+	return found;
+}
+
+/* return: 0 - parsed, 1 - error */
+static int module_cfg_parse_model(struct np_module_model* model, xmlNodePtr node) {
+	xmlNodePtr child;
+	char** features;
+
+	for (child = node->children; child != NULL; child = child->next) {
+		if (child->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		if (model->path == NULL && xmlStrcmp(child->name, BAD_CAST "path") == 0) {
+			model->path = (char*)xmlNodeGetContent(child);
+		} else if (model->transapi == NULL && xmlStrcmp(child->name, BAD_CAST "transapi") == 0) {
+			model->transapi = (char*)xmlNodeGetContent(child);
+		} else if (xmlStrcmp(child->name, BAD_CAST "feature") == 0) {
+			if ((features = realloc(model->features, (model->feature_count + 1) * sizeof *features)) == NULL) {
+				return 1;
+			}
+			model->features = features;
+			model->features[model->feature_count++] = (char*)xmlNodeGetContent(child);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * get the name, namespace and the latest revision of the main model of a lazy module
+ * from the YIN header, without parsing the whole model
+ *
+ * return: 0 - read, 1 - error
+ */
+static int module_cfg_read_header(struct np_module_cfg* cfg, const struct np_module_model* model) {
+	xmlTextReaderPtr reader;
+	const xmlChar* name;
+	xmlChar* revision = NULL;
+	unsigned int i;
+	char* features = NULL, *aux;
+	int depth, ret = 1;
+
+	if ((reader = xmlReaderForFile(model->path, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NOWARNING|XML_PARSE_NOERROR)) == NULL) {
+		return 1;
+	}
+	while (revision == NULL && xmlTextReaderRead(reader) == 1) {
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+			continue;
+		}
+		name = xmlTextReaderConstLocalName(reader);
+		depth = xmlTextReaderDepth(reader);
+		if (depth == 0) {
+			if (xmlStrcmp(name, BAD_CAST "module") != 0) {
+				break;
+			}
+			cfg->model = (char*)xmlTextReaderGetAttribute(reader, BAD_CAST "name");
+		} else if (depth == 1) {
+			if (xmlStrcmp(name, BAD_CAST "namespace") == 0) {
+				cfg->ns = (char*)xmlTextReaderGetAttribute(reader, BAD_CAST "uri");
+			} else if (xmlStrcmp(name, BAD_CAST "revision") == 0) {
+				/* the revisions are sorted from the latest one */
+				revision = xmlTextReaderGetAttribute(reader, BAD_CAST "date");
+			} else if (xmlStrcmp(name, BAD_CAST "yang-version") && xmlStrcmp(name, BAD_CAST "prefix") && xmlStrcmp(name, BAD_CAST "import")
+					&& xmlStrcmp(name, BAD_CAST "include") && xmlStrcmp(name, BAD_CAST "organization") && xmlStrcmp(name, BAD_CAST "contact")
+					&& xmlStrcmp(name, BAD_CAST "description") && xmlStrcmp(name, BAD_CAST "reference")) {
+				/* the header is over, there is no revision */
+				break;
+			}
+			xmlTextReaderNext(reader);
+		}
+	}
+	xmlFreeTextReader(reader);
+
+	if (cfg->model == NULL || cfg->ns == NULL) {
+		goto finish;
+	}
+
+	/* the same format as libnetconf uses, except that all the features ("*") are unknown until the model is parsed */
+	for (i = 0; i < model->feature_count; ++i) {
+		if (strcmp(model->features[i], "*") == 0) {
+			continue;
+		}
+		if (asprintf(&aux, "%s%s%s", (features ? features : ""), (features ? "," : ""), model->features[i]) == -1) {
+			goto finish;
+		}
+		free(features);
+		features = aux;
+	}
+	if (asprintf(&cfg->capability, "%s?module=%s%s%s%s%s", cfg->ns, cfg->model, (revision ? "&revision=" : ""),
+			(revision ? (char*)revision : ""), (features ? "&features=" : ""), (features ? features : "")) == -1) {
+		cfg->capability = NULL;
+		goto finish;
+	}
+	ret = 0;
+
+finish:
+	xmlFree(revision);
+	free(features);
+	return ret;
+}
+
+/* read MODULES_CFG_DIR/<name>.xml, return: configuration, NULL if it cannot be read */
+static struct np_module_cfg* module_cfg_read(const char* name) {
+	struct np_module_cfg* cfg;
+	struct np_module_model* models;
+	char* config_path;
+	xmlDocPtr doc;
+	xmlNodePtr root, repo, data_models, node;
+	xmlChar* value;
+	unsigned int i;
+
+	if (asprintf(&config_path, "%s/%s%s", module_cfg_dir(), name, MODULE_CFG_SUFFIX) == -1) {
+		nc_verb_error("asprintf() failed (%s:%d).", __FILE__, __LINE__);
+		return NULL;
+	}
+	doc = xmlReadFile(config_path, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NSCLEAN|XML_PARSE_NOWARNING|XML_PARSE_NOERROR);
+	free(config_path);
+	if (doc == NULL) {
+		return NULL;
+	}
+
+	if ((cfg = calloc(1, sizeof *cfg)) == NULL || (cfg->name = strdup(name)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+		free(cfg);
+		xmlFreeDoc(doc);
+		return NULL;
+	}
+	cfg->refs = 1;
+
+	root = xmlDocGetRootElement(doc);
+	if (root == NULL || root->ns != NULL || xmlStrcmp(root->name, BAD_CAST "device") != 0
+			|| (repo = module_cfg_unique(root, "repo")) == NULL) {
+		cfg->error = "repo is not unique";
+		goto finish;
+	}
+	for (node = repo->children; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		if (xmlStrcmp(node->name, BAD_CAST "type") == 0) {
+			free(cfg->repo_type);
+			cfg->repo_type = (char*)xmlNodeGetContent(node);
+		} else if (xmlStrcmp(node->name, BAD_CAST "path") == 0) {
+			free(cfg->repo_path);
+			cfg->repo_path = (char*)xmlNodeGetContent(node);
+		}
+	}
+
+	if ((data_models = module_cfg_unique(root, "data-models")) == NULL) {
+		cfg->error = "data-models is not unique";
+		goto finish;
+	}
+	for (node = data_models->children; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE || (xmlStrcmp(node->name, BAD_CAST "model") && xmlStrcmp(node->name, BAD_CAST "model-main"))) {
+			continue;
+		}
+		if ((models = realloc(cfg->models, (cfg->model_count + 1) * sizeof *models)) == NULL) {
+			cfg->error = "memory allocation failed";
+			goto finish;
+		}
+		cfg->models = models;
+		memset(&cfg->models[cfg->model_count], 0, sizeof *cfg->models);
+		cfg->models[cfg->model_count].main = (xmlStrcmp(node->name, BAD_CAST "model-main") == 0);
+		if (module_cfg_parse_model(&cfg->models[cfg->model_count++], node)) {
+			cfg->error = "memory allocation failed";
+			goto finish;
+		}
+	}
+
+	if ((node = module_cfg_unique(root, "lazy")) != NULL) {
+		value = xmlNodeGetContent(node);
+		cfg->lazy = (value != NULL && xmlStrcmp(value, BAD_CAST "true") == 0);
+		xmlFree(value);
+	}
+	if ((node = module_cfg_unique(root, "state-cache-ttl")) != NULL) {
+		value = xmlNodeGetContent(node);
+		cfg->state_ttl = (value ? strtoul((char*)value, NULL, 10) : 0);
+		xmlFree(value);
+	}
+	if (cfg->lazy || cfg->state_ttl) {
+		for (i = 0; i < cfg->model_count && !cfg->models[i].main; ++i);
+		if (i == cfg->model_count || cfg->models[i].path == NULL || module_cfg_read_header(cfg, &cfg->models[i])) {
+			nc_verb_warning("%s: the main model of the module \"%s\" cannot be read, %s.", __func__, name,
+					(cfg->lazy ? "the module will not be lazy" : "its cached state data can only be invalidated by the module name"));
+			cfg->lazy = 0;
+		}
+	}
+
+finish:
+	xmlFreeDoc(doc);
+	return cfg;
+}
+
+/* the module name of a file in MODULES_CFG_DIR, return: name length, 0 if not a module configuration */
+static size_t module_cfg_name_len(const char* file) {
+	size_t len = strlen(file);
+
+	if (len <= strlen(MODULE_CFG_SUFFIX) || strcmp(file + len - strlen(MODULE_CFG_SUFFIX), MODULE_CFG_SUFFIX) != 0) {
+		return 0;
+	}
+	return len - strlen(MODULE_CFG_SUFFIX);
+}
+
+/* drop the cached configuration of a module, or of all for NULL, the caller must hold the lock */
+static void module_cfg_drop(const char* name, size_t name_len) {
+	struct np_module_cfg** prev, *cfg;
+
+	for (prev = &module_cfgs.cfgs; *prev != NULL;) {
+		cfg = *prev;
+		if (name == NULL || (strncmp(cfg->name, name, name_len) == 0 && cfg->name[name_len] == '\0')) {
+			*prev = cfg->next;
+			cfg->next = NULL;
+			if (--cfg->refs == 0) {
+				module_cfg_free(cfg);
+			}
+			if (name != NULL) {
+				return;
+			}
+		} else {
+			prev = &cfg->next;
+		}
+	}
+}
+
+/* apply the pending inotify events, the caller must hold the lock */
+static void module_cfg_process_events(void) {
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event* event;
+	ssize_t len;
+	char* ptr;
+	size_t name_len;
+
+	while ((len = read(module_cfgs.inotify_fd, buf, sizeof buf)) > 0) {
+		for (ptr = buf; ptr < buf + len; ptr += sizeof *event + event->len) {
+			event = (const struct inotify_event*)ptr;
+
+			if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				module_cfg_drop(NULL, 0);
+				if (!(event->mask & IN_Q_OVERFLOW)) {
+					nc_verb_warning("%s: \"%s\" was removed, module configurations will be read on every use.", __func__, module_cfg_dir());
+					close(module_cfgs.inotify_fd);
+					module_cfgs.inotify_fd = -1;
+					return;
+				}
+			} else if (event->len && (name_len = module_cfg_name_len(event->name))) {
+				nc_verb_verbose("%s: configuration of the module \"%.*s\" changed.", __func__, (int)name_len, event->name);
+				module_cfg_drop(event->name, name_len);
+			}
+		}
+	}
+}
+
+int module_cfg_init(void) {
+	struct np_module_cfg* cfg;
+	struct dirent* entry;
+	DIR* dir;
+	char* name;
+	size_t name_len;
+	int count = 0;
+
+	/* MODULE CFGS LOCK */
+	pthread_mutex_lock(&module_cfgs.lock);
+
+	if (module_cfgs.inotify_fd != -1) {
+		/* MODULE CFGS UNLOCK */
+		pthread_mutex_unlock(&module_cfgs.lock);
+		return EXIT_SUCCESS;
+	}
+
+	/* watch first, so that no change made during the scan is missed */
+	if ((module_cfgs.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+		nc_verb_warning("%s: inotify_init1 failed (%s), module configurations will be read on every use.", __func__, strerror(errno));
+	} else if (inotify_add_watch(module_cfgs.inotify_fd, module_cfg_dir(), MODULE_CFG_EVENTS) == -1) {
+		nc_verb_warning("%s: watching \"%s\" failed (%s), module configurations will be read on every use.", __func__,
+				module_cfg_dir(), strerror(errno));
+		close(module_cfgs.inotify_fd);
+		module_cfgs.inotify_fd = -1;
+	}
+
+	if (module_cfgs.inotify_fd != -1 && (dir = opendir(module_cfg_dir())) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			if ((name_len = module_cfg_name_len(entry->d_name)) == 0 || (name = strndup(entry->d_name, name_len)) == NULL) {
+				continue;
+			}
+			if ((cfg = module_cfg_read(name)) != NULL) {
+				cfg->next = module_cfgs.cfgs;
+				module_cfgs.cfgs = cfg;
+				++count;
+			}
+			free(name);
+		}
+		closedir(dir);
+		nc_verb_verbose("%s: %d module configurations read from \"%s\".", __func__, count, module_cfg_dir());
+	}
+
+	/* MODULE CFGS UNLOCK */
+	pthread_mutex_unlock(&module_cfgs.lock);
+
+	return (module_cfgs.inotify_fd == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void module_cfg_cleanup(void) {
+	/* MODULE CFGS LOCK */
+	pthread_mutex_lock(&module_cfgs.lock);
+
+	module_cfg_drop(NULL, 0);
+	if (module_cfgs.inotify_fd != -1) {
+		close(module_cfgs.inotify_fd);
+		module_cfgs.inotify_fd = -1;
+	}
+
+	/* MODULE CFGS UNLOCK */
+	pthread_mutex_unlock(&module_cfgs.lock);
+}
+
+struct np_module_cfg* module_cfg_get(const char* name) {
+	struct np_module_cfg* cfg;
+
+	/* MODULE CFGS LOCK */
+	pthread_mutex_lock(&module_cfgs.lock);
+
+	if (module_cfgs.inotify_fd != -1) {
+		module_cfg_process_events();
+	}
+	if (module_cfgs.inotify_fd == -1) {
+		/* nothing tells us about the changes */
+		module_cfg_drop(name, strlen(name));
+	}
+
+	for (cfg = module_cfgs.cfgs; cfg != NULL; cfg = cfg->next) {
+		if (strcmp(cfg->name, name) == 0) {
+			break;
+		}
+	}
+	if (cfg == NULL && (cfg = module_cfg_read(name)) != NULL) {
+		cfg->next = module_cfgs.cfgs;
+		module_cfgs.cfgs = cfg;
+	}
+	if (cfg != NULL) {
+		++cfg->refs;
+	}
+
+	/* MODULE CFGS UNLOCK */
+	pthread_mutex_unlock(&module_cfgs.lock);
+
+	return cfg;
+}
+
+void module_cfg_put(struct np_module_cfg* cfg) {
+	if (cfg == NULL) {
+		return;
+	}
+
+	/* MODULE CFGS LOCK */
+	pthread_mutex_lock(&module_cfgs.lock);
+	if (--cfg->refs == 0) {
+		module_cfg_free(cfg);
+	}
+	/* MODULE CFGS UNLOCK */
+	pthread_mutex_unlock(&module_cfgs.lock);
+}
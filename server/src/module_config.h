@@ -0,0 +1,99 @@
+/**
+ * @file module_config.h
+ * @brief Netopeer cache of the module configuration files header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _MODULE_CONFIG_H_
+#define _MODULE_CONFIG_H_
+
+/* a model-main or model element of a module configuration */
+struct np_module_model {
+	char* path;
+	char* transapi;
+	char** features;
+	unsigned int feature_count;
+	int main;
+};
+
+/* parsed MODULES_CFG_DIR/<name>.xml */
+struct np_module_cfg {
+	char* name;
+	char* repo_type;	/**< NULL if missing */
+	char* repo_path;
+	struct np_module_model* models; /**< in the configuration order */
+	unsigned int model_count;
+	const char* error;	/**< the file is not valid, the rest is not filled */
+
+	int lazy;			/**< activate the module on the first RPC targeting it */
+	unsigned int state_ttl;	/**< milliseconds its <get> data are cached for, 0 if not */
+	char* model;		/**< main model name, only for lazy and cached modules */
+	char* ns;			/**< main model namespace, only for lazy and cached modules */
+	char* capability;	/**< advertised until the module is activated, only for lazy modules */
+
+	unsigned int refs;
+	struct np_module_cfg* next;
+};
+
+/**
+ * @brief Read all the module configurations and watch MODULES_CFG_DIR for changes
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the changes cannot be watched and every
+ * module_cfg_get() reads the file again
+ */
+int module_cfg_init(void);
+
+/**
+ * @brief Free the cached module configurations and stop watching MODULES_CFG_DIR
+ */
+void module_cfg_cleanup(void);
+
+/**
+ * @brief Get the current configuration of a module, read it only if it changed
+ *
+ * @param name Module name
+ *
+ * @return Module configuration to be released by module_cfg_put(), check its error
+ * member, NULL if the file cannot be read
+ */
+struct np_module_cfg* module_cfg_get(const char* name);
+
+/**
+ * @brief Release a module configuration returned by module_cfg_get()
+ *
+ * @param cfg Module configuration
+ */
+void module_cfg_put(struct np_module_cfg* cfg);
+
+#endif /* _MODULE_CONFIG_H_ */
@@ -69,11 +69,13 @@
 #include <libnetconf_ssh.h>
 
 #include "server.h"
+#include "tcp_profile.h"
 
 static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
 
 extern struct np_options netopeer_options;
 extern int quit;
+extern int server_start;
 
 static struct ch_app* callhome_apps = NULL;
 
@@ -92,7 +94,7 @@ static void free_all_bind_addr(struct np_bind_addr** list) {
 	}
 }
 
-static void add_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port) {
+void add_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port) {
 	struct np_bind_addr* cur;
 
 	if (root == NULL) {
@@ -117,7 +119,7 @@ static void add_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, co
 	cur->next->next = NULL;
 }
 
-static void del_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port) {
+void del_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port) {
 	struct np_bind_addr* cur, *prev = NULL;
 
 	if (root == NULL || addr == NULL) {
@@ -325,7 +327,7 @@ static xmlNodePtr find_node(xmlNodePtr parent, xmlChar* name) {
 	return NULL;
 }
 
-static struct client_struct* sock_connect(const char* address, uint16_t port) {
+static struct client_struct* sock_connect(const char* address, uint16_t port, NC_TRANSPORT transport) {
 	struct client_struct* ret;
 	int is_ipv4;
 
@@ -334,6 +336,9 @@ static struct client_struct* sock_connect(const char* address, uint16_t port) {
 
 	ret = calloc(1, sizeof(struct client_struct));
 	ret->sock = -1;
+	ret->wake_fd = -1;
+	ret->callhome = 1;
+	ret->transport = transport;
 
 	if (strchr(address, ':') != NULL) {
 		is_ipv4 = 0;
@@ -357,6 +362,7 @@ static struct client_struct* sock_connect(const char* address, uint16_t port) {
 			goto fail;
 		}
 
+		tcp_profile_apply(ret->sock, transport, 1, &ret->saddr);
 		if (connect(ret->sock, (struct sockaddr*)saddr4, sizeof(struct sockaddr_in)) == -1) {
 			nc_verb_error("Call Home: could not connect to %s:%u (%s)", address, port, strerror(errno));
 			goto fail;
@@ -373,12 +379,17 @@ static struct client_struct* sock_connect(const char* address, uint16_t port) {
 			goto fail;
 		}
 
+		tcp_profile_apply(ret->sock, transport, 1, &ret->saddr);
 		if (connect(ret->sock, (struct sockaddr*)saddr6, sizeof(struct sockaddr_in6)) == -1) {
 			nc_verb_error("Call Home: could not connect %s:%u (%s)",address, port, strerror(errno));
 			goto fail;
 		}
 	}
 
+	if (np_client_wake_init(ret) != 0) {
+		goto fail;
+	}
+
 	nc_verb_verbose("Call Home: connected to %s:%u", address, port);
 	return ret;
 
@@ -427,8 +438,7 @@ static void* app_loop(void* app_v) {
 		/* try to connect to a server indefinitely */
 		for (;;) {
 			for (i = 0; i < app->rec_count; ++i) {
-				if ((app->client = sock_connect(cur_server->address, cur_server->port)) != NULL) {
-                    app->client->transport = app->transport;
+				if ((app->client = sock_connect(cur_server->address, cur_server->port, app->transport)) != NULL) {
 					break;
 				}
 				sleep(app->rec_interval);
@@ -517,12 +527,34 @@ static void* app_loop(void* app_v) {
 	}
 }
 
+static int app_start(struct ch_app* app) {
+	int ret;
+
+	ret = pthread_create(&(app->thread), NULL, app_loop, app);
+	if (ret) {
+		nc_verb_error("%s: pthread_create() error (%s)", __func__, strerror(ret));
+		return EXIT_FAILURE;
+	}
+	app->running = 1;
+
+	return EXIT_SUCCESS;
+}
+
+void callhome_start(void) {
+	struct ch_app* app;
+
+	for (app = callhome_apps; app != NULL; app = app->next) {
+		if (!app->running) {
+			app_start(app);
+		}
+	}
+}
+
 static int app_create(xmlNodePtr node, struct nc_err** error, NC_TRANSPORT transport) {
 	struct ch_app* new;
 	struct ch_server* srv, *del_srv;
 	xmlNodePtr auxnode, servernode, childnode;
 	xmlChar* auxstr;
-	int ret;
 
 	new = calloc(1, sizeof(struct ch_app));
 	new->transport = transport;
@@ -632,9 +664,8 @@ static int app_create(xmlNodePtr node, struct nc_err** error, NC_TRANSPORT trans
 		}
 	}
 
-	ret = pthread_create(&(new->thread), NULL, app_loop, new);
-	if (ret) {
-		nc_verb_error("%s: pthread_create() error (%s)", __func__, strerror(ret));
+	/* when the server starts, callhome_start() starts it once the worker processes are forked */
+	if (!server_start && app_start(new)) {
 		goto fail;
 	}
 
@@ -690,8 +721,10 @@ static int app_rm(const char* name, NC_TRANSPORT transport) {
 		return EXIT_FAILURE;
 	}
 
-	pthread_cancel(app->thread);
-	pthread_join(app->thread, NULL);
+	if (app->running) {
+		pthread_cancel(app->thread);
+		pthread_join(app->thread, NULL);
+	}
 
 	if (app->prev) {
 		app->prev->next = app->next;
@@ -728,6 +761,7 @@ static int app_rm(const char* name, NC_TRANSPORT transport) {
 			nc_verb_error("%s: internal error (%s:%d)", __func__, __FILE__, __LINE__);
 			app->client->to_free = 1;
 		}
+		np_client_wake(app->client);
 	}
 
 	free(app->name);
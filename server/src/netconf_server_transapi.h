@@ -65,11 +65,22 @@ struct ch_app {
 	uint8_t rep_timeout;        /* connection-type/periodic/timeout-mins */
 	uint8_t rep_linger;         /* connection-type/periodic/linger-secs */
 	pthread_t thread;
+	uint8_t running;            /* the thread was started */
 	struct client_struct* client;
 	struct ch_app *next;
 	struct ch_app *prev;
 };
 
+void add_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port);
+
+void del_bind_addr(struct np_bind_addr** root, NC_TRANSPORT transport, const char* addr, unsigned int port);
+
+/**
+ * @brief Start the threads of the Call Home applications configured while the
+ * server was starting, only after the worker processes are forked
+ */
+void callhome_start(void);
+
 int callback_srv_netconf_srv_call_home_srv_applications_srv_application(XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error, NC_TRANSPORT transport);
 
 int callback_srv_netconf_srv_listen_srv_port(XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error, NC_TRANSPORT transport);
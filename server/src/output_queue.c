@@ -0,0 +1,779 @@
+/**
+ * @file output_queue.c
+ * @brief Netopeer bounded session output queues
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "server.h"
+#include "event.h"
+#include "output_queue.h"
+
+extern struct np_options netopeer_options;
+
+/* the event data of a queue are its token and one of these */
+enum queue_event {
+	QUEUE_EV_PIPE_IN,		// session output to read
+	QUEUE_EV_SOCK_OUT,		// the socket takes more output
+	QUEUE_EV_SOCK_IN,		// client input to relay (duplex)
+	QUEUE_EV_PIPE_OUT		// the session takes more input (duplex)
+};
+
+#define QUEUE_EV(q, type) (((q)->token << 2) | (type))
+
+struct output_queue {
+	struct client_struct* client;	// NULL once the client was freed
+	uint64_t token;					// identifies the events of the queue, increasing in the array
+	char* sid;
+	int sock;						// -1 once closed
+	int pipe_r;						// -1 once closed
+	int pipe_w;						// -1 once closed by the client
+	char* buf;						// data the socket did not take yet
+	size_t start, len, size;
+	size_t max_depth;
+	volatile int paused;			// above the high watermark, no RPCs are read
+	int eof;						// all the session output was read from the pipe
+	int dead;						// disconnected, the buffered data were dropped
+	int watch_in, watch_out;		// the pipe or the socket is registered in the event set
+	uint64_t stall_since;			// milliseconds the socket has taken no data since, 0 if it is not full
+	uint64_t stall_time;			// milliseconds the socket took no data before
+
+	/* duplex, the pipe is a socket pair and the client input is relayed into it as well */
+	int duplex;
+	int in_sock, in_pipe;			// duplicates of sock and pipe_r watched for the input, -1 once closed
+	char* in_buf;					// input the session did not take yet
+	size_t in_start, in_len;
+	int in_eof;						// the client closed its side
+	int watch_sock_in, watch_pipe_out;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct output_queue** queues;	// increasing tokens
+	unsigned int count;
+	unsigned int size;
+	unsigned int unwatched;	// the queues from this index on are not registered yet
+	uint64_t next_token;
+	int notify_fd;			// eventfd interrupting the thread wait
+	pthread_t tid;
+	int running;			// the thread is started by the first queue
+	volatile int stop;
+} outq = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.next_token = 1,
+	.notify_fd = -1
+};
+
+static uint64_t queue_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void queue_notify(void) {
+	uint64_t count = 1;
+
+	if (write(outq.notify_fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: write failed (%s)", __func__, strerror(errno));
+	}
+}
+
+/* the queues created while the limit was 0 are not limited */
+static size_t queue_limit(void) {
+	return (netopeer_options.queue_limit ? netopeer_options.queue_limit : SIZE_MAX);
+}
+
+static void queue_close_fd(int* fd) {
+	if (*fd != -1) {
+		close(*fd);
+		*fd = -1;
+	}
+}
+
+/* QUEUE LOCK is expected to be held */
+static void queue_unwatch(struct np_event* ev, struct output_queue* q) {
+	if (q->watch_in) {
+		np_event_unwatch(ev, q->pipe_r, QUEUE_EV(q, QUEUE_EV_PIPE_IN));
+		q->watch_in = 0;
+	}
+	if (q->watch_out) {
+		np_event_unwatch(ev, q->sock, QUEUE_EV(q, QUEUE_EV_SOCK_OUT));
+		q->watch_out = 0;
+	}
+	if (q->watch_sock_in) {
+		np_event_unwatch(ev, q->in_sock, QUEUE_EV(q, QUEUE_EV_SOCK_IN));
+		q->watch_sock_in = 0;
+	}
+	if (q->watch_pipe_out) {
+		np_event_unwatch(ev, q->in_pipe, QUEUE_EV(q, QUEUE_EV_PIPE_OUT));
+		q->watch_pipe_out = 0;
+	}
+}
+
+/* QUEUE LOCK is expected to be held */
+static void queue_stall_end(struct output_queue* q, uint64_t now) {
+	if (q->stall_since) {
+		q->stall_time += now - q->stall_since;
+		q->stall_since = 0;
+	}
+}
+
+/* QUEUE LOCK is expected to be held */
+static void queue_finish(struct np_event* ev, struct output_queue* q) {
+	queue_unwatch(ev, q);
+	queue_close_fd(&q->pipe_r);
+	queue_close_fd(&q->in_pipe);
+	queue_close_fd(&q->sock);
+	queue_close_fd(&q->in_sock);
+}
+
+/* QUEUE LOCK is expected to be held */
+static void queue_disconnect(struct np_event* ev, struct output_queue* q, uint64_t now, const char* reason) {
+	nc_verb_warning("Disconnecting session %s, %s.", (q->sid ? q->sid : "without an ID"), reason);
+
+	queue_unwatch(ev, q);
+	/* a writer blocked on the full pipe gets EPIPE, a duplex session reads EOF */
+	queue_close_fd(&q->pipe_r);
+	queue_close_fd(&q->in_pipe);
+	queue_close_fd(&q->in_sock);
+	free(q->buf);
+	q->buf = NULL;
+	q->start = q->len = q->size = 0;
+	free(q->in_buf);
+	q->in_buf = NULL;
+	q->in_start = q->in_len = 0;
+	q->dead = 1;
+	q->paused = 0;
+	queue_stall_end(q, now);
+
+	if (q->client == NULL) {
+		queue_close_fd(&q->sock);
+	} else {
+		/* the client reads EOF, frees the session, and closes the socket in output_queue_close() */
+		shutdown(q->sock, SHUT_RDWR);
+		np_client_wake(q->client);
+	}
+}
+
+/* QUEUE LOCK is expected to be held */
+static int queue_append(struct output_queue* q, const char* data, size_t len) {
+	char* new_buf;
+	size_t size;
+
+	if (q->start && q->start + q->len + len > q->size) {
+		memmove(q->buf, q->buf + q->start, q->len);
+		q->start = 0;
+	}
+	if (q->len + len > q->size) {
+		for (size = (q->size ? 2*q->size : OUTPUT_QUEUE_CHUNK); size < q->len + len; size *= 2);
+		if ((new_buf = realloc(q->buf, size)) == NULL) {
+			return EXIT_FAILURE;
+		}
+		q->buf = new_buf;
+		q->size = size;
+	}
+
+	memcpy(q->buf + q->start + q->len, data, len);
+	q->len += len;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * move the client input of a duplex queue from the socket to the session without
+ * blocking, no more is read until the session takes what was read
+ *
+ * QUEUE LOCK is expected to be held
+ */
+static void queue_relay(struct np_event* ev, struct output_queue* q, uint64_t now) {
+	ssize_t r, s;
+
+	while (q->in_len || !q->in_eof) {
+		if (q->in_len == 0) {
+			if (q->in_buf == NULL && (q->in_buf = malloc(OUTPUT_QUEUE_CHUNK)) == NULL) {
+				queue_disconnect(ev, q, now, "memory allocation failed");
+				return;
+			}
+			q->in_start = 0;
+			if ((r = recv(q->in_sock, q->in_buf, OUTPUT_QUEUE_CHUNK, MSG_DONTWAIT)) == 0) {
+				/* the session reads EOF as well */
+				q->in_eof = 1;
+				shutdown(q->in_pipe, SHUT_WR);
+				break;
+			} else if (r == -1) {
+				if (errno == EINTR) {
+					continue;
+				} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					queue_disconnect(ev, q, now, strerror(errno));
+					return;
+				}
+				break;
+			}
+			q->in_len = r;
+		}
+
+		if ((s = send(q->in_pipe, q->in_buf + q->in_start, q->in_len, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				/* the session was closed, the pump reads EOF from the pipe */
+				q->in_len = 0;
+				q->in_eof = 1;
+			}
+			break;
+		}
+		q->in_start += s;
+		q->in_len -= s;
+	}
+
+	/* an idle session keeps no input buffer */
+	if (q->in_len == 0) {
+		free(q->in_buf);
+		q->in_buf = NULL;
+	}
+
+	if (!q->watch_sock_in && !q->in_eof && q->in_len == 0) {
+		q->watch_sock_in = !np_event_watch(ev, q->in_sock, POLLIN, QUEUE_EV(q, QUEUE_EV_SOCK_IN));
+	}
+	if (!q->watch_pipe_out && q->in_len) {
+		q->watch_pipe_out = !np_event_watch(ev, q->in_pipe, POLLOUT, QUEUE_EV(q, QUEUE_EV_PIPE_OUT));
+	}
+}
+
+/*
+ * move the data from the pipe to the socket without blocking, buffer what the
+ * socket does not take, and register the queue for the events it waits for
+ *
+ * QUEUE LOCK is expected to be held
+ */
+static void queue_pump(struct np_event* ev, struct output_queue* q, uint64_t now) {
+	char chunk[OUTPUT_QUEUE_CHUNK];
+	ssize_t r, s;
+	size_t off, limit = queue_limit();
+	int sent = 0;
+
+	if (q->dead || q->sock == -1) {
+		return;
+	}
+
+	if (q->duplex) {
+		queue_relay(ev, q, now);
+		if (q->dead) {
+			return;
+		}
+	}
+
+	/* the buffered data go first */
+	while (q->len) {
+		if ((s = send(q->sock, q->buf + q->start, q->len, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			queue_disconnect(ev, q, now, strerror(errno));
+			return;
+		}
+		q->start += s;
+		q->len -= s;
+		sent = 1;
+	}
+
+	/* new data are read only under the limit, a full pipe then blocks the writer */
+	while (!q->eof && q->len < limit) {
+		if ((r = read(q->pipe_r, chunk, sizeof chunk)) == 0) {
+			q->eof = 1;
+			break;
+		} else if (r == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno != EAGAIN) {
+				nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+				q->eof = 1;
+			}
+			break;
+		}
+
+		off = 0;
+		if (q->len == 0) {
+			/* usually the socket takes it all and nothing is copied */
+			if ((s = send(q->sock, chunk, r, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1
+					&& errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				queue_disconnect(ev, q, now, strerror(errno));
+				return;
+			}
+			if (s > 0) {
+				off = s;
+				sent = 1;
+			}
+		}
+		if (off < (size_t)r && queue_append(q, chunk + off, r - off)) {
+			queue_disconnect(ev, q, now, "memory allocation failed");
+			return;
+		}
+	}
+
+	if (q->len > q->max_depth) {
+		q->max_depth = q->len;
+	}
+
+	/* the stall time counts while the socket takes no data */
+	if (q->len == 0 || sent) {
+		queue_stall_end(q, now);
+	}
+	if (q->len == 0) {
+		free(q->buf);
+		q->buf = NULL;
+		q->start = q->size = 0;
+		if (q->eof) {
+			/* everything was sent after the client was freed */
+			queue_finish(ev, q);
+			return;
+		}
+	} else if (!q->stall_since) {
+		q->stall_since = now;
+	}
+
+	if (q->len >= limit && netopeer_options.queue_overflow == OUTPUT_QUEUE_DISCONNECT) {
+		queue_disconnect(ev, q, now, "its output queue is full");
+		return;
+	}
+
+	if (!q->paused && q->len >= netopeer_options.queue_high_watermark) {
+		q->paused = 1;
+	} else if (q->paused && q->len <= netopeer_options.queue_low_watermark) {
+		q->paused = 0;
+		if (q->client != NULL) {
+			np_client_wake(q->client);
+		}
+	}
+
+	if (!q->watch_in && !q->eof && q->len < limit) {
+		q->watch_in = !np_event_watch(ev, q->pipe_r, POLLIN, QUEUE_EV(q, QUEUE_EV_PIPE_IN));
+	}
+	if (!q->watch_out && q->len) {
+		q->watch_out = !np_event_watch(ev, q->sock, POLLOUT, QUEUE_EV(q, QUEUE_EV_SOCK_OUT));
+	}
+}
+
+/* QUEUE LOCK is expected to be held */
+static struct output_queue* queue_find(uint64_t token) {
+	unsigned int low = 0, high = outq.count, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (outq.queues[mid]->token == token) {
+			return outq.queues[mid];
+		} else if (outq.queues[mid]->token < token) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return NULL;
+}
+
+static void queue_free(struct output_queue* q) {
+	free(q->buf);
+	free(q->in_buf);
+	free(q->sid);
+	free(q);
+}
+
+static void* queue_thread(void* UNUSED(arg)) {
+	struct np_event* ev = NULL;
+	struct np_event_res res[EVENT_BATCH];
+	struct output_queue* q;
+	uint64_t now, last_scan = 0, stop_time = 0, notify_count;
+	unsigned int i, j, unwatched;
+	int backend = -1, count, notify_watched = 0;
+
+	while (1) {
+		now = queue_time();
+
+		/* QUEUE LOCK */
+		pthread_mutex_lock(&outq.lock);
+
+		if (outq.stop) {
+			if (stop_time == 0) {
+				stop_time = now;
+			}
+			if (outq.count == 0 || now - stop_time >= OUTPUT_QUEUE_LINGER * 1000) {
+				break;
+			}
+		}
+
+		/* another backend was configured, everything is registered again in a new event set */
+		if (ev == NULL || backend != netopeer_options.io_backend) {
+			np_event_free(ev);
+			backend = netopeer_options.io_backend;
+			if ((ev = np_event_new(backend)) == NULL) {
+				/* QUEUE UNLOCK */
+				pthread_mutex_unlock(&outq.lock);
+				sleep(1);
+				continue;
+			}
+			notify_watched = 0;
+			for (i = 0; i < outq.count; ++i) {
+				outq.queues[i]->watch_in = 0;
+				outq.queues[i]->watch_out = 0;
+				outq.queues[i]->watch_sock_in = 0;
+				outq.queues[i]->watch_pipe_out = 0;
+			}
+			outq.unwatched = 0;
+		}
+
+		/* only the new queues are registered, the rest stays registered between the waits */
+		if (!notify_watched) {
+			notify_watched = !np_event_watch(ev, outq.notify_fd, POLLIN, 0);
+		}
+		for (i = outq.unwatched; i < outq.count; ++i) {
+			queue_pump(ev, outq.queues[i], now);
+		}
+		outq.unwatched = outq.count;
+
+		/* QUEUE UNLOCK */
+		pthread_mutex_unlock(&outq.lock);
+
+		if ((count = np_event_wait(ev, res, EVENT_BATCH, 1000)) == -1) {
+			sleep(1);
+			continue;
+		}
+
+		now = queue_time();
+
+		/* QUEUE LOCK */
+		pthread_mutex_lock(&outq.lock);
+
+		for (i = 0; i < (unsigned int)count; ++i) {
+			if (res[i].data == 0) {
+				if (read(outq.notify_fd, &notify_count, sizeof notify_count) == -1 && errno != EAGAIN) {
+					nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+				}
+				notify_watched = 0;
+			} else if ((q = queue_find(res[i].data >> 2)) != NULL) {
+				switch (res[i].data & 3) {
+				case QUEUE_EV_PIPE_IN:
+					q->watch_in = 0;
+					break;
+				case QUEUE_EV_SOCK_OUT:
+					q->watch_out = 0;
+					break;
+				case QUEUE_EV_SOCK_IN:
+					q->watch_sock_in = 0;
+					break;
+				default:
+					q->watch_pipe_out = 0;
+					break;
+				}
+				queue_pump(ev, q, now);
+			}
+		}
+
+		/*
+		 * only this thread removes queues, once a second all of them are pumped
+		 * to apply any new limits, the stalled ones are disconnected, and the
+		 * finished ones are removed from the array
+		 */
+		if (outq.stop || now / 1000 != last_scan) {
+			last_scan = now / 1000;
+			unwatched = 0;
+			for (i = 0, j = 0; i < outq.count; ++i) {
+				if (i == outq.unwatched) {
+					unwatched = j;
+				}
+				q = outq.queues[i];
+				if (q->stall_since && netopeer_options.queue_stall_timeout
+						&& now - q->stall_since >= (uint64_t)netopeer_options.queue_stall_timeout * 1000) {
+					queue_disconnect(ev, q, now, "its output stalled");
+				} else if (i < outq.unwatched) {
+					queue_pump(ev, q, now);
+				}
+				if (q->client == NULL && q->sock == -1) {
+					queue_free(q);
+				} else {
+					outq.queues[j++] = q;
+				}
+			}
+			outq.unwatched = (outq.unwatched >= outq.count ? j : unwatched);
+			outq.count = j;
+		}
+
+		/* QUEUE UNLOCK */
+		pthread_mutex_unlock(&outq.lock);
+	}
+
+	/* the data not sent until now are dropped, no client is left */
+	for (i = 0; i < outq.count; ++i) {
+		queue_finish(ev, outq.queues[i]);
+		queue_free(outq.queues[i]);
+	}
+	outq.count = 0;
+	outq.unwatched = 0;
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+
+	np_event_free(ev);
+	return NULL;
+}
+
+void output_queue_init(void) {
+	if ((outq.notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		nc_verb_error("%s: eventfd failed (%s), sessions will write to their sockets directly", __func__, strerror(errno));
+	}
+}
+
+void output_queue_cleanup(void) {
+	if (outq.notify_fd == -1) {
+		return;
+	}
+
+	if (outq.running) {
+		outq.stop = 1;
+		queue_notify();
+		pthread_join(outq.tid, NULL);
+		outq.running = 0;
+	}
+
+	close(outq.notify_fd);
+	outq.notify_fd = -1;
+	free(outq.queues);
+	outq.queues = NULL;
+	outq.size = 0;
+	outq.stop = 0;
+}
+
+/* QUEUE LOCK is expected to be held, return: 0 - the thread runs, 1 - it could not be started */
+static int queue_thread_start(void) {
+	int ret;
+
+	if (outq.running) {
+		return 0;
+	}
+	if ((ret = pthread_create(&outq.tid, NULL, queue_thread, NULL)) != 0) {
+		nc_verb_error("%s: failed to create a thread (%s), sessions will write to their sockets directly", __func__, strerror(ret));
+		return 1;
+	}
+	outq.running = 1;
+	return 0;
+}
+
+static struct output_queue* queue_new(struct client_struct* client, int duplex, int* out_fd) {
+	struct output_queue* q, **new_queues;
+	int fds[2];
+
+	/* the queues are used only when configured */
+	if (netopeer_options.queue_limit == 0 || outq.notify_fd == -1 || outq.stop) {
+		return NULL;
+	}
+
+	if ((duplex ? socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) : pipe2(fds, O_CLOEXEC)) == -1) {
+		nc_verb_error("%s: %s failed (%s)", __func__, (duplex ? "socketpair" : "pipe2"), strerror(errno));
+		return NULL;
+	}
+	/*
+	 * only the pump side is non-blocking, the session writes block when the queue is full,
+	 * a duplex session gets a non-blocking socket as the accepted one it replaces
+	 */
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1 || (duplex && fcntl(fds[1], F_SETFL, O_NONBLOCK) == -1)
+			|| (q = calloc(1, sizeof *q)) == NULL) {
+		nc_verb_error("%s: failed to create an output queue (%s)", __func__, strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+	q->client = client;
+	q->sock = client->sock;
+	q->pipe_r = fds[0];
+	q->pipe_w = fds[1];
+	q->in_sock = -1;
+	q->in_pipe = -1;
+	q->duplex = duplex;
+
+	/* the input is watched separately from the output of the same sockets */
+	if (duplex && ((q->in_sock = dup(q->sock)) == -1 || (q->in_pipe = dup(q->pipe_r)) == -1)) {
+		nc_verb_error("%s: dup failed (%s)", __func__, strerror(errno));
+		queue_close_fd(&q->in_sock);
+		close(fds[0]);
+		close(fds[1]);
+		free(q);
+		return NULL;
+	}
+
+	/* QUEUE LOCK */
+	pthread_mutex_lock(&outq.lock);
+
+	if (queue_thread_start() || (outq.count == outq.size &&
+			(new_queues = realloc(outq.queues, (outq.size ? 2*outq.size : 16) * sizeof *outq.queues)) == NULL)) {
+		/* QUEUE UNLOCK */
+		pthread_mutex_unlock(&outq.lock);
+		nc_verb_error("%s: failed to create an output queue", __func__);
+		queue_close_fd(&q->in_sock);
+		queue_close_fd(&q->in_pipe);
+		close(fds[0]);
+		close(fds[1]);
+		free(q);
+		return NULL;
+	}
+	if (outq.count == outq.size) {
+		outq.queues = new_queues;
+		outq.size = (outq.size ? 2*outq.size : 16);
+	}
+	q->token = outq.next_token++;
+	outq.queues[outq.count++] = q;
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+
+	queue_notify();
+
+	*out_fd = q->pipe_w;
+	return q;
+}
+
+struct output_queue* output_queue_new(struct client_struct* client, int* out_fd) {
+	return queue_new(client, 0, out_fd);
+}
+
+struct output_queue* output_queue_new_duplex(struct client_struct* client, int* session_fd) {
+	return queue_new(client, 1, session_fd);
+}
+
+void output_queue_set_sid(struct output_queue* q, const char* sid) {
+	/* QUEUE LOCK */
+	pthread_mutex_lock(&outq.lock);
+
+	free(q->sid);
+	q->sid = strdup(sid);
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+}
+
+void output_queue_cork(struct output_queue* q, int cork) {
+	/* QUEUE LOCK */
+	pthread_mutex_lock(&outq.lock);
+
+	/* fails only on a socket that is not TCP, the data are sent as they are then */
+	if (q->sock != -1) {
+		setsockopt(q->sock, IPPROTO_TCP, TCP_CORK, &cork, sizeof cork);
+	}
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+}
+
+int output_queue_readable(const struct output_queue* q) {
+	return !q->paused;
+}
+
+void output_queue_close(struct output_queue* q) {
+	/* QUEUE LOCK */
+	pthread_mutex_lock(&outq.lock);
+
+	/* the pump reads EOF once it has read everything written, the session of a duplex queue closes its socket itself */
+	q->client = NULL;
+	if (!q->duplex) {
+		close(q->pipe_w);
+	}
+	q->pipe_w = -1;
+	if (q->dead && q->sock != -1) {
+		close(q->sock);
+		q->sock = -1;
+	}
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+}
+
+void output_queue_stats(xmlNodePtr parent) {
+	struct output_queue* q;
+	xmlNodePtr node;
+	char buf[24];
+	uint64_t now = queue_time();
+	size_t depth;
+	unsigned int i;
+	int pending;
+
+	/* QUEUE LOCK */
+	pthread_mutex_lock(&outq.lock);
+
+	for (i = 0; i < outq.count; ++i) {
+		q = outq.queues[i];
+		if (q->client == NULL || q->sid == NULL) {
+			continue;
+		}
+
+		/* the data still in the pipe count as well */
+		if (q->pipe_r == -1 || ioctl(q->pipe_r, FIONREAD, &pending) == -1) {
+			pending = 0;
+		}
+		depth = q->len + pending;
+
+		node = xmlNewChild(parent, parent->ns, BAD_CAST "session", NULL);
+		xmlNewTextChild(node, parent->ns, BAD_CAST "session-id", BAD_CAST q->sid);
+		snprintf(buf, sizeof buf, "%zu", depth);
+		xmlNewChild(node, parent->ns, BAD_CAST "depth", BAD_CAST buf);
+		snprintf(buf, sizeof buf, "%zu", (depth > q->max_depth ? depth : q->max_depth));
+		xmlNewChild(node, parent->ns, BAD_CAST "max-depth", BAD_CAST buf);
+		xmlNewChild(node, parent->ns, BAD_CAST "reading-paused", BAD_CAST (q->paused ? "true" : "false"));
+		snprintf(buf, sizeof buf, "%" PRIu64, q->stall_time + (q->stall_since ? now - q->stall_since : 0));
+		xmlNewChild(node, parent->ns, BAD_CAST "stall-time", BAD_CAST buf);
+	}
+
+	/* QUEUE UNLOCK */
+	pthread_mutex_unlock(&outq.lock);
+}
@@ -0,0 +1,139 @@
+/**
+ * @file output_queue.h
+ * @brief Netopeer bounded session output queues header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _OUTPUT_QUEUE_H_
+#define _OUTPUT_QUEUE_H_
+
+#include <libxml/tree.h>
+
+#include "server.h"
+
+/*
+ * With a non-zero limit configured, the output of a session is written into a
+ * pipe and moved to the client socket by a single thread, multiplexing all the
+ * queues by the event backend, without ever blocking on it. The data the
+ * socket does not take are kept in a buffer. Once it reaches the high
+ * watermark, no RPCs are read from the session until it falls to the low
+ * watermark. Once it reaches the limit, the session is disconnected, or its
+ * writes block, until its socket stalls for too long. An SSH session gets a
+ * socket pair instead of the pipe, its input is relayed by the same thread.
+ */
+struct output_queue;
+
+/* what happens to a session whose queue reaches the limit */
+enum output_queue_overflow {
+	OUTPUT_QUEUE_WAIT,			/**< its writes block until the socket takes more data */
+	OUTPUT_QUEUE_DISCONNECT		/**< it is disconnected */
+};
+
+/**
+ * @brief Prepare the queues, the thread flushing them is started with the first one
+ */
+void output_queue_init(void);
+
+/**
+ * @brief Flush the queues of the freed sessions for at most OUTPUT_QUEUE_LINGER
+ * seconds and stop the thread, there must be no client left
+ */
+void output_queue_cleanup(void);
+
+/**
+ * @brief Create the output queue of a client
+ *
+ * @param client Client, its socket is owned by the queue from now on
+ * @param[out] out_fd Blocking descriptor to write the session output to
+ *
+ * @return Queue, NULL if the queues are disabled or on error and the session
+ * writes into the socket directly
+ */
+struct output_queue* output_queue_new(struct client_struct* client, int* out_fd);
+
+/**
+ * @brief Create the output queue of a client whose session needs a single
+ * socket for both directions (SSH), the client input is relayed into it
+ *
+ * @param client Client, its socket is owned by the queue from now on
+ * @param[out] session_fd Non-blocking socket for the session, closed by the
+ * session
+ *
+ * @return Queue, NULL if the queues are disabled or on error and the session
+ * uses the client socket directly
+ */
+struct output_queue* output_queue_new_duplex(struct client_struct* client, int* session_fd);
+
+/**
+ * @brief Set the session ID the queue is reported under
+ *
+ * @param q Queue
+ * @param sid Session ID
+ */
+void output_queue_set_sid(struct output_queue* q, const char* sid);
+
+/**
+ * @brief Cork or uncork the client socket of a queue, the thread moving the
+ * data may still be writing when it is uncorked, the rest is sent uncorked
+ *
+ * @param q Queue
+ * @param cork 1 to cork, 0 to uncork
+ */
+void output_queue_cork(struct output_queue* q, int cork);
+
+/**
+ * @brief Whether RPCs may be read from the session
+ *
+ * @param q Queue
+ *
+ * @return 0 if the queue is above its high watermark, non-zero otherwise
+ */
+int output_queue_readable(const struct output_queue* q);
+
+/**
+ * @brief Close the written end of a queue of a client being freed, the rest of
+ * its data are still sent and the client socket is closed afterwards
+ *
+ * @param q Queue, must not be used anymore
+ */
+void output_queue_close(struct output_queue* q);
+
+/**
+ * @brief Add the depth and the stall time of the queues as "session" elements
+ *
+ * @param parent Parent element, its namespace is used
+ */
+void output_queue_stats(xmlNodePtr parent);
+
+#endif /* _OUTPUT_QUEUE_H_ */
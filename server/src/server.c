@@ -49,10 +49,13 @@
 #include <linux/limits.h>
 #include <sys/poll.h>
 #include <sys/time.h>
+#include <sys/eventfd.h>
+#include <malloc.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include <time.h>
 #include <shadow.h>
 #include <pwd.h>
@@ -64,6 +67,14 @@
 #include <libnetconf_xml.h>
 
 #include "server.h"
+#include "module_config.h"
+#include "state_data.h"
+#include "commit.h"
+#include "event.h"
+#include "output_queue.h"
+#include "tcp_profile.h"
+#include "worker.h"
+#include "datastore_journal.h"
 
 static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
 
@@ -75,7 +86,9 @@ extern struct ch_app* callhome_app;
 
 /* one global structure holding all the client information */
 struct np_state netopeer_state = {
-	.global_lock = PTHREAD_MUTEX_INITIALIZER
+	.global_lock = PTHREAD_MUTEX_INITIALIZER,
+	.clients_cond = PTHREAD_COND_INITIALIZER,
+	.sess_idx_lock = PTHREAD_MUTEX_INITIALIZER
 };
 
 /* flags of main server loop, they are turned when a signal comes */
@@ -201,6 +214,168 @@ void np_client_detach(struct client_struct** root, struct client_struct* del_cli
 	}
 }
 
+int np_client_wake_init(struct client_struct* client) {
+	client->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (client->wake_fd == -1) {
+		nc_verb_error("%s: eventfd failed (%s)", __func__, strerror(errno));
+		return 1;
+	}
+
+	return 0;
+}
+
+void np_client_wake(struct client_struct* client) {
+	uint64_t count = 1;
+
+	if (client->wake_fd == -1) {
+		return;
+	}
+
+	if (write(client->wake_fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: write failed (%s)", __func__, strerror(errno));
+	}
+}
+
+/* sleep for response_time or until woken up by np_client_wake() */
+static void client_sleep(struct client_struct* client) {
+	struct pollfd pfd;
+	uint64_t count;
+
+	pfd.fd = client->wake_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	/* negative fd is ignored by poll, so it is a plain sleep then */
+	if (poll(&pfd, 1, netopeer_options.response_time) == 1 && (pfd.revents & POLLIN)) {
+		/* reset the counter, all the wake ups are handled by the next pass */
+		if (read(client->wake_fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+			nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+		}
+	}
+}
+
+static unsigned int sess_idx_hash(const char* sid) {
+	unsigned int hash = 5381;
+
+	for (; *sid != '\0'; ++sid) {
+		hash = ((hash << 5) + hash) + (unsigned char)*sid;
+	}
+
+	return hash % SESSION_INDEX_SIZE;
+}
+
+void np_session_index_add(struct nc_session* session, struct client_struct* client, volatile int* to_free) {
+	struct np_sess_idx* entry;
+	const char* sid;
+	unsigned int hash;
+
+	if (session == NULL || (sid = nc_session_get_id(session)) == NULL) {
+		return;
+	}
+
+	if ((entry = malloc(sizeof(struct np_sess_idx))) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		return;
+	}
+	if ((entry->sid = strdup(sid)) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		free(entry);
+		return;
+	}
+	entry->client = client;
+	entry->to_free = to_free;
+	hash = sess_idx_hash(sid);
+
+	/* SESSION INDEX LOCK */
+	pthread_mutex_lock(&netopeer_state.sess_idx_lock);
+
+	entry->next = netopeer_state.sess_idx[hash];
+	netopeer_state.sess_idx[hash] = entry;
+
+	/* SESSION INDEX UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.sess_idx_lock);
+
+	/* the owner keeps a copy of the sessions of a worker, from their start */
+	worker_session_start(session);
+}
+
+void np_session_index_del(const char* sid) {
+	struct np_sess_idx* entry, *prev = NULL;
+	unsigned int hash;
+
+	if (sid == NULL) {
+		return;
+	}
+
+	hash = sess_idx_hash(sid);
+
+	/* SESSION INDEX LOCK */
+	pthread_mutex_lock(&netopeer_state.sess_idx_lock);
+
+	for (entry = netopeer_state.sess_idx[hash]; entry != NULL; entry = entry->next) {
+		if (strcmp(entry->sid, sid) == 0) {
+			break;
+		}
+		prev = entry;
+	}
+
+	if (entry != NULL) {
+		if (prev == NULL) {
+			netopeer_state.sess_idx[hash] = entry->next;
+		} else {
+			prev->next = entry->next;
+		}
+	}
+
+	/* SESSION INDEX UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.sess_idx_lock);
+
+	if (entry != NULL) {
+		free(entry->sid);
+		free(entry);
+	}
+
+	/* a confirmed commit does not outlive its session */
+	commit_session_end(sid);
+	/* the owner keeps a copy of the sessions of a worker */
+	worker_session_end(sid);
+}
+
+/* return: 0 - session marked for deletion and its client woken up, 1 - session not found, 2 - session of cur_client */
+int np_session_kill(const char* sid, const struct client_struct* cur_client) {
+	struct np_sess_idx* entry;
+	int ret;
+
+	if (sid == NULL) {
+		return 1;
+	}
+
+	/* SESSION INDEX LOCK */
+	pthread_mutex_lock(&netopeer_state.sess_idx_lock);
+
+	for (entry = netopeer_state.sess_idx[sess_idx_hash(sid)]; entry != NULL; entry = entry->next) {
+		if (strcmp(entry->sid, sid) == 0) {
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		ret = 1;
+	} else if (entry->client == cur_client) {
+		ret = 2;
+	} else {
+		/* the entry cannot be removed (and the client freed) while we hold the lock */
+		*entry->to_free = 1;
+		np_client_wake(entry->client);
+		ret = 0;
+	}
+
+	/* SESSION INDEX UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.sess_idx_lock);
+
+	return ret;
+}
+
 /* return seconds rounded down */
 unsigned int timeval_diff(struct timeval tv1, struct timeval tv2) {
 	time_t sec;
@@ -219,77 +394,906 @@ unsigned int timeval_diff(struct timeval tv1, struct timeval tv2) {
 	return sec;
 }
 
+/* all the transports the server was compiled with */
+static const struct np_transport* np_transports[] = {
+#ifdef NP_SSH
+	&np_ssh_transport,
+#endif
+#ifdef NP_TLS
+	&np_tls_transport,
+#endif
+	&np_unix_transport,
+	NULL
+};
+
+#define NP_TRANSPORT_COUNT (sizeof np_transports / sizeof *np_transports - 1)
+
+static int np_transport_idx(NC_TRANSPORT transport) {
+	int i;
+
+	for (i = 0; np_transports[i] != NULL; ++i) {
+		if (np_transports[i]->transport == transport) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+const struct np_transport* np_transport_get(NC_TRANSPORT transport) {
+	int i;
+
+	if ((i = np_transport_idx(transport)) == -1) {
+		return NULL;
+	}
+	return np_transports[i];
+}
+
+void np_client_free(struct client_struct* client) {
+	const struct np_transport* tr;
+
+	if ((tr = np_transport_get(client->transport)) == NULL) {
+		nc_verb_error("%s: internal error (%s:%d)", __func__, __FILE__, __LINE__);
+		free(client);
+		return;
+	}
+	tr->client_free(client);
+}
+
 void* client_notif_thread(void* arg) {
 	struct ntf_thread_config *config = (struct ntf_thread_config*)arg;
 
-	ncntf_dispatch_send(config->session, config->subscribe_rpc);
-	nc_rpc_free(config->subscribe_rpc);
-	free(config);
+	ncntf_dispatch_send(config->session, config->subscribe_rpc);
+	nc_rpc_free(config->subscribe_rpc);
+	free(config);
+
+	return NULL;
+}
+
+static nc_reply* rpc_kill_session(struct client_struct* client, const nc_rpc* rpc) {
+	xmlNodePtr op;
+	struct nc_err* err;
+	char* sid;
+	int ret;
+
+	if ((op = ncxml_rpc_get_op_content(rpc)) == NULL || op->name == NULL ||
+			xmlStrEqual(op->name, BAD_CAST "kill-session") == 0) {
+		nc_verb_error("%s: corrupted RPC message", __func__);
+		xmlFreeNodeList(op);
+		return nc_reply_error(nc_err_new(NC_ERR_OP_FAILED));
+	}
+	if (op->children == NULL || xmlStrEqual(op->children->name, BAD_CAST "session-id") == 0) {
+		nc_verb_error("%s: no session ID found", __func__);
+		xmlFreeNodeList(op);
+		err = nc_err_new(NC_ERR_MISSING_ELEM);
+		nc_err_set(err, NC_ERR_PARAM_INFO_BADELEM, "session-id");
+		return nc_reply_error(err);
+	}
+
+	sid = (char*)xmlNodeGetContent(op->children);
+	xmlFreeNodeList(op);
+
+	ret = np_session_kill(sid, client);
+	if (ret == 1) {
+		/* a session of another worker process */
+		ret = worker_kill(sid);
+	}
+
+	/* check if this client is not requested to be killed */
+	if (ret == 2) {
+		free(sid);
+		err = nc_err_new(NC_ERR_INVALID_VALUE);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "Requested to kill this session.");
+		return nc_reply_error(err);
+	}
+
+	if (ret != 0) {
+		free(sid);
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "No session with the requested ID found.");
+		return nc_reply_error(err);
+	}
+
+	nc_verb_verbose("Session with the ID %s killed.", sid);
+	free(sid);
+
+	return nc_reply_ok();
+}
+
+static nc_reply* rpc_create_subscription(struct nc_session* session, const nc_rpc* rpc) {
+	nc_reply* rpc_reply;
+	struct nc_err* err;
+	pthread_t thread;
+	pthread_attr_t attr;
+	struct ntf_thread_config* ntf_config;
+	int ret;
+
+	if (nc_cpblts_enabled(session, "urn:ietf:params:netconf:capability:notification:1.0") == 0) {
+		return nc_reply_error(nc_err_new(NC_ERR_OP_NOT_SUPPORTED));
+	}
+
+	/* check if notifications are allowed on this session */
+	if (nc_session_notif_allowed(session) == 0) {
+		nc_verb_error("%s: notification subscription is not allowed on the session %s", __func__, nc_session_get_id(session));
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_TYPE, "protocol");
+		nc_err_set(err, NC_ERR_PARAM_MSG, "Another notification subscription is currently active on this session.");
+		return nc_reply_error(err);
+	}
+
+	rpc_reply = ncntf_subscription_check(rpc);
+	if (nc_reply_get_type(rpc_reply) != NC_REPLY_OK) {
+		return rpc_reply;
+	}
+
+	if ((ntf_config = malloc(sizeof(struct ntf_thread_config))) == NULL) {
+		nc_verb_error("%s: memory allocation failed", __func__);
+		nc_reply_free(rpc_reply);
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "Memory allocation failed.");
+		return nc_reply_error(err);
+	}
+	ntf_config->session = session;
+	ntf_config->subscribe_rpc = nc_rpc_dup(rpc);
+
+	/* perform notification sending, the thread mostly waits for the events, so it needs no default-sized stack */
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, NOTIF_THREAD_STACK);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, client_notif_thread, ntf_config);
+	pthread_attr_destroy(&attr);
+	if (ret != 0) {
+		nc_rpc_free(ntf_config->subscribe_rpc);
+		free(ntf_config);
+		nc_reply_free(rpc_reply);
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "Creating thread for sending Notifications failed.");
+		return nc_reply_error(err);
+	}
+
+	return rpc_reply;
+}
+
+/* add the namespaces of the child elements, return: 0 - added, 1 - the targets cannot be determined */
+static int rpc_targets_add(xmlNodePtr parent, const char*** targets, unsigned int* count) {
+	xmlNodePtr node;
+	const char** new_targets;
+
+	if (parent == NULL) {
+		return 1;
+	}
+	for (node = parent->children; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		if (node->ns == NULL || (new_targets = realloc(*targets, (*count + 1) * sizeof *new_targets)) == NULL) {
+			return 1;
+		}
+		*targets = new_targets;
+		(*targets)[(*count)++] = (const char*)node->ns->href;
+	}
+
+	return 0;
+}
+
+/* the first child element of the name */
+static xmlNodePtr rpc_child(xmlNodePtr parent, const char* name) {
+	xmlNodePtr node;
+
+	for (node = (parent ? parent->children : NULL); node != NULL; node = node->next) {
+		if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST name) == 0) {
+			break;
+		}
+	}
+
+	return node;
+}
+
+/*
+ * activate the lazy modules an RPC targets - the module of the operation, the
+ * top-level elements of a subtree filter or a configuration, or the requested
+ * schema, any other RPC may affect all the modules
+ */
+static void rpc_activate_lazy(const nc_rpc* rpc) {
+	xmlDocPtr doc = NULL;
+	xmlNodePtr op = NULL, node;
+	xmlChar* type = NULL, *identifier = NULL;
+	const char** targets = NULL;
+	unsigned int count = 0;
+	char* dump;
+	int all = 1;
+
+	if (netopeer_options.lazy_count == 0) {
+		return;
+	}
+
+	if ((dump = nc_rpc_dump(rpc)) != NULL) {
+		doc = xmlReadMemory(dump, strlen(dump), NULL, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN);
+		free(dump);
+	}
+	if (doc != NULL && xmlDocGetRootElement(doc) != NULL) {
+		for (op = xmlDocGetRootElement(doc)->children; op != NULL && op->type != XML_ELEMENT_NODE; op = op->next);
+	}
+	if (op == NULL || op->ns == NULL) {
+		goto activate;
+	}
+
+	switch (nc_rpc_get_op(rpc)) {
+	case NC_OP_GETSCHEMA:
+		if ((node = rpc_child(op, "identifier")) != NULL && (identifier = xmlNodeGetContent(node)) != NULL
+				&& (targets = malloc(sizeof *targets)) != NULL) {
+			targets[count++] = (const char*)identifier;
+			all = 0;
+		}
+		break;
+	case NC_OP_GET:
+	case NC_OP_GETCONFIG:
+		/* no filter selects everything, an XPath filter is not examined */
+		node = rpc_child(op, "filter");
+		type = (node ? xmlGetProp(node, BAD_CAST "type") : NULL);
+		if (node != NULL && (type == NULL || xmlStrcmp(type, BAD_CAST "subtree") == 0)) {
+			all = rpc_targets_add(node, &targets, &count);
+		}
+		break;
+	case NC_OP_EDITCONFIG:
+		all = rpc_targets_add(rpc_child(op, "config"), &targets, &count);
+		break;
+	case NC_OP_COPYCONFIG:
+		all = rpc_targets_add(rpc_child(rpc_child(op, "source"), "config"), &targets, &count);
+		break;
+	default:
+		if (xmlStrcmp(op->ns->href, BAD_CAST NC_NS_BASE10) != 0 && (targets = malloc(sizeof *targets)) != NULL) {
+			/* an RPC defined by a module */
+			targets[count++] = (const char*)op->ns->href;
+			all = 0;
+		}
+		break;
+	}
+
+activate:
+	if (all) {
+		module_activate_lazy(NULL, 0);
+	} else if (count) {
+		module_activate_lazy(targets, count);
+	}
+
+	free(targets);
+	xmlFree(identifier);
+	xmlFree(type);
+	xmlFreeDoc(doc);
+}
+
+/*
+ * apply an RPC to the datastores, on behalf of a session of the owner or of a worker
+ *
+ * return: reply, state_get is to be passed to state_data_finish() once it is sent
+ */
+nc_reply* np_rpc_apply(struct nc_session* session, const nc_rpc* rpc, struct state_get** state_get) {
+	nc_reply* rpc_reply;
+	struct nc_err* err;
+
+	rpc_activate_lazy(rpc);
+	if (nc_rpc_get_op(rpc) == NC_OP_GET) {
+		/* the datastores are asked for their state data in parallel */
+		rpc_reply = state_data_get(session, rpc, state_get);
+	} else if (commit_writes_config(rpc)) {
+		/* serialized, a commit aligns the candidate with running first, checkpoints record running changes */
+		rpc_reply = commit_apply(session, rpc);
+	} else {
+		rpc_reply = ncds_apply_rpc2all(session, rpc, NULL);
+	}
+	if (rpc_reply == NULL) {
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "For unknown reason no reply was returned by the library.");
+		rpc_reply = nc_reply_error(err);
+	} else if (rpc_reply == NCDS_RPC_NOT_APPLICABLE) {
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "There is no device/data that could be affected.");
+		nc_reply_free(rpc_reply);
+		rpc_reply = nc_reply_error(err);
+	}
+
+	return rpc_reply;
+}
+
+/*
+ * common RPC processing of all the transports, receives a single RPC on the session
+ * and sends the reply
+ *
+ * return: 0 - nothing happened (sleep), 1 - something happened (skip sleep),
+ *         2 - the session is to be closed (skip sleep)
+ */
+int np_rpc_dispatch(struct client_struct* client, struct nc_session* session, volatile struct timeval* last_rpc_time) {
+	nc_rpc* rpc = NULL;
+	nc_reply* rpc_reply = NULL;
+	NC_MSG_TYPE rpc_type;
+	int closing = 0;
+	struct state_get* state_get = NULL;
+	const struct np_transport* tr = np_transport_get(client->transport);
+
+	/* the client does not read the replies, so no more RPCs are read until it does */
+	if (client->outq != NULL && !output_queue_readable(client->outq)) {
+		return 0;
+	}
+
+	/* receive a new RPC */
+	rpc_type = nc_session_recv_rpc(session, 0, &rpc);
+	if (rpc_type == NC_MSG_WOULDBLOCK || rpc_type == NC_MSG_NONE) {
+		/* no RPC, or processed internally */
+		return 0;
+	}
+
+	gettimeofday((struct timeval*)last_rpc_time, NULL);
+
+	if (rpc_type == NC_MSG_UNKNOWN) {
+		if (nc_session_get_status(session) != NC_SESSION_STATUS_WORKING) {
+			/* something really bad happened, and communication is not possible anymore */
+			nc_verb_error("%s: failed to receive client's message (nc session not working)", __func__);
+			return 2;
+		}
+		/* ignore */
+		return 1;
+	}
+
+	if (rpc_type != NC_MSG_RPC) {
+		/* NC_MSG_HELLO, NC_MSG_REPLY, NC_MSG_NOTIFICATION */
+		nc_verb_warning("%s: received a %s RPC from session %s, ignoring", __func__,
+						(rpc_type == NC_MSG_HELLO ? "hello" : (rpc_type == NC_MSG_REPLY ? "reply" : "notification")),
+						nc_session_get_id(session));
+		return 1;
+	}
+
+	/* process the new RPC */
+	switch (nc_rpc_get_op(rpc)) {
+	case NC_OP_CLOSESESSION:
+		closing = 1;
+		rpc_reply = nc_reply_ok();
+		break;
+
+	case NC_OP_KILLSESSION:
+		rpc_reply = rpc_kill_session(client, rpc);
+		break;
+
+	case NC_OP_CREATESUBSCRIPTION:
+		rpc_reply = rpc_create_subscription(session, rpc);
+		break;
+
+	default:
+		if (worker_id() != -1) {
+			/* the datastores are in the owner process */
+			rpc_reply = worker_rpc(session, rpc);
+		} else {
+			rpc_reply = np_rpc_apply(session, rpc, &state_get);
+		}
+		break;
+	}
+
+	/* send reply */
+	if (tr != NULL && tr->reply_batch != NULL) {
+		tr->reply_batch(client, 1);
+	}
+	nc_session_send_reply(session, rpc, rpc_reply);
+	if (tr != NULL && tr->reply_batch != NULL) {
+		tr->reply_batch(client, 0);
+	}
+	nc_reply_free(rpc_reply);
+	/* the datastores that did not reply in time may still use the session and the RPC */
+	state_data_finish(state_get);
+	nc_rpc_free(rpc);
+
+	/* the session is closed only after the reply was sent */
+	return (closing ? 2 : 1);
+}
+
+void* client_main_thread(void* arg);
+
+/* clients waiting in hibernation for their socket to become readable, without a thread */
+static struct {
+	pthread_mutex_t lock;
+	struct np_hibernated {
+		struct client_struct* client;	// NULL once rehydrated, until the array is compacted
+		time_t last_rpc;				// monotonic time of the idle timeout base, 0 if it never expires
+		uint64_t token;					// identifies the events of the client, increasing in the array
+		int watched;					// its socket and wake eventfd are registered in the event set
+	} *clients;
+	unsigned int count;
+	unsigned int size;
+	unsigned int unwatched;	// the clients from this index on are not registered yet
+	uint64_t next_token;
+	int notify_fd;		// eventfd interrupting the hibernation thread wait
+	int trim;			// memory was freed, return it to the system
+} hibernation = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.next_token = 1,
+	.notify_fd = -1
+};
+
+static void client_finish(struct client_struct* client) {
+	/* GLOBAL LOCK */
+	pthread_mutex_lock(&netopeer_state.global_lock);
+
+	np_client_detach(&netopeer_state.clients, client);
+
+	/* GLOBAL UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.global_lock);
+
+	np_client_free(client);
+}
+
+static void client_thread_done(void) {
+	/* GLOBAL LOCK */
+	pthread_mutex_lock(&netopeer_state.global_lock);
+	--netopeer_state.client_threads;
+	pthread_cond_broadcast(&netopeer_state.clients_cond);
+	/* GLOBAL UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.global_lock);
+}
+
+/* return: 0 - the client thread continues, 1 - the client was hibernated, the thread must exit without touching it */
+static int client_hibernate(struct client_struct* client, const struct np_transport* tr) {
+	struct np_hibernated* new_clients;
+	struct timespec ts;
+	struct timeval last_rpc_time, cur_time;
+	uint64_t count = 1;
+
+	/* Call Home apps join the client thread, so their clients must keep it */
+	if (quit || netopeer_options.hibernate_timeout == 0 || hibernation.notify_fd == -1 || client->callhome ||
+			client->wake_fd == -1 || (client->outq != NULL && !output_queue_readable(client->outq)) || tr->client_idle == NULL ||
+			!tr->client_idle(client, netopeer_options.hibernate_timeout, &last_rpc_time)) {
+		return 0;
+	}
+
+	/* the idle timeout is measured from the last RPC, not from the hibernation */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	gettimeofday(&cur_time, NULL);
+
+	/* HIBERNATION LOCK */
+	pthread_mutex_lock(&hibernation.lock);
+
+	if (hibernation.count == hibernation.size) {
+		new_clients = realloc(hibernation.clients, (hibernation.size ? 2*hibernation.size : 16) * sizeof *hibernation.clients);
+		if (new_clients == NULL) {
+			/* HIBERNATION UNLOCK */
+			pthread_mutex_unlock(&hibernation.lock);
+			return 0;
+		}
+		hibernation.clients = new_clients;
+		hibernation.size = (hibernation.size ? 2*hibernation.size : 16);
+	}
+	hibernation.clients[hibernation.count].client = client;
+	hibernation.clients[hibernation.count].last_rpc = (timerisset(&last_rpc_time) ? ts.tv_sec - (time_t)timeval_diff(cur_time, last_rpc_time) : 0);
+	hibernation.clients[hibernation.count].token = hibernation.next_token++;
+	hibernation.clients[hibernation.count].watched = 0;
+	++hibernation.count;
+	hibernation.trim = 1;
+
+	/* HIBERNATION UNLOCK */
+	pthread_mutex_unlock(&hibernation.lock);
+
+	if (write(hibernation.notify_fd, &count, sizeof count) == -1) {
+		nc_verb_error("%s: write failed (%s)", __func__, strerror(errno));
+	}
+
+	return 1;
+}
+
+static void client_rehydrate(struct client_struct* client) {
+	int ret;
+
+	if ((ret = pthread_create((pthread_t*)&client->tid, NULL, client_main_thread, (void*)client)) != 0) {
+		nc_verb_error("%s: failed to create a thread (%s)", __func__, strerror(ret));
+
+		client->to_free = 1;
+		client_finish(client);
+		client_thread_done();
+	}
+}
+
+/* HIBERNATION LOCK is expected to be held */
+static void hibernation_wake(struct np_event* ev, struct np_hibernated* hib) {
+	if (hib->watched) {
+		np_event_unwatch(ev, hib->client->sock, hib->token << 1);
+		np_event_unwatch(ev, hib->client->wake_fd, (hib->token << 1) | 1);
+	}
+	client_rehydrate(hib->client);
+	hib->client = NULL;
+}
+
+/* HIBERNATION LOCK is expected to be held */
+static struct np_hibernated* hibernation_find(uint64_t token) {
+	unsigned int low = 0, high = hibernation.count, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (hibernation.clients[mid].token == token) {
+			return &hibernation.clients[mid];
+		} else if (hibernation.clients[mid].token < token) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return NULL;
+}
+
+static void* hibernation_thread(void* UNUSED(arg)) {
+	struct np_event* ev = NULL;
+	struct np_event_res res[EVENT_BATCH];
+	struct np_hibernated* hib;
+	struct timespec ts;
+	time_t last_scan = 0;
+	unsigned int i, j, unwatched;
+	uint64_t notify_count;
+	int backend = -1, count, trim, notify_watched = 0;
+
+	while (1) {
+		/* HIBERNATION LOCK */
+		pthread_mutex_lock(&hibernation.lock);
+
+		if (quit && hibernation.count == 0) {
+			/* HIBERNATION UNLOCK */
+			pthread_mutex_unlock(&hibernation.lock);
+			break;
+		}
+
+		/* another backend was configured, everything is registered again in a new event set */
+		if (ev == NULL || backend != netopeer_options.io_backend) {
+			np_event_free(ev);
+			backend = netopeer_options.io_backend;
+			if ((ev = np_event_new(backend)) == NULL) {
+				/* HIBERNATION UNLOCK */
+				pthread_mutex_unlock(&hibernation.lock);
+				sleep(1);
+				continue;
+			}
+			notify_watched = 0;
+			for (i = 0; i < hibernation.count; ++i) {
+				hibernation.clients[i].watched = 0;
+			}
+			hibernation.unwatched = 0;
+		}
+
+		/* only the newly hibernated clients are registered, the rest stays registered between the waits */
+		if (!notify_watched) {
+			notify_watched = !np_event_watch(ev, hibernation.notify_fd, POLLIN, 0);
+		}
+		for (i = hibernation.unwatched; i < hibernation.count; ++i) {
+			hib = &hibernation.clients[i];
+			if (hib->client == NULL) {
+				continue;
+			}
+			hib->watched = 1;
+			if (np_event_watch(ev, hib->client->sock, POLLIN, hib->token << 1) ||
+					np_event_watch(ev, hib->client->wake_fd, POLLIN, (hib->token << 1) | 1)) {
+				hibernation_wake(ev, hib);
+			}
+		}
+		hibernation.unwatched = hibernation.count;
+
+		trim = hibernation.trim;
+		hibernation.trim = 0;
+
+		/* HIBERNATION UNLOCK */
+		pthread_mutex_unlock(&hibernation.lock);
+
+		if (trim) {
+			/* the released buffers and thread stacks of the newly hibernated clients */
+			malloc_trim(0);
+		}
+
+		if ((count = np_event_wait(ev, res, EVENT_BATCH, 1000)) == -1) {
+			sleep(1);
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		/* HIBERNATION LOCK */
+		pthread_mutex_lock(&hibernation.lock);
+
+		/* clients are woken up on any socket event or wake request */
+		for (i = 0; i < (unsigned int)count; ++i) {
+			if (res[i].data == 0) {
+				if (read(hibernation.notify_fd, &notify_count, sizeof notify_count) == -1 && errno != EAGAIN) {
+					nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+				}
+				notify_watched = 0;
+			} else if ((hib = hibernation_find(res[i].data >> 1)) != NULL && hib->client != NULL) {
+				hibernation_wake(ev, hib);
+			}
+		}
+
+		/*
+		 * only this thread removes clients, once a second they are checked for
+		 * the idle timeout and the woken ones are removed from the array, on
+		 * shutdown all of them are woken up
+		 */
+		if (quit || ts.tv_sec != last_scan) {
+			last_scan = ts.tv_sec;
+			unwatched = 0;
+			for (i = 0, j = 0; i < hibernation.count; ++i) {
+				if (i == hibernation.unwatched) {
+					unwatched = j;
+				}
+				hib = &hibernation.clients[i];
+				if (hib->client != NULL && (quit || (netopeer_options.idle_timeout && hib->last_rpc &&
+						ts.tv_sec - hib->last_rpc >= netopeer_options.idle_timeout))) {
+					hibernation_wake(ev, hib);
+				}
+				if (hib->client != NULL) {
+					hibernation.clients[j++] = *hib;
+				}
+			}
+			hibernation.unwatched = (hibernation.unwatched >= hibernation.count ? j : unwatched);
+			hibernation.count = j;
+		}
+
+		/* HIBERNATION UNLOCK */
+		pthread_mutex_unlock(&hibernation.lock);
+	}
+
+	np_event_free(ev);
+	return NULL;
+}
+
+static void hibernation_init(void) {
+	pthread_t tid;
+	int ret;
+
+	if ((hibernation.notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		nc_verb_error("%s: eventfd failed (%s), sessions will not be hibernated", __func__, strerror(errno));
+		return;
+	}
+
+	if ((ret = pthread_create(&tid, NULL, hibernation_thread, NULL)) != 0) {
+		nc_verb_error("%s: failed to create a thread (%s), sessions will not be hibernated", __func__, strerror(ret));
+		close(hibernation.notify_fd);
+		hibernation.notify_fd = -1;
+		return;
+	}
+	pthread_detach(tid);
+}
+
+void* client_main_thread(void* arg) {
+	struct client_struct* client = (struct client_struct*)arg;
+	const struct np_transport* tr;
+	int skip_sleep;
+
+	if ((tr = np_transport_get(client->transport)) == NULL) {
+		nc_verb_error("%s: internal error (%s:%d)", __func__, __FILE__, __LINE__);
+		client->to_free = 1;
+	}
+
+	while (!client->to_free) {
+		skip_sleep = tr->client_transport(client);
+		skip_sleep += tr->client_netconf_rpc(client);
+
+		if (!skip_sleep) {
+			if (client_hibernate(client, tr)) {
+				/* the hibernation thread creates a new thread for the client when needed */
+				pthread_detach(pthread_self());
+				return NULL;
+			}
+
+			/* we did not do anything productive, so let the thread sleep */
+			client_sleep(client);
+		}
+	}
+
+	client_finish(client);
+
+	if (tr != NULL && tr->thread_cleanup != NULL) {
+		tr->thread_cleanup();
+	}
+
+	client_thread_done();
+
+	pthread_detach(pthread_self());
+
+	return NULL;
+}
+
+/*
+ * listening sockets kept open across a restart, passed by the previous server
+ * instance or by the service manager, until the binds claim them
+ */
+static struct {
+	int* fds;
+	unsigned int count;
+} handoff = {NULL, 0};
+
+static void handoff_add(int fd) {
+	handoff.fds = realloc(handoff.fds, (handoff.count + 1) * sizeof *handoff.fds);
+	handoff.fds[handoff.count++] = fd;
+}
+
+/* the sockets of the previous instance (hard restart) or of a systemd-style socket activation */
+static void handoff_import(void) {
+	char* str, *ptr;
+	long fd, count;
+
+	if ((str = getenv(ENVIRONMENT_LISTEN_FDS)) != NULL) {
+		for (ptr = str; *ptr != '\0'; ) {
+			fd = strtol(ptr, &ptr, 10);
+			if (fd > STDERR_FILENO && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0) {
+				handoff_add(fd);
+			}
+			if (*ptr != ',') {
+				break;
+			}
+			++ptr;
+		}
+	} else if ((str = getenv("LISTEN_FDS")) != NULL && getenv("LISTEN_PID") != NULL && atol(getenv("LISTEN_PID")) == getpid()) {
+		/* the sockets start at 3 */
+		for (count = atol(str), fd = 3; fd < 3 + count; ++fd) {
+			if (fcntl(fd, F_SETFD, FD_CLOEXEC) == 0) {
+				handoff_add(fd);
+			}
+		}
+	}
+
+	/* not for any processes started by the server */
+	unsetenv(ENVIRONMENT_LISTEN_FDS);
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDNAMES");
+
+	if (handoff.count) {
+		nc_verb_verbose("%u listening sockets passed to the server.", handoff.count);
+	}
+}
+
+/* pass the kept sockets to the executed new instance */
+static void handoff_export(void) {
+	char* str = NULL, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < handoff.count; ++i) {
+		if (fcntl(handoff.fds[i], F_SETFD, 0) != 0) {
+			nc_verb_warning("%s: fcntl failed (%s)", __func__, strerror(errno));
+			continue;
+		}
+		if (asprintf(&tmp, "%s%s%d", (str ? str : ""), (str ? "," : ""), handoff.fds[i]) == -1) {
+			break;
+		}
+		free(str);
+		str = tmp;
+	}
+
+	if (str != NULL) {
+		setenv(ENVIRONMENT_LISTEN_FDS, str, 1);
+		free(str);
+	}
+}
+
+/* return: kept socket listening on the bind address, -1 if there is none */
+static int handoff_take(const struct np_bind_addr* addr) {
+	struct sockaddr_storage saddr, baddr;
+	socklen_t len;
+	unsigned int i;
+	int listening, fd;
+
+	bzero(&baddr, sizeof baddr);
+	if (addr->transport == NP_TRANSPORT_UNIX) {
+		baddr.ss_family = AF_UNIX;
+		if (strlen(addr->addr) >= sizeof ((struct sockaddr_un*)&baddr)->sun_path) {
+			return -1;
+		}
+		strcpy(((struct sockaddr_un*)&baddr)->sun_path, addr->addr);
+	} else if (inet_pton(AF_INET, addr->addr, &((struct sockaddr_in*)&baddr)->sin_addr) == 1) {
+		baddr.ss_family = AF_INET;
+		((struct sockaddr_in*)&baddr)->sin_port = htons(addr->port);
+	} else if (inet_pton(AF_INET6, addr->addr, &((struct sockaddr_in6*)&baddr)->sin6_addr) == 1) {
+		baddr.ss_family = AF_INET6;
+		((struct sockaddr_in6*)&baddr)->sin6_port = htons(addr->port);
+	} else {
+		return -1;
+	}
+
+	for (i = 0; i < handoff.count; ++i) {
+		fd = handoff.fds[i];
+		len = sizeof listening;
+		if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0 || !listening) {
+			continue;
+		}
+		len = sizeof saddr;
+		bzero(&saddr, sizeof saddr);
+		if (getsockname(fd, (struct sockaddr*)&saddr, &len) != 0 || saddr.ss_family != baddr.ss_family) {
+			continue;
+		}
+
+		if ((baddr.ss_family == AF_UNIX && strcmp(((struct sockaddr_un*)&saddr)->sun_path, ((struct sockaddr_un*)&baddr)->sun_path) == 0)
+				|| (baddr.ss_family == AF_INET && !memcmp(&((struct sockaddr_in*)&saddr)->sin_addr, &((struct sockaddr_in*)&baddr)->sin_addr, sizeof(struct in_addr))
+					&& ((struct sockaddr_in*)&saddr)->sin_port == ((struct sockaddr_in*)&baddr)->sin_port)
+				|| (baddr.ss_family == AF_INET6 && !memcmp(&((struct sockaddr_in6*)&saddr)->sin6_addr, &((struct sockaddr_in6*)&baddr)->sin6_addr, sizeof(struct in6_addr))
+					&& ((struct sockaddr_in6*)&saddr)->sin6_port == ((struct sockaddr_in6*)&baddr)->sin6_port)) {
+			handoff.fds[i] = handoff.fds[--handoff.count];
+			return fd;
+		}
+	}
 
-	return NULL;
+	return -1;
 }
 
-void* client_main_thread(void* arg) {
-	struct client_struct* client = (struct client_struct*)arg;
-	int skip_sleep;
+/* close the kept sockets no bind claimed */
+static void handoff_close(void) {
+	unsigned int i;
 
-	do {
-		skip_sleep = 0;
+	for (i = 0; i < handoff.count; ++i) {
+		close(handoff.fds[i]);
+	}
+	free(handoff.fds);
+	handoff.fds = NULL;
+	handoff.count = 0;
+}
 
-		switch (client->transport) {
-#ifdef NP_SSH
-		case NC_TRANSPORT_SSH:
-			skip_sleep += np_ssh_client_transport((struct client_struct_ssh*)client);
-			skip_sleep += np_ssh_client_netconf_rpc((struct client_struct_ssh*)client);
-			break;
-#endif
-#ifdef NP_TLS
-		case NC_TRANSPORT_TLS:
-			skip_sleep += np_tls_client_transport((struct client_struct_tls*)client);
-			skip_sleep += np_tls_client_netconf_rpc((struct client_struct_tls*)client);
-			break;
-#endif
-		default:
-			nc_verb_error("%s: internal error (%s:%d)", __func__, __FILE__, __LINE__);
-		}
+/*
+ * connections accepted by an event set before it was freed (binds or io-backend change,
+ * soft restart), served before any new ones
+ */
+static struct {
+	struct client_struct** clients;
+	unsigned int count;
+} accepted = {NULL, 0};
 
-		if (!skip_sleep) {
-			/* we did not do anything productive, so let the thread sleep */
-			usleep(netopeer_options.response_time*1000);
-		}
-	} while (!client->to_free);
+/* the client of a connection accepted on npsock, NULL on error */
+static struct client_struct* sock_client(const struct np_sock* npsock, const struct np_event_res* res) {
+	struct client_struct* ret;
+	struct sockaddr_storage laddr;
+	socklen_t laddr_len = sizeof laddr;
 
-	/* GLOBAL LOCK */
-	pthread_mutex_lock(&netopeer_state.global_lock);
+	ret = calloc(1, sizeof(struct client_struct));
+	ret->sock = res->fd;
+	ret->wake_fd = -1;
+	memcpy(&ret->saddr, &res->saddr, sizeof ret->saddr);
+	if (np_client_wake_init(ret) != 0) {
+		close(ret->sock);
+		free(ret);
+		return NULL;
+	}
+	ret->transport = npsock->transport[res->data];
 
-	np_client_detach(&netopeer_state.clients, client);
+	/* the profiles are matched against the configured bind, not the local address of the connection */
+	if (ret->transport != NP_TRANSPORT_UNIX && getsockname(npsock->pollsock[res->data].fd, (struct sockaddr*)&laddr, &laddr_len) == 0) {
+		tcp_profile_apply(ret->sock, ret->transport, 0, &laddr);
+	}
 
-	/* GLOBAL UNLOCK */
-	pthread_mutex_unlock(&netopeer_state.global_lock);
+	return ret;
+}
 
-	switch (client->transport) {
-#ifdef NP_SSH
-	case NC_TRANSPORT_SSH:
-		client_free_ssh((struct client_struct_ssh*)client);
-		break;
-#endif
-#ifdef NP_TLS
-	case NC_TRANSPORT_TLS:
-		client_free_tls((struct client_struct_tls*)client);
-		break;
-#endif
-	default:
-		free(client);
-		break;
-	}
+/* free the event set, the connections it accepted meanwhile are not dropped but queued */
+static void sock_event_free(struct np_sock* npsock) {
+	struct np_event_res res[EVENT_BATCH];
+	struct client_struct* client;
+	int i, count;
 
-#ifdef NP_TLS
-	np_tls_thread_cleanup();
-#endif
+	do {
+		count = np_event_cancel(npsock->event, res, EVENT_BATCH);
+		for (i = 0; i < count; ++i) {
+			if ((client = sock_client(npsock, &res[i])) == NULL) {
+				continue;
+			}
+			accepted.clients = realloc(accepted.clients, (accepted.count + 1) * sizeof *accepted.clients);
+			accepted.clients[accepted.count++] = client;
+		}
+	} while (count == EVENT_BATCH);
 
-	pthread_detach(pthread_self());
+	np_event_free(npsock->event);
+	npsock->event = NULL;
+}
 
-	return NULL;
+/* drop the queued connections, nobody is going to serve them */
+static void accepted_drop(void) {
+	unsigned int i;
+
+	for (i = 0; i < accepted.count; ++i) {
+		accepted.clients[i]->to_free = 1;
+		np_client_free(accepted.clients[i]);
+	}
+	free(accepted.clients);
+	accepted.clients = NULL;
+	accepted.count = 0;
 }
 
 static void sock_cleanup(struct np_sock* npsock) {
@@ -299,6 +1303,9 @@ static void sock_cleanup(struct np_sock* npsock) {
 		return;
 	}
 
+	/* no accept may be in flight on a closed socket */
+	sock_event_free(npsock);
+
 	for (i = 0; i < npsock->count; ++i) {
 		close(npsock->pollsock[i].fd);
 	}
@@ -309,6 +1316,17 @@ static void sock_cleanup(struct np_sock* npsock) {
 	npsock->count = 0;
 }
 
+/* like sock_cleanup(), but the listening sockets are kept for the next sock_listen() or a new instance */
+static void sock_keep(struct np_sock* npsock) {
+	unsigned int i;
+
+	for (i = 0; i < npsock->count; ++i) {
+		handoff_add(npsock->pollsock[i].fd);
+	}
+	npsock->count = 0;
+	sock_cleanup(npsock);
+}
+
 static void sock_listen(const struct np_bind_addr* addrs, struct np_sock* npsock) {
 	const int optVal = 1;
 	const socklen_t optLen = sizeof(optVal);
@@ -317,8 +1335,10 @@ static void sock_listen(const struct np_bind_addr* addrs, struct np_sock* npsock
 
 	struct sockaddr_in* saddr4;
 	struct sockaddr_in6* saddr6;
+	struct sockaddr_un* saddru;
 
 	if (addrs == NULL || npsock == NULL) {
+		handoff_close();
 		return;
 	}
 
@@ -338,65 +1358,111 @@ static void sock_listen(const struct np_bind_addr* addrs, struct np_sock* npsock
 
 	/* for every address and port a pollfd struct is created */
 	for (;addrs != NULL; addrs = addrs->next) {
-		npsock->transport[npsock->count-1] = addrs->transport;
-
-		if (strchr(addrs->addr, ':') == NULL) {
-			is_ipv4 = 1;
-		} else {
-			is_ipv4 = 0;
-		}
-
-		npsock->pollsock[npsock->count-1].fd = socket((is_ipv4 ? AF_INET : AF_INET6), SOCK_STREAM, 0);
-		if (npsock->pollsock[npsock->count-1].fd == -1) {
-			nc_verb_error("%s: could not create socket (%s)", __func__, strerror(errno));
+		/* the workers accept on the SSH and TLS binds, the owner on the Unix sockets */
+		if (addrs->transport == NP_TRANSPORT_UNIX ? worker_id() != -1 : worker_count() > 0) {
 			continue;
 		}
 
-		if (setsockopt(npsock->pollsock[npsock->count-1].fd, SOL_SOCKET, SO_REUSEADDR, (void*) &optVal, optLen) != 0) {
-			nc_verb_error("%s: could not set socket SO_REUSEADDR option (%s)", __func__, strerror(errno));
-			continue;
-		}
+		npsock->transport[npsock->count-1] = addrs->transport;
 
-		if (fcntl(npsock->pollsock[npsock->count-1].fd, F_SETFD, FD_CLOEXEC) != 0) {
-			nc_verb_error("%s: fcntl failed (%s)", __func__, strerror(errno));
+		if ((npsock->pollsock[npsock->count-1].fd = handoff_take(addrs)) != -1) {
+			/* the connections waiting in its backlog are accepted now */
+			nc_verb_verbose("%s: reusing the listening socket of \"%s\" port %d", __func__, addrs->addr, addrs->port);
+		} else if (worker_id() != -1) {
+			/* a worker accepts only on the sockets of the owner, it could not listen on this one */
 			continue;
-		}
-
-		bzero(&saddr, sizeof(struct sockaddr_storage));
-		if (is_ipv4) {
-			saddr4 = (struct sockaddr_in*)&saddr;
-
-			saddr4->sin_family = AF_INET;
-			saddr4->sin_port = htons(addrs->port);
+		} else if (addrs->transport == NP_TRANSPORT_UNIX) {
+			saddru = (struct sockaddr_un*)&saddr;
+			bzero(saddru, sizeof(struct sockaddr_un));
+			saddru->sun_family = AF_UNIX;
+			if (strlen(addrs->addr) >= sizeof saddru->sun_path) {
+				nc_verb_error("%s: Unix socket path \"%s\" too long", __func__, addrs->addr);
+				continue;
+			}
+			strcpy(saddru->sun_path, addrs->addr);
 
-			if (inet_pton(AF_INET, addrs->addr, &saddr4->sin_addr) != 1) {
-				nc_verb_error("%s: failed to convert IPv4 address \"%s\"", __func__, addrs->addr);
+			npsock->pollsock[npsock->count-1].fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (npsock->pollsock[npsock->count-1].fd == -1) {
+				nc_verb_error("%s: could not create socket (%s)", __func__, strerror(errno));
 				continue;
 			}
 
-			if (bind(npsock->pollsock[npsock->count-1].fd, (struct sockaddr*)saddr4, sizeof(struct sockaddr_in)) == -1) {
-				nc_verb_error("%s: could not bind \"%s\" port %d (%s)", __func__, addrs->addr, addrs->port, strerror(errno));
+			if (fcntl(npsock->pollsock[npsock->count-1].fd, F_SETFD, FD_CLOEXEC) != 0) {
+				nc_verb_error("%s: fcntl failed (%s)", __func__, strerror(errno));
+				close(npsock->pollsock[npsock->count-1].fd);
 				continue;
 			}
 
+			/* remove a stale socket left by a previous run */
+			if (unlink(addrs->addr) == -1 && errno != ENOENT) {
+				nc_verb_warning("%s: could not remove \"%s\" (%s)", __func__, addrs->addr, strerror(errno));
+			}
+
+			if (bind(npsock->pollsock[npsock->count-1].fd, (struct sockaddr*)saddru, sizeof(struct sockaddr_un)) == -1) {
+				nc_verb_error("%s: could not bind \"%s\" (%s)", __func__, addrs->addr, strerror(errno));
+				close(npsock->pollsock[npsock->count-1].fd);
+				continue;
+			}
 		} else {
-			saddr6 = (struct sockaddr_in6*)&saddr;
+			if (strchr(addrs->addr, ':') == NULL) {
+				is_ipv4 = 1;
+			} else {
+				is_ipv4 = 0;
+			}
 
-			saddr6->sin6_family = AF_INET6;
-			saddr6->sin6_port = htons(addrs->port);
+			npsock->pollsock[npsock->count-1].fd = socket((is_ipv4 ? AF_INET : AF_INET6), SOCK_STREAM, 0);
+			if (npsock->pollsock[npsock->count-1].fd == -1) {
+				nc_verb_error("%s: could not create socket (%s)", __func__, strerror(errno));
+				continue;
+			}
 
-			if (inet_pton(AF_INET6, addrs->addr, &saddr6->sin6_addr) != 1) {
-				nc_verb_error("%s: failed to convert IPv6 address \"%s\"", __func__, addrs->addr);
+			if (setsockopt(npsock->pollsock[npsock->count-1].fd, SOL_SOCKET, SO_REUSEADDR, (void*) &optVal, optLen) != 0) {
+				nc_verb_error("%s: could not set socket SO_REUSEADDR option (%s)", __func__, strerror(errno));
 				continue;
 			}
 
-			if (bind(npsock->pollsock[npsock->count-1].fd, (struct sockaddr*)saddr6, sizeof(struct sockaddr_in6)) == -1) {
-				nc_verb_error("%s: could not bind \"%s\" port %d (%s)", __func__, addrs->addr, addrs->port, strerror(errno));
+			if (fcntl(npsock->pollsock[npsock->count-1].fd, F_SETFD, FD_CLOEXEC) != 0) {
+				nc_verb_error("%s: fcntl failed (%s)", __func__, strerror(errno));
 				continue;
 			}
+
+			bzero(&saddr, sizeof(struct sockaddr_storage));
+			if (is_ipv4) {
+				saddr4 = (struct sockaddr_in*)&saddr;
+
+				saddr4->sin_family = AF_INET;
+				saddr4->sin_port = htons(addrs->port);
+
+				if (inet_pton(AF_INET, addrs->addr, &saddr4->sin_addr) != 1) {
+					nc_verb_error("%s: failed to convert IPv4 address \"%s\"", __func__, addrs->addr);
+					continue;
+				}
+
+				if (bind(npsock->pollsock[npsock->count-1].fd, (struct sockaddr*)saddr4, sizeof(struct sockaddr_in)) == -1) {
+					nc_verb_error("%s: could not bind \"%s\" port %d (%s)", __func__, addrs->addr, addrs->port, strerror(errno));
+					continue;
+				}
+
+			} else {
+				saddr6 = (struct sockaddr_in6*)&saddr;
+
+				saddr6->sin6_family = AF_INET6;
+				saddr6->sin6_port = htons(addrs->port);
+
+				if (inet_pton(AF_INET6, addrs->addr, &saddr6->sin6_addr) != 1) {
+					nc_verb_error("%s: failed to convert IPv6 address \"%s\"", __func__, addrs->addr);
+					continue;
+				}
+
+				if (bind(npsock->pollsock[npsock->count-1].fd, (struct sockaddr*)saddr6, sizeof(struct sockaddr_in6)) == -1) {
+					nc_verb_error("%s: could not bind \"%s\" port %d (%s)", __func__, addrs->addr, addrs->port, strerror(errno));
+					continue;
+				}
+			}
 		}
 
-		if (listen(npsock->pollsock[npsock->count-1].fd, 5) == -1) {
+		/* the backlog holds the connections made while the server is restarting */
+		if (listen(npsock->pollsock[npsock->count-1].fd, SOMAXCONN) == -1) {
 			nc_verb_error("%s: unable to start listening on \"%s\" port %d (%s)", __func__, addrs->addr, addrs->port, strerror(errno));
 			continue;
 		}
@@ -411,57 +1477,103 @@ static void sock_listen(const struct np_bind_addr* addrs, struct np_sock* npsock
 
 	/* the last pollsock is not valid */
 	--npsock->count;
+
+	/* the sockets of the removed binds */
+	handoff_close();
+}
+
+/*
+ * the SSH and TLS listening sockets of the owner, every worker accepts on them,
+ * so they stay open while a worker or the whole server restarts
+ */
+static struct {
+	int* fds;
+	unsigned int count;
+} shared = {NULL, 0};
+
+/* listen on all the binds before the workers are forked, the SSH and TLS sockets are shared */
+static void handoff_share(void) {
+	struct np_sock npsock = {.count = 0};
+	unsigned int i;
+	int fd, flags;
+
+	/* BINDS LOCK */
+	pthread_mutex_lock(&netopeer_options.binds_lock);
+	sock_listen(netopeer_options.binds, &npsock);
+	/* BINDS UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.binds_lock);
+
+	for (i = 0; i < npsock.count; ++i) {
+		fd = npsock.pollsock[i].fd;
+		if (npsock.transport[i] == NP_TRANSPORT_UNIX) {
+			/* taken again by the listen loop of the owner */
+			handoff_add(fd);
+			continue;
+		}
+
+		/* a worker that lost a connection to another one must not block in accept() */
+		if ((flags = fcntl(fd, F_GETFL)) == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+			nc_verb_warning("%s: fcntl failed (%s)", __func__, strerror(errno));
+		}
+		shared.fds = realloc(shared.fds, (shared.count + 1) * sizeof *shared.fds);
+		shared.fds[shared.count++] = fd;
+	}
+	npsock.count = 0;
+	sock_cleanup(&npsock);
+}
+
+/* the shared sockets are listened on by this process (a worker, the owner without workers) or a new instance */
+static void handoff_unshare(void) {
+	unsigned int i;
+
+	for (i = 0; i < shared.count; ++i) {
+		handoff_add(shared.fds[i]);
+	}
+	free(shared.fds);
+	shared.fds = NULL;
+	shared.count = 0;
+}
+
+/* (re)create the event set of the listening sockets with the configured backend */
+static void sock_event(struct np_sock* npsock) {
+	unsigned int i;
+
+	sock_event_free(npsock);
+	npsock->backend = netopeer_options.io_backend;
+	if ((npsock->event = np_event_new(npsock->backend)) == NULL) {
+		return;
+	}
+
+	for (i = 0; i < npsock->count; ++i) {
+		np_event_listen(npsock->event, npsock->pollsock[i].fd, i);
+	}
 }
 
 /* always returns only a single new connection */
 static struct client_struct* sock_accept(const struct np_sock* npsock) {
-	int r, flags;
-	unsigned int i;
-	socklen_t client_saddr_len;
-	struct client_struct* ret;
+	struct np_event_res res;
 
 	if (npsock == NULL) {
 		return NULL;
 	}
 
-	/* poll for a new connection */
-	errno = 0;
-	r = poll(npsock->pollsock, npsock->count, netopeer_options.response_time);
-	if (r == 0 || (r == -1 && errno == EINTR)) {
-		/* we either timeouted or going to exit or restart */
-		return NULL;
+	if (accepted.count) {
+		return accepted.clients[--accepted.count];
 	}
-	if (r == -1) {
-		nc_verb_error("%s: poll failed (%s)", __func__, strerror(errno));
+
+	if (npsock->event == NULL) {
+		/* it is created again in the next iteration */
+		usleep(netopeer_options.response_time*1000);
 		return NULL;
 	}
 
-	ret = calloc(1, sizeof(struct client_struct));
-	client_saddr_len = sizeof(struct sockaddr_storage);
-
-	/* accept the first polled connection */
-	for (i = 0; i < npsock->count; ++i) {
-		if (npsock->pollsock[i].revents & POLLIN) {
-			ret->sock = accept(npsock->pollsock[i].fd, (struct sockaddr*)&ret->saddr, &client_saddr_len);
-			if (ret->sock == -1) {
-				nc_verb_error("%s: accept failed (%s)", __func__, strerror(errno));
-				free(ret);
-				return NULL;
-			}
-			/* make the socket non-blocking */
-			if (((flags = fcntl(ret->sock, F_GETFL)) == -1) || (fcntl(ret->sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
-				nc_verb_error("%s: fcntl failed (%s)", __func__, strerror(errno));
-				close(ret->sock);
-				free(ret);
-				return NULL;
-			}
-			ret->transport = npsock->transport[i];
-			npsock->pollsock[i].revents = 0;
-			break;
-		}
+	/* wait for a new connection, it is accepted by the event backend as well */
+	if (np_event_wait(npsock->event, &res, 1, netopeer_options.response_time) < 1) {
+		/* we either timeouted, failed, or going to exit or restart */
+		return NULL;
 	}
 
-	return ret;
+	return sock_client(npsock, &res);
 }
 
 static void clear_broadcast_callhome_client(int fail) {
@@ -478,26 +1590,59 @@ static void clear_broadcast_callhome_client(int fail) {
     pthread_mutex_unlock(&callhome_lock);
 }
 
+/* return: 0 - all the clients finished, 1 - shutdown timeout elapsed */
+static int shutdown_clients(void) {
+	struct client_struct* client;
+	struct timespec start, end, deadline;
+	unsigned int left;
+	int ret = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += SHUTDOWN_TIMEOUT;
+
+	/* GLOBAL LOCK */
+	pthread_mutex_lock(&netopeer_state.global_lock);
+
+	/*
+	 * wake all the client threads at once so that they notice quit right away
+	 * and close their sessions concurrently instead of on their next poll period
+	 */
+	for (client = netopeer_state.clients; client != NULL; client = client->next) {
+		np_client_wake(client);
+	}
+
+	while (netopeer_state.client_threads > 0 && ret != ETIMEDOUT) {
+		ret = pthread_cond_timedwait(&netopeer_state.clients_cond, &netopeer_state.global_lock, &deadline);
+	}
+	left = netopeer_state.client_threads;
+
+	/* GLOBAL UNLOCK */
+	pthread_mutex_unlock(&netopeer_state.global_lock);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (left > 0) {
+		nc_verb_error("Shutdown timeout (%d s) elapsed with %u client(s) still running.", SHUTDOWN_TIMEOUT, left);
+		return 1;
+	}
+
+	nc_verb_verbose("All the clients finished in %ld ms.", (long)((end.tv_sec - start.tv_sec)*1000 + (end.tv_nsec - start.tv_nsec)/1000000));
+	return 0;
+}
+
 void listen_loop(int do_init) {
 	struct client_struct* new_client;
 	struct np_sock npsock = {.count = 0};
-	pthread_t client_tid;
-	int ret;
-#ifdef NP_SSH
-	ssh_bind sshbind = NULL;
-#endif
-#ifdef NP_TLS
-	SSL_CTX* tlsctx = NULL;
-#endif
+	void* transport_ctx[NP_TRANSPORT_COUNT] = {NULL};
+	int ret, i;
 
 	/* Init */
 	if (do_init) {
-#ifdef NP_SSH
-		np_ssh_init();
-#endif
-#ifdef NP_TLS
-		np_tls_init();
-#endif
+		for (i = 0; np_transports[i] != NULL; ++i) {
+			np_transports[i]->init();
+		}
+		hibernation_init();
+		output_queue_init();
 	}
 
 	/* Main accept loop */
@@ -509,24 +1654,29 @@ void listen_loop(int do_init) {
 			/* BINDS LOCK */
 			pthread_mutex_lock(&netopeer_options.binds_lock);
 
-			sock_cleanup(&npsock);
+			/* the unchanged binds keep their sockets */
+			sock_keep(&npsock);
 			sock_listen(netopeer_options.binds, &npsock);
 
 			netopeer_options.binds_change_flag = 0;
 			/* BINDS UNLOCK */
 			pthread_mutex_unlock(&netopeer_options.binds_lock);
 
-			if (npsock.count == 0) {
+			if (npsock.count == 0 && worker_count() == 0) {
 				nc_verb_warning("Server is not listening on any address!");
 			}
 		}
 
-#ifdef NP_SSH
-		sshbind = np_ssh_server_id_check(sshbind);
-#endif
-#ifdef NP_TLS
-		tlsctx = np_tls_server_id_check(tlsctx);
-#endif
+		/* Event backend change check */
+		if (npsock.event == NULL || npsock.backend != netopeer_options.io_backend) {
+			sock_event(&npsock);
+		}
+
+		for (i = 0; np_transports[i] != NULL; ++i) {
+			if (np_transports[i]->server_id_check != NULL) {
+				transport_ctx[i] = np_transports[i]->server_id_check(transport_ctx[i]);
+			}
+		}
 
 		/* Callhome client check */
         /* CALLHOME LOCK */
@@ -550,33 +1700,16 @@ void listen_loop(int do_init) {
 				ret = 0;
 				/* GLOBAL LOCK */
 				pthread_mutex_lock(&netopeer_state.global_lock);
-#ifdef NP_SSH
-				ret += np_ssh_session_count();
-#endif
-#ifdef NP_TLS
-				ret += np_tls_session_count();
-#endif
+				for (i = 0; np_transports[i] != NULL; ++i) {
+					ret += np_transports[i]->session_count();
+				}
 				/* GLOBAL UNLOCK */
 				pthread_mutex_unlock(&netopeer_state.global_lock);
 
 				if (ret >= netopeer_options.max_sessions) {
 					nc_verb_error("Maximum number of sessions reached, droppping the new client.");
 					new_client->to_free = 1;
-					switch (new_client->transport) {
-#ifdef NP_SSH
-					case NC_TRANSPORT_SSH:
-						client_free_ssh((struct client_struct_ssh*)new_client);
-						break;
-#endif
-#ifdef NP_TLS
-					case NC_TRANSPORT_TLS:
-						client_free_tls((struct client_struct_tls*)new_client);
-						break;
-#endif
-					default:
-						free(new_client);
-						nc_verb_error("%s: internal error (%s:%d)", __func__, __FILE__, __LINE__);
-					}
+					np_client_free(new_client);
 
 					clear_broadcast_callhome_client(1);
 
@@ -586,29 +1719,13 @@ void listen_loop(int do_init) {
 				}
 			}
 
-			switch (new_client->transport) {
-#ifdef NP_SSH
-			case NC_TRANSPORT_SSH:
-				ret = np_ssh_create_client((struct client_struct_ssh*)new_client, sshbind);
-				if (ret != 0) {
-					new_client->to_free = 1;
-					client_free_ssh((struct client_struct_ssh*)new_client);
-				}
-				break;
-#endif
-#ifdef NP_TLS
-			case NC_TRANSPORT_TLS:
-				ret = np_tls_create_client((struct client_struct_tls*)new_client, tlsctx);
-				if (ret != 0) {
-					new_client->to_free = 1;
-					client_free_tls((struct client_struct_tls*)new_client);
-				}
-				break;
-#endif
-			default:
+			if ((i = np_transport_idx(new_client->transport)) == -1) {
 				nc_verb_error("Client with an unknown transport protocol, dropping it.");
 				free(new_client);
 				ret = 1;
+			} else if ((ret = np_transports[i]->create_client(new_client, transport_ctx[i])) != 0) {
+				new_client->to_free = 1;
+				np_client_free(new_client);
 			}
 
 			/* client is not valid, some error occured */
@@ -621,6 +1738,7 @@ void listen_loop(int do_init) {
 			/* GLOBAL LOCK */
 			pthread_mutex_lock(&netopeer_state.global_lock);
 			client_append(&netopeer_state.clients, new_client);
+			++netopeer_state.client_threads;
 			/* GLOBAL UNLOCK */
 			pthread_mutex_unlock(&netopeer_state.global_lock);
 
@@ -631,26 +1749,13 @@ void listen_loop(int do_init) {
 				/* GLOBAL LOCK */
 				pthread_mutex_lock(&netopeer_state.global_lock);
 				np_client_detach(&netopeer_state.clients, new_client);
+				--netopeer_state.client_threads;
 				/* GLOBAL UNLOCK */
 				pthread_mutex_unlock(&netopeer_state.global_lock);
 
 				new_client->tid = 0;
 				new_client->to_free = 1;
-				switch (new_client->transport) {
-#ifdef NP_SSH
-				case NC_TRANSPORT_SSH:
-					client_free_ssh((struct client_struct_ssh*)new_client);
-					break;
-#endif
-#ifdef NP_TLS
-				case NC_TRANSPORT_TLS:
-					client_free_tls((struct client_struct_tls*)new_client);
-					break;
-#endif
-				default:
-					free(new_client);
-					break;
-				}
+				np_client_free(new_client);
 
 				clear_broadcast_callhome_client(1);
 				continue;
@@ -663,48 +1768,30 @@ void listen_loop(int do_init) {
 	} while (!quit && !restart_soft);
 
 	/* Cleanup */
-	sock_cleanup(&npsock);
-#ifdef NP_SSH
-	ssh_bind_free(sshbind);
-#endif
-#ifdef NP_TLS
-	SSL_CTX_free(tlsctx);
-#endif
+	if (restart_soft || restart_hard) {
+		/* the connections are accepted once the server listens again */
+		sock_keep(&npsock);
+	} else {
+		sock_cleanup(&npsock);
+	}
+	for (i = 0; np_transports[i] != NULL; ++i) {
+		if (np_transports[i]->ctx_free != NULL) {
+			np_transports[i]->ctx_free(transport_ctx[i]);
+		}
+	}
 	if (!restart_soft) {
-		/* wait for all the clients to exit nicely themselves */
-		while (1) {
-			/* GLOBAL LOCK */
-			pthread_mutex_lock(&netopeer_state.global_lock);
-
-			if (netopeer_state.clients == NULL) {
-				/* GLOBAL UNLOCK */
-				pthread_mutex_unlock(&netopeer_state.global_lock);
-
-				break;
-			}
-
-			client_tid = netopeer_state.clients->tid;
-
-			/* GLOBAL UNLOCK */
-			pthread_mutex_unlock(&netopeer_state.global_lock);
-
-			ret = pthread_join(client_tid, NULL);
-			if (ret == EINVAL) {
-				/* Call Home app is already waiting for it, let it handle it */
-				usleep(10000);
-				continue;
-			}
-			if (ret != 0) {
-				nc_verb_error("Failed to join client thread (%s).", strerror(ret));
-			}
+		/* a shutdown or a hard restart ends all the sessions, so also the connections queued for one */
+		accepted_drop();
+		if (shutdown_clients() != 0) {
+			/* some client threads are still running, they may use the transport contexts */
+			return;
 		}
+		/* the last replies of the freed clients */
+		output_queue_cleanup();
 
-#ifdef NP_SSH
-		np_ssh_cleanup();
-#endif
-#ifdef NP_TLS
-		np_tls_cleanup();
-#endif
+		for (i = 0; np_transports[i] != NULL; ++i) {
+			np_transports[i]->cleanup();
+		}
 	}
 }
 
@@ -714,7 +1801,7 @@ int main(int argc, char** argv) {
 
 	char *aux_string = NULL, path[PATH_MAX+1];
 	int next_option;
-	int daemonize = 0, len;
+	int daemonize = 0, len, ret;
 	int listen_init = 1;
 	struct np_module* netopeer_module = NULL, *server_module = NULL;
 
@@ -758,6 +1845,9 @@ int main(int argc, char** argv) {
 	sigaction(SIGABRT, &action, NULL);
 	sigaction(SIGTERM, &action, NULL);
 	sigaction(SIGHUP, &action, NULL);
+	/* a write to a closed session output queue or socket fails with EPIPE instead */
+	action.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &action, NULL);
 
 	nc_callback_print(clb_print);
 
@@ -767,6 +1857,9 @@ int main(int argc, char** argv) {
 	}
 	nc_verbosity(netopeer_options.verbose);
 
+	/* before daemon() changes the PID of a socket activation */
+	handoff_import();
+
 	/* go to the background as a daemon */
 	if (daemonize == 1) {
 		if (daemon(0, 0) != 0) {
@@ -799,6 +1892,9 @@ int main(int argc, char** argv) {
 
 	server_start = 1;
 
+	/* parse all the module configurations once, they are kept up to date by inotify */
+	module_cfg_init();
+
 restart:
 	/* start NETCONF server module */
 	if ((server_module = calloc(1, sizeof(struct np_module))) == NULL) {
@@ -829,11 +1925,54 @@ restart:
 		return EXIT_FAILURE;
 	}
 
+	/*
+	 * the workers are started once, they keep running across soft restarts, and
+	 * they are forked while this is the only thread, the threads of the owner and
+	 * of the other modules are started only then
+	 */
+	if (listen_init && netopeer_options.workers > 0) {
+		handoff_share();
+		if ((ret = worker_start(netopeer_options.workers)) == 0) {
+			/* only the SSH and TLS sockets of the owner */
+			handoff_close();
+			handoff_unshare();
+			listen_loop(1);
+			/* the datastores and the library belong to the owner */
+			nc_verb_verbose("Worker %d finished.", worker_id());
+			_exit(EXIT_SUCCESS);
+		} else if (ret == -1) {
+			/* no worker, the owner accepts on them itself */
+			handoff_unshare();
+		}
+	}
+
+	if (listen_init) {
+		/* the threads applying <get> to the datastores */
+		state_data_init();
+		if (module_enable_deferred()) {
+			nc_verb_error("Starting the modules of the Netopeer configuration failed!");
+			worker_stop();
+			module_disable(server_module, 1);
+			module_disable(netopeer_module, 1);
+			return EXIT_FAILURE;
+		}
+		np_journal_start();
+		callhome_start();
+	}
+
 	server_start = 0;
 	nc_verb_verbose("Netopeer server successfully initialized.");
 
 	listen_loop(listen_init);
 
+	if (!restart_soft) {
+		/* the workers finish their sessions while the datastores still exist */
+		worker_stop();
+	}
+
+	/* roll back an unconfirmed commit while the datastores still exist */
+	commit_cleanup();
+
 	/* unload Netopeer module -> unload all modules */
 	module_disable(server_module, 1);
 	module_disable(netopeer_module, 1);
@@ -855,7 +1994,12 @@ restart:
 		len = readlink("/proc/self/exe", path, PATH_MAX);
 		if (len > 0) {
 			path[len] = 0;
+			state_data_cleanup();
+			module_cfg_cleanup();
 			xmlCleanupParser();
+			/* the workers are gone, the new instance gets the SSH and TLS sockets they accepted on */
+			handoff_unshare();
+			handoff_export();
 			execv(path, argv);
 		}
 		nc_verb_error("Failed to get the path to self.");
@@ -867,6 +2011,8 @@ restart:
 	 *Free the global variables that may
 	 *have been allocated by the parser.
 	 */
+	state_data_cleanup();
+	module_cfg_cleanup();
 	xmlCleanupParser();
 
 	return EXIT_SUCCESS;
@@ -53,13 +53,24 @@ struct client_struct {
 	NC_TRANSPORT transport;
 
 	int sock;
+	int wake_fd;		// eventfd used to interrupt the client thread sleep
+	int callhome;		// the client thread is joined by its Call Home app
 	struct sockaddr_storage saddr;
 	volatile pthread_t tid;
 	char* username;
 	volatile int to_free;
 	struct client_struct* next;
+	struct output_queue* outq;	// buffered session output, NULL if not used
 
-	char __padding[((((CLIENT_STRUCT_MAX_SIZE) - 2*sizeof(int)) - sizeof(struct sockaddr_storage)) - 3*sizeof(void*)) - sizeof(NC_TRANSPORT)];
+	char __padding[((((CLIENT_STRUCT_MAX_SIZE) - 4*sizeof(int)) - sizeof(struct sockaddr_storage)) - 4*sizeof(void*)) - sizeof(NC_TRANSPORT)];
+};
+
+/* for each NETCONF session, indexed by its ID */
+struct np_sess_idx {
+	char* sid;
+	struct client_struct* client;	// client (thread) handling the session
+	volatile int* to_free;			// flag to set when the session is to be killed
+	struct np_sess_idx* next;
 };
 
 /* one global structure */
@@ -67,9 +78,45 @@ struct np_state {
 	/* locked when adding/removing clients */
 	pthread_mutex_t global_lock;
 	struct client_struct* clients;
+	unsigned int client_threads;	// running or hibernated client threads, signalled on clients_cond on exit
+	pthread_cond_t clients_cond;
+	/* locked when adding/removing/killing sessions */
+	pthread_mutex_t sess_idx_lock;
+	struct np_sess_idx* sess_idx[SESSION_INDEX_SIZE];
 	struct np_state_tls* tls_state;
 };
 
+/* transport implementation, one for each supported NC_TRANSPORT */
+struct np_transport {
+	NC_TRANSPORT transport;
+	const char* name;
+
+	void (*init)(void);
+	/* optional, create or refresh (on a configuration change) the server context, the old one is freed if replaced */
+	void* (*server_id_check)(void* ctx);
+	void (*ctx_free)(void* ctx);
+	/* transport handshake of a newly accepted client */
+	int (*create_client)(struct client_struct* client, void* ctx);
+	/* process transport events, return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
+	int (*client_transport)(struct client_struct* client);
+	/* receive and dispatch NETCONF RPCs, return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
+	int (*client_netconf_rpc)(struct client_struct* client);
+	/*
+	 * optional, whether all the sessions of the client are idle for timeout seconds with no data buffered,
+	 * last_rpc_time is set to the oldest last RPC of the sessions without a subscription, cleared if none
+	 */
+	int (*client_idle)(struct client_struct* client, unsigned int timeout, struct timeval* last_rpc_time);
+	/* optional, called with 1 before a reply is sent and with 0 after it */
+	void (*reply_batch)(struct client_struct* client, int start);
+	/* close the transport and free the client */
+	void (*client_free)(struct client_struct* client);
+	/* number of the NETCONF sessions, GLOBAL LOCK is expected to be held */
+	int (*session_count)(void);
+	/* optional, called by every client thread on its exit */
+	void (*thread_cleanup)(void);
+	void (*cleanup)(void);
+};
+
 struct ntf_thread_config {
 	struct nc_session* session;
 	nc_rpc* subscribe_rpc;
@@ -79,12 +126,34 @@ struct np_sock {
 	struct pollfd* pollsock;
 	NC_TRANSPORT* transport;
 	unsigned int count;
+	struct np_event* event;		// accepting on all the sockets
+	uint8_t backend;			// configured when the event set was created
 };
 
 unsigned int timeval_diff(struct timeval tv1, struct timeval tv2);
 
 void* client_notif_thread(void* arg);
 
+const struct np_transport* np_transport_get(NC_TRANSPORT transport);
+
+void np_client_free(struct client_struct* client);
+
+struct state_get;
+
+nc_reply* np_rpc_apply(struct nc_session* session, const nc_rpc* rpc, struct state_get** state_get);
+
+int np_rpc_dispatch(struct client_struct* client, struct nc_session* session, volatile struct timeval* last_rpc_time);
+
 void np_client_detach(struct client_struct** root, struct client_struct* del_client);
 
+int np_client_wake_init(struct client_struct* client);
+
+void np_client_wake(struct client_struct* client);
+
+void np_session_index_add(struct nc_session* session, struct client_struct* client, volatile int* to_free);
+
+void np_session_index_del(const char* sid);
+
+int np_session_kill(const char* sid, const struct client_struct* cur_client);
+
 #endif /* _SERVER_H_ */
\ No newline at end of file
@@ -105,7 +105,7 @@ int callback_n_netopeer_n_ssh_n_server_keys_n_rsa_key(void** UNUSED(data), XMLDI
 	if (op & XMLDIFF_REM) {
 		free(netopeer_options.ssh_opts->rsa_key);
 		netopeer_options.ssh_opts->rsa_key = strdup("/etc/ssh/ssh_host_rsa_key");
-		netopeer_options.ssh_opts->server_key_change_flag = 1;
+		np_ssh_server_id_reload();
 		return EXIT_SUCCESS;
 	}
 
@@ -118,7 +118,7 @@ int callback_n_netopeer_n_ssh_n_server_keys_n_rsa_key(void** UNUSED(data), XMLDI
 
 	free(netopeer_options.ssh_opts->rsa_key);
 	netopeer_options.ssh_opts->rsa_key = strdup(content);
-	netopeer_options.ssh_opts->server_key_change_flag = 1;
+	np_ssh_server_id_reload();
 	return EXIT_SUCCESS;
 }
 
@@ -139,7 +139,7 @@ int callback_n_netopeer_n_ssh_n_server_keys_n_dsa_key(void** UNUSED(data), XMLDI
 	if (op & XMLDIFF_REM) {
 		free(netopeer_options.ssh_opts->dsa_key);
 		netopeer_options.ssh_opts->dsa_key = NULL;
-		netopeer_options.ssh_opts->server_key_change_flag = 1;
+		np_ssh_server_id_reload();
 		return EXIT_SUCCESS;
 	}
 
@@ -152,7 +152,7 @@ int callback_n_netopeer_n_ssh_n_server_keys_n_dsa_key(void** UNUSED(data), XMLDI
 
 	free(netopeer_options.ssh_opts->dsa_key);
 	netopeer_options.ssh_opts->dsa_key = strdup(content);
-	netopeer_options.ssh_opts->server_key_change_flag = 1;
+	np_ssh_server_id_reload();
 	return EXIT_SUCCESS;
 }
 
@@ -380,6 +380,41 @@ int callback_n_netopeer_n_ssh_n_auth_timeout(void** UNUSED(data), XMLDIFF_OP op,
 	return EXIT_SUCCESS;
 }
 
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:ssh/n:coalesce-replies changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_ssh_n_coalesce_replies(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL;
+
+	if (op & XMLDIFF_REM) {
+		netopeer_options.ssh_opts->coalesce_replies = 1;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	/* applied from the next reply on */
+	if (strcmp(content, "false") == 0) {
+		netopeer_options.ssh_opts->coalesce_replies = 0;
+	} else {
+		netopeer_options.ssh_opts->coalesce_replies = 1;
+	}
+	return EXIT_SUCCESS;
+}
+
 int netopeer_transapi_init_ssh(void) {
 	xmlDocPtr doc;
 	struct nc_err* error = NULL;
@@ -389,6 +424,7 @@ int netopeer_transapi_init_ssh(void) {
 
 	netopeer_options.ssh_opts = calloc(1, sizeof(struct np_options_ssh));
 	pthread_mutex_init(&netopeer_options.ssh_opts->client_keys_lock, NULL);
+	netopeer_options.ssh_opts->coalesce_replies = 1;
 
 	doc = xmlReadDoc(BAD_CAST "<netopeer xmlns=\"urn:cesnet:tmc:netopeer:1.0\"><ssh><server-keys><rsa-key>/etc/ssh/ssh_host_rsa_key</rsa-key></server-keys><password-auth-enabled>true</password-auth-enabled><auth-attempts>3</auth-attempts><auth-timeout>10</auth-timeout></ssh></netopeer>",
 		NULL, NULL, 0);
@@ -40,7 +40,6 @@
 #define _CFGNETOPEER_TRANSAPI_SSH_H_
 
 struct np_options_ssh {
-	uint8_t server_key_change_flag;		// flag to communicate server key change
 	char* rsa_key;
 	char* dsa_key;
 	pthread_mutex_t client_keys_lock;
@@ -53,6 +52,7 @@ struct np_options_ssh {
 	uint8_t password_auth_enabled;
 	uint8_t auth_attempts;
 	uint16_t auth_timeout;
+	uint8_t coalesce_replies;
 };
 
 int netopeer_transapi_init_ssh(void);
@@ -69,6 +69,8 @@ int callback_n_netopeer_n_ssh_n_auth_attempts(void** UNUSED(data), XMLDIFF_OP op
 
 int callback_n_netopeer_n_ssh_n_auth_timeout(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error);
 
+int callback_n_netopeer_n_ssh_n_coalesce_replies(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error);
+
 void netopeer_transapi_close_ssh(void);
 
 #endif /* _CFGNETOPEER_TRANSAPI_SSH_H_ */
\ No newline at end of file
@@ -168,7 +168,7 @@ static void* netconf_session_thread(void* arg) {
 	struct ncsess_thread_config* nstc = (struct ncsess_thread_config*)arg;
 	struct nc_cpblts* caps = NULL;
 
-	caps = nc_session_get_cpblts_default();
+	caps = module_get_cpblts();
 	nstc->chan->nc_sess = nc_session_accept_inout(caps, nstc->client->username, nstc->chan->chan_out[0], nstc->chan->chan_in[1]);
 	nc_cpblts_free(caps);
 	if (nstc->chan->to_free == 1) {
@@ -53,6 +53,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <shadow.h>
 #include <pwd.h>
@@ -62,6 +63,7 @@
 #include <libssh/server.h>
 
 #include "../server.h"
+#include "../output_queue.h"
 
 static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
 
@@ -71,9 +73,52 @@ extern int quit, restart_soft;
 extern struct np_state netopeer_state;
 extern struct np_options netopeer_options;
 
+/* server identity (host keys), replaced as a whole whenever the keys change */
+struct np_ssh_server_id {
+	ssh_bind sshbind;
+	unsigned int refcount;	// the current identity and every handshake in progress
+};
+
+static struct np_ssh_server_id* server_id = NULL;
+static pthread_mutex_t server_id_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct np_ssh_server_id* server_id_get(void) {
+	struct np_ssh_server_id* ret;
+
+	/* SERVER ID LOCK */
+	pthread_mutex_lock(&server_id_lock);
+	if ((ret = server_id) != NULL) {
+		++ret->refcount;
+	}
+	/* SERVER ID UNLOCK */
+	pthread_mutex_unlock(&server_id_lock);
+
+	return ret;
+}
+
+static void server_id_put(struct np_ssh_server_id* id) {
+	unsigned int refcount;
+
+	if (id == NULL) {
+		return;
+	}
+
+	/* SERVER ID LOCK */
+	pthread_mutex_lock(&server_id_lock);
+	refcount = --id->refcount;
+	/* SERVER ID UNLOCK */
+	pthread_mutex_unlock(&server_id_lock);
+
+	if (refcount == 0) {
+		ssh_bind_free(id->sshbind);
+		free(id);
+	}
+}
+
 static inline void _chan_free(struct client_struct_ssh* client, struct chan_struct* chan) {
 	if (chan->nc_sess != NULL) {
 		nc_verb_error("%s: internal error: freeing a channel with an opened NC session", __func__);
+		np_session_index_del(nc_session_get_id(chan->nc_sess));
 		nc_session_free(chan->nc_sess);
 	}
 
@@ -82,7 +127,9 @@ static inline void _chan_free(struct client_struct_ssh* client, struct chan_stru
 	}
 }
 
-void client_free_ssh(struct client_struct_ssh* client) {
+static void client_free_ssh(struct client_struct* arg) {
+	struct client_struct_ssh* client = (struct client_struct_ssh*)arg;
+
 	if (client->ssh_chans != NULL) {
 		nc_verb_error("%s: internal error: freeing a client with some channels", __func__);
 	}
@@ -96,6 +143,13 @@ void client_free_ssh(struct client_struct_ssh* client) {
 	/*if (client->sock != -1) {
 		close(client->sock);
 	}*/
+	if (client->outq != NULL) {
+		/* the client socket is closed once the queued output is sent */
+		output_queue_close(client->outq);
+	}
+	if (client->wake_fd != -1) {
+		close(client->wake_fd);
+	}
 
 	free(client->username);
 	free(client);
@@ -158,30 +212,10 @@ static struct chan_struct* client_free_channel(struct client_struct_ssh* client,
 	return prev_chan;
 }
 
-static struct chan_struct* client_find_channel_by_sid(struct client_struct_ssh* client, const char* sid) {
-	struct chan_struct* chan = NULL;
-
-	if (client == NULL || sid == NULL) {
-		return NULL;
-	}
-
-	for (chan = client->ssh_chans; chan != NULL; chan = chan->next) {
-		if (chan->nc_sess == NULL) {
-			continue;
-		}
-
-		if (strcmp(sid, nc_session_get_id(chan->nc_sess)) == 0) {
-			break;
-		}
-	}
-
-	return chan;
-}
-
 static int create_netconf_session(struct client_struct_ssh* client, struct chan_struct* channel) {
 	struct nc_cpblts* caps = NULL;
 
-	caps = nc_session_get_cpblts_default();
+	caps = module_get_cpblts();
 	channel->nc_sess = nc_session_accept_libssh_channel(caps, client->username, channel->ssh_chan);
 	nc_cpblts_free(caps);
 	if (channel->to_free == 1) {
@@ -201,6 +235,11 @@ static int create_netconf_session(struct client_struct_ssh* client, struct chan_
 
 	/* new session was created */
 	nc_verb_verbose("New server session for '%s' with ID %s", client->username, nc_session_get_id(channel->nc_sess));
+	np_session_index_add(channel->nc_sess, (struct client_struct*)client, &channel->to_free);
+	if (client->outq != NULL) {
+		/* all the channels share the queue, it is reported under the last session */
+		output_queue_set_sid(client->outq, nc_session_get_id(channel->nc_sess));
+	}
 	gettimeofday((struct timeval*)&channel->last_rpc_time, NULL);
 
 	return EXIT_SUCCESS;
@@ -425,43 +464,11 @@ static int sshcb_channel_open(struct client_struct_ssh* client, ssh_channel chan
 	return 0;
 }
 
-int np_ssh_kill_session(const char* sid, struct client_struct_ssh* cur_client) {
-	struct client_struct_ssh* kill_client;
-	struct chan_struct* kill_chan = NULL;
-
-	if (sid == NULL) {
-		return 1;
-	}
-
-	/* find the requested session (channel) */
-	for (kill_client = (struct client_struct_ssh*)netopeer_state.clients; kill_client != NULL; kill_client = (struct client_struct_ssh*)kill_client->next) {
-		if (kill_client->transport != NC_TRANSPORT_SSH || kill_client == cur_client) {
-			continue;
-		}
-
-		kill_chan = client_find_channel_by_sid(kill_client, sid);
-		if (kill_chan != NULL) {
-			break;
-		}
-	}
-
-	if (kill_chan == NULL) {
-		return 1;
-	}
-
-	kill_chan->to_free = 1;
-	return 0;
-}
-
 /* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
-int np_ssh_client_netconf_rpc(struct client_struct_ssh* client) {
-	nc_rpc* rpc = NULL;
-	nc_reply* rpc_reply = NULL;
-	NC_MSG_TYPE rpc_type;
-	xmlNodePtr op;
-	int closing = 0, skip_sleep = 0;
-	struct nc_err* err;
+static int np_ssh_client_netconf_rpc(struct client_struct* arg) {
+	struct client_struct_ssh* client = (struct client_struct_ssh*)arg;
 	struct chan_struct* chan;
+	int skip_sleep = 0;
 
 	if (client->to_free) {
 		return 1;
@@ -483,176 +490,23 @@ int np_ssh_client_netconf_rpc(struct client_struct_ssh* client) {
 			}
 		}
 
-		/* receive a new RPC */
-		rpc_type = nc_session_recv_rpc(chan->nc_sess, 0, &rpc);
-		if (rpc_type == NC_MSG_WOULDBLOCK || rpc_type == NC_MSG_NONE) {
-			/* no RPC, or processed internally */
-			continue;
-		}
-
-		gettimeofday((struct timeval*)&chan->last_rpc_time, NULL);
-
-		if (rpc_type == NC_MSG_UNKNOWN) {
-			if (nc_session_get_status(chan->nc_sess) != NC_SESSION_STATUS_WORKING) {
-				/* something really bad happened, and communication is not possible anymore */
-				nc_verb_error("%s: failed to receive client's message (nc session not working)", __func__);
-				chan->to_free = 1;
-			}
-			/* ignore */
-			continue;
-		}
-
-		if (rpc_type != NC_MSG_RPC) {
-			/* NC_MSG_HELLO, NC_MSG_REPLY, NC_MSG_NOTIFICATION */
-			nc_verb_warning("%s: received a %s RPC from session %s, ignoring", __func__,
-							(rpc_type == NC_MSG_HELLO ? "hello" : (rpc_type == NC_MSG_REPLY ? "reply" : "notification")),
-							nc_session_get_id(chan->nc_sess));
+		switch (np_rpc_dispatch(arg, chan->nc_sess, &chan->last_rpc_time)) {
+		case 2:
+			/* the channel is freed by the transport processing */
+			chan->to_free = 1;
+			/* fallthrough */
+		case 1:
 			++skip_sleep;
-			continue;
-		}
-
-		++skip_sleep;
-
-		/* process the new RPC */
-		switch (nc_rpc_get_op(rpc)) {
-		case NC_OP_CLOSESESSION:
-			closing = 1;
-			rpc_reply = nc_reply_ok();
-			break;
-
-		case NC_OP_KILLSESSION:
-			if ((op = ncxml_rpc_get_op_content(rpc)) == NULL || op->name == NULL ||
-					xmlStrEqual(op->name, BAD_CAST "kill-session") == 0) {
-				nc_verb_error("%s: corrupted RPC message", __func__);
-				rpc_reply = nc_reply_error(nc_err_new(NC_ERR_OP_FAILED));
-				err = NULL;
-				xmlFreeNodeList(op);
-				break;
-			}
-			if (op->children == NULL || xmlStrEqual(op->children->name, BAD_CAST "session-id") == 0) {
-				nc_verb_error("%s: no session ID found");
-				err = nc_err_new(NC_ERR_MISSING_ELEM);
-				nc_err_set(err, NC_ERR_PARAM_INFO_BADELEM, "session-id");
-				rpc_reply = nc_reply_error(err);
-				err = NULL;
-				xmlFreeNodeList(op);
-				break;
-			}
-
-			/* block-local variables */
-			char* sid;
-			int ret;
-
-			sid = (char*)xmlNodeGetContent(op->children);
-			xmlFreeNodeList(op);
-
-			/* check if this client is not requested to be killed */
-			if (client_find_channel_by_sid(client, sid) != NULL) {
-				free(sid);
-				err = nc_err_new(NC_ERR_INVALID_VALUE);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "Requested to kill this session.");
-				rpc_reply = nc_reply_error(err);
-				break;
-			}
-
-			ret = 1;
-#ifdef NP_TLS
-			ret = np_tls_kill_session(sid, (struct client_struct_tls*)client);
-#endif
-			if (ret != 0 && np_ssh_kill_session(sid, client) != 0) {
-				free(sid);
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "No session with the requested ID found.");
-				rpc_reply = nc_reply_error(err);
-				break;
-			}
-
-			nc_verb_verbose("Session with the ID %s killed.", sid);
-			rpc_reply = nc_reply_ok();
-
-			free(sid);
-			break;
-
-		case NC_OP_CREATESUBSCRIPTION:
-			/* create-subscription message */
-			if (nc_cpblts_enabled(chan->nc_sess, "urn:ietf:params:netconf:capability:notification:1.0") == 0) {
-				rpc_reply = nc_reply_error(nc_err_new(NC_ERR_OP_NOT_SUPPORTED));
-				break;
-			}
-
-			/* check if notifications are allowed on this session */
-			if (nc_session_notif_allowed(chan->nc_sess) == 0) {
-				nc_verb_error("%s: notification subscription is not allowed on the session %s", __func__, nc_session_get_id(chan->nc_sess));
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_TYPE, "protocol");
-				nc_err_set(err, NC_ERR_PARAM_MSG, "Another notification subscription is currently active on this session.");
-				rpc_reply = nc_reply_error(err);
-				err = NULL;
-				break;
-			}
-
-			rpc_reply = ncntf_subscription_check(rpc);
-			if (nc_reply_get_type(rpc_reply) != NC_REPLY_OK) {
-				break;
-			}
-
-			pthread_t thread;
-			struct ntf_thread_config* ntf_config;
-
-			if ((ntf_config = malloc(sizeof(struct ntf_thread_config))) == NULL) {
-				nc_verb_error("%s: memory allocation failed", __func__);
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "Memory allocation failed.");
-				rpc_reply = nc_reply_error(err);
-				err = NULL;
-				break;
-			}
-			ntf_config->session = chan->nc_sess;
-			ntf_config->subscribe_rpc = nc_rpc_dup(rpc);
-
-			/* perform notification sending */
-			if ((pthread_create(&thread, NULL, client_notif_thread, ntf_config)) != 0) {
-				nc_reply_free(rpc_reply);
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "Creating thread for sending Notifications failed.");
-				rpc_reply = nc_reply_error(err);
-				err = NULL;
-				break;
-			}
-			pthread_detach(thread);
-			break;
-
-		default:
-			if ((rpc_reply = ncds_apply_rpc2all(chan->nc_sess, rpc, NULL)) == NULL) {
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "For unknown reason no reply was returned by the library.");
-				rpc_reply = nc_reply_error(err);
-			} else if (rpc_reply == NCDS_RPC_NOT_APPLICABLE) {
-				err = nc_err_new(NC_ERR_OP_FAILED);
-				nc_err_set(err, NC_ERR_PARAM_MSG, "There is no device/data that could be affected.");
-				nc_reply_free(rpc_reply);
-				rpc_reply = nc_reply_error(err);
-			}
-
 			break;
 		}
-
-		/* send reply */
-		nc_session_send_reply(chan->nc_sess, rpc, rpc_reply);
-		nc_reply_free(rpc_reply);
-		nc_rpc_free(rpc);
-
-		if (closing) {
-			chan->to_free = 1;
-			closing = 0;
-		}
 	}
 
 	return skip_sleep;
 }
 
 /* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
-int np_ssh_client_transport(struct client_struct_ssh* client) {
+static int np_ssh_client_transport(struct client_struct* arg) {
+	struct client_struct_ssh* client = (struct client_struct_ssh*)arg;
 	struct chan_struct* chan;
 	struct timeval cur_time;
 	int skip_sleep = 0;
@@ -735,6 +589,9 @@ int np_ssh_client_transport(struct client_struct_ssh* client) {
 			/* don't sleep, we may have been asked to quit */
 			skip_sleep = 1;
 			nc_verb_verbose("Freeing session for '%s'", client->username);
+			if (chan->nc_sess != NULL) {
+				np_session_index_del(nc_session_get_id(chan->nc_sess));
+			}
 			nc_session_free(chan->nc_sess);
 			chan->nc_sess = NULL;
 
@@ -760,6 +617,57 @@ int np_ssh_client_transport(struct client_struct_ssh* client) {
 	return skip_sleep;
 }
 
+/* return: 0 - the client is busy, 1 - no RPC was exchanged for timeout seconds and nothing is pending on any channel */
+static int np_ssh_client_idle(struct client_struct* arg, unsigned int timeout, struct timeval* last_rpc_time) {
+	struct client_struct_ssh* client = (struct client_struct_ssh*)arg;
+	struct chan_struct* chan;
+	struct timeval cur_time;
+
+	if (client->to_free || !client->authenticated || client->ssh_chans == NULL || client->new_ssh_msg) {
+		return 0;
+	}
+
+	gettimeofday(&cur_time, NULL);
+
+	for (chan = client->ssh_chans; chan != NULL; chan = chan->next) {
+		if (chan->to_free || chan->nc_sess == NULL || timeval_diff(cur_time, chan->last_rpc_time) < timeout
+				|| ssh_channel_poll(chan->ssh_chan, 0) != 0) {
+			return 0;
+		}
+	}
+
+	/* the idle timeout of the sessions with a subscription never expires */
+	timerclear(last_rpc_time);
+	for (chan = client->ssh_chans; chan != NULL; chan = chan->next) {
+		if (!ncntf_session_get_active_subscription(chan->nc_sess) &&
+				(!timerisset(last_rpc_time) || timercmp(&chan->last_rpc_time, last_rpc_time, <))) {
+			*last_rpc_time = chan->last_rpc_time;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * libnetconf writes a reply into the channel piece by piece and libssh sends
+ * every piece as a separate packet, the corked socket sends them in full
+ * segments and uncorking sends the rest right away, without waiting for ACKs
+ */
+static void np_ssh_reply_batch(struct client_struct* client, int start) {
+	if (start && !netopeer_options.ssh_opts->coalesce_replies) {
+		return;
+	}
+
+	if (client->outq != NULL) {
+		/* client->sock is the socket pair of the queue, the client socket is owned by the queue */
+		output_queue_cork(client->outq, start);
+		return;
+	}
+
+	/* fails only on a socket that is not TCP, the reply is sent as it is then */
+	setsockopt(client->sock, IPPROTO_TCP, TCP_CORK, &start, sizeof start);
+}
+
 int sshcb_msg(ssh_session session, ssh_message msg, void* UNUSED(data)) {
 	const char* str_type, *str_subtype = NULL, *username;
 	int subtype, type;
@@ -982,40 +890,75 @@ void sshcb_log(int priority, const char* UNUSED(function), const char* buffer, v
 	}
 }
 
-void np_ssh_init(void) {
+static void np_ssh_init(void) {
 	ssh_set_log_level(netopeer_options.verbose);
 	ssh_set_log_callback(sshcb_log);
 }
 
-ssh_bind np_ssh_server_id_check(ssh_bind sshbind) {
-	ssh_bind ret;
+static int server_id_import_key(ssh_bind sshbind, const char* path, enum ssh_bind_options_e type) {
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
+	ssh_key key;
 
-	/* Check server keys for a change */
-	if (netopeer_options.ssh_opts->server_key_change_flag || sshbind == NULL) {
-		ssh_bind_free(sshbind);
-		if ((ret = ssh_bind_new()) == NULL) {
-			nc_verb_error("%s: failed to create SSH bind", __func__);
-			return NULL;
-		}
+	(void)type;
+	if (ssh_pki_import_privkey_file(path, NULL, NULL, NULL, &key) != SSH_OK) {
+		nc_verb_error("Failed to import the server key \"%s\".", path);
+		return EXIT_FAILURE;
+	}
 
-		if (netopeer_options.ssh_opts->rsa_key != NULL) {
-			ssh_bind_options_set(ret, SSH_BIND_OPTIONS_RSAKEY, netopeer_options.ssh_opts->rsa_key);
-		}
-		if (netopeer_options.ssh_opts->dsa_key != NULL) {
-			ssh_bind_options_set(ret, SSH_BIND_OPTIONS_DSAKEY, netopeer_options.ssh_opts->dsa_key);
-		}
+	/* the bind takes over the key */
+	if (ssh_bind_options_set(sshbind, SSH_BIND_OPTIONS_IMPORT_KEY, key) != SSH_OK) {
+		nc_verb_error("Failed to set the server key \"%s\" (%s).", path, ssh_get_error(sshbind));
+		ssh_key_free(key);
+		return EXIT_FAILURE;
+	}
+#else
+	/* old libssh cannot take parsed keys, they are read on the first accept */
+	if (ssh_bind_options_set(sshbind, type, path) != SSH_OK) {
+		nc_verb_error("Failed to set the server key \"%s\" (%s).", path, ssh_get_error(sshbind));
+		return EXIT_FAILURE;
+	}
+#endif
 
-		ssh_bind_options_set(ret, SSH_BIND_OPTIONS_LOG_VERBOSITY, &netopeer_options.verbose);
+	return EXIT_SUCCESS;
+}
 
-		netopeer_options.ssh_opts->server_key_change_flag = 0;
-	} else {
-		ret = sshbind;
+/* return: 0 - the new server keys are used, 1 - error, the previous server keys stay in use */
+int np_ssh_server_id_reload(void) {
+	struct np_ssh_server_id* new_id, *old_id;
+
+	if ((new_id = calloc(1, sizeof *new_id)) == NULL || (new_id->sshbind = ssh_bind_new()) == NULL) {
+		nc_verb_error("%s: failed to create SSH bind", __func__);
+		free(new_id);
+		return EXIT_FAILURE;
 	}
+	new_id->refcount = 1;
 
-	return ret;
+	ssh_bind_options_set(new_id->sshbind, SSH_BIND_OPTIONS_LOG_VERBOSITY, &netopeer_options.verbose);
+
+	if ((netopeer_options.ssh_opts->rsa_key != NULL &&
+			server_id_import_key(new_id->sshbind, netopeer_options.ssh_opts->rsa_key, SSH_BIND_OPTIONS_RSAKEY) != EXIT_SUCCESS) ||
+			(netopeer_options.ssh_opts->dsa_key != NULL &&
+			server_id_import_key(new_id->sshbind, netopeer_options.ssh_opts->dsa_key, SSH_BIND_OPTIONS_DSAKEY) != EXIT_SUCCESS)) {
+		ssh_bind_free(new_id->sshbind);
+		free(new_id);
+		nc_verb_error("Server keys were not changed, the previous ones are still used.");
+		return EXIT_FAILURE;
+	}
+
+	/* SERVER ID LOCK */
+	pthread_mutex_lock(&server_id_lock);
+	old_id = server_id;
+	server_id = new_id;
+	/* SERVER ID UNLOCK */
+	pthread_mutex_unlock(&server_id_lock);
+
+	/* handshakes still using the old keys hold their own reference */
+	server_id_put(old_id);
+
+	return EXIT_SUCCESS;
 }
 
-int np_ssh_session_count(void) {
+static int np_ssh_session_count(void) {
 	struct client_struct_ssh* client;
 	struct chan_struct* chan;
 	int count = 0;
@@ -1041,8 +984,10 @@ int np_ssh_session_count(void) {
 	return count;
 }
 
-int np_ssh_create_client(struct client_struct_ssh* new_client, ssh_bind sshbind) {
-	int ret;
+static int np_ssh_create_client(struct client_struct* arg, void* UNUSED(ctx)) {
+	struct client_struct_ssh* new_client = (struct client_struct_ssh*)arg;
+	struct np_ssh_server_id* id;
+	int ret, sock;
 
 	new_client->ssh_sess = ssh_new();
 	if (new_client->ssh_sess == NULL) {
@@ -1058,10 +1003,23 @@ int np_ssh_create_client(struct client_struct_ssh* new_client, ssh_bind sshbind)
 
 	ssh_set_message_callback(new_client->ssh_sess, sshcb_msg, NULL);
 
-	if (ssh_bind_accept_fd(sshbind, new_client->ssh_sess, new_client->sock) == SSH_ERROR) {
-		nc_verb_error("%s: SSH failed to accept a new connection: %s", __func__, ssh_get_error(sshbind));
+	if ((id = server_id_get()) == NULL) {
+		nc_verb_error("%s: no SSH server keys loaded", __func__);
+		return 1;
+	}
+
+	/* libssh reads and writes a socket pair, the queue relays it to the client socket */
+	if ((new_client->outq = output_queue_new_duplex(arg, &sock)) != NULL) {
+		new_client->sock = sock;
+	}
+
+	/* the keys are copied into the session, the identity is not needed after this */
+	if (ssh_bind_accept_fd(id->sshbind, new_client->ssh_sess, new_client->sock) == SSH_ERROR) {
+		nc_verb_error("%s: SSH failed to accept a new connection: %s", __func__, ssh_get_error(id->sshbind));
+		server_id_put(id);
 		return 1;
 	}
+	server_id_put(id);
 
 	gettimeofday((struct timeval*)&new_client->conn_time, NULL);
 
@@ -1078,6 +1036,34 @@ int np_ssh_create_client(struct client_struct_ssh* new_client, ssh_bind sshbind)
 	return 0;
 }
 
-void np_ssh_cleanup(void) {
-	/* nothing to do here, libssh finalize is called by libnetconf */
+static void np_ssh_cleanup(void) {
+	struct np_ssh_server_id* id;
+
+	/* SERVER ID LOCK */
+	pthread_mutex_lock(&server_id_lock);
+	id = server_id;
+	server_id = NULL;
+	/* SERVER ID UNLOCK */
+	pthread_mutex_unlock(&server_id_lock);
+
+	server_id_put(id);
+
+	/* libssh finalize is called by libnetconf */
 }
+
+const struct np_transport np_ssh_transport = {
+	.transport = NC_TRANSPORT_SSH,
+	.name = "SSH",
+	.init = np_ssh_init,
+	.server_id_check = NULL,
+	.ctx_free = NULL,
+	.create_client = np_ssh_create_client,
+	.client_transport = np_ssh_client_transport,
+	.client_netconf_rpc = np_ssh_client_netconf_rpc,
+	.client_idle = np_ssh_client_idle,
+	.reply_batch = np_ssh_reply_batch,
+	.client_free = client_free_ssh,
+	.session_count = np_ssh_session_count,
+	.thread_cleanup = NULL,
+	.cleanup = np_ssh_cleanup
+};
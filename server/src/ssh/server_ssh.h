@@ -58,11 +58,14 @@ struct client_struct_ssh {
 	NC_TRANSPORT transport;
 
 	int sock;
+	int wake_fd;
+	int callhome;
 	struct sockaddr_storage saddr;
 	pthread_t tid;
 	char* username;
 	volatile int to_free;
 	struct client_struct* next;
+	struct output_queue* outq;
 
 	volatile struct timeval conn_time;	// timestamp of the new connection
 	int auth_attempts;					// number of failed auth attempts
@@ -77,22 +80,8 @@ struct ncsess_thread_config {
 	struct client_struct_ssh* client;
 };
 
-int np_ssh_client_netconf_rpc(struct client_struct_ssh* client);
+extern const struct np_transport np_ssh_transport;
 
-int np_ssh_client_transport(struct client_struct_ssh* client);
-
-void np_ssh_init(void);
-
-ssh_bind np_ssh_server_id_check(ssh_bind sshbind);
-
-int np_ssh_session_count(void);
-
-int np_ssh_kill_session(const char* sid, struct client_struct_ssh* cur_client);
-
-int np_ssh_create_client(struct client_struct_ssh* new_client, ssh_bind sshbind);
-
-void np_ssh_cleanup(void);
-
-void client_free_ssh(struct client_struct_ssh* client);
+int np_ssh_server_id_reload(void);
 
 #endif /* _SERVER_SSH_H_ */
@@ -0,0 +1,707 @@
+/**
+ * @file state_data.c
+ * @brief Netopeer parallel state data collection
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <libxml/parser.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "server.h"
+#include "state_data.h"
+
+enum state_job_status {
+	STATE_JOB_QUEUED,
+	STATE_JOB_RUNNING,
+	STATE_JOB_DONE,
+	STATE_JOB_CANCELLED
+};
+
+/* ncds_apply_rpc() of a single datastore */
+struct state_job {
+	struct state_get* get;
+	ncds_id id;
+	nc_reply* reply;
+	enum state_job_status status;
+	int collected;			/**< done before the reply was merged */
+	struct state_job* next;	/**< in the queue */
+};
+
+struct state_get {
+	struct nc_session* session;
+	const nc_rpc* rpc;
+	char* key;				/**< of the cached data, NULL if no module caches them */
+	pthread_cond_t cond;	/**< a job finished */
+	unsigned int running;	/**< jobs queued or running */
+	unsigned int count;
+	struct state_job jobs[];
+};
+
+/* data of a <get> applied to a datastore */
+struct state_cache_entry {
+	char* key;
+	char* data;				/**< NULL while being generated */
+	struct timespec expires;
+	int stale;				/**< invalidated while being generated */
+	struct state_cache_entry* next;
+};
+
+/* cached <get> data of a module datastore */
+struct state_cache {
+	ncds_id id;
+	char* name;
+	char* model;			/**< NULL if not known */
+	char* ns;				/**< NULL if not known */
+	unsigned int ttl;		/**< milliseconds */
+	uint64_t hits, misses;
+	unsigned int generating;
+	int removed;			/**< to be freed by the last generation */
+	struct state_cache_entry* entries;
+	struct state_cache* next;
+};
+
+/*
+ * A <get> is applied to every datastore separately by the pool threads, the
+ * datastore IDs are learned from a <get> without a filter applied by
+ * ncds_apply_rpc2all(), which visits all of them.
+ *
+ * The data of a datastore are cached for the same user and <get> operation,
+ * only one thread generates them and the others wait for its result.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/**< a job was queued or the threads are to quit */
+	struct state_job* head, *tail;
+	pthread_t threads[STATE_DATA_THREADS];
+	unsigned int thread_count;
+	int quit;
+
+	ncds_id* ids;			/**< terminated by -1, NULL if not known */
+	unsigned int id_count;
+	unsigned int generation;	/**< changed by every state_data_invalidate() */
+
+	struct state_cache* caches;
+	pthread_cond_t cache_cond;	/**< some cached data were generated */
+} state_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.cache_cond = PTHREAD_COND_INITIALIZER
+};
+
+static void state_time_add(struct timespec* ts, unsigned int msec) {
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (msec % 1000) * 1000000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		++ts->tv_sec;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+static int state_time_passed(const struct timespec* ts) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec > ts->tv_sec || (now.tv_sec == ts->tv_sec && now.tv_nsec >= ts->tv_nsec));
+}
+
+static void state_cache_free(struct state_cache* cache) {
+	struct state_cache_entry* entry;
+
+	while ((entry = cache->entries) != NULL) {
+		cache->entries = entry->next;
+		free(entry->key);
+		free(entry->data);
+		free(entry);
+	}
+	free(cache->name);
+	free(cache->model);
+	free(cache->ns);
+	free(cache);
+}
+
+/* the caller must hold the lock */
+static struct state_cache* state_cache_find(ncds_id id) {
+	struct state_cache* cache;
+
+	for (cache = state_pool.caches; cache != NULL && cache->id != id; cache = cache->next);
+	return cache;
+}
+
+/* drop the expired data, or all of them, the data being generated are only marked stale, the caller must hold the lock */
+static void state_cache_drop(struct state_cache* cache, int all) {
+	struct state_cache_entry** prev, *entry;
+
+	for (prev = &cache->entries; *prev != NULL;) {
+		entry = *prev;
+		if (entry->data == NULL) {
+			entry->stale |= all;
+			prev = &entry->next;
+		} else if (all || state_time_passed(&entry->expires)) {
+			*prev = entry->next;
+			free(entry->key);
+			free(entry->data);
+			free(entry);
+		} else {
+			prev = &entry->next;
+		}
+	}
+}
+
+/* ncds_apply_rpc() of a job, with the data cached if the datastore has a cache */
+static nc_reply* state_job_apply(struct state_job* job) {
+	struct state_cache* cache;
+	struct state_cache_entry* entry, **prev;
+	nc_reply* reply;
+
+	if (job->get->key == NULL) {
+		return ncds_apply_rpc(job->id, job->get->session, job->get->rpc);
+	}
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	while (1) {
+		if ((cache = state_cache_find(job->id)) == NULL) {
+			/* STATE POOL UNLOCK */
+			pthread_mutex_unlock(&state_pool.lock);
+			return ncds_apply_rpc(job->id, job->get->session, job->get->rpc);
+		}
+		for (entry = cache->entries; entry != NULL && strcmp(entry->key, job->get->key); entry = entry->next);
+		if (entry == NULL || entry->data != NULL) {
+			break;
+		}
+		/* the same data are being generated by another thread */
+		pthread_cond_wait(&state_pool.cache_cond, &state_pool.lock);
+	}
+
+	if (entry != NULL && !state_time_passed(&entry->expires)) {
+		++cache->hits;
+		reply = nc_reply_data(entry->data);
+
+		/* STATE POOL UNLOCK */
+		pthread_mutex_unlock(&state_pool.lock);
+		return reply;
+	}
+	++cache->misses;
+
+	/* a good time to forget the expired data, including the ones to be generated again */
+	state_cache_drop(cache, 0);
+	if ((entry = calloc(1, sizeof *entry)) == NULL || (entry->key = strdup(job->get->key)) == NULL) {
+		free(entry);
+		/* STATE POOL UNLOCK */
+		pthread_mutex_unlock(&state_pool.lock);
+		return ncds_apply_rpc(job->id, job->get->session, job->get->rpc);
+	}
+	entry->next = cache->entries;
+	cache->entries = entry;
+	++cache->generating;
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	reply = ncds_apply_rpc(job->id, job->get->session, job->get->rpc);
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	--cache->generating;
+	if (!entry->stale && !cache->removed && reply != NULL && reply != NCDS_RPC_NOT_APPLICABLE
+			&& nc_reply_get_type(reply) == NC_REPLY_DATA && (entry->data = nc_reply_get_data(reply)) != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &entry->expires);
+		state_time_add(&entry->expires, cache->ttl);
+	} else {
+		/* nothing to cache, the next thread generates the data on its own */
+		for (prev = &cache->entries; *prev != entry; prev = &(*prev)->next);
+		*prev = entry->next;
+		free(entry->key);
+		free(entry);
+	}
+	if (cache->removed && cache->generating == 0) {
+		state_cache_free(cache);
+	}
+	pthread_cond_broadcast(&state_pool.cache_cond);
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	return reply;
+}
+
+static void* state_data_thread(void* UNUSED(arg)) {
+	struct state_job* job;
+	nc_reply* reply;
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	while (1) {
+		while (!state_pool.quit && state_pool.head == NULL) {
+			pthread_cond_wait(&state_pool.cond, &state_pool.lock);
+		}
+		if (state_pool.quit) {
+			break;
+		}
+
+		job = state_pool.head;
+		state_pool.head = job->next;
+		if (state_pool.head == NULL) {
+			state_pool.tail = NULL;
+		}
+		job->status = STATE_JOB_RUNNING;
+
+		/* STATE POOL UNLOCK */
+		pthread_mutex_unlock(&state_pool.lock);
+
+		reply = state_job_apply(job);
+
+		/* STATE POOL LOCK */
+		pthread_mutex_lock(&state_pool.lock);
+
+		job->reply = reply;
+		job->status = STATE_JOB_DONE;
+		--job->get->running;
+		pthread_cond_signal(&job->get->cond);
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	return NULL;
+}
+
+int state_data_init(void) {
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	state_pool.quit = 0;
+	while (state_pool.thread_count < STATE_DATA_THREADS
+			&& pthread_create(&state_pool.threads[state_pool.thread_count], NULL, state_data_thread, NULL) == 0) {
+		++state_pool.thread_count;
+	}
+	if (state_pool.thread_count == 0) {
+		nc_verb_warning("%s: no thread could be started, state data will be collected serially.", __func__);
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	return (state_pool.thread_count ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void state_data_cleanup(void) {
+	struct state_cache* cache;
+	unsigned int i;
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	state_pool.quit = 1;
+	pthread_cond_broadcast(&state_pool.cond);
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	for (i = 0; i < state_pool.thread_count; ++i) {
+		pthread_join(state_pool.threads[i], NULL);
+	}
+	state_pool.thread_count = 0;
+
+	state_data_invalidate();
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	while ((cache = state_pool.caches) != NULL) {
+		state_pool.caches = cache->next;
+		state_cache_free(cache);
+	}
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+}
+
+void state_data_invalidate(void) {
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	free(state_pool.ids);
+	state_pool.ids = NULL;
+	state_pool.id_count = 0;
+	++state_pool.generation;
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+}
+
+/* apply the <get> serially and learn the datastores from it if it has no filter */
+static nc_reply* state_data_get_serial(struct nc_session* session, const nc_rpc* rpc) {
+	struct nc_filter* filter;
+	ncds_id* ids = NULL;
+	nc_reply* reply;
+	unsigned int count, generation;
+
+	if ((filter = nc_rpc_get_filter(rpc)) != NULL) {
+		nc_filter_free(filter);
+		return ncds_apply_rpc2all(session, rpc, NULL);
+	}
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	generation = state_pool.generation;
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	reply = ncds_apply_rpc2all(session, rpc, &ids);
+	if (ids == NULL) {
+		return reply;
+	}
+	for (count = 0; ids[count] != -1; ++count);
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	if (generation == state_pool.generation) {
+		free(state_pool.ids);
+		state_pool.ids = ids;
+		state_pool.id_count = count;
+		ids = NULL;
+	}
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	if (ids == NULL) {
+		nc_verb_verbose("%s: <get> will be applied to %u datastores in parallel.", __func__, count);
+	}
+	/* a datastore was added or removed meanwhile */
+	free(ids);
+	return reply;
+}
+
+/* merge the replies in the order of the datastores, the first error wins like in ncds_apply_rpc2all() */
+static nc_reply* state_data_merge(struct state_get* get) {
+	nc_reply* error = NULL, *reply;
+	char* data = NULL, *part, *aux;
+	unsigned int i;
+	int applicable = 0;
+
+	for (i = 0; i < get->count; ++i) {
+		reply = get->jobs[i].reply;
+		if (!get->jobs[i].collected) {
+			nc_verb_warning("%s: datastore %d did not reply within %d ms, its data are left out.", __func__, get->jobs[i].id, STATE_DATA_TIMEOUT);
+			continue;
+		}
+		get->jobs[i].reply = NULL;
+		if (reply == NULL || reply == NCDS_RPC_NOT_APPLICABLE) {
+			/* also a datastore removed meanwhile */
+			continue;
+		}
+		applicable = 1;
+
+		if (error != NULL) {
+			nc_reply_free(reply);
+		} else if (nc_reply_get_type(reply) != NC_REPLY_DATA) {
+			free(data);
+			data = NULL;
+			error = reply;
+		} else {
+			part = nc_reply_get_data(reply);
+			nc_reply_free(reply);
+			if (part != NULL && asprintf(&aux, "%s%s", (data ? data : ""), part) != -1) {
+				free(data);
+				data = aux;
+			}
+			free(part);
+		}
+	}
+
+	if (error != NULL) {
+		return error;
+	} else if (!applicable) {
+		return NCDS_RPC_NOT_APPLICABLE;
+	}
+	reply = nc_reply_data(data ? data : "");
+	free(data);
+	return reply;
+}
+
+/* the cache key of a <get>, the user and the RPC without its message-id, return: key, NULL on error */
+static char* state_get_key(struct nc_session* session, const nc_rpc* rpc) {
+	xmlDocPtr doc = NULL;
+	xmlChar* dump = NULL;
+	char* rpc_dump, *key = NULL;
+	const char* user;
+	int len;
+
+	if ((rpc_dump = nc_rpc_dump(rpc)) != NULL) {
+		doc = xmlReadMemory(rpc_dump, strlen(rpc_dump), NULL, NULL, XML_PARSE_NOBLANKS | XML_PARSE_NSCLEAN);
+		free(rpc_dump);
+	}
+	if (doc == NULL || xmlDocGetRootElement(doc) == NULL) {
+		xmlFreeDoc(doc);
+		return NULL;
+	}
+	xmlUnsetProp(xmlDocGetRootElement(doc), BAD_CAST "message-id");
+	xmlDocDumpMemory(doc, &dump, &len);
+	xmlFreeDoc(doc);
+
+	user = nc_session_get_user(session);
+	if (dump != NULL && asprintf(&key, "%s\n%s", (user ? user : ""), (char*)dump) == -1) {
+		key = NULL;
+	}
+	xmlFree(dump);
+	return key;
+}
+
+nc_reply* state_data_get(struct nc_session* session, const nc_rpc* rpc, struct state_get** pending) {
+	struct state_get* get;
+	struct state_job* job, **prev;
+	struct timespec deadline;
+	unsigned int i;
+	nc_reply* reply;
+	char* key = NULL;
+	int cached;
+
+	*pending = NULL;
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	cached = (state_pool.caches != NULL);
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	if (cached) {
+		key = state_get_key(session, rpc);
+	}
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	if (state_pool.ids == NULL || (get = calloc(1, sizeof *get + state_pool.id_count * sizeof *get->jobs)) == NULL) {
+		/* STATE POOL UNLOCK */
+		pthread_mutex_unlock(&state_pool.lock);
+		free(key);
+		return state_data_get_serial(session, rpc);
+	}
+
+	get->session = session;
+	get->rpc = rpc;
+	get->key = key;
+	pthread_cond_init(&get->cond, NULL);
+	get->count = get->running = state_pool.id_count;
+	for (i = 0; i < get->count; ++i) {
+		get->jobs[i].get = get;
+		get->jobs[i].id = state_pool.ids[i];
+		get->jobs[i].status = STATE_JOB_QUEUED;
+	}
+
+	if (state_pool.thread_count == 0) {
+		/* STATE POOL UNLOCK */
+		pthread_mutex_unlock(&state_pool.lock);
+
+		/* no threads, the datastores are asked one by one just to use the cache */
+		for (i = 0; i < get->count; ++i) {
+			get->jobs[i].reply = state_job_apply(&get->jobs[i]);
+			get->jobs[i].status = STATE_JOB_DONE;
+			get->jobs[i].collected = 1;
+		}
+		get->running = 0;
+		reply = state_data_merge(get);
+		state_data_finish(get);
+		return reply;
+	}
+
+	for (i = 0; i < get->count; ++i) {
+		job = &get->jobs[i];
+		if (state_pool.tail != NULL) {
+			state_pool.tail->next = job;
+		} else {
+			state_pool.head = job;
+		}
+		state_pool.tail = job;
+	}
+	pthread_cond_broadcast(&state_pool.cond);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	state_time_add(&deadline, STATE_DATA_TIMEOUT);
+	while (get->running && pthread_cond_timedwait(&get->cond, &state_pool.lock, &deadline) != ETIMEDOUT);
+
+	if (get->running) {
+		/* the jobs still in the queue are not run at all */
+		for (prev = &state_pool.head, job = NULL; *prev != NULL;) {
+			if ((*prev)->get == get) {
+				(*prev)->status = STATE_JOB_CANCELLED;
+				--get->running;
+				*prev = (*prev)->next;
+			} else {
+				job = *prev;
+				prev = &(*prev)->next;
+			}
+		}
+		state_pool.tail = job;
+	}
+	for (i = 0; i < get->count; ++i) {
+		get->jobs[i].collected = (get->jobs[i].status == STATE_JOB_DONE);
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	/* the collected jobs are not touched by the threads anymore */
+	reply = state_data_merge(get);
+
+	if (get->running) {
+		*pending = get;
+	} else {
+		state_data_finish(get);
+	}
+	return reply;
+}
+
+void state_data_finish(struct state_get* pending) {
+	unsigned int i;
+
+	if (pending == NULL) {
+		return;
+	}
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	while (pending->running) {
+		pthread_cond_wait(&pending->cond, &state_pool.lock);
+	}
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	for (i = 0; i < pending->count; ++i) {
+		if (pending->jobs[i].reply != NULL && pending->jobs[i].reply != NCDS_RPC_NOT_APPLICABLE) {
+			nc_reply_free(pending->jobs[i].reply);
+		}
+	}
+	pthread_cond_destroy(&pending->cond);
+	free(pending->key);
+	free(pending);
+}
+
+int state_data_cache_add(ncds_id id, const char* name, const char* model, const char* ns, unsigned int ttl) {
+	struct state_cache* cache;
+
+	if ((cache = calloc(1, sizeof *cache)) == NULL || (cache->name = strdup(name)) == NULL
+			|| (model != NULL && (cache->model = strdup(model)) == NULL) || (ns != NULL && (cache->ns = strdup(ns)) == NULL)) {
+		nc_verb_error("%s: memory allocation failed (%s:%d).", __func__, __FILE__, __LINE__);
+		if (cache != NULL) {
+			state_cache_free(cache);
+		}
+		return EXIT_FAILURE;
+	}
+	cache->id = id;
+	cache->ttl = ttl;
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+	cache->next = state_pool.caches;
+	state_pool.caches = cache;
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+
+	nc_verb_verbose("%s: state data of the module \"%s\" will be cached for %u ms.", __func__, name, ttl);
+	return EXIT_SUCCESS;
+}
+
+void state_data_cache_del(ncds_id id) {
+	struct state_cache** prev, *cache;
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	for (prev = &state_pool.caches; *prev != NULL && (*prev)->id != id; prev = &(*prev)->next);
+	if ((cache = *prev) != NULL) {
+		*prev = cache->next;
+		if (cache->generating) {
+			cache->removed = 1;
+		} else {
+			state_cache_free(cache);
+		}
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+}
+
+void np_state_data_changed(const char* module) {
+	struct state_cache* cache;
+
+	if (module == NULL) {
+		return;
+	}
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	for (cache = state_pool.caches; cache != NULL; cache = cache->next) {
+		if (strcmp(cache->name, module) == 0 || (cache->model != NULL && strcmp(cache->model, module) == 0)
+				|| (cache->ns != NULL && strcmp(cache->ns, module) == 0)) {
+			state_cache_drop(cache, 1);
+		}
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+}
+
+void state_data_cache_stats(xmlNodePtr parent) {
+	struct state_cache* cache;
+	xmlNodePtr node;
+	char buf[24];
+
+	/* STATE POOL LOCK */
+	pthread_mutex_lock(&state_pool.lock);
+
+	for (cache = state_pool.caches; cache != NULL; cache = cache->next) {
+		node = xmlNewChild(parent, parent->ns, BAD_CAST "module", NULL);
+		xmlNewChild(node, parent->ns, BAD_CAST "name", BAD_CAST cache->name);
+		snprintf(buf, sizeof buf, "%u", cache->ttl);
+		xmlNewChild(node, parent->ns, BAD_CAST "ttl", BAD_CAST buf);
+		snprintf(buf, sizeof buf, "%" PRIu64, cache->hits);
+		xmlNewChild(node, parent->ns, BAD_CAST "hits", BAD_CAST buf);
+		snprintf(buf, sizeof buf, "%" PRIu64, cache->misses);
+		xmlNewChild(node, parent->ns, BAD_CAST "misses", BAD_CAST buf);
+	}
+
+	/* STATE POOL UNLOCK */
+	pthread_mutex_unlock(&state_pool.lock);
+}
@@ -0,0 +1,129 @@
+/**
+ * @file state_data.h
+ * @brief Netopeer parallel state data collection header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _STATE_DATA_H_
+#define _STATE_DATA_H_
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+
+/* a <get> whose state data providers did not all finish in time */
+struct state_get;
+
+/**
+ * @brief Start the threads calling the state data providers of the datastores
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if no thread could be started and
+ * every <get> is applied to the datastores in turn
+ */
+int state_data_init(void);
+
+/**
+ * @brief Stop the threads, there must be no <get> in progress
+ */
+void state_data_cleanup(void);
+
+/**
+ * @brief Forget the datastores a <get> is applied to, they are learned again
+ * from the next <get> without a filter, call whenever a datastore is added or removed
+ */
+void state_data_invalidate(void);
+
+/**
+ * @brief Apply a <get> to all the datastores, in parallel if they are known
+ *
+ * The datastores that do not reply within STATE_DATA_TIMEOUT are left out of
+ * the reply, they can still be using the session and the RPC, so state_data_finish()
+ * must be called before freeing any of them.
+ *
+ * @param session Session of the RPC
+ * @param rpc The <get> RPC
+ * @param[out] pending Set to the unfinished <get>, NULL if there is none
+ *
+ * @return Reply as from ncds_apply_rpc2all()
+ */
+nc_reply* state_data_get(struct nc_session* session, const nc_rpc* rpc, struct state_get** pending);
+
+/**
+ * @brief Wait for the datastores that timed out in state_data_get() and
+ * discard their replies
+ *
+ * @param pending Unfinished <get>, NULL is ignored
+ */
+void state_data_finish(struct state_get* pending);
+
+/**
+ * @brief Cache the <get> data of a module datastore
+ *
+ * @param id Datastore ID
+ * @param name Module name
+ * @param model Main model name, NULL if not known
+ * @param ns Main model namespace, NULL if not known
+ * @param ttl Milliseconds the data are valid for
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int state_data_cache_add(ncds_id id, const char* name, const char* model, const char* ns, unsigned int ttl);
+
+/**
+ * @brief Stop caching the <get> data of a datastore, if they are
+ *
+ * @param id Datastore ID
+ */
+void state_data_cache_del(ncds_id id);
+
+/**
+ * @brief Add the hit and miss counters of the caches as "module" elements
+ *
+ * @param parent Parent element, its namespace is used
+ */
+void state_data_cache_stats(xmlNodePtr parent);
+
+/**
+ * @brief Drop the cached <get> data of a module, a transAPI module calls it
+ * when its state data changed, it is exported from netopeer-server so the module
+ * can declare it as
+ *
+ *     extern void np_state_data_changed(const char* module) __attribute__((weak));
+ *
+ * and call it only if it is not NULL.
+ *
+ * @param module Module name, its main model name, or namespace
+ */
+void np_state_data_changed(const char* module);
+
+#endif /* _STATE_DATA_H_ */
@@ -0,0 +1,369 @@
+/**
+ * @file tcp_profile.c
+ * @brief Netopeer TCP socket profiles
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "server.h"
+#include "tcp_profile.h"
+
+char* get_node_content(const xmlNodePtr node);
+
+struct tcp_profile {
+	char* name;
+	NC_TRANSPORT transport;
+	int callhome;
+	struct sockaddr_storage addr;	// AF_UNSPEC matches any address
+	uint16_t port;					// 0 matches any port
+	int nodelay;
+	int keepalive;
+	uint32_t keepalive_idle, keepalive_interval, keepalive_count;
+	uint32_t user_timeout;			// milliseconds, 0 leaves the system default
+	uint32_t sndbuf, rcvbuf;		// bytes, 0 leaves the system default
+	uint32_t notsent_lowat;			// bytes, 0 leaves the system default
+	struct tcp_profile* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct tcp_profile* list;		// in the configured order
+} profiles = {PTHREAD_MUTEX_INITIALIZER, NULL};
+
+static xmlNodePtr profile_child(xmlNodePtr node, const char* name) {
+	xmlNodePtr child;
+
+	for (child = node->children; child != NULL; child = child->next) {
+		if (child->type == XML_ELEMENT_NODE && xmlStrEqual(child->name, BAD_CAST name)) {
+			return child;
+		}
+	}
+
+	return NULL;
+}
+
+static void profile_error(struct nc_err** error, const char* leaf, const char* content) {
+	char* msg;
+
+	*error = nc_err_new(NC_ERR_BAD_ELEM);
+	if (asprintf(&msg, "Invalid value '%s'.", content) != -1) {
+		nc_err_set(*error, NC_ERR_PARAM_MSG, msg);
+		free(msg);
+	}
+	if (asprintf(&msg, "/netopeer/tcp-profile/%s", leaf) != -1) {
+		nc_err_set(*error, NC_ERR_PARAM_INFO_BADELEM, msg);
+		free(msg);
+	}
+}
+
+/* return: 0 - the leaf is not there or was converted, 1 - invalid */
+static int profile_number(xmlNodePtr node, const char* leaf, unsigned long max, uint32_t* value, struct nc_err** error) {
+	xmlNodePtr child;
+	char* content, *ptr;
+	unsigned long num;
+
+	if ((child = profile_child(node, leaf)) == NULL) {
+		return 0;
+	}
+	if ((content = get_node_content(child)) == NULL) {
+		profile_error(error, leaf, "");
+		return 1;
+	}
+
+	num = strtoul(content, &ptr, 10);
+	if (*ptr != '\0' || num > max) {
+		profile_error(error, leaf, content);
+		return 1;
+	}
+
+	*value = num;
+	return 0;
+}
+
+/* return: 0 - the leaf is not there or was converted, 1 - invalid */
+static int profile_bool(xmlNodePtr node, const char* leaf, int* value, struct nc_err** error) {
+	xmlNodePtr child;
+	char* content;
+
+	if ((child = profile_child(node, leaf)) == NULL) {
+		return 0;
+	}
+	content = get_node_content(child);
+	if (content != NULL && strcmp(content, "true") == 0) {
+		*value = 1;
+	} else if (content != NULL && strcmp(content, "false") == 0) {
+		*value = 0;
+	} else {
+		profile_error(error, leaf, (content ? content : ""));
+		return 1;
+	}
+
+	return 0;
+}
+
+static void profile_free(struct tcp_profile* prof) {
+	if (prof == NULL) {
+		return;
+	}
+
+	free(prof->name);
+	free(prof);
+}
+
+static struct tcp_profile* profile_parse(xmlNodePtr node, struct nc_err** error) {
+	struct tcp_profile* prof;
+	xmlNodePtr child;
+	char* content;
+	uint32_t num;
+
+	prof = calloc(1, sizeof *prof);
+	prof->addr.ss_family = AF_UNSPEC;
+	prof->nodelay = 1;
+
+	if ((child = profile_child(node, "name")) == NULL || (content = get_node_content(child)) == NULL) {
+		*error = nc_err_new(NC_ERR_MISSING_ELEM);
+		nc_err_set(*error, NC_ERR_PARAM_MSG, "name element missing.");
+		goto fail;
+	}
+	prof->name = strdup(content);
+
+	if ((child = profile_child(node, "transport")) == NULL || (content = get_node_content(child)) == NULL) {
+		*error = nc_err_new(NC_ERR_MISSING_ELEM);
+		nc_err_set(*error, NC_ERR_PARAM_MSG, "transport element missing.");
+		goto fail;
+	}
+	if (strcmp(content, "ssh") == 0) {
+		prof->transport = NC_TRANSPORT_SSH;
+	} else if (strcmp(content, "tls") == 0) {
+		prof->transport = NC_TRANSPORT_TLS;
+	} else {
+		profile_error(error, "transport", content);
+		goto fail;
+	}
+
+	if ((child = profile_child(node, "address")) != NULL) {
+		content = get_node_content(child);
+		if (content != NULL && inet_pton(AF_INET, content, &((struct sockaddr_in*)&prof->addr)->sin_addr) == 1) {
+			prof->addr.ss_family = AF_INET;
+		} else if (content != NULL && inet_pton(AF_INET6, content, &((struct sockaddr_in6*)&prof->addr)->sin6_addr) == 1) {
+			prof->addr.ss_family = AF_INET6;
+		} else {
+			profile_error(error, "address", (content ? content : ""));
+			goto fail;
+		}
+	}
+
+	num = 0;
+	if (profile_number(node, "port", UINT16_MAX, &num, error)) {
+		goto fail;
+	}
+	prof->port = num;
+
+	if (profile_bool(node, "call-home", &prof->callhome, error) || profile_bool(node, "no-delay", &prof->nodelay, error)) {
+		goto fail;
+	}
+
+	if ((child = profile_child(node, "keepalive")) != NULL) {
+		prof->keepalive = 1;
+		prof->keepalive_idle = 60;
+		prof->keepalive_interval = 10;
+		prof->keepalive_count = 5;
+		if (profile_number(child, "idle", INT32_MAX, &prof->keepalive_idle, error)
+				|| profile_number(child, "interval", INT32_MAX, &prof->keepalive_interval, error)
+				|| profile_number(child, "count", INT32_MAX, &prof->keepalive_count, error)) {
+			goto fail;
+		}
+	}
+
+	if (profile_number(node, "user-timeout", INT32_MAX, &prof->user_timeout, error)
+			|| profile_number(node, "send-buffer", INT32_MAX, &prof->sndbuf, error)
+			|| profile_number(node, "receive-buffer", INT32_MAX, &prof->rcvbuf, error)
+			|| profile_number(node, "notsent-lowat", INT32_MAX, &prof->notsent_lowat, error)) {
+		goto fail;
+	}
+
+	return prof;
+
+fail:
+	profile_free(prof);
+	return NULL;
+}
+
+int tcp_profile_set(xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error) {
+	struct tcp_profile* new = NULL, *prof, **prev;
+	xmlNodePtr child;
+	char* name = NULL;
+
+	if (new_node != NULL && (new = profile_parse(new_node, error)) == NULL) {
+		return EXIT_FAILURE;
+	}
+	if (old_node != NULL && (child = profile_child(old_node, "name")) != NULL) {
+		name = get_node_content(child);
+	}
+
+	/* PROFILES LOCK */
+	pthread_mutex_lock(&profiles.lock);
+
+	/* a changed profile keeps its position */
+	for (prev = &profiles.list; *prev != NULL; prev = &(*prev)->next) {
+		if (name != NULL && strcmp((*prev)->name, name) == 0) {
+			prof = *prev;
+			if (new != NULL) {
+				new->next = prof->next;
+				*prev = new;
+				new = NULL;
+			} else {
+				*prev = prof->next;
+			}
+			profile_free(prof);
+			break;
+		}
+	}
+	if (new != NULL) {
+		for (prev = &profiles.list; *prev != NULL; prev = &(*prev)->next);
+		*prev = new;
+	}
+
+	/* PROFILES UNLOCK */
+	pthread_mutex_unlock(&profiles.lock);
+
+	return EXIT_SUCCESS;
+}
+
+void tcp_profile_del_all(void) {
+	struct tcp_profile* prof;
+
+	/* PROFILES LOCK */
+	pthread_mutex_lock(&profiles.lock);
+	while (profiles.list != NULL) {
+		prof = profiles.list;
+		profiles.list = prof->next;
+		profile_free(prof);
+	}
+	/* PROFILES UNLOCK */
+	pthread_mutex_unlock(&profiles.lock);
+}
+
+static uint16_t addr_port(const struct sockaddr_storage* addr) {
+	if (addr->ss_family == AF_INET) {
+		return ntohs(((const struct sockaddr_in*)addr)->sin_port);
+	}
+	return ntohs(((const struct sockaddr_in6*)addr)->sin6_port);
+}
+
+static int addr_equal(const struct sockaddr_storage* addr1, const struct sockaddr_storage* addr2) {
+	if (addr1->ss_family != addr2->ss_family) {
+		return 0;
+	}
+	if (addr1->ss_family == AF_INET) {
+		return !memcmp(&((const struct sockaddr_in*)addr1)->sin_addr, &((const struct sockaddr_in*)addr2)->sin_addr, sizeof(struct in_addr));
+	}
+	return !memcmp(&((const struct sockaddr_in6*)addr1)->sin6_addr, &((const struct sockaddr_in6*)addr2)->sin6_addr, sizeof(struct in6_addr));
+}
+
+static void profile_setopt(int sock, int level, int opt, const char* opt_name, int value, const char* profile) {
+	if (setsockopt(sock, level, opt, &value, sizeof value) == -1) {
+		nc_verb_warning("%s: setting %s of the TCP profile \"%s\" failed (%s)", __func__, opt_name, profile, strerror(errno));
+	}
+}
+
+void tcp_profile_apply(int sock, NC_TRANSPORT transport, int callhome, const struct sockaddr_storage* addr) {
+	struct tcp_profile* prof, *best = NULL;
+	int score, best_score = -1;
+
+	if (addr->ss_family != AF_INET && addr->ss_family != AF_INET6) {
+		return;
+	}
+
+	/* PROFILES LOCK */
+	pthread_mutex_lock(&profiles.lock);
+
+	/* an address match is more specific than a port match */
+	for (prof = profiles.list; prof != NULL; prof = prof->next) {
+		if (prof->transport != transport || prof->callhome != (callhome ? 1 : 0)) {
+			continue;
+		}
+		if ((prof->port && prof->port != addr_port(addr)) || (prof->addr.ss_family != AF_UNSPEC && !addr_equal(&prof->addr, addr))) {
+			continue;
+		}
+		score = (prof->addr.ss_family != AF_UNSPEC ? 2 : 0) + (prof->port ? 1 : 0);
+		if (score > best_score) {
+			best = prof;
+			best_score = score;
+		}
+	}
+
+	if ((prof = best) != NULL) {
+		profile_setopt(sock, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", prof->nodelay, prof->name);
+		if (prof->keepalive) {
+			profile_setopt(sock, SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", 1, prof->name);
+			profile_setopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", prof->keepalive_idle, prof->name);
+			profile_setopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL", prof->keepalive_interval, prof->name);
+			profile_setopt(sock, IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", prof->keepalive_count, prof->name);
+		}
+#ifdef TCP_USER_TIMEOUT
+		if (prof->user_timeout) {
+			profile_setopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, "TCP_USER_TIMEOUT", prof->user_timeout, prof->name);
+		}
+#endif
+		if (prof->sndbuf) {
+			profile_setopt(sock, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", prof->sndbuf, prof->name);
+		}
+		if (prof->rcvbuf) {
+			profile_setopt(sock, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", prof->rcvbuf, prof->name);
+		}
+#ifdef TCP_NOTSENT_LOWAT
+		if (prof->notsent_lowat) {
+			profile_setopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "TCP_NOTSENT_LOWAT", prof->notsent_lowat, prof->name);
+		}
+#endif
+	}
+
+	/* PROFILES UNLOCK */
+	pthread_mutex_unlock(&profiles.lock);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file tcp_profile.h
+ * @brief Netopeer TCP socket profiles header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _TCP_PROFILE_H_
+#define _TCP_PROFILE_H_
+
+#include <sys/socket.h>
+#include <libnetconf.h>
+#include <libxml/tree.h>
+
+/*
+ * A profile sets the TCP options of the sessions of a transport, either of
+ * the ones accepted on a listening address and port, or of the Call Home ones
+ * connecting to a server address and port. The address and port of a profile
+ * are optional, the most specific matching profile is used. Sockets matched
+ * by no profile are left with the system defaults.
+ */
+
+/**
+ * @brief Add, replace, or remove a profile
+ *
+ * @param old_node Previous tcp-profile list entry, NULL if it is being added
+ * @param new_node New tcp-profile list entry, NULL if it is being removed
+ * @param[out] error Error of an invalid entry
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int tcp_profile_set(xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error);
+
+/**
+ * @brief Remove all the profiles
+ */
+void tcp_profile_del_all(void);
+
+/**
+ * @brief Set the options of the matching profile on a new socket, before it
+ * connects for a Call Home session
+ *
+ * @param sock Socket, it is left as it is if not TCP
+ * @param transport Transport of the session
+ * @param callhome Whether it is a Call Home session
+ * @param addr Listening address the socket was accepted on, or the Call Home
+ * server address
+ */
+void tcp_profile_apply(int sock, NC_TRANSPORT transport, int callhome, const struct sockaddr_storage* addr);
+
+#endif /* _TCP_PROFILE_H_ */
@@ -50,6 +50,7 @@
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <string.h>
+#include <openssl/ssl.h>
 
 #include "../server.h"
 
@@ -495,6 +496,44 @@ int callback_n_netopeer_n_tls_n_crl_dir(void** UNUSED(data), XMLDIFF_OP op, xmlN
 	return EXIT_SUCCESS;
 }
 
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:tls/n:kernel-tls changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_tls_n_kernel_tls(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error) {
+	char* content = NULL;
+
+	if (op & XMLDIFF_REM) {
+		netopeer_options.tls_opts->kernel_tls = 0;
+		return EXIT_SUCCESS;
+	}
+
+	content = get_node_content(new_node);
+	if (content == NULL) {
+		*error = nc_err_new(NC_ERR_OP_FAILED);
+		nc_verb_error("%s: node content missing", __func__);
+		return EXIT_FAILURE;
+	}
+
+	/* applied to the new clients only */
+	if (strcmp(content, "true") == 0) {
+		netopeer_options.tls_opts->kernel_tls = 1;
+#ifndef SSL_OP_ENABLE_KTLS
+		nc_verb_warning("Kernel TLS is not supported by the OpenSSL the server was built with, it will not be used.");
+#endif
+	} else {
+		netopeer_options.tls_opts->kernel_tls = 0;
+	}
+	return EXIT_SUCCESS;
+}
+
 /**
  * @brief This callback will be run when node in path /n:netopeer/n:tls/n:cert-maps/n:cert-to-name changes
  *
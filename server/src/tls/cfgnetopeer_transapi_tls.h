@@ -64,6 +64,8 @@ struct np_options_tls {
 	pthread_mutex_t crl_dir_lock;
 	char* crl_dir;
 
+	uint8_t kernel_tls;		/* hand the record layer of new clients to the kernel */
+
 	pthread_mutex_t ctn_map_lock;
 	struct np_ctn_item {
 		uint32_t id;
@@ -87,6 +89,8 @@ int callback_n_netopeer_n_tls_n_trusted_client_certs_n_trusted_client_cert(void*
 
 int callback_n_netopeer_n_tls_n_crl_dir(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error);
 
+int callback_n_netopeer_n_tls_n_kernel_tls(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr UNUSED(old_node), xmlNodePtr new_node, struct nc_err** error);
+
 int callback_n_netopeer_n_tls_n_cert_maps_n_cert_to_name(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error);
 
 void netopeer_transapi_close_tls(void);
@@ -63,6 +63,7 @@
 #include <openssl/x509v3.h>
 
 #include "../server.h"
+#include "../output_queue.h"
 
 static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
 
@@ -71,12 +72,15 @@ extern int quit, restart_soft;
 extern struct np_options netopeer_options;
 extern struct np_state netopeer_state;
 
-void client_free_tls(struct client_struct_tls* client) {
+static void client_free_tls(struct client_struct* arg) {
+	struct client_struct_tls* client = (struct client_struct_tls*)arg;
+
 	if (!client->to_free) {
 		nc_verb_error("%s: internal error: freeing a client not marked for deletion", __func__);
 	}
 	if (client->nc_sess != NULL) {
 		nc_verb_error("%s: internal error: freeing a client with an opened NC session", __func__);
+		np_session_index_del(nc_session_get_id(client->nc_sess));
 		nc_session_free(client->nc_sess);
 	}
 
@@ -84,9 +88,15 @@ void client_free_tls(struct client_struct_tls* client) {
 		SSL_shutdown(client->tls);
 		SSL_free(client->tls);
 	}
-	if (client->sock != -1) {
+	if (client->outq != NULL) {
+		/* the socket is closed once the queued output, including the close notify, is sent */
+		output_queue_close(client->outq);
+	} else if (client->sock != -1) {
 		close(client->sock);
 	}
+	if (client->wake_fd != -1) {
+		close(client->wake_fd);
+	}
 	free(client->username);
 	X509_free(client->cert);
 
@@ -712,8 +722,19 @@ fail:
 
 static int create_netconf_session(struct client_struct_tls* client) {
 	struct nc_cpblts* caps = NULL;
+	int out_fd, ktls = 0;
+
+#ifdef SSL_OP_ENABLE_KTLS
+	/* kernel TLS encrypts only what is written to the socket itself */
+	ktls = BIO_get_ktls_send(SSL_get_wbio(client->tls));
+#endif
+	/* the records are written into the queue, the reads stay on the socket */
+	if (!ktls && (client->outq = output_queue_new((struct client_struct*)client, &out_fd)) != NULL
+			&& SSL_set_wfd(client->tls, out_fd) != 1) {
+		nc_verb_error("%s: tls error: failed to write into the output queue, writing into the socket", __func__);
+	}
 
-	caps = nc_session_get_cpblts_default();
+	caps = module_get_cpblts();
 	client->nc_sess = nc_session_accept_tls(caps, client->username, client->tls);
 	nc_cpblts_free(caps);
 	if (client->to_free == 1) {
@@ -731,45 +752,19 @@ static int create_netconf_session(struct client_struct_tls* client) {
 	}
 
 	nc_verb_verbose("New server session for '%s' with ID %s", client->username, nc_session_get_id(client->nc_sess));
+	np_session_index_add(client->nc_sess, (struct client_struct*)client, &client->to_free);
+	if (client->outq != NULL) {
+		output_queue_set_sid(client->outq, nc_session_get_id(client->nc_sess));
+	}
 	gettimeofday((struct timeval*)&client->last_rpc_time, NULL);
 
 	return EXIT_SUCCESS;
 }
 
-int np_tls_kill_session(const char* sid, struct client_struct_tls* cur_client) {
-	struct client_struct_tls* kill_client;
-
-	if (sid == NULL) {
-		return 1;
-	}
-
-	for (kill_client = (struct client_struct_tls*)netopeer_state.clients; kill_client != NULL; kill_client = (struct client_struct_tls*)kill_client->next) {
-		if (kill_client->transport != NC_TRANSPORT_TLS || kill_client == cur_client) {
-			continue;
-		}
-
-		if (strcmp(sid, nc_session_get_id(kill_client->nc_sess)) == 0) {
-			break;
-		}
-	}
-
-	if (kill_client == NULL) {
-		return 1;
-	}
-
-	kill_client->to_free = 1;
-
-	return 0;
-}
-
 /* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
-int np_tls_client_netconf_rpc(struct client_struct_tls* client) {
-	nc_rpc* rpc = NULL;
-	nc_reply* rpc_reply = NULL;
-	NC_MSG_TYPE rpc_type;
-	xmlNodePtr op;
-	int closing = 0, skip_sleep = 0;
-	struct nc_err* err;
+static int np_tls_client_netconf_rpc(struct client_struct* arg) {
+	struct client_struct_tls* client = (struct client_struct_tls*)arg;
+	int ret;
 
 	if (client->to_free) {
 		return 1;
@@ -779,185 +774,31 @@ int np_tls_client_netconf_rpc(struct client_struct_tls* client) {
 		return 1;
 	}
 
-	/* receive a new RPC */
-	rpc_type = nc_session_recv_rpc(client->nc_sess, 0, &rpc);
-	if (rpc_type == NC_MSG_WOULDBLOCK || rpc_type == NC_MSG_NONE) {
-		/* no RPC, or processed internally */
-		return skip_sleep;
-	}
-
-	gettimeofday((struct timeval*)&client->last_rpc_time, NULL);
-
-	if (rpc_type == NC_MSG_UNKNOWN) {
-		if (nc_session_get_status(client->nc_sess) != NC_SESSION_STATUS_WORKING) {
-			/* something really bad happened, and communication is not possible anymore */
-			nc_verb_error("%s: failed to receive client's message (nc session not working)", __func__);
-			client->to_free = 1;
-		}
-		/* ignore */
-		return 1;
-	}
-
-	if (rpc_type != NC_MSG_RPC) {
-		/* NC_MSG_HELLO, NC_MSG_REPLY, NC_MSG_NOTIFICATION */
-		nc_verb_warning("%s: received a %s RPC from session %s, ignoring", __func__,
-						(rpc_type == NC_MSG_HELLO ? "hello" : (rpc_type == NC_MSG_REPLY ? "reply" : "notification")),
-						nc_session_get_id(client->nc_sess));
-		return 1;
-	}
-
-	++skip_sleep;
-
-	/* process the new RPC */
-	switch (nc_rpc_get_op(rpc)) {
-	case NC_OP_CLOSESESSION:
-		closing = 1;
-		rpc_reply = nc_reply_ok();
-		break;
-
-	case NC_OP_KILLSESSION:
-		if ((op = ncxml_rpc_get_op_content(rpc)) == NULL || op->name == NULL ||
-				xmlStrEqual(op->name, BAD_CAST "kill-session") == 0) {
-			nc_verb_error("%s: corrupted RPC message", __func__);
-			rpc_reply = nc_reply_error(nc_err_new(NC_ERR_OP_FAILED));
-			err = NULL;
-			xmlFreeNodeList(op);
-			break;
-		}
-		if (op->children == NULL || xmlStrEqual(op->children->name, BAD_CAST "session-id") == 0) {
-			nc_verb_error("%s: no session ID found");
-			err = nc_err_new(NC_ERR_MISSING_ELEM);
-			nc_err_set(err, NC_ERR_PARAM_INFO_BADELEM, "session-id");
-			rpc_reply = nc_reply_error(err);
-			err = NULL;
-			xmlFreeNodeList(op);
-			break;
-		}
-
-		/* block-local variables */
-		char* sid;
-		int ret;
-
-		sid = (char*)xmlNodeGetContent(op->children);
-		xmlFreeNodeList(op);
+	ret = np_rpc_dispatch(arg, client->nc_sess, &client->last_rpc_time);
 
-		/* check if this client is not requested to be killed */
-		if (strcmp(nc_session_get_id(client->nc_sess), sid) == 0) {
-			free(sid);
-			err = nc_err_new(NC_ERR_INVALID_VALUE);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "Requested to kill this session.");
-			rpc_reply = nc_reply_error(err);
-			break;
-		}
-
-		ret = 1;
-#ifdef NP_SSH
-		ret = np_ssh_kill_session(sid, (struct client_struct_ssh*)client);
-#endif
-		if (ret != 0 && np_tls_kill_session(sid, client) != 0) {
-			free(sid);
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "No session with the requested ID found.");
-			rpc_reply = nc_reply_error(err);
-			break;
-		}
-
-		nc_verb_verbose("Session with the ID %s killed.", sid);
-		rpc_reply = nc_reply_ok();
-
-		free(sid);
-		break;
-
-	case NC_OP_CREATESUBSCRIPTION:
-		/* create-subscription message */
-		if (nc_cpblts_enabled(client->nc_sess, "urn:ietf:params:netconf:capability:notification:1.0") == 0) {
-			rpc_reply = nc_reply_error(nc_err_new(NC_ERR_OP_NOT_SUPPORTED));
-			break;
-		}
-
-		/* check if notifications are allowed on this session */
-		if (nc_session_notif_allowed(client->nc_sess) == 0) {
-			nc_verb_error("%s: notification subscription is not allowed on the session %s", __func__, nc_session_get_id(client->nc_sess));
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_TYPE, "protocol");
-			nc_err_set(err, NC_ERR_PARAM_MSG, "Another notification subscription is currently active on this session.");
-			rpc_reply = nc_reply_error(err);
-			err = NULL;
-			break;
-		}
-
-		rpc_reply = ncntf_subscription_check(rpc);
-		if (nc_reply_get_type(rpc_reply) != NC_REPLY_OK) {
-			break;
-		}
-
-		pthread_t thread;
-		struct ntf_thread_config* ntf_config;
-
-		if ((ntf_config = malloc(sizeof(struct ntf_thread_config))) == NULL) {
-			nc_verb_error("%s: memory allocation failed", __func__);
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "Memory allocation failed.");
-			rpc_reply = nc_reply_error(err);
-			err = NULL;
-			break;
-		}
-		ntf_config->session = client->nc_sess;
-		ntf_config->subscribe_rpc = nc_rpc_dup(rpc);
-
-		/* perform notification sending */
-		if ((pthread_create(&thread, NULL, client_notif_thread, ntf_config)) != 0) {
-			nc_reply_free(rpc_reply);
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "Creating thread for sending Notifications failed.");
-			rpc_reply = nc_reply_error(err);
-			err = NULL;
-			break;
-		}
-		pthread_detach(thread);
-		break;
-
-	default:
-		if ((rpc_reply = ncds_apply_rpc2all(client->nc_sess, rpc, NULL)) == NULL) {
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "For unknown reason no reply was returned by the library.");
-			rpc_reply = nc_reply_error(err);
-		} else if (rpc_reply == NCDS_RPC_NOT_APPLICABLE) {
-			err = nc_err_new(NC_ERR_OP_FAILED);
-			nc_err_set(err, NC_ERR_PARAM_MSG, "There is no device/data that could be affected.");
-			nc_reply_free(rpc_reply);
-			rpc_reply = nc_reply_error(err);
-		}
-
-		break;
-	}
-
-	/* send reply */
-	nc_session_send_reply(client->nc_sess, rpc, rpc_reply);
-	nc_reply_free(rpc_reply);
-	nc_rpc_free(rpc);
-
-	/* so that we do not free the client before
-	 * this reply gets sent
-	 */
-	if (closing) {
+	/* the reply was already sent, the session can be freed */
+	if (ret == 2) {
 		nc_verb_verbose("Freeing session for '%s'", client->username);
+		np_session_index_del(nc_session_get_id(client->nc_sess));
 		nc_session_free(client->nc_sess);
 		client->nc_sess = NULL;
 		client->to_free = 1;
+		ret = 1;
 	}
 
-	return skip_sleep;
+	return ret;
 }
 
 /* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
-int np_tls_client_transport(struct client_struct_tls* client) {
+static int np_tls_client_transport(struct client_struct* arg) {
+	struct client_struct_tls* client = (struct client_struct_tls*)arg;
 	struct timeval cur_time;
 	int skip_sleep = 0;
 
 	if (quit) {
 		if (client->nc_sess != NULL) {
 			nc_verb_verbose("Freeing session for '%s'", client->username);
+			np_session_index_del(nc_session_get_id(client->nc_sess));
 			nc_session_free(client->nc_sess);
 			client->nc_sess = NULL;
 		}
@@ -983,7 +824,31 @@ int np_tls_client_transport(struct client_struct_tls* client) {
 	return skip_sleep;
 }
 
-void np_tls_thread_cleanup(void) {
+/* return: 0 - the client is busy, 1 - no RPC was exchanged for timeout seconds and nothing is buffered */
+static int np_tls_client_idle(struct client_struct* arg, unsigned int timeout, struct timeval* last_rpc_time) {
+	struct client_struct_tls* client = (struct client_struct_tls*)arg;
+	struct timeval cur_time;
+
+	if (client->to_free || client->nc_sess == NULL || SSL_pending(client->tls) != 0) {
+		return 0;
+	}
+
+	gettimeofday(&cur_time, NULL);
+	if (timeval_diff(cur_time, client->last_rpc_time) < timeout) {
+		return 0;
+	}
+
+	/* the idle timeout of a session with a subscription never expires */
+	if (ncntf_session_get_active_subscription(client->nc_sess)) {
+		timerclear(last_rpc_time);
+	} else {
+		*last_rpc_time = client->last_rpc_time;
+	}
+
+	return 1;
+}
+
+static void np_tls_thread_cleanup(void) {
 	CRYPTO_THREADID crypto_tid;
 
 	CRYPTO_THREADID_current(&crypto_tid);
@@ -1025,7 +890,7 @@ static void tls_thread_cleanup(void) {
 	free(netopeer_state.tls_state->tls_mutex_buf);
 }
 
-void np_tls_init(void) {
+static void np_tls_init(void) {
 	SSL_load_error_strings();
 	SSL_library_init();
 
@@ -1033,8 +898,8 @@ void np_tls_init(void) {
 	tls_thread_setup();
 }
 
-SSL_CTX* np_tls_server_id_check(SSL_CTX* tlsctx) {
-	SSL_CTX* ret;
+static void* np_tls_server_id_check(void* ctx) {
+	SSL_CTX* tlsctx = ctx, *ret;
 	X509* cert;
 	EVP_PKEY* key;
 	X509_STORE* trusted_store;
@@ -1101,7 +966,7 @@ SSL_CTX* np_tls_server_id_check(SSL_CTX* tlsctx) {
 	return ret;
 }
 
-int np_tls_session_count(void) {
+static int np_tls_session_count(void) {
 	struct client_struct_tls* client;
 	int count = 0;
 
@@ -1115,7 +980,9 @@ int np_tls_session_count(void) {
 	return count;
 }
 
-int np_tls_create_client(struct client_struct_tls* new_client, SSL_CTX* tlsctx) {
+static int np_tls_create_client(struct client_struct* arg, void* ctx) {
+	struct client_struct_tls* new_client = (struct client_struct_tls*)arg;
+	SSL_CTX* tlsctx = ctx;
 	int ret;
 
 	new_client->tls = SSL_new(tlsctx);
@@ -1131,6 +998,13 @@ int np_tls_create_client(struct client_struct_tls* new_client, SSL_CTX* tlsctx)
 	netopeer_state.tls_state->last_tls_idx = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
 	SSL_set_ex_data(new_client->tls, netopeer_state.tls_state->last_tls_idx, new_client);
 
+#ifdef SSL_OP_ENABLE_KTLS
+	if (netopeer_options.tls_opts->kernel_tls) {
+		/* after the handshake, OpenSSL hands the keys to the kernel and only writes and reads the socket */
+		SSL_set_options(new_client->tls, SSL_OP_ENABLE_KTLS);
+	}
+#endif
+
 	while (((ret = SSL_accept(new_client->tls)) == -1) && (SSL_get_error(new_client->tls, ret) == SSL_ERROR_WANT_READ)) {
 		usleep(READ_SLEEP);
 	}
@@ -1139,6 +1013,15 @@ int np_tls_create_client(struct client_struct_tls* new_client, SSL_CTX* tlsctx)
 		return 1;
 	}
 
+#ifdef SSL_OP_ENABLE_KTLS
+	if (netopeer_options.tls_opts->kernel_tls) {
+		/* the cipher or the kernel may not support it, OpenSSL falls back to user space then */
+		nc_verb_verbose("Kernel TLS %s for sending, %s for receiving.",
+				BIO_get_ktls_send(SSL_get_wbio(new_client->tls)) ? "enabled" : "not available",
+				BIO_get_ktls_recv(SSL_get_rbio(new_client->tls)) ? "enabled" : "not available");
+	}
+#endif
+
 	if (fcntl(new_client->sock, F_SETFL, O_NONBLOCK) != 0) {
 		nc_verb_error("%s: fcntl failed (%s)", __func__, strerror(errno));
 		return 1;
@@ -1149,7 +1032,11 @@ int np_tls_create_client(struct client_struct_tls* new_client, SSL_CTX* tlsctx)
 	return 0;
 }
 
-void np_tls_cleanup(void) {
+static void np_tls_ctx_free(void* ctx) {
+	SSL_CTX_free(ctx);
+}
+
+static void np_tls_cleanup(void) {
 	CRYPTO_THREADID crypto_tid;
 
 	EVP_cleanup();
@@ -1163,3 +1050,20 @@ void np_tls_cleanup(void) {
 	free(netopeer_state.tls_state);
 	netopeer_state.tls_state = NULL;
 }
+
+const struct np_transport np_tls_transport = {
+	.transport = NC_TRANSPORT_TLS,
+	.name = "TLS",
+	.init = np_tls_init,
+	.server_id_check = np_tls_server_id_check,
+	.ctx_free = np_tls_ctx_free,
+	.create_client = np_tls_create_client,
+	.client_transport = np_tls_client_transport,
+	.client_netconf_rpc = np_tls_client_netconf_rpc,
+	.client_idle = np_tls_client_idle,
+	.reply_batch = NULL,
+	.client_free = client_free_tls,
+	.session_count = np_tls_session_count,
+	.thread_cleanup = np_tls_thread_cleanup,
+	.cleanup = np_tls_cleanup
+};
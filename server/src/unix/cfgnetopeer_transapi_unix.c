@@ -0,0 +1,109 @@
+/**
+ * @file cfgnetopeer_transapi_unix.c
+ * @brief Netopeer cfgnetopeer transapi module Unix socket part
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <libxml/tree.h>
+#include <libnetconf_xml.h>
+
+#include "../server.h"
+
+static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
+
+extern struct np_options netopeer_options;
+
+char* get_node_content(const xmlNodePtr node);
+
+/**
+ * @brief This callback will be run when node in path /n:netopeer/n:unix/n:listen-path changes
+ *
+ * @param[in] data	Double pointer to void. Its passed to every callback. You can share data using it.
+ * @param[in] op	Observed change in path. XMLDIFF_OP type.
+ * @param[in] node	Modified node. if op == XMLDIFF_REM its copy of node removed.
+ * @param[out] error	If callback fails, it can return libnetconf error structure with a failure description.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* !DO NOT ALTER FUNCTION SIGNATURE! */
+int callback_n_netopeer_n_unix_n_listen_path(void** UNUSED(data), XMLDIFF_OP op, xmlNodePtr old_node, xmlNodePtr new_node, struct nc_err** error) {
+	char* old_path = NULL, *new_path = NULL;
+
+	if (op & (XMLDIFF_REM | XMLDIFF_MOD)) {
+		old_path = get_node_content(old_node);
+		if (old_path == NULL) {
+			*error = nc_err_new(NC_ERR_OP_FAILED);
+			nc_verb_error("%s: node content missing", __func__);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (op & (XMLDIFF_MOD | XMLDIFF_ADD)) {
+		new_path = get_node_content(new_node);
+		if (new_path == NULL) {
+			*error = nc_err_new(NC_ERR_OP_FAILED);
+			nc_verb_error("%s: node content missing", __func__);
+			return EXIT_FAILURE;
+		}
+		if (new_path[0] != '/') {
+			*error = nc_err_new(NC_ERR_INVALID_VALUE);
+			nc_err_set(*error, NC_ERR_PARAM_MSG, "The Unix socket path must be absolute.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* BINDS LOCK */
+	pthread_mutex_lock(&netopeer_options.binds_lock);
+
+	if (old_path != NULL) {
+		del_bind_addr(&netopeer_options.binds, NP_TRANSPORT_UNIX, old_path, 0);
+		netopeer_options.binds_change_flag = 1;
+
+		nc_verb_verbose("%s: stopped listening on the Unix socket %s", __func__, old_path);
+	}
+	if (new_path != NULL) {
+		add_bind_addr(&netopeer_options.binds, NP_TRANSPORT_UNIX, new_path, 0);
+		netopeer_options.binds_change_flag = 1;
+
+		nc_verb_verbose("%s: listening on the Unix socket %s", __func__, new_path);
+	}
+
+	/* BINDS UNLOCK */
+	pthread_mutex_unlock(&netopeer_options.binds_lock);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file server_unix.c
+ * @brief Netopeer server Unix socket part
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf_xml.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <pwd.h>
+
+#include "../server.h"
+#include "../output_queue.h"
+
+static const char rcsid[] __attribute__((used)) ="$Id: "__FILE__": "RCSID" $";
+
+extern int quit;
+
+extern struct np_options netopeer_options;
+extern struct np_state netopeer_state;
+
+static void client_free_unix(struct client_struct* arg) {
+	struct client_struct_unix* client = (struct client_struct_unix*)arg;
+
+	if (!client->to_free) {
+		nc_verb_error("%s: internal error: freeing a client not marked for deletion", __func__);
+	}
+	if (client->nc_sess != NULL) {
+		nc_verb_error("%s: internal error: freeing a client with an opened NC session", __func__);
+		np_session_index_del(nc_session_get_id(client->nc_sess));
+		nc_session_free(client->nc_sess);
+	}
+
+	if (client->outq != NULL) {
+		/* the socket is closed once the queued output is sent */
+		output_queue_close(client->outq);
+	} else if (client->sock != -1) {
+		close(client->sock);
+	}
+	if (client->wake_fd != -1) {
+		close(client->wake_fd);
+	}
+	free(client->username);
+	free(client);
+}
+
+static int create_netconf_session(struct client_struct_unix* client) {
+	struct nc_cpblts* caps = NULL;
+	int out_fd = client->sock;
+
+	client->outq = output_queue_new((struct client_struct*)client, &out_fd);
+
+	caps = module_get_cpblts();
+	client->nc_sess = nc_session_accept_inout(caps, client->username, client->sock, out_fd);
+	nc_cpblts_free(caps);
+	if (client->to_free == 1) {
+		/* probably a signal received */
+		if (client->nc_sess != NULL) {
+			/* unlikely to happen */
+			nc_session_free(client->nc_sess);
+		}
+		return EXIT_FAILURE;
+	}
+	if (client->nc_sess == NULL) {
+		nc_verb_error("%s: failed to create a new NETCONF session", __func__);
+		client->to_free = 1;
+		return EXIT_FAILURE;
+	}
+
+	nc_verb_verbose("New server session for '%s' with ID %s", client->username, nc_session_get_id(client->nc_sess));
+	np_session_index_add(client->nc_sess, (struct client_struct*)client, &client->to_free);
+	if (client->outq != NULL) {
+		output_queue_set_sid(client->outq, nc_session_get_id(client->nc_sess));
+	}
+	gettimeofday((struct timeval*)&client->last_rpc_time, NULL);
+
+	return EXIT_SUCCESS;
+}
+
+/* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
+static int np_unix_client_netconf_rpc(struct client_struct* arg) {
+	struct client_struct_unix* client = (struct client_struct_unix*)arg;
+	int ret;
+
+	if (client->to_free) {
+		return 1;
+	}
+
+	if (client->nc_sess == NULL && create_netconf_session(client)) {
+		return 1;
+	}
+
+	ret = np_rpc_dispatch(arg, client->nc_sess, &client->last_rpc_time);
+
+	/* the reply was already sent, the session can be freed */
+	if (ret == 2) {
+		nc_verb_verbose("Freeing session for '%s'", client->username);
+		np_session_index_del(nc_session_get_id(client->nc_sess));
+		nc_session_free(client->nc_sess);
+		client->nc_sess = NULL;
+		client->to_free = 1;
+		ret = 1;
+	}
+
+	return ret;
+}
+
+/* return: 0 - nothing happened (sleep), 1 - something happened (skip sleep) */
+static int np_unix_client_transport(struct client_struct* arg) {
+	struct client_struct_unix* client = (struct client_struct_unix*)arg;
+	struct timeval cur_time;
+
+	if (quit) {
+		if (client->nc_sess != NULL) {
+			nc_verb_verbose("Freeing session for '%s'", client->username);
+			np_session_index_del(nc_session_get_id(client->nc_sess));
+			nc_session_free(client->nc_sess);
+			client->nc_sess = NULL;
+		}
+		client->to_free = 1;
+	}
+
+	if (client->to_free || client->nc_sess == NULL) {
+		return 1;
+	}
+
+	gettimeofday(&cur_time, NULL);
+
+	/* check the session for idle timeout */
+	if (timeval_diff(cur_time, client->last_rpc_time) >= netopeer_options.idle_timeout) {
+		/* check for active event subscriptions, in that case we can never disconnect an idle session */
+		if (!ncntf_session_get_active_subscription(client->nc_sess)) {
+			nc_verb_warning("Session of client '%s' did not send/receive an RPC for too long, disconnecting.", client->username);
+			client->to_free = 1;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* return: 0 - the client is busy, 1 - no RPC was exchanged for timeout seconds */
+static int np_unix_client_idle(struct client_struct* arg, unsigned int timeout, struct timeval* last_rpc_time) {
+	struct client_struct_unix* client = (struct client_struct_unix*)arg;
+	struct timeval cur_time;
+
+	if (client->to_free || client->nc_sess == NULL) {
+		return 0;
+	}
+
+	gettimeofday(&cur_time, NULL);
+	if (timeval_diff(cur_time, client->last_rpc_time) < timeout) {
+		return 0;
+	}
+
+	/* the idle timeout of a session with a subscription never expires */
+	if (ncntf_session_get_active_subscription(client->nc_sess)) {
+		timerclear(last_rpc_time);
+	} else {
+		*last_rpc_time = client->last_rpc_time;
+	}
+
+	return 1;
+}
+
+static void np_unix_init(void) {
+	/* nothing to do */
+}
+
+static int np_unix_session_count(void) {
+	struct client_struct* client;
+	int count = 0;
+
+	for (client = netopeer_state.clients; client != NULL; client = client->next) {
+		if (client->transport != NP_TRANSPORT_UNIX) {
+			continue;
+		}
+		++count;
+	}
+
+	return count;
+}
+
+static int np_unix_create_client(struct client_struct* arg, void* UNUSED(ctx)) {
+	struct client_struct_unix* new_client = (struct client_struct_unix*)arg;
+	struct ucred cred;
+	socklen_t len = sizeof cred;
+	struct passwd pwd, *pwd_ret;
+	char* buf;
+	size_t buf_len;
+	int ret;
+
+	/* the peer credentials are those of the process that called connect() */
+	if (getsockopt(new_client->sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+		nc_verb_error("%s: getsockopt failed (%s)", __func__, strerror(errno));
+		return 1;
+	}
+	new_client->uid = cred.uid;
+	new_client->pid = cred.pid;
+
+	/* the NETCONF username is the name of the local user */
+	if ((buf_len = sysconf(_SC_GETPW_R_SIZE_MAX)) == (size_t)-1) {
+		buf_len = 2048;
+	}
+	buf = malloc(buf_len);
+	ret = getpwuid_r(cred.uid, &pwd, buf, buf_len, &pwd_ret);
+	if (pwd_ret == NULL) {
+		if (ret != 0) {
+			nc_verb_error("%s: getpwuid_r failed (%s)", __func__, strerror(ret));
+		} else {
+			nc_verb_warning("Unix socket client (PID %d) with an unknown UID %d, dropping it.", (int)cred.pid, (int)cred.uid);
+		}
+		free(buf);
+		return 1;
+	}
+	new_client->username = strdup(pwd.pw_name);
+	free(buf);
+
+	nc_verb_verbose("Unix socket client '%s' (PID %d) connected.", new_client->username, (int)cred.pid);
+	gettimeofday((struct timeval*)&new_client->last_rpc_time, NULL);
+
+	return 0;
+}
+
+static void np_unix_cleanup(void) {
+	/* nothing to do */
+}
+
+const struct np_transport np_unix_transport = {
+	.transport = NP_TRANSPORT_UNIX,
+	.name = "Unix",
+	.init = np_unix_init,
+	/* the peer is authenticated by the kernel, there is no server identity */
+	.server_id_check = NULL,
+	.ctx_free = NULL,
+	.create_client = np_unix_create_client,
+	.client_transport = np_unix_client_transport,
+	.client_netconf_rpc = np_unix_client_netconf_rpc,
+	.client_idle = np_unix_client_idle,
+	.reply_batch = NULL,
+	.client_free = client_free_unix,
+	.session_count = np_unix_session_count,
+	.thread_cleanup = NULL,
+	.cleanup = np_unix_cleanup
+};
@@ -0,0 +1,71 @@
+/**
+ * @file server_unix.h
+ * @brief Netopeer server Unix socket part header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _SERVER_UNIX_H_
+#define _SERVER_UNIX_H_
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <libnetconf.h>
+
+/* local transport unknown to libnetconf, the NETCONF session uses plain file descriptors */
+#define NP_TRANSPORT_UNIX ((NC_TRANSPORT)(NC_TRANSPORT_TLS + 1))
+
+/* for each client */
+struct client_struct_unix {
+	NC_TRANSPORT transport;
+
+	int sock;
+	int wake_fd;
+	int callhome;
+	struct sockaddr_storage saddr;
+	pthread_t tid;
+	char* username;
+	volatile int to_free;
+	struct client_struct* next;
+	struct output_queue* outq;
+
+	uid_t uid;							// peer credentials
+	pid_t pid;
+	struct nc_session* nc_sess;
+	volatile struct timeval last_rpc_time;	// timestamp of the last RPC either in or out
+};
+
+extern const struct np_transport np_unix_transport;
+
+#endif /* _SERVER_UNIX_H_ */
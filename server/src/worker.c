@@ -0,0 +1,1484 @@
+/**
+ * @file worker.c
+ * @brief Netopeer session worker processes
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#define _GNU_SOURCE
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "server.h"
+#include "commit.h"
+#include "state_data.h"
+#include "worker.h"
+
+extern int quit;
+
+/* one direction between the owner and a worker, in the shared memory */
+struct worker_ring {
+	volatile uint32_t head;			// bytes ever written, moved by the producer only
+	volatile uint32_t tail;			// bytes ever read, moved by the consumer only
+	char data[WORKER_RING_SIZE];
+};
+
+struct worker_shm {
+	struct worker_ring req;			// from the worker to the owner
+	struct worker_ring rep;			// from the owner to the worker
+	volatile unsigned int cpblts_changes;	// of the owner, written by it to every worker
+};
+
+/* eventfds of a worker, created by the owner before the fork */
+enum {
+	WORKER_FD_REQ_DATA,
+	WORKER_FD_REQ_SPACE,
+	WORKER_FD_REP_DATA,
+	WORKER_FD_REP_SPACE,
+	WORKER_FD_COUNT
+};
+
+/* the rings as seen by one of the processes */
+struct worker_link {
+	struct worker_ring* in;
+	struct worker_ring* out;
+	int in_data, in_space;			// signaled by the peer when it wrote, by us when we read
+	int out_data, out_space;		// signaled by us when we wrote, by the peer when it read
+	pthread_mutex_t out_lock;		// a message is written at once
+	pid_t peer;
+	volatile int dead;				// the peer process is gone
+};
+
+enum worker_msg_type {
+	WORKER_MSG_START,				// sid, username, hostname, capabilities
+	WORKER_MSG_STOP,				// sid
+	WORKER_MSG_RPC,					// sid, RPC
+	WORKER_MSG_KILL,				// sid, a request of a worker or an order of the owner
+	WORKER_MSG_CPBLTS,				// nothing
+	WORKER_MSG_REPLY				// reply, kill result, or capabilities
+};
+
+struct worker_msg {
+	uint32_t type;
+	uint32_t len;					// of the payload, NUL-terminated strings
+	uint64_t id;					// matches a reply with its request, 0 for none
+};
+
+/* a session of a worker */
+struct worker_sess {
+	char* sid;
+	struct nc_session* dummy;		// its copy in the owner the RPCs are applied on
+	unsigned int refs;				// the worker until STOP and the RPCs being applied
+};
+
+/* a worker thread waiting for the owner */
+struct worker_call {
+	uint64_t id;
+	char* reply;
+	uint32_t len;
+	int done;
+	struct worker_call* next;
+};
+
+/* an RPC of a worker waiting for a thread of the owner */
+struct worker_rpc_arg {
+	struct worker_proc* proc;
+	uint64_t id;
+	char* payload;
+	uint32_t len;
+	struct worker_rpc_arg* next;
+};
+
+static struct {
+	int id;							// index of this worker, -1 in the owner
+	struct worker_shm* shm;
+	size_t shm_size;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* the owner */
+	struct worker_proc {
+		struct worker_link link;
+		int fds[WORKER_FD_COUNT];
+		pthread_t tid;				// reading the requests of the worker
+		unsigned long rpcs;
+		unsigned long restarts;
+		struct worker_sess** sessions;	// sorted by sid
+		unsigned int sess_count;
+	} *procs;
+	unsigned int count;
+	int launcher_fd;				// the process forking the workers, -1 if none
+	pid_t launcher_pid;
+	pthread_mutex_t launcher_lock;	// one worker is forked at a time
+	pthread_t* rpc_pool;			// applying the RPCs of the workers
+	unsigned int rpc_pool_size;
+	struct worker_rpc_arg* rpc_head, **rpc_tail;
+	pthread_cond_t rpc_cond;
+	int rpc_quit;					// the pool finishes the queued RPCs and exits
+	volatile int stopping;
+
+	/* a worker */
+	pthread_t tid;					// reading the replies of the owner
+	uint64_t next_id;
+	struct worker_call* calls;
+	struct worker_sess** sessions;	// announced to the owner, sorted by sid
+	unsigned int sess_count;
+} workers = {
+	.id = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.launcher_fd = -1,
+	.launcher_lock = PTHREAD_MUTEX_INITIALIZER,
+	.rpc_tail = &workers.rpc_head,
+	.rpc_cond = PTHREAD_COND_INITIALIZER
+};
+
+/*
+ * binary search in a session array
+ *
+ * return: 1 - found at idx, 0 - not found, idx is where it belongs
+ */
+static int sess_find(struct worker_sess** sessions, unsigned int count, const char* sid, unsigned int* idx) {
+	unsigned int low = 0, high = count, mid;
+	int cmp;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		cmp = strcmp(sessions[mid]->sid, sid);
+		if (cmp == 0) {
+			*idx = mid;
+			return 1;
+		} else if (cmp < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	*idx = low;
+	return 0;
+}
+
+/* return: 0 - success, 1 - memory allocation failed */
+static int sess_insert(struct worker_sess*** sessions, unsigned int* count, unsigned int idx, struct worker_sess* sess) {
+	struct worker_sess** new_sessions;
+
+	new_sessions = realloc(*sessions, (*count + 1) * sizeof *new_sessions);
+	if (new_sessions == NULL) {
+		return 1;
+	}
+	memmove(new_sessions + idx + 1, new_sessions + idx, (*count - idx) * sizeof *new_sessions);
+	new_sessions[idx] = sess;
+	*sessions = new_sessions;
+	++(*count);
+
+	return 0;
+}
+
+static void sess_remove(struct worker_sess** sessions, unsigned int* count, unsigned int idx) {
+	--(*count);
+	memmove(sessions + idx, sessions + idx + 1, (*count - idx) * sizeof *sessions);
+}
+
+/* call with the lock held */
+static void sess_put(struct worker_sess* sess) {
+	if (--sess->refs > 0) {
+		return;
+	}
+
+	if (sess->dummy != NULL) {
+		nc_session_free(sess->dummy);
+	}
+	free(sess->sid);
+	free(sess);
+}
+
+static void link_init(struct worker_link* link, struct worker_shm* shm, const int* fds, int owner, pid_t peer) {
+	if (owner) {
+		link->in = &shm->req;
+		link->out = &shm->rep;
+		link->in_data = fds[WORKER_FD_REQ_DATA];
+		link->in_space = fds[WORKER_FD_REQ_SPACE];
+		link->out_data = fds[WORKER_FD_REP_DATA];
+		link->out_space = fds[WORKER_FD_REP_SPACE];
+	} else {
+		link->in = &shm->rep;
+		link->out = &shm->req;
+		link->in_data = fds[WORKER_FD_REP_DATA];
+		link->in_space = fds[WORKER_FD_REP_SPACE];
+		link->out_data = fds[WORKER_FD_REQ_DATA];
+		link->out_space = fds[WORKER_FD_REQ_SPACE];
+	}
+	pthread_mutex_init(&link->out_lock, NULL);
+	link->peer = peer;
+	link->dead = 0;
+}
+
+static int link_peer_gone(struct worker_link* link) {
+	if (workers.id != -1) {
+		/* a worker is reparented once the launcher exits, it does with the owner */
+		return (getppid() != link->peer);
+	}
+
+	/* the workers are children of the launcher, it reaps them */
+	return (kill(link->peer, 0) == -1 && errno == ESRCH);
+}
+
+/* the rings are emptied for a new worker, call with the out lock held */
+static void link_reset(struct worker_link* link, pid_t peer) {
+	uint64_t count;
+
+	link->in->head = link->in->tail = 0;
+	link->out->head = link->out->tail = 0;
+	if (read(link->in_data, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+	}
+	if (read(link->in_space, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+	}
+	if (read(link->out_data, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+	}
+	if (read(link->out_space, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+	}
+	link->peer = peer;
+	link->dead = 0;
+}
+
+static void link_signal(int fd) {
+	uint64_t count = 1;
+
+	if (write(fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+		nc_verb_error("%s: write failed (%s)", __func__, strerror(errno));
+	}
+}
+
+/*
+ * wait for the peer to signal an eventfd, checking every second whether it still exists
+ *
+ * return: 0 - signaled, 1 - the peer is gone
+ */
+static int link_wait(struct worker_link* link, int fd) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	uint64_t count;
+	int ret;
+
+	while (!link->dead) {
+		ret = poll(&pfd, 1, 1000);
+		if (ret == 1) {
+			if (read(fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+				nc_verb_error("%s: read failed (%s)", __func__, strerror(errno));
+			}
+			return 0;
+		}
+		if (ret == -1 && errno != EINTR) {
+			nc_verb_error("%s: poll failed (%s)", __func__, strerror(errno));
+		}
+		if (link_peer_gone(link)) {
+			link->dead = 1;
+		}
+	}
+
+	return 1;
+}
+
+/* return: 0 - written, 1 - the peer is gone */
+static int ring_write(struct worker_link* link, const char* buf, size_t len) {
+	struct worker_ring* ring = link->out;
+	uint32_t head, off, n;
+
+	while (len > 0) {
+		head = ring->head;
+		n = WORKER_RING_SIZE - (head - ring->tail);
+		if (n == 0) {
+			if (link_wait(link, link->out_space)) {
+				return 1;
+			}
+			continue;
+		}
+
+		off = head & (WORKER_RING_SIZE - 1);
+		if (n > WORKER_RING_SIZE - off) {
+			n = WORKER_RING_SIZE - off;
+		}
+		if (n > len) {
+			n = len;
+		}
+		memcpy(ring->data + off, buf, n);
+		/* the data must be visible before the new head */
+		__sync_synchronize();
+		ring->head = head + n;
+
+		buf += n;
+		len -= n;
+		link_signal(link->out_data);
+	}
+
+	return 0;
+}
+
+/* return: 0 - read, 1 - the peer is gone */
+static int ring_read(struct worker_link* link, char* buf, size_t len) {
+	struct worker_ring* ring = link->in;
+	uint32_t tail, off, n;
+
+	while (len > 0) {
+		tail = ring->tail;
+		n = ring->head - tail;
+		if (n == 0) {
+			if (link_wait(link, link->in_data)) {
+				return 1;
+			}
+			continue;
+		}
+		/* the data must not be read before the head */
+		__sync_synchronize();
+
+		off = tail & (WORKER_RING_SIZE - 1);
+		if (n > WORKER_RING_SIZE - off) {
+			n = WORKER_RING_SIZE - off;
+		}
+		if (n > len) {
+			n = len;
+		}
+		memcpy(buf, ring->data + off, n);
+		/* the data must be copied before the space is released */
+		__sync_synchronize();
+		ring->tail = tail + n;
+
+		buf += n;
+		len -= n;
+		link_signal(link->in_space);
+	}
+
+	return 0;
+}
+
+/* return: 0 - sent, 1 - the peer is gone */
+static int link_send(struct worker_link* link, uint32_t type, uint64_t id, const char* const* parts, unsigned int count) {
+	struct worker_msg msg;
+	unsigned int i;
+	size_t len = 0;
+	int ret;
+
+	for (i = 0; i < count; ++i) {
+		len += strlen(parts[i]) + 1;
+	}
+	msg.type = type;
+	msg.len = len;
+	msg.id = id;
+
+	/* OUT LOCK */
+	pthread_mutex_lock(&link->out_lock);
+
+	ret = ring_write(link, (char*)&msg, sizeof msg);
+	for (i = 0; ret == 0 && i < count; ++i) {
+		ret = ring_write(link, parts[i], strlen(parts[i]) + 1);
+	}
+
+	/* OUT UNLOCK */
+	pthread_mutex_unlock(&link->out_lock);
+
+	return ret;
+}
+
+/* return: payload of the message, NULL if the peer is gone */
+static char* link_recv(struct worker_link* link, struct worker_msg* msg) {
+	char* payload;
+
+	if (ring_read(link, (char*)msg, sizeof *msg)) {
+		return NULL;
+	}
+
+	/* always terminated, even if empty */
+	if ((payload = malloc(msg->len + 1)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		link->dead = 1;
+		return NULL;
+	}
+	if (ring_read(link, payload, msg->len)) {
+		free(payload);
+		return NULL;
+	}
+	payload[msg->len] = '\0';
+
+	return payload;
+}
+
+/* return: the string following part in the payload, NULL if there is none */
+static const char* msg_next(const char* part, const char* payload, uint32_t len) {
+	part += strlen(part) + 1;
+	if (part >= payload + len) {
+		return NULL;
+	}
+	return part;
+}
+
+/*
+ * the worker
+ */
+
+static void* worker_reply_thread(void* UNUSED(arg)) {
+	struct worker_link* link = &workers.procs[workers.id].link;
+	struct worker_call* call;
+	struct worker_msg msg;
+	char* payload;
+
+	while ((payload = link_recv(link, &msg)) != NULL) {
+		if (msg.type == WORKER_MSG_KILL) {
+			/* another process asked for one of our sessions */
+			if (np_session_kill(payload, NULL) == 0) {
+				nc_verb_verbose("Session with the ID %s killed.", payload);
+			}
+			free(payload);
+			continue;
+		}
+
+		/* WORKER LOCK */
+		pthread_mutex_lock(&workers.lock);
+
+		for (call = workers.calls; call != NULL && call->id != msg.id; call = call->next);
+		if (call != NULL) {
+			call->reply = payload;
+			call->len = msg.len;
+			call->done = 1;
+			pthread_cond_broadcast(&workers.cond);
+		} else {
+			free(payload);
+		}
+
+		/* WORKER UNLOCK */
+		pthread_mutex_unlock(&workers.lock);
+	}
+
+	nc_verb_error("Worker %d: the owner process is gone, terminating.", workers.id);
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	/* nothing can be applied anymore */
+	link->dead = 1;
+	for (call = workers.calls; call != NULL; call = call->next) {
+		call->done = 1;
+	}
+	pthread_cond_broadcast(&workers.cond);
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	quit = 1;
+	return NULL;
+}
+
+/* return: reply payload, NULL if the owner is gone */
+static char* worker_call(uint32_t type, const char* const* parts, unsigned int count, uint32_t* len) {
+	struct worker_link* link = &workers.procs[workers.id].link;
+	struct worker_call call, **prev;
+
+	memset(&call, 0, sizeof call);
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (link->dead) {
+		/* WORKER UNLOCK */
+		pthread_mutex_unlock(&workers.lock);
+		return NULL;
+	}
+	call.id = ++workers.next_id;
+	call.next = workers.calls;
+	workers.calls = &call;
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	/* the reply thread completes the call even if the owner is gone */
+	if (link_send(link, type, call.id, parts, count)) {
+		link->dead = 1;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	while (!call.done && !link->dead) {
+		pthread_cond_wait(&workers.cond, &workers.lock);
+	}
+	for (prev = &workers.calls; *prev != &call; prev = &(*prev)->next);
+	*prev = call.next;
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	if (len != NULL) {
+		*len = call.len;
+	}
+	return call.reply;
+}
+
+int worker_session_start(struct nc_session* session) {
+	struct worker_link* link;
+	struct worker_sess* sess;
+	struct nc_cpblts* cpblts;
+	const char* sid, *str, **parts;
+	unsigned int idx, count;
+	int found, ret;
+
+	if (workers.id == -1 || session == NULL) {
+		return 0;
+	}
+	link = &workers.procs[workers.id].link;
+	sid = nc_session_get_id(session);
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+	found = sess_find(workers.sessions, workers.sess_count, sid, &idx);
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	if (found) {
+		return 0;
+	}
+
+	/* only the thread of the session announces it */
+	cpblts = nc_session_get_cpblts(session);
+	count = 3 + (cpblts != NULL ? nc_cpblts_count(cpblts) : 0);
+	if ((parts = malloc(count * sizeof *parts)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		return 1;
+	}
+	parts[0] = sid;
+	parts[1] = ((str = nc_session_get_user(session)) != NULL ? str : "");
+	parts[2] = ((str = nc_session_get_host(session)) != NULL ? str : "");
+	count = 3;
+	if (cpblts != NULL) {
+		nc_cpblts_iter_start(cpblts);
+		while ((str = nc_cpblts_iter_next(cpblts)) != NULL) {
+			parts[count++] = str;
+		}
+	}
+	ret = link_send(link, WORKER_MSG_START, 0, parts, count);
+	free(parts);
+	if (ret) {
+		return 1;
+	}
+
+	if ((sess = calloc(1, sizeof *sess)) == NULL || (sess->sid = strdup(sid)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		free(sess);
+		return 1;
+	}
+	sess->refs = 1;
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+	sess_find(workers.sessions, workers.sess_count, sid, &idx);
+	ret = sess_insert(&workers.sessions, &workers.sess_count, idx, sess);
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	if (ret) {
+		free(sess->sid);
+		free(sess);
+		return 1;
+	}
+	return 0;
+}
+
+nc_reply* worker_rpc(struct nc_session* session, const nc_rpc* rpc) {
+	const char* parts[2];
+	struct nc_err* err;
+	nc_reply* reply = NULL;
+	char* dump, *str = NULL;
+	uint32_t len = 0;
+
+	/* announced when it was created, unless that failed */
+	if (worker_session_start(session) == 0 && (dump = nc_rpc_dump(rpc)) != NULL) {
+		parts[0] = nc_session_get_id(session);
+		parts[1] = dump;
+		str = worker_call(WORKER_MSG_RPC, parts, 2, &len);
+		free(dump);
+	}
+
+	/* an empty reply means the owner could not apply the RPC */
+	if (str != NULL && len > 1) {
+		reply = nc_reply_build(str);
+	}
+	free(str);
+
+	if (reply == NULL) {
+		err = nc_err_new(NC_ERR_OP_FAILED);
+		nc_err_set(err, NC_ERR_PARAM_MSG, "The RPC could not be applied by the server.");
+		reply = nc_reply_error(err);
+	}
+	return reply;
+}
+
+void worker_session_end(const char* sid) {
+	struct worker_sess* sess;
+	unsigned int idx;
+
+	if (workers.id == -1 || sid == NULL) {
+		return;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (!sess_find(workers.sessions, workers.sess_count, sid, &idx)) {
+		/* announcing it failed */
+		/* WORKER UNLOCK */
+		pthread_mutex_unlock(&workers.lock);
+		return;
+	}
+	sess = workers.sessions[idx];
+	sess_remove(workers.sessions, &workers.sess_count, idx);
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	link_send(&workers.procs[workers.id].link, WORKER_MSG_STOP, 0, &sid, 1);
+	free(sess->sid);
+	free(sess);
+}
+
+struct nc_cpblts* worker_cpblts(void) {
+	struct nc_cpblts* cpblts = NULL;
+	const char** list;
+	const char* part;
+	unsigned int count = 0;
+	char* str;
+	uint32_t len;
+
+	if ((str = worker_call(WORKER_MSG_CPBLTS, NULL, 0, &len)) == NULL) {
+		return NULL;
+	}
+
+	for (part = str; part < str + len; part += strlen(part) + 1) {
+		++count;
+	}
+	if ((list = malloc((count + 1) * sizeof *list)) != NULL) {
+		count = 0;
+		for (part = str; part < str + len; part += strlen(part) + 1) {
+			list[count++] = part;
+		}
+		list[count] = NULL;
+		cpblts = nc_cpblts_new(list);
+		free(list);
+	}
+	free(str);
+
+	return cpblts;
+}
+
+unsigned int worker_cpblts_changes(void) {
+	return workers.shm[workers.id].cpblts_changes;
+}
+
+static int worker_child(unsigned int idx) {
+	struct sigaction action;
+	unsigned int i, j;
+	int ret;
+
+	workers.id = idx;
+	/* the other workers */
+	for (i = 0; i < workers.count; ++i) {
+		for (j = 0; i != idx && j < WORKER_FD_COUNT; ++j) {
+			close(workers.procs[i].fds[j]);
+		}
+	}
+	workers.count = 0;
+	close(workers.launcher_fd);
+	workers.launcher_fd = -1;
+	link_init(&workers.procs[idx].link, &workers.shm[idx], workers.procs[idx].fds, 0, getppid());
+	/* a late reply to a call of a previous worker in this slot must not match ours */
+	workers.next_id = (uint64_t)getpid() << 32;
+
+	/* only the owner restarts the server */
+	memset(&action, 0, sizeof action);
+	action.sa_handler = SIG_IGN;
+	sigaction(SIGHUP, &action, NULL);
+
+	if ((ret = pthread_create(&workers.tid, NULL, worker_reply_thread, NULL)) != 0) {
+		nc_verb_error("Worker %u: creating a thread failed (%s).", idx, strerror(ret));
+		return 1;
+	}
+
+	nc_verb_verbose("Worker %u started (PID %d).", idx, getpid());
+	return 0;
+}
+
+/*
+ * the launcher
+ */
+
+/*
+ * forked by the owner while it has a single thread, it forks the workers the
+ * owner asks for so that the owner never forks with its threads running,
+ * and reaps them
+ *
+ * return: index of the worker to run, in a new worker only
+ */
+static unsigned int launcher_loop(int fd) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	sigset_t mask;
+	uint32_t idx;
+	ssize_t len;
+	pid_t pid;
+	int status;
+
+	/* the signals are for the owner, the launcher exits with it */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGQUIT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+
+	while (1) {
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			if (WIFSIGNALED(status)) {
+				nc_verb_error("Worker process %d was killed by signal %d.", pid, WTERMSIG(status));
+			} else if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS) {
+				nc_verb_error("Worker process %d exited with status %d.", pid, WEXITSTATUS(status));
+			}
+		}
+
+		if (poll(&pfd, 1, 1000) < 1) {
+			continue;
+		}
+		if ((len = recv(fd, &idx, sizeof idx, 0)) != sizeof idx) {
+			if (len == -1 && errno == EINTR) {
+				continue;
+			}
+			/* the owner is gone */
+			_exit(EXIT_SUCCESS);
+		}
+
+		if ((pid = fork()) == 0) {
+			sigprocmask(SIG_UNBLOCK, &mask, NULL);
+			return idx;
+		}
+		/* -1 if it failed */
+		send(fd, &pid, sizeof pid, MSG_NOSIGNAL);
+	}
+}
+
+/*
+ * ask the launcher for a new worker
+ *
+ * return: PID of the worker, -1 on error
+ */
+static pid_t launcher_spawn(unsigned int idx) {
+	uint32_t msg = idx;
+	pid_t pid = -1;
+
+	/* LAUNCHER LOCK */
+	pthread_mutex_lock(&workers.launcher_lock);
+
+	if (workers.stopping || workers.launcher_fd == -1) {
+		/* no new worker once they are being stopped */
+	} else if (send(workers.launcher_fd, &msg, sizeof msg, MSG_NOSIGNAL) != sizeof msg ||
+			recv(workers.launcher_fd, &pid, sizeof pid, 0) != sizeof pid) {
+		nc_verb_error("%s: the launcher is gone (%s)", __func__, strerror(errno));
+		pid = -1;
+	}
+
+	/* LAUNCHER UNLOCK */
+	pthread_mutex_unlock(&workers.launcher_lock);
+
+	return pid;
+}
+
+/*
+ * the owner
+ */
+
+static void owner_sess_start(struct worker_proc* proc, const char* payload, uint32_t len) {
+	struct worker_sess* sess;
+	struct nc_cpblts* cpblts;
+	const char* user, *host, *part, **list;
+	unsigned int idx, count = 0;
+
+	if ((user = msg_next(payload, payload, len)) == NULL || (host = msg_next(user, payload, len)) == NULL) {
+		nc_verb_error("%s: corrupted message", __func__);
+		return;
+	}
+	for (part = msg_next(host, payload, len); part != NULL; part = msg_next(part, payload, len)) {
+		++count;
+	}
+	if ((list = malloc((count + 1) * sizeof *list)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		return;
+	}
+	count = 0;
+	for (part = msg_next(host, payload, len); part != NULL; part = msg_next(part, payload, len)) {
+		list[count++] = part;
+	}
+	list[count] = NULL;
+
+	if ((sess = calloc(1, sizeof *sess)) == NULL || (sess->sid = strdup(payload)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		free(sess);
+		free(list);
+		return;
+	}
+	cpblts = nc_cpblts_new(list);
+	sess->dummy = nc_session_dummy(payload, user, (host[0] != '\0' ? host : NULL), cpblts);
+	nc_cpblts_free(cpblts);
+	free(list);
+	sess->refs = 1;
+	if (sess->dummy == NULL) {
+		nc_verb_error("%s: creating the session %s of worker %u failed", __func__, payload, (unsigned int)(proc - workers.procs));
+		sess_put(sess);
+		return;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (sess_find(proc->sessions, proc->sess_count, payload, &idx) ||
+			sess_insert(&proc->sessions, &proc->sess_count, idx, sess)) {
+		sess_put(sess);
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+}
+
+static void owner_sess_stop(struct worker_proc* proc, const char* sid) {
+	unsigned int idx;
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (sess_find(proc->sessions, proc->sess_count, sid, &idx)) {
+		sess_put(proc->sessions[idx]);
+		sess_remove(proc->sessions, &proc->sess_count, idx);
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	/* its confirmed commit was applied here */
+	commit_session_end(sid);
+}
+
+static void owner_rpc_apply(struct worker_rpc_arg* rpc_arg) {
+	struct worker_proc* proc = rpc_arg->proc;
+	struct worker_sess* sess = NULL;
+	struct state_get* state_get = NULL;
+	const char* dump, *str;
+	nc_rpc* rpc = NULL;
+	nc_reply* reply;
+	char* reply_dump = NULL;
+	unsigned int idx;
+
+	dump = msg_next(rpc_arg->payload, rpc_arg->payload, rpc_arg->len);
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (sess_find(proc->sessions, proc->sess_count, rpc_arg->payload, &idx)) {
+		sess = proc->sessions[idx];
+		++sess->refs;
+	}
+	++proc->rpcs;
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	if (sess != NULL && dump != NULL && (rpc = nc_rpc_build(dump, sess->dummy)) != NULL) {
+		reply = np_rpc_apply(sess->dummy, rpc, &state_get);
+		reply_dump = nc_reply_dump(reply);
+		nc_reply_free(reply);
+	}
+
+	str = (reply_dump != NULL ? reply_dump : "");
+	link_send(&proc->link, WORKER_MSG_REPLY, rpc_arg->id, &str, 1);
+	free(reply_dump);
+
+	/* the datastores that did not reply in time may still use the session and the RPC */
+	state_data_finish(state_get);
+	nc_rpc_free(rpc);
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	if (sess != NULL) {
+		sess_put(sess);
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	free(rpc_arg->payload);
+	free(rpc_arg);
+}
+
+/* the RPCs of all the workers are applied in parallel by a fixed number of threads */
+static void* owner_rpc_thread(void* UNUSED(arg)) {
+	struct worker_rpc_arg* rpc_arg;
+
+	while (1) {
+		/* WORKER LOCK */
+		pthread_mutex_lock(&workers.lock);
+
+		while (workers.rpc_head == NULL && !workers.rpc_quit) {
+			pthread_cond_wait(&workers.rpc_cond, &workers.lock);
+		}
+		if ((rpc_arg = workers.rpc_head) != NULL) {
+			if ((workers.rpc_head = rpc_arg->next) == NULL) {
+				workers.rpc_tail = &workers.rpc_head;
+			}
+		}
+
+		/* WORKER UNLOCK */
+		pthread_mutex_unlock(&workers.lock);
+
+		if (rpc_arg == NULL) {
+			/* nothing queued and quitting */
+			break;
+		}
+		owner_rpc_apply(rpc_arg);
+	}
+
+	return NULL;
+}
+
+static void owner_rpc(struct worker_proc* proc, uint64_t id, char* payload, uint32_t len) {
+	struct worker_rpc_arg* rpc_arg;
+	const char* str = "";
+
+	if ((rpc_arg = malloc(sizeof *rpc_arg)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		link_send(&proc->link, WORKER_MSG_REPLY, id, &str, 1);
+		free(payload);
+		return;
+	}
+	rpc_arg->proc = proc;
+	rpc_arg->id = id;
+	rpc_arg->payload = payload;
+	rpc_arg->len = len;
+	rpc_arg->next = NULL;
+
+	if (workers.rpc_pool_size == 0) {
+		/* no thread could be started, the reader of the worker applies it */
+		owner_rpc_apply(rpc_arg);
+		return;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	*workers.rpc_tail = rpc_arg;
+	workers.rpc_tail = &rpc_arg->next;
+	pthread_cond_signal(&workers.rpc_cond);
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+}
+
+static void owner_cpblts(struct worker_proc* proc, uint64_t id) {
+	struct nc_cpblts* cpblts;
+	const char** parts = NULL, *str;
+	unsigned int count = 0;
+
+	if ((cpblts = module_get_cpblts()) != NULL &&
+			(parts = malloc((nc_cpblts_count(cpblts) + 1) * sizeof *parts)) != NULL) {
+		nc_cpblts_iter_start(cpblts);
+		while ((str = nc_cpblts_iter_next(cpblts)) != NULL) {
+			parts[count++] = str;
+		}
+	}
+
+	link_send(&proc->link, WORKER_MSG_REPLY, id, parts, count);
+	free(parts);
+	if (cpblts != NULL) {
+		nc_cpblts_free(cpblts);
+	}
+}
+
+/* the sessions of a worker that exited */
+static void owner_sess_drop(struct worker_proc* proc) {
+	struct worker_sess** sessions;
+	unsigned int i, count;
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	sessions = proc->sessions;
+	count = proc->sess_count;
+	proc->sessions = NULL;
+	proc->sess_count = 0;
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	/* their confirmed commit was applied here */
+	for (i = 0; i < count; ++i) {
+		commit_session_end(sessions[i]->sid);
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	for (i = 0; i < count; ++i) {
+		sess_put(sessions[i]);
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	free(sessions);
+}
+
+/*
+ * start a new worker in the slot of one that exited
+ *
+ * return: 0 - restarted, 1 - the slot stays empty
+ */
+static int owner_restart(struct worker_proc* proc) {
+	unsigned int idx = proc - workers.procs;
+	pid_t pid;
+
+	/* a worker crashing right away is not restarted in a loop */
+	sleep(WORKER_RESTART_DELAY);
+	if (workers.stopping) {
+		return 1;
+	}
+	/* it may be alive, but useless, if its messages could not be read */
+	if (!link_peer_gone(&proc->link)) {
+		kill(proc->link.peer, SIGKILL);
+	}
+
+	/* OUT LOCK */
+	pthread_mutex_lock(&proc->link.out_lock);
+
+	/* the rings must be empty before the worker starts using them */
+	if ((pid = launcher_spawn(idx)) != -1) {
+		link_reset(&proc->link, pid);
+	}
+
+	/* OUT UNLOCK */
+	pthread_mutex_unlock(&proc->link.out_lock);
+
+	if (pid == -1) {
+		if (!workers.stopping) {
+			nc_verb_error("Restarting worker %u failed.", idx);
+		}
+		return 1;
+	}
+	if (workers.stopping) {
+		/* worker_stop() may have signaled the previous one */
+		kill(pid, SIGTERM);
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+	++proc->restarts;
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	nc_verb_warning("Worker %u restarted (PID %d).", idx, pid);
+	return 0;
+}
+
+static void* owner_read_thread(void* arg) {
+	struct worker_proc* proc = (struct worker_proc*)arg;
+	struct worker_msg msg;
+	const char* str;
+	char* payload;
+
+restart:
+	while ((payload = link_recv(&proc->link, &msg)) != NULL) {
+		switch (msg.type) {
+		case WORKER_MSG_START:
+			owner_sess_start(proc, payload, msg.len);
+			break;
+		case WORKER_MSG_STOP:
+			owner_sess_stop(proc, payload);
+			break;
+		case WORKER_MSG_RPC:
+			owner_rpc(proc, msg.id, payload, msg.len);
+			payload = NULL;
+			break;
+		case WORKER_MSG_KILL:
+			/* the session may be of the owner or of any worker */
+			str = (np_session_kill(payload, NULL) == 0 || worker_kill(payload) == 0 ? "0" : "1");
+			link_send(&proc->link, WORKER_MSG_REPLY, msg.id, &str, 1);
+			break;
+		case WORKER_MSG_CPBLTS:
+			owner_cpblts(proc, msg.id);
+			break;
+		default:
+			nc_verb_error("%s: unknown message type %u of worker %u", __func__, msg.type, (unsigned int)(proc - workers.procs));
+			break;
+		}
+		free(payload);
+	}
+
+	proc->link.dead = 1;
+	owner_sess_drop(proc);
+
+	if (!workers.stopping) {
+		nc_verb_error("Worker %u (PID %d) exited unexpectedly, its sessions were dropped.",
+				(unsigned int)(proc - workers.procs), proc->link.peer);
+		if (owner_restart(proc) == 0) {
+			goto restart;
+		}
+	}
+
+	return NULL;
+}
+
+void worker_cpblts_changed(unsigned int changes) {
+	unsigned int i;
+
+	if (workers.id != -1) {
+		return;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	/* concurrent changes may be published in any order, only a newer one counts */
+	for (i = 0; i < workers.count; ++i) {
+		if ((int)(changes - workers.shm[i].cpblts_changes) > 0) {
+			workers.shm[i].cpblts_changes = changes;
+		}
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+}
+
+int worker_kill(const char* sid) {
+	struct worker_proc* proc = NULL;
+	unsigned int i, idx;
+	char* str;
+	int ret;
+
+	if (workers.id != -1) {
+		/* the owner knows the sessions of all the processes */
+		if ((str = worker_call(WORKER_MSG_KILL, &sid, 1, NULL)) == NULL) {
+			return 1;
+		}
+		ret = (strcmp(str, "0") == 0 ? 0 : 1);
+		free(str);
+		return ret;
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	for (i = 0; i < workers.count; ++i) {
+		if (!workers.procs[i].link.dead &&
+				sess_find(workers.procs[i].sessions, workers.procs[i].sess_count, sid, &idx)) {
+			proc = &workers.procs[i];
+			break;
+		}
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	/* all the sessions of the workers are announced when they are created */
+	if (proc == NULL || link_send(&proc->link, WORKER_MSG_KILL, 0, &sid, 1)) {
+		return 1;
+	}
+	return 0;
+}
+
+static void worker_fds_close(struct worker_proc* proc) {
+	unsigned int i;
+
+	for (i = 0; i < WORKER_FD_COUNT; ++i) {
+		if (proc->fds[i] != -1) {
+			close(proc->fds[i]);
+			proc->fds[i] = -1;
+		}
+	}
+}
+
+static void launcher_stop(void) {
+	if (workers.launcher_fd == -1) {
+		return;
+	}
+
+	/* it exits once it reads the end */
+	close(workers.launcher_fd);
+	workers.launcher_fd = -1;
+	waitpid(workers.launcher_pid, NULL, 0);
+}
+
+int worker_start(unsigned int count) {
+	struct worker_proc* proc;
+	unsigned int i, j, pool_size;
+	long cpus;
+	pid_t pid;
+	int ret, sv[2];
+
+	if (count > WORKER_MAX) {
+		nc_verb_warning("Only %u worker processes can be started.", WORKER_MAX);
+		count = WORKER_MAX;
+	}
+
+	workers.shm_size = count * sizeof *workers.shm;
+	workers.shm = mmap(NULL, workers.shm_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (workers.shm == MAP_FAILED) {
+		nc_verb_error("%s: mmap failed (%s)", __func__, strerror(errno));
+		workers.shm = NULL;
+		return -1;
+	}
+	if ((workers.procs = calloc(count, sizeof *workers.procs)) == NULL) {
+		nc_verb_error("%s: memory allocation failed (%s:%d)", __func__, __FILE__, __LINE__);
+		munmap(workers.shm, workers.shm_size);
+		workers.shm = NULL;
+		return -1;
+	}
+
+	/* the eventfds of all the workers, the launcher inherits them */
+	for (i = 0; i < count; ++i) {
+		proc = &workers.procs[i];
+		for (j = 0; j < WORKER_FD_COUNT; ++j) {
+			if ((proc->fds[j] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+				nc_verb_error("%s: eventfd failed (%s)", __func__, strerror(errno));
+			}
+		}
+		if (proc->fds[WORKER_FD_COUNT - 1] == -1) {
+			nc_verb_error("Starting worker %u failed.", i);
+			worker_fds_close(proc);
+			break;
+		}
+	}
+	workers.count = i;
+
+	/* the launcher forks the workers, now and whenever one of them crashes */
+	if (workers.count > 0 && socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0) {
+		if ((pid = fork()) == 0) {
+			close(sv[0]);
+			workers.launcher_fd = sv[1];
+			if (worker_child(launcher_loop(sv[1]))) {
+				_exit(EXIT_FAILURE);
+			}
+			return 0;
+		}
+		close(sv[1]);
+		if (pid == -1) {
+			close(sv[0]);
+		} else {
+			workers.launcher_fd = sv[0];
+			workers.launcher_pid = pid;
+		}
+	}
+	if (workers.count > 0 && workers.launcher_fd == -1) {
+		nc_verb_error("Starting the worker launcher failed (%s).", strerror(errno));
+	}
+
+	for (i = 0; workers.launcher_fd != -1 && i < workers.count; ++i) {
+		if ((pid = launcher_spawn(i)) == -1) {
+			nc_verb_error("Starting worker %u failed.", i);
+			break;
+		}
+		link_init(&workers.procs[i].link, &workers.shm[i], workers.procs[i].fds, 1, pid);
+	}
+	/* the slots left without a worker */
+	for (j = i; j < workers.count; ++j) {
+		worker_fds_close(&workers.procs[j]);
+	}
+	workers.count = i;
+
+	if (workers.count == 0) {
+		launcher_stop();
+		free(workers.procs);
+		workers.procs = NULL;
+		munmap(workers.shm, workers.shm_size);
+		workers.shm = NULL;
+		return -1;
+	}
+
+	/* the threads applying the RPCs, the owner is never flooded by more of them */
+	pool_size = WORKER_RPC_THREADS;
+	if (pool_size == 0 && (cpus = sysconf(_SC_NPROCESSORS_ONLN)) > 0) {
+		pool_size = cpus;
+	}
+	if (pool_size == 0) {
+		pool_size = 1;
+	}
+	if ((workers.rpc_pool = calloc(pool_size, sizeof *workers.rpc_pool)) != NULL) {
+		workers.rpc_quit = 0;
+		while (workers.rpc_pool_size < pool_size && (ret = pthread_create(&workers.rpc_pool[workers.rpc_pool_size], NULL, owner_rpc_thread, NULL)) == 0) {
+			++workers.rpc_pool_size;
+		}
+	}
+	if (workers.rpc_pool_size == 0) {
+		nc_verb_warning("%s: no thread could be started, the RPCs of every worker are applied one by one.", __func__);
+	}
+
+	for (i = 0; i < workers.count; ++i) {
+		if ((ret = pthread_create(&workers.procs[i].tid, NULL, owner_read_thread, &workers.procs[i])) != 0) {
+			/* without a reader it cannot be used, it finishes once its rings are full */
+			nc_verb_error("%s: creating a thread failed (%s), stopping worker %u.", __func__, strerror(ret), i);
+			kill(workers.procs[i].link.peer, SIGTERM);
+			workers.procs[i].link.dead = 1;
+			workers.procs[i].tid = 0;
+		}
+	}
+
+	nc_verb_verbose("%u worker processes started, their RPCs are applied by %u threads.", workers.count, workers.rpc_pool_size);
+	return 1;
+}
+
+void worker_stop(void) {
+	struct timespec deadline;
+	unsigned int i;
+
+	if (workers.id != -1 || workers.count == 0) {
+		return;
+	}
+
+	/* LAUNCHER LOCK */
+	pthread_mutex_lock(&workers.launcher_lock);
+	/* no worker is restarted anymore */
+	workers.stopping = 1;
+	/* LAUNCHER UNLOCK */
+	pthread_mutex_unlock(&workers.launcher_lock);
+
+	for (i = 0; i < workers.count; ++i) {
+		kill(workers.procs[i].link.peer, SIGTERM);
+	}
+
+	/* the workers close their sessions the same way the owner does */
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += SHUTDOWN_TIMEOUT + 2;
+	for (i = 0; i < workers.count; ++i) {
+		if (workers.procs[i].tid == 0) {
+			/* terminated when it was started */
+			continue;
+		}
+		if (pthread_timedjoin_np(workers.procs[i].tid, NULL, &deadline) != 0) {
+			nc_verb_warning("Worker %u (PID %d) did not finish in time, killing it.", i, workers.procs[i].link.peer);
+			kill(workers.procs[i].link.peer, SIGKILL);
+			pthread_join(workers.procs[i].tid, NULL);
+		}
+	}
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+	/* nothing is queued anymore, the pool applies the queued RPCs first */
+	workers.rpc_quit = 1;
+	pthread_cond_broadcast(&workers.rpc_cond);
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	for (i = 0; i < workers.rpc_pool_size; ++i) {
+		pthread_join(workers.rpc_pool[i], NULL);
+	}
+	free(workers.rpc_pool);
+	workers.rpc_pool = NULL;
+	workers.rpc_pool_size = 0;
+
+	/* the workers are gone, it exits with no child left */
+	launcher_stop();
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	for (i = 0; i < workers.count; ++i) {
+		worker_fds_close(&workers.procs[i]);
+		pthread_mutex_destroy(&workers.procs[i].link.out_lock);
+	}
+	munmap(workers.shm, workers.shm_size);
+	workers.shm = NULL;
+	free(workers.procs);
+	workers.procs = NULL;
+	workers.count = 0;
+	workers.stopping = 0;
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+
+	nc_verb_verbose("Worker processes stopped.");
+}
+
+int worker_id(void) {
+	return workers.id;
+}
+
+unsigned int worker_count(void) {
+	return workers.count;
+}
+
+void worker_stats(xmlNodePtr parent) {
+	xmlNodePtr node;
+	unsigned int i;
+	char str[32];
+
+	/* WORKER LOCK */
+	pthread_mutex_lock(&workers.lock);
+
+	for (i = 0; i < workers.count; ++i) {
+		node = xmlNewChild(parent, parent->ns, BAD_CAST "worker", NULL);
+		sprintf(str, "%u", i);
+		xmlNewChild(node, node->ns, BAD_CAST "id", BAD_CAST str);
+		sprintf(str, "%d", workers.procs[i].link.peer);
+		xmlNewChild(node, node->ns, BAD_CAST "pid", BAD_CAST str);
+		xmlNewChild(node, node->ns, BAD_CAST "running", BAD_CAST (workers.procs[i].link.dead ? "false" : "true"));
+		sprintf(str, "%u", workers.procs[i].sess_count);
+		xmlNewChild(node, node->ns, BAD_CAST "sessions", BAD_CAST str);
+		sprintf(str, "%lu", workers.procs[i].rpcs);
+		xmlNewChild(node, node->ns, BAD_CAST "rpcs", BAD_CAST str);
+		sprintf(str, "%lu", workers.procs[i].restarts);
+		xmlNewChild(node, node->ns, BAD_CAST "restarts", BAD_CAST str);
+	}
+
+	/* WORKER UNLOCK */
+	pthread_mutex_unlock(&workers.lock);
+}
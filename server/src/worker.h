@@ -0,0 +1,152 @@
+/**
+ * @file worker.h
+ * @brief Netopeer session worker processes header
+ *
+ * Copyright (C) 2026 CESNET, z.s.p.o.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is, and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ */
+
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <libnetconf.h>
+#include <libxml/tree.h>
+
+/*
+ * With workers configured, the server forks a launcher once the internal
+ * modules are loaded, before any other thread is started and before the other
+ * modules are enabled. The launcher forks the worker processes, at the start
+ * and whenever one of them exited, so the server, the owner, never forks with
+ * its threads running. The owner listens on all the SSH and TLS binds, and every worker accepts on these
+ * sockets and runs the sessions it accepted. The owner never accepts on them,
+ * it keeps them open for a restart, and it keeps the datastores, the transAPI
+ * modules, the Unix socket and the Call Home sessions. The RPCs of the worker
+ * sessions that need the datastores are passed to the owner through a pair of
+ * shared-memory rings of each worker and applied there on behalf of the session.
+ */
+
+/**
+ * @brief Fork the worker processes, in the owner
+ *
+ * @param count Number of the workers
+ *
+ * @return 0 in a new worker, 1 in the owner, -1 if no worker could be started
+ */
+int worker_start(unsigned int count);
+
+/**
+ * @brief Terminate the workers and wait for them to finish their sessions,
+ * in the owner, before the datastores are freed
+ */
+void worker_stop(void);
+
+/**
+ * @brief Index of this worker process
+ *
+ * @return Index, -1 in the owner
+ */
+int worker_id(void);
+
+/**
+ * @brief Number of the workers started by the owner
+ */
+unsigned int worker_count(void);
+
+/**
+ * @brief Apply an RPC in the owner process, in a worker
+ *
+ * @param session Session of the RPC
+ * @param rpc RPC
+ *
+ * @return Reply of the owner
+ */
+nc_reply* worker_rpc(struct nc_session* session, const nc_rpc* rpc);
+
+/**
+ * @brief Kill a session of another process, the owner passes it to the worker
+ * running it
+ *
+ * @param sid Session ID
+ *
+ * @return 0 - the session is being killed, 1 - session not found
+ */
+int worker_kill(const char* sid);
+
+/**
+ * @brief Announce a new session to the owner, in a worker, so that it can be
+ * killed and its RPCs applied there
+ *
+ * @param session New session
+ *
+ * @return 0 - the owner knows the session, 1 - error
+ */
+int worker_session_start(struct nc_session* session);
+
+/**
+ * @brief Let the owner free its copy of a finished session, in a worker
+ *
+ * @param sid Session ID
+ */
+void worker_session_end(const char* sid);
+
+/**
+ * @brief Get the capabilities of the owner for a server hello, in a worker,
+ * module_get_cpblts() calls it only after worker_cpblts_changes() changed
+ *
+ * @return Capabilities to be freed by nc_cpblts_free()
+ */
+struct nc_cpblts* worker_cpblts(void);
+
+/**
+ * @brief Publish a change of the advertised capabilities to all the workers,
+ * in the owner
+ *
+ * @param changes The new value of the capability change counter
+ */
+void worker_cpblts_changed(unsigned int changes);
+
+/**
+ * @brief Capability change counter last published by the owner, in a worker,
+ * the capabilities of the owner are asked for again only once it changes
+ *
+ * @return Counter value
+ */
+unsigned int worker_cpblts_changes(void);
+
+/**
+ * @brief Add a worker element for every worker as children
+ *
+ * @param parent Parent element, its namespace is used
+ */
+void worker_stats(xmlNodePtr parent);
+
+#endif /* _WORKER_H_ */